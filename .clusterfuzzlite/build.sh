@@ -11,4 +11,5 @@ $CXX $CFLAGS $LIB_FUZZING_ENGINE \
   -stdlib=libc++ -std=c++17 \
   -o $OUT/parser_fuzzer \
   -I$SRC/muparserx/parser \
-  $SRC/muparserx/build/libmuparserx.a
+  $SRC/muparserx/build/libmuparserx.a \
+  -lpthread -ldl
@@ -0,0 +1,444 @@
+/** \file
+    \brief Implementation of the C++ code generator for real valued expressions.
+
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpCodeGen.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <type_traits>
+
+#include "mpRealEngine.h"
+
+
+MUP_NAMESPACE_START
+
+namespace
+{
+	//---------------------------------------------------------------------------
+	/** \brief Definitions at the beginning of each generated file. 
+	
+		PowReal is the power operator of the non complex package (see 
+		mpRealEngine.cpp).
+	*/
+	const char* const c_szHeader =
+		"#include <cmath>\n"
+		"#include <complex>\n"
+		"#include <cstdint>\n"
+		"#include <cstring>\n"
+		"\n"
+		"namespace\n"
+		"{\n"
+		"  typedef double float_type;\n"
+		"  typedef std::int64_t int_type;\n"
+		"  typedef std::complex<float_type> cmplx_type;\n"
+		"\n"
+		"  inline float_type FromBits(std::uint64_t nBits)\n"
+		"  {\n"
+		"    float_type v;\n"
+		"    std::memcpy(&v, &nBits, sizeof(v));\n"
+		"    return v;\n"
+		"  }\n"
+		"\n"
+		"  inline float_type PowReal(float_type a, float_type b)\n"
+		"  {\n"
+		"    int ib = (int)b;\n"
+		"    if (b - ib != 0)\n"
+		"      return std::pow(a, b);\n"
+		"\n"
+		"    switch (ib)\n"
+		"    {\n"
+		"    case 1:  return a;\n"
+		"    case 2:  return a * a;\n"
+		"    case 3:  return a * a * a;\n"
+		"    case 4:  return a * a * a * a;\n"
+		"    case 5:  return a * a * a * a * a;\n"
+		"    default: return std::pow(a, ib);\n"
+		"    }\n"
+		"  }\n"
+		"}\n";
+
+	//---------------------------------------------------------------------------
+	/** \brief Replace the placeholders %1 and %2 in the code of a function. */
+	std::string Subst(const char* szCode, const std::string& sArg1, const std::string& sArg2 = std::string())
+	{
+		std::string sRes;
+		for (const char* p = szCode; *p != 0; ++p)
+		{
+			if (p[0] == '%' && (p[1] == '1' || p[1] == '2'))
+			{
+				sRes += (p[1] == '1') ? sArg1 : sArg2;
+				++p;
+			}
+			else
+				sRes += *p;
+		}
+
+		return sRes;
+	}
+
+	//---------------------------------------------------------------------------
+	/** \brief Returns a constant as exact C++ expression. */
+	std::string Literal(float_type fVal)
+	{
+		std::uint64_t nBits;
+		std::memcpy(&nBits, &fVal, sizeof(nBits));
+
+		std::ostringstream ss;
+		ss << "FromBits(0x" << std::hex << std::setw(16) << std::setfill('0') << nBits << "ULL)";
+		return ss.str();
+	}
+
+	//---------------------------------------------------------------------------
+	std::string Stack(int nIdx)
+	{
+		return "s" + std::to_string(nIdx);
+	}
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if code can be generated for the value types of this build. */
+bool CodeGen::IsSupported()
+{
+	return std::is_same<float_type, double>::value && std::is_same<int_type, std::int64_t>::value;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Compute the stack depth before each instruction.
+	\param engine The bytecode engine
+	\param vDepth Receives the depth before each instruction and at the end.
+	\param vTarget Receives true for the instructions that are jump targets.
+	\return false if the depth is not the same on all paths.
+*/
+bool CodeGen::GetStackDepth(const RealEngine& engine, std::vector<int>& vDepth, std::vector<bool>& vTarget)
+{
+	const std::vector<RealEngine::SInstr>& vInstr = engine.m_vInstr;
+	const std::size_t nSize = vInstr.size();
+	vDepth.assign(nSize + 1, -1);
+	vTarget.assign(nSize + 1, false);
+
+	auto SetDepth = [&](std::size_t nIdx, int nDepth)
+	{
+		if (nIdx > nSize || (vDepth[nIdx] >= 0 && vDepth[nIdx] != nDepth))
+			return false;
+
+		vDepth[nIdx] = nDepth;
+		return true;
+	};
+
+	int d = 0;
+	bool bReachable = true;
+	for (std::size_t i = 0; i <= nSize; ++i)
+	{
+		if (bReachable)
+		{
+			if (!SetDepth(i, d))
+				return false;
+		}
+		else if (vDepth[i] < 0)
+			return false;
+
+		d = vDepth[i];
+		bReachable = true;
+		if (i == nSize)
+			break;
+
+		const RealEngine::SInstr& instr = vInstr[i];
+		int nArgs = 1;
+		switch (instr.eCode)
+		{
+		case RealEngine::opVAL:
+		case RealEngine::opVAR:
+		case RealEngine::opLOAD:
+		case RealEngine::opJMP:
+			nArgs = 0;
+			break;
+
+		case RealEngine::opADD:
+		case RealEngine::opSUB:
+		case RealEngine::opMUL:
+		case RealEngine::opMUL_CMPLX:
+		case RealEngine::opDIV:
+		case RealEngine::opPOW:
+		case RealEngine::opPOW_CMPLX:
+		case RealEngine::opLT:
+		case RealEngine::opGT:
+		case RealEngine::opLE:
+		case RealEngine::opGE:
+		case RealEngine::opEQ:
+		case RealEngine::opNEQ:
+		case RealEngine::opFUN2:
+		case RealEngine::opFUN2_CMPLX:
+			nArgs = 2;
+			break;
+
+		case RealEngine::opFMA:
+			nArgs = 3;
+			break;
+
+		default:
+			break;
+		}
+
+		if (d < nArgs)
+			return false;
+
+		switch (instr.eCode)
+		{
+		case RealEngine::opVAL:
+		case RealEngine::opVAR:
+		case RealEngine::opLOAD:
+			++d;
+			break;
+
+		case RealEngine::opIF:
+			--d;
+			vTarget[instr.nIdx] = true;
+			if (!SetDepth(instr.nIdx, d))
+				return false;
+			break;
+
+		case RealEngine::opJMP:
+			vTarget[instr.nIdx] = true;
+			if (!SetDepth(instr.nIdx, d))
+				return false;
+			bReachable = false;
+			break;
+
+		case RealEngine::opOR:
+		case RealEngine::opAND:
+			vTarget[instr.nIdx] = true;
+			if (!SetDepth(instr.nIdx, d))
+				return false;
+			--d;
+			break;
+
+		default:
+			d -= nArgs - 1;
+			break;
+		}
+	}
+
+	return vDepth[nSize] == 1;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create a C++ translation unit computing the expression of a bytecode engine.
+	\param engine The bytecode engine
+	\param sFunName The name of the generated function
+	\param sComment A comment written at the beginning of the file, i.e. the expression
+	\param sCode Receives the code
+	\return false if the bytecode can't be translated.
+
+	Each stack item and each temporary value becomes a local variable. 
+	Conditional code is translated into gotos.
+*/
+bool CodeGen::Generate(const RealEngine& engine, const std::string& sFunName, const std::string& sComment, std::string& sCode)
+{
+	std::vector<int> vDepth;
+	std::vector<bool> vTarget;
+	if (!IsSupported() || !engine.IsValid() || !GetStackDepth(engine, vDepth, vTarget))
+		return false;
+
+	const std::vector<RealEngine::SInstr>& vInstr = engine.m_vInstr;
+	int nMaxDepth = 0;
+	for (int d : vDepth)
+		nMaxDepth = std::max(nMaxDepth, d);
+
+	std::ostringstream ss;
+	ss << "// Generated by muparserx\n";
+	if (!sComment.empty())
+	{
+		ss << "//\n// ";
+		for (char c : sComment)
+			ss << ((c == '\n' || c == '\r') ? ' ' : c);
+		ss << "\n";
+	}
+
+	ss << "\n" << c_szHeader << "\n"
+	   << "extern \"C\" int " << sFunName << "(float_type *pVar, float_type *pRes)\n"
+	   << "{\n";
+
+	for (int i = 0; i < nMaxDepth; ++i)
+		ss << "  float_type " << Stack(i) << ";\n";
+
+	for (int i = 0; i < engine.m_nTempSlots; ++i)
+		ss << "  float_type t" << i << ";\n";
+
+	ss << "\n";
+	for (std::size_t i = 0; i < vInstr.size(); ++i)
+	{
+		const RealEngine::SInstr& instr = vInstr[i];
+		const int d = vDepth[i];
+		const std::string sTop = (d > 0) ? Stack(d - 1) : std::string();
+		const std::string sArg1 = (d > 1) ? Stack(d - 2) : std::string();
+
+		if (vTarget[i])
+			ss << "L" << i << ":\n";
+
+		ss << "  ";
+		switch (instr.eCode)
+		{
+		case RealEngine::opVAL:   ss << Stack(d) << " = " << Literal(instr.fVal) << ";"; break;
+		case RealEngine::opVAR:   ss << Stack(d) << " = pVar[" << instr.nIdx << "];"; break;
+		case RealEngine::opLOAD:  ss << Stack(d) << " = t" << instr.nIdx << ";"; break;
+		case RealEngine::opSTORE: ss << "t" << instr.nIdx << " = " << sTop << ";"; break;
+
+		case RealEngine::opADD: ss << sArg1 << " = " << sArg1 << " + " << sTop << ";"; break;
+		case RealEngine::opSUB: ss << sArg1 << " = " << sArg1 << " - " << sTop << ";"; break;
+		case RealEngine::opMUL: ss << sArg1 << " = " << sArg1 << " * " << sTop << ";"; break;
+		case RealEngine::opDIV: ss << sArg1 << " = " << sArg1 << " / " << sTop << ";"; break;
+		case RealEngine::opNEG: ss << sTop << " = -" << sTop << ";"; break;
+
+		case RealEngine::opMUL_CMPLX:
+			ss << sArg1 << " = " << sArg1 << " * " << sTop << "; "
+			   << "if (" << sArg1 << " == 0 || !std::isfinite(" << sArg1 << ")) return 0;";
+			break;
+
+		case RealEngine::opPOW:
+			ss << sArg1 << " = PowReal(" << sArg1 << ", " << sTop << ");";
+			break;
+
+		case RealEngine::opPOW_CMPLX:
+			ss << "if (" << sArg1 << " < 0 && " << sTop << " != static_cast<int_type>(" << sTop << ")) return 0; "
+			   << sArg1 << " = std::pow(" << sArg1 << ", " << sTop << ");";
+			break;
+
+		case RealEngine::opNEG_CMPLX:
+			ss << sTop << " = (" << sTop << " == 0) ? 0 : -" << sTop << ";";
+			break;
+
+		case RealEngine::opLT:
+		case RealEngine::opGT:
+		case RealEngine::opLE:
+		case RealEngine::opGE:
+		case RealEngine::opEQ:
+		case RealEngine::opNEQ:
+		{
+			const char* szOp[] = { "<", ">", "<=", ">=", "==", "!=" };
+			ss << sArg1 << " = (" << sArg1 << " " << szOp[instr.eCode - RealEngine::opLT] << " " << sTop << ") ? 1 : 0;";
+		}
+		break;
+
+		case RealEngine::opFUN1:
+			ss << sTop << " = " << Subst(instr.szCode, sTop) << ";";
+			break;
+
+		case RealEngine::opFUN2:
+			ss << sArg1 << " = " << Subst(instr.szCode, sArg1, sTop) << ";";
+			break;
+
+		case RealEngine::opFUN1_CMPLX:
+			ss << "{ cmplx_type v = " << Subst(instr.szCode, "cmplx_type(" + sTop + ", 0)") << "; "
+			   << "if (v.imag() != 0) return 0; " << sTop << " = v.real(); }";
+			break;
+
+		case RealEngine::opFUN2_CMPLX:
+			ss << "{ cmplx_type v = " << Subst(instr.szCode, "cmplx_type(" + sArg1 + ", 0)", "cmplx_type(" + sTop + ", 0)") << "; "
+			   << "if (v.imag() != 0) return 0; " << sArg1 << " = v.real(); }";
+			break;
+
+		case RealEngine::opFMA:
+		{
+			const std::string sArg0 = Stack(d - 3);
+			if (instr.nIdx != 0)
+				ss << "if (" << sArg0 << " * " << sArg1 << " == 0 || !std::isfinite(" << sArg0 << " * " << sArg1 << ")) return 0; ";
+
+			ss << sArg0 << " = std::fma(" << sArg0 << ", " << sArg1 << ", " << sTop << ");";
+		}
+		break;
+
+		case RealEngine::opIF:  ss << "if (" << sTop << " != 1) goto L" << instr.nIdx << ";"; break;
+		case RealEngine::opJMP: ss << "goto L" << instr.nIdx << ";"; break;
+		case RealEngine::opOR:  ss << "if (" << sTop << " == 1) goto L" << instr.nIdx << ";"; break;
+		case RealEngine::opAND: ss << "if (" << sTop << " != 1) goto L" << instr.nIdx << ";"; break;
+
+		// Strength reduced operators fail for arguments that are not finite
+		case RealEngine::opIDENTITY:
+		case RealEngine::opADD_ZERO:
+		case RealEngine::opPOW_INT:
+		case RealEngine::opMUL_CONST:
+		case RealEngine::opDIV_CONST:
+			ss << "if (!std::isfinite(" << sTop << ")) return 0; ";
+			switch (instr.eCode)
+			{
+			case RealEngine::opADD_ZERO:
+				ss << sTop << " = (" << sTop << " == 0) ? 0 : " << sTop << ";";
+				break;
+
+			case RealEngine::opPOW_INT:
+				if (instr.nIdx < 2 || instr.nIdx > 5)
+					return false;
+
+				ss << sTop << " = " << sTop;
+				for (int k = 1; k < instr.nIdx; ++k)
+					ss << " * " << sTop;
+				ss << ";";
+				break;
+
+			case RealEngine::opMUL_CONST:
+				ss << sTop << " = " << sTop << " * " << Literal(instr.fVal) << ";";
+				break;
+
+			case RealEngine::opDIV_CONST:
+				ss << sTop << " = " << sTop << " / " << Literal(instr.fVal) << ";";
+				break;
+
+			default:
+				break;
+			}
+			break;
+
+		default:
+			return false;
+		}
+
+		ss << "\n";
+	}
+
+	if (vTarget[vInstr.size()])
+		ss << "L" << vInstr.size() << ":\n";
+
+	ss << "  *pRes = s0;\n"
+	   << "  return 1;\n"
+	   << "}\n";
+
+	sCode = ss.str();
+	return true;
+}
+
+MUP_NAMESPACE_END
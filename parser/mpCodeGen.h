@@ -0,0 +1,84 @@
+#ifndef MUP_CODE_GEN_H
+#define MUP_CODE_GEN_H
+
+/** \file
+    \brief Definition of the C++ code generator for real valued expressions.
+
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <string>
+#include <vector>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief Translates the bytecode of a RealEngine into C++ source code.
+
+    The generated translation unit is standalone, it includes only headers 
+    of the standard library. It defines a single function with C linkage:
+
+    <pre>
+    extern "C" int name(double *pVar, double *pRes);
+    </pre>
+
+    pVar holds the values of the variables in the order of 
+    RealEngine::GetVar(). The function stores the result in pRes and returns
+    1, or 0 if the bytecode engine would fail for these values. Built in 
+    functions are called inline with the same functions of the standard 
+    library the bytecode engine uses, so the results are bit identical
+    provided the code is compiled without floating point contraction.
+    See NativeCache for building and loading the code at runtime.
+  */
+  class CodeGen
+  {
+  public:
+
+    static bool IsSupported();
+    static bool Generate(const RealEngine &engine, 
+                         const std::string &sFunName, 
+                         const std::string &sComment,
+                         std::string &sCode);
+
+  private:
+
+    static bool GetStackDepth(const RealEngine &engine, std::vector<int> &vDepth, std::vector<bool> &vTarget);
+  };
+
+MUP_NAMESPACE_END
+
+#endif
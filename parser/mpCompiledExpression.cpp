@@ -0,0 +1,151 @@
+/** \file
+    \brief Implementation of an immutable expression that can be shared by several threads.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+#include "mpCompiledExpression.h"
+
+#include "mpParserBase.h"
+
+MUP_NAMESPACE_START
+
+//---------------------------------------------------------------------------
+/** \brief Compile the expression of a parser.
+	\param a_Parser The parser
+	\throw ParserError in case of syntax errors in the expression of the parser.
+
+	The RPN is copied including its tokens, so the parser may change or 
+	parse another expression afterwards.
+*/
+CompiledExpression::CompiledExpression(const ParserXBase& a_Parser)
+	:m_pData()
+{
+	if (a_Parser.m_pParserEngine == &ParserXBase::ParseFromString)
+		a_Parser.CreateEngine();
+
+	if (a_Parser.m_pParserEngine == &ParserXBase::ParseTiered)
+		a_Parser.FinishTierUp();
+
+	std::shared_ptr<SData> pData = std::make_shared<SData>();
+	pData->m_sExpr = a_Parser.m_pTokenReader->GetExpr();
+	pData->m_nPos = a_Parser.m_pTokenReader->GetPos();
+	pData->m_rpn = a_Parser.m_rpn.Clone();
+	pData->m_bRealEngine = a_Parser.m_pParserEngine == &ParserXBase::ParseFromRealEngine ||
+						   a_Parser.m_pParserEngine == &ParserXBase::ParseFromJit;
+	if (pData->m_bRealEngine)
+		pData->m_realEngine = a_Parser.m_realEngine;
+
+	m_pData = pData;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create a copy of a compiled expression that is evaluated by native code.
+	\param a_Expr The compiled expression
+	\param a_pNative Native code created from the bytecode of the expression
+*/
+CompiledExpression::CompiledExpression(const CompiledExpression& a_Expr, const std::shared_ptr<const JitEngine>& a_pNative)
+	:m_pData()
+{
+	const SData& src = *a_Expr.m_pData;
+	std::shared_ptr<SData> pData = std::make_shared<SData>();
+	pData->m_sExpr = src.m_sExpr;
+	pData->m_nPos = src.m_nPos;
+	pData->m_rpn = src.m_rpn.Clone();
+	pData->m_realEngine = src.m_realEngine;
+	pData->m_bRealEngine = src.m_bRealEngine;
+	pData->m_pNative = a_pNative;
+	m_pData = pData;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create a compiled expression from its data. 
+	
+	Used by RPNArchive for expressions that were not compiled by a parser.
+*/
+CompiledExpression::CompiledExpression(const std::shared_ptr<const SData>& a_pData)
+	:m_pData(a_pData)
+{}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the expression.
+	\param a_Ctx The evaluation context of the calling thread
+	\return The result. It remains valid until the context is used for
+	        the next evaluation.
+*/
+const IValue& CompiledExpression::Eval(EvalContext& a_Ctx) const
+{
+	const SData& data = *m_pData;
+	if (a_Ctx.m_pExpr != m_pData)
+	{
+		a_Ctx.Init(data.m_rpn, (data.m_bRealEngine) ? &data.m_realEngine : nullptr);
+		a_Ctx.m_pExpr = m_pData;
+	}
+
+	if (data.m_bRealEngine)
+	{
+		const IValue* pVal = a_Ctx.ParseFromRealEngine(data.m_realEngine, data.m_pNative.get());
+		if (pVal != nullptr)
+			return *pVal;
+	}
+
+	return a_Ctx.ParseFromRPN(data.m_rpn, data.m_sExpr, data.m_nPos);
+}
+
+//---------------------------------------------------------------------------
+const string_type& CompiledExpression::GetExpr() const
+{
+	return m_pData->m_sExpr;
+}
+
+//---------------------------------------------------------------------------
+const RPN& CompiledExpression::GetRPN() const
+{
+	return m_pData->m_rpn;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if the expression is evaluated by the bytecode engine 
+		   for real numbers. */
+bool CompiledExpression::IsRealEngineUsed() const
+{
+	return m_pData->m_bRealEngine;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if the expression is evaluated by native code 
+		   loaded by a NativeCache. */
+bool CompiledExpression::IsNativeCodeUsed() const
+{
+	return m_pData->m_pNative != nullptr;
+}
+
+MUP_NAMESPACE_END
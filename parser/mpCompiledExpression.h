@@ -0,0 +1,106 @@
+#ifndef MUP_COMPILED_EXPRESSION_H
+#define MUP_COMPILED_EXPRESSION_H
+
+/** \file
+    \brief Definition of an immutable expression that can be shared by several threads.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <memory>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+#include "mpRPN.h"
+#include "mpRealEngine.h"
+#include "mpEvalContext.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief An expression compiled by a parser that can be evaluated by 
+             several threads at the same time.
+
+    The compiled expression contains copies of the RPN and the bytecode of
+    the parser. It does not change after construction and does not depend
+    on the parser. Copies of a compiled expression share the same data.
+    All mutable state needed for the evaluation is kept in an EvalContext.
+    Each thread must use its own context.
+
+    The variables of the expression refer to the values they are bound to
+    in the parser unless a context binds them to other values (see 
+    EvalContext::DefineVar). These values must stay valid as long as the
+    expression is evaluated. Expressions changing their variables (i.e. 
+    by the assignment operators) or calling functions that are not thread 
+    safe must not be evaluated by several threads with shared variables.
+  */
+  class CompiledExpression
+  {
+  public:
+
+    explicit CompiledExpression(const ParserXBase &a_Parser);
+
+    const IValue& Eval(EvalContext &a_Ctx) const;
+
+    const string_type& GetExpr() const;
+    const RPN& GetRPN() const;
+    bool IsRealEngineUsed() const;
+    bool IsNativeCodeUsed() const;
+
+  private:
+
+    friend class NativeCache;
+    friend class RPNArchive;
+    friend class RPNArchiveWriter;
+
+    CompiledExpression(const CompiledExpression &a_Expr, const std::shared_ptr<const JitEngine> &a_pNative);
+
+    /** \brief The data shared by all copies of a compiled expression. */
+    struct SData
+    {
+      string_type m_sExpr;
+      int m_nPos;                 ///< Position of the token reader after parsing
+      RPN m_rpn;
+      RealEngine m_realEngine;
+      bool m_bRealEngine;         ///< True if m_realEngine was compiled successfully
+      std::shared_ptr<const JitEngine> m_pNative;   ///< Native code of m_realEngine loaded by a NativeCache
+    };
+
+    explicit CompiledExpression(const std::shared_ptr<const SData> &a_pData);
+
+    std::shared_ptr<const SData> m_pData;
+  };
+
+MUP_NAMESPACE_END
+
+#endif
@@ -0,0 +1,1508 @@
+/** \file
+    \brief Implementation of the per thread state used for evaluating expressions.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+#include "mpEvalContext.h"
+
+#include <map>
+
+#include "mpRPN.h"
+#include "mpRealEngine.h"
+#include "mpJitEngine.h"
+#include "mpICallback.h"
+#include "mpIOprtBinShortcut.h"
+#include "mpIfThenElse.h"
+#include "mpTempTokens.h"
+#include "mpVariable.h"
+#include "mpValue.h"
+#include "mpError.h"
+#include "mpMatrixError.h"
+#include "mpOprtNonCmplx.h"
+#include "mpOprtCmplx.h"
+#include "mpOprtBinCommon.h"
+#include "mpOprtFused.h"
+
+#include <typeinfo>
+
+// Chain the handlers of the threaded code by computed gotos if the compiler 
+// supports taking the address of a label
+#if defined(__GNUC__)
+	#define MUP_COMPUTED_GOTO
+#endif
+
+MUP_NAMESPACE_START
+
+namespace
+{
+	//---------------------------------------------------------------------------
+	/** \brief Returns the index of a built in binary operator with a handler of 
+			   its own in the order add, sub, mul, div, lt, gt, le, ge, eq, neq 
+			   or -1 for other tokens.
+	*/
+	int GetBinaryOprt(const IToken* pTok)
+	{
+		const std::type_info& type = typeid(*pTok);
+		if (type == typeid(OprtAdd) || type == typeid(OprtAddCmplx))
+			return 0;
+		else if (type == typeid(OprtSub) || type == typeid(OprtSubCmplx))
+			return 1;
+		else if (type == typeid(OprtMul))
+			return 2;
+		else if (type == typeid(OprtDiv) || type == typeid(OprtDivCmplx))
+			return 3;
+		else if (type == typeid(OprtLT))
+			return 4;
+		else if (type == typeid(OprtGT))
+			return 5;
+		else if (type == typeid(OprtLE))
+			return 6;
+		else if (type == typeid(OprtGE))
+			return 7;
+		else if (type == typeid(OprtEQ))
+			return 8;
+		else if (type == typeid(OprtNEQ))
+			return 9;
+		else
+			return -1;
+	}
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+EvalContext::EvalContext()
+	:m_varDef()
+	, m_pExpr()
+	, m_vVar()
+	, m_vFusedArg()
+	, m_vStackBuffer()
+	, m_vTempBuffer()
+	, m_cache()
+	, m_vRealVar()
+	, m_vRealBuffer()
+	, m_vCode()
+	, m_vRegCode()
+	, m_vConstReg()
+	, m_bThreadedCode(true)
+	, m_bRegisterCode(false)
+{}
+
+//---------------------------------------------------------------------------
+EvalContext::~EvalContext()
+{
+	// The stack buffer must be released before the value cache
+	// since it may contain values referencing the cache.
+	m_vStackBuffer.clear();
+	m_vTempBuffer.clear();
+	m_vConstReg.clear();
+	m_vFusedArg.clear();
+	m_cache.ReleaseAll();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Bind a variable of the expressions evaluated with this context 
+		   to another value.
+	\param ident The name of the variable
+	\param var The variable
+*/
+void EvalContext::DefineVar(const string_type& ident, const Variable& var)
+{
+	m_varDef[ident] = ptr_tok_type(var.Clone());
+	m_pExpr.reset();
+}
+
+//---------------------------------------------------------------------------
+void EvalContext::RemoveVar(const string_type& ident)
+{
+	m_varDef.erase(ident);
+	m_pExpr.reset();
+}
+
+//---------------------------------------------------------------------------
+void EvalContext::ClearVar()
+{
+	m_varDef.clear();
+	m_pExpr.reset();
+}
+
+//---------------------------------------------------------------------------
+bool EvalContext::IsVarDefined(const string_type& ident) const
+{
+	return m_varDef.find(ident) != m_varDef.end();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Enable or disable the threaded code of the generic engine.
+
+	If disabled, the generic engine decodes the RPN tokens during each 
+	evaluation. Enabled by default. The setting takes effect the next time
+	an expression is evaluated with this context.
+*/
+void EvalContext::EnableThreadedCode(bool bStat)
+{
+	m_bThreadedCode = bStat;
+	m_pExpr.reset();
+}
+
+//---------------------------------------------------------------------------
+bool EvalContext::IsThreadedCodeEnabled() const
+{
+	return m_bThreadedCode;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Enable or disable the register code of the generic engine.
+
+	If enabled, the register code is used instead of the threaded code. 
+	Disabled by default. The setting takes effect the next time an 
+	expression is evaluated with this context.
+*/
+void EvalContext::EnableRegisterCode(bool bStat)
+{
+	m_bRegisterCode = bStat;
+	m_pExpr.reset();
+}
+
+//---------------------------------------------------------------------------
+bool EvalContext::IsRegisterCodeEnabled() const
+{
+	return m_bRegisterCode;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the buffers needed for evaluating an expression.
+	\param rpn The RPN of the expression
+	\param pRealEngine The bytecode engine of the expression or nullptr
+
+	Each variable token of the RPN gets a copy owned by this context. The 
+	stack holds references to these copies instead of the tokens of the 
+	RPN, so the reference counters of the RPN tokens are never modified 
+	during evaluation.
+*/
+void EvalContext::Init(const RPN& rpn, const RealEngine* pRealEngine)
+{
+	Reset();
+
+	m_vStackBuffer.assign(rpn.GetRequiredStackSize(), ptr_val_type());
+	for (std::size_t i = 0; i < m_vStackBuffer.size(); ++i)
+	{
+		Value* pValue = new Value;
+		pValue->BindToCache(&m_cache);
+		m_vStackBuffer[i].Reset(pValue);
+	}
+
+	m_vTempBuffer.assign(rpn.GetNumTempSlots(), ptr_val_type());
+	for (std::size_t i = 0; i < m_vTempBuffer.size(); ++i)
+		m_vTempBuffer[i].Reset(new Value);
+
+	std::map<const IValue*, const IValue*> mapBound;
+	auto CopyVar = [&](const Variable* pVar)
+	{
+		Variable* pCopy = new Variable(*pVar);
+		pCopy->SetIdent(pVar->GetIdent());
+		pCopy->SetExprPos(pVar->GetExprPos());
+
+		var_maptype::const_iterator item = m_varDef.find(pVar->GetIdent());
+		if (item != m_varDef.end())
+			pCopy->Bind(static_cast<Variable*>(item->second.Get())->GetPtr());
+
+		mapBound[pVar->GetPtr()] = pCopy->GetPtr();
+		return pCopy;
+	};
+
+	const token_vec_type& vRPN = rpn.GetData();
+	m_vVar.assign(vRPN.size(), ptr_val_type());
+	m_vFusedArg.assign(vRPN.size(), val_vec_type());
+	for (std::size_t i = 0; i < vRPN.size(); ++i)
+	{
+		const IToken* pTok = vRPN[i].Get();
+		if (pTok->GetCode() == cmFUSED)
+		{
+			// The values of fused tokens are passed as arguments, constants are copied
+			for (const ptr_tok_type& tok : static_cast<const OprtFused*>(pTok)->GetTokens())
+			{
+				if (tok->GetCode() != cmVAL)
+					continue;
+
+				const IValue* pVal = tok->AsIValue();
+				if (pVal->IsVariable())
+					m_vFusedArg[i].push_back(ptr_val_type(CopyVar(static_cast<const Variable*>(pVal))));
+				else
+					m_vFusedArg[i].push_back(ptr_val_type(new Value(*pVal)));
+			}
+		}
+
+		if (pTok->GetCode() != cmVAL || !static_cast<const IValue*>(pTok)->IsVariable())
+			continue;
+
+		m_vVar[i].Reset(CopyVar(static_cast<const Variable*>(pTok)));
+	}
+
+	if (pRealEngine != nullptr)
+	{
+		const std::vector<const IValue*>& vVar = pRealEngine->GetVar();
+		m_vRealVar.resize(vVar.size());
+		for (std::size_t i = 0; i < vVar.size(); ++i)
+			m_vRealVar[i] = mapBound[vVar[i]];
+
+		m_vRealBuffer.assign(pRealEngine->GetBufferSize(), 0);
+	}
+
+	if (m_bRegisterCode)
+		CompileRegCode(rpn);
+
+	if (m_bThreadedCode && m_vRegCode.empty())
+		CompileCode(rpn);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Translate the RPN into threaded code.
+
+	The instructions refer to the variable copies of this context, so Init 
+	must have created them before. Tokens without an effect at runtime (end 
+	of if-then-else and of short circuit operators) are omitted and jumps 
+	point directly to their target instruction. If the RPN contains an 
+	unexpected token no code is created and ParseFromRPN reports the error.
+*/
+void EvalContext::CompileCode(const RPN& rpn)
+{
+	const token_vec_type& vRPN = rpn.GetData();
+	if (vRPN.empty())
+		return;
+
+	// Index of the instruction executed first for each RPN token
+	std::vector<int> vPos(vRPN.size() + 1);
+
+	m_vCode.reserve(vRPN.size() + 1);
+	for (std::size_t i = 0; i < vRPN.size(); ++i)
+	{
+		vPos[i] = (int)m_vCode.size();
+
+		IToken* pTok = vRPN[i].Get();
+		SCode code;
+		code.pHandler = nullptr;
+		code.nArgs = 0;
+		code.pTok = pTok;
+
+		switch (pTok->GetCode())
+		{
+		case cmSCRIPT_NEWLINE:
+			code.eCode = cdNEWLINE;
+			break;
+
+		case cmVAL:
+			if (static_cast<IValue*>(pTok)->IsVariable())
+			{
+				code.eCode = cdVAR;
+				code.pVar = &m_vVar[i];
+			}
+			else
+				code.eCode = cdVAL;
+			break;
+
+		case cmIC:
+			code.eCode = cdINDEX;
+			code.nArgs = static_cast<ICallback*>(pTok)->GetArgsPresent();
+			break;
+
+		case cmFUSED:
+			code.eCode = cdFUSED;
+			code.nArgs = (int)i;
+			break;
+
+		case cmOPRT_BIN:
+		case cmCBC:
+		case cmOPRT_POSTFIX:
+		case cmFUNC:
+		case cmOPRT_INFIX:
+		{
+			code.eCode = cdCALL;
+			code.nArgs = static_cast<ICallback*>(pTok)->GetArgsPresent();
+			if (pTok->GetCode() != cmOPRT_BIN || code.nArgs != 2)
+				break;
+
+			int nOprt = GetBinaryOprt(pTok);
+			if (nOprt >= 0)
+				code.eCode = (ECode)(cdADD + nOprt);
+		}
+		break;
+
+		case cmSTORE:
+			code.eCode = cdSTORE;
+			code.nArgs = static_cast<TokenTemp*>(pTok)->GetSlot();
+			break;
+
+		case cmLOAD:
+			code.eCode = cdLOAD;
+			code.nArgs = static_cast<TokenTemp*>(pTok)->GetSlot();
+			break;
+
+		// Jumps store the index of their target token until the code is complete
+		case cmIF:
+			code.eCode = cdIF;
+			code.nArgs = (int)i + static_cast<TokenIfThenElse*>(pTok)->GetOffset() + 1;
+			break;
+
+		case cmELSE:
+		case cmJMP:
+			code.eCode = cdJMP;
+			code.nArgs = (int)i + static_cast<TokenIfThenElse*>(pTok)->GetOffset() + 1;
+			break;
+
+		case cmSHORTCUT_BEGIN:
+			code.eCode = (pTok->AsIPrecedence()->GetPri() == prLOGIC_OR) ? cdOR : cdAND;
+			code.nArgs = (int)i + static_cast<IOprtBinShortcut*>(pTok)->GetOffset() + 1;
+			break;
+
+		case cmENDIF:
+		case cmSHORTCUT_END:
+			continue;
+
+		default:
+			m_vCode.clear();
+			return;
+		}
+
+		m_vCode.push_back(code);
+	}
+
+	vPos.back() = (int)m_vCode.size();
+
+	SCode end;
+	end.pHandler = nullptr;
+	end.eCode = cdEND;
+	end.nArgs = 0;
+	end.pTok = nullptr;
+	m_vCode.push_back(end);
+
+	for (std::size_t i = 0; i < m_vCode.size(); ++i)
+	{
+		SCode& code = m_vCode[i];
+		if (code.eCode == cdIF || code.eCode == cdJMP || code.eCode == cdOR || code.eCode == cdAND)
+		{
+			MUP_VERIFY(code.nArgs >= 0 && code.nArgs < (int)vPos.size());
+			code.pJump = &m_vCode[vPos[code.nArgs]];
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+/** \brief Translate the RPN into register code.
+
+	The compiler keeps a stack of operands instead of values. Variables, 
+	constants and temporary values are pushed as references to their storage.
+	They are moved into the register of their stack position only if a 
+	callback needs them there, before jumps and at jump targets. Registers a 
+	variable may be moved into are marked, all other registers always hold 
+	values owned by the context. If the RPN can't be translated no code is 
+	created and the threaded code or the RPN interpreter reports the error.
+*/
+void EvalContext::CompileRegCode(const RPN& rpn)
+{
+	const token_vec_type& vRPN = rpn.GetData();
+	const std::size_t nSize = vRPN.size();
+	if (nSize == 0)
+		return;
+
+	// An item of the compile time stack
+	struct SOperand
+	{
+		const ptr_val_type* pVal;
+		char cMode;                  // 'r' register of the stack position, 'p' variable, 'v' value
+		int nSlot;                   // Temporary slot of the value or -1
+	};
+
+	ptr_val_type* pReg = m_vStackBuffer.data();
+	const std::size_t nRegs = m_vStackBuffer.size();
+	std::vector<SOperand> vStack;
+	std::vector<bool> vVarReg(nRegs, false);     // Registers that may refer to a variable
+	std::vector<bool> vTarget(nSize + 1, false); // Tokens that are jump targets
+	std::vector<int> vDepth(nSize + 1, -1);      // Stack depth at the jump targets
+	std::vector<int> vPos(nSize + 1, 0);         // Index of the instruction executed first for each token
+	bool bReachable = true;
+	bool bValid = true;
+
+	m_vConstReg.reserve(nSize);
+	m_vRegCode.reserve(2 * nSize + 1);
+
+	auto Emit = [&](ERegCode eCode) -> SRegCode&
+	{
+		SRegCode code;
+		code.pHandler = nullptr;
+		code.eCode = eCode;
+		code.nArgs = 0;
+		code.pDst = nullptr;
+		code.pArg[0] = code.pArg[1] = nullptr;
+		code.cArgMode[0] = code.cArgMode[1] = 'r';
+		code.bVarDst = false;
+		code.pTok = nullptr;
+		m_vRegCode.push_back(code);
+		return m_vRegCode.back();
+	};
+
+	auto Push = [&](const ptr_val_type* pVal, char cMode, int nSlot)
+	{
+		if (vStack.size() >= nRegs)
+			bValid = false;
+		else
+			vStack.push_back(SOperand{ pVal, cMode, nSlot });
+	};
+
+	auto Materialize = [&](std::size_t nIdx)
+	{
+		SOperand& op = vStack[nIdx];
+		if (op.cMode == 'r')
+			return;
+
+		SRegCode& code = Emit((op.cMode == 'p') ? rgMOVPTR : rgMOVVAL);
+		code.pDst = &pReg[nIdx];
+		code.pArg[0] = op.pVal;
+		if (op.cMode == 'p')
+			vVarReg[nIdx] = true;
+
+		op = SOperand{ &pReg[nIdx], 'r', -1 };
+	};
+
+	auto MaterializeAll = [&]()
+	{
+		for (std::size_t k = 0; k < vStack.size(); ++k)
+			Materialize(k);
+	};
+
+	// All paths leading to a jump target must have the same stack depth
+	auto SetDepth = [&](int nTarget, int nDepth)
+	{
+		if (vDepth[nTarget] >= 0 && vDepth[nTarget] != nDepth)
+			bValid = false;
+
+		vDepth[nTarget] = nDepth;
+	};
+
+	// Find the jump targets, jumps store the index of their target token 
+	// until the code is complete
+	std::vector<int> vJump(nSize, -1);
+	for (std::size_t i = 0; i < nSize; ++i)
+	{
+		const IToken* pTok = vRPN[i].Get();
+		switch (pTok->GetCode())
+		{
+		case cmIF:
+		case cmELSE:
+		case cmJMP:
+			vJump[i] = (int)i + static_cast<const TokenIfThenElse*>(pTok)->GetOffset() + 1;
+			break;
+
+		case cmSHORTCUT_BEGIN:
+			vJump[i] = (int)i + static_cast<const IOprtBinShortcut*>(pTok)->GetOffset() + 1;
+			break;
+
+		default:
+			continue;
+		}
+
+		if (vJump[i] <= (int)i || vJump[i] > (int)nSize)
+			return;
+
+		vTarget[vJump[i]] = true;
+	}
+
+	for (std::size_t i = 0; i <= nSize && bValid; ++i)
+	{
+		// Values are in their registers at jump targets
+		if (vTarget[i])
+		{
+			if (bReachable)
+			{
+				MaterializeAll();
+				SetDepth((int)i, (int)vStack.size());
+			}
+			else
+			{
+				vStack.clear();
+				for (int k = 0; k < vDepth[i]; ++k)
+					Push(&pReg[k], 'r', -1);
+			}
+
+			bReachable = true;
+		}
+		else if (!bReachable)
+			bValid = false;
+
+		vPos[i] = (int)m_vRegCode.size();
+		if (i == nSize || !bValid)
+			break;
+
+		IToken* pTok = vRPN[i].Get();
+		switch (pTok->GetCode())
+		{
+		// The result of the last line is returned if the script ends with a newline
+		case cmSCRIPT_NEWLINE:
+			MaterializeAll();
+			vStack.clear();
+			break;
+
+		case cmVAL:
+			if (static_cast<IValue*>(pTok)->IsVariable())
+			{
+				Push(&m_vVar[i], 'p', -1);
+			}
+			else
+			{
+				m_vConstReg.push_back(ptr_val_type(new Value(*static_cast<IValue*>(pTok))));
+				Push(&m_vConstReg.back(), 'v', -1);
+			}
+			break;
+
+		case cmLOAD:
+		{
+			int nSlot = static_cast<TokenTemp*>(pTok)->GetSlot();
+			if (nSlot < 0 || nSlot >= (int)m_vTempBuffer.size())
+				bValid = false;
+			else
+				Push(&m_vTempBuffer[nSlot], 'v', nSlot);
+		}
+		break;
+
+		case cmSTORE:
+		{
+			int nSlot = static_cast<TokenTemp*>(pTok)->GetSlot();
+			if (vStack.empty() || nSlot < 0 || nSlot >= (int)m_vTempBuffer.size())
+			{
+				bValid = false;
+				break;
+			}
+
+			// Values loaded from the slot before must not change
+			for (std::size_t k = 0; k < vStack.size(); ++k)
+			{
+				if (vStack[k].nSlot == nSlot)
+					Materialize(k);
+			}
+
+			SRegCode& code = Emit(rgSTORE);
+			code.pDst = &m_vTempBuffer[nSlot];
+			code.pArg[0] = vStack.back().pVal;
+		}
+		break;
+
+		case cmIC:
+		{
+			int nArgs = static_cast<ICallback*>(pTok)->GetArgsPresent();
+			if (nArgs < 0 || (int)vStack.size() < nArgs + 1)
+			{
+				bValid = false;
+				break;
+			}
+
+			std::size_t nBase = vStack.size() - nArgs - 1;
+			for (std::size_t k = nBase; k < vStack.size(); ++k)
+				Materialize(k);
+
+			SRegCode& code = Emit(rgINDEX);
+			code.pDst = &pReg[nBase];
+			code.nArgs = nArgs;
+			code.pTok = pTok;
+			vVarReg[nBase] = true;
+			vStack.resize(nBase + 1);
+		}
+		break;
+
+		case cmFUSED:
+		{
+			// The original tokens are evaluated in the registers above the 
+			// result if the values are not real numbers
+			std::size_t nBase = vStack.size();
+			std::size_t nTop = nBase + static_cast<OprtFused*>(pTok)->GetStackSize();
+			if (nTop > nRegs)
+			{
+				bValid = false;
+				break;
+			}
+
+			SRegCode& code = Emit(rgFUSED);
+			code.pDst = &pReg[nBase];
+			code.pArg[0] = m_vFusedArg[i].data();
+			code.pTok = pTok;
+			std::fill(vVarReg.begin() + nBase, vVarReg.begin() + nTop, true);
+			Push(&pReg[nBase], 'r', -1);
+		}
+		break;
+
+		case cmOPRT_BIN:
+		case cmCBC:
+		case cmOPRT_POSTFIX:
+		case cmFUNC:
+		case cmOPRT_INFIX:
+		{
+			int nArgs = static_cast<ICallback*>(pTok)->GetArgsPresent();
+			if (nArgs < 0 || (int)vStack.size() < nArgs || vStack.size() - nArgs >= nRegs)
+			{
+				bValid = false;
+				break;
+			}
+
+			std::size_t nBase = vStack.size() - nArgs;
+			int nOprt = (pTok->GetCode() == cmOPRT_BIN && nArgs == 2) ? GetBinaryOprt(pTok) : -1;
+			if (nOprt >= 0)
+			{
+				// Operands are used where they are
+				SRegCode& code = Emit((ERegCode)(rgADD + nOprt));
+				code.pDst = &pReg[nBase];
+				code.pTok = pTok;
+				for (int k = 0; k < 2; ++k)
+				{
+					code.pArg[k] = vStack[nBase + k].pVal;
+					code.cArgMode[k] = vStack[nBase + k].cMode;
+				}
+			}
+			else
+			{
+				for (std::size_t k = nBase; k < vStack.size(); ++k)
+					Materialize(k);
+
+				SRegCode& code = Emit(rgCALL);
+				code.pDst = &pReg[nBase];
+				code.nArgs = nArgs;
+				code.pTok = pTok;
+				vVarReg[nBase] = true;
+			}
+
+			vStack.resize(nBase);
+			Push(&pReg[nBase], 'r', -1);
+		}
+		break;
+
+		case cmIF:
+		{
+			if (vStack.empty())
+			{
+				bValid = false;
+				break;
+			}
+
+			SOperand cond = vStack.back();
+			vStack.pop_back();
+			MaterializeAll();
+
+			SRegCode& code = Emit(rgIF);
+			code.pArg[0] = cond.pVal;
+			code.nArgs = vJump[i];
+			SetDepth(vJump[i], (int)vStack.size());
+		}
+		break;
+
+		case cmELSE:
+		case cmJMP:
+		{
+			MaterializeAll();
+
+			SRegCode& code = Emit(rgJMP);
+			code.nArgs = vJump[i];
+			SetDepth(vJump[i], (int)vStack.size());
+			bReachable = false;
+		}
+		break;
+
+		case cmSHORTCUT_BEGIN:
+		{
+			if (vStack.empty())
+			{
+				bValid = false;
+				break;
+			}
+
+			// The value is the result if the jump is taken
+			MaterializeAll();
+
+			SRegCode& code = Emit((pTok->AsIPrecedence()->GetPri() == prLOGIC_OR) ? rgOR : rgAND);
+			code.pArg[0] = vStack.back().pVal;
+			code.nArgs = vJump[i];
+			SetDepth(vJump[i], (int)vStack.size());
+			vStack.pop_back();
+		}
+		break;
+
+		case cmENDIF:
+		case cmSHORTCUT_END:
+			break;
+
+		default:
+			bValid = false;
+			break;
+		}
+	}
+
+	if (bValid && bReachable)
+	{
+		MaterializeAll();
+		Emit(rgEND);
+	}
+	else
+		bValid = false;
+
+	if (!bValid)
+	{
+		m_vRegCode.clear();
+		m_vConstReg.clear();
+		return;
+	}
+
+	for (SRegCode& code : m_vRegCode)
+	{
+		if (code.eCode == rgIF || code.eCode == rgJMP || code.eCode == rgOR || code.eCode == rgAND)
+			code.pJump = &m_vRegCode[vPos[code.nArgs]];
+
+		if (code.pDst >= pReg && code.pDst < pReg + nRegs)
+			code.bVarDst = vVarReg[code.pDst - pReg];
+	}
+}
+
+//---------------------------------------------------------------------------
+/** \brief Release all buffers. */
+void EvalContext::Reset()
+{
+	m_pExpr.reset();
+	m_vVar.clear();
+	m_vStackBuffer.clear();
+	m_vTempBuffer.clear();
+	m_vRealVar.clear();
+	m_vRealBuffer.clear();
+	m_vCode.clear();
+	m_vRegCode.clear();
+	m_vConstReg.clear();
+	m_vFusedArg.clear();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate an expression with the bytecode engine for real numbers.
+	\param engine The bytecode engine
+	\param pJit Machine code created for the engine or nullptr
+	\return A pointer to the result or nullptr if the engine can't compute it.
+
+	Fails if a variable does not contain a real number or if the result 
+	can't be computed by the bytecode engine. The caller must use 
+	ParseFromRPN instead.
+*/
+const IValue* EvalContext::ParseFromRealEngine(const RealEngine& engine, const JitEngine* pJit)
+{
+	float_type* pBuf = &m_vRealBuffer[0];
+	for (std::size_t i = 0; i < m_vRealVar.size(); ++i)
+	{
+		if (!m_vRealVar[i]->IsNonComplexScalar())
+			return nullptr;
+
+		pBuf[i] = m_vRealVar[i]->GetFloat();
+	}
+
+	float_type fRes;
+	bool bStat = (pJit != nullptr) ? pJit->Eval(pBuf, fRes) : engine.Eval(pBuf, fRes);
+	if (!bStat)
+		return nullptr;
+
+	ptr_val_type& val = m_vStackBuffer[0];
+	if (val->IsVariable())
+		val.Reset(m_cache.CreateFromCache());
+
+	// Assign the result the same way the final operation of the 
+	// generic engine would do it
+	switch (engine.GetResultType())
+	{
+	case 'b': *val = (fRes == 1); break;
+	case 'c': *val = cmplx_type(fRes, 0); break;
+	default:  *val = fRes; break;
+	}
+
+	return val.Get();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate an expression with the generic engine.
+	\param rpn The RPN the buffers were created for
+	\param sExpr The expression, used for error messages
+	\param nPos The position reported for misplaced commas
+*/
+const IValue& EvalContext::ParseFromRPN(const RPN& rpn, const string_type& sExpr, int nPos)
+{
+	if (!m_vRegCode.empty())
+		return ParseFromRegCode(sExpr);
+
+	if (!m_vCode.empty())
+		return ParseFromCode(sExpr, nPos);
+
+	ptr_val_type* pStack = m_vStackBuffer.data();
+	if (rpn.GetSize() == 0)
+	{
+		// Passiert bei leeren strings oder solchen, die nur Leerzeichen enthalten
+		ErrorContext err;
+		err.Expr = sExpr;
+		err.Errc = ecUNEXPECTED_EOF;
+		err.Pos = 0;
+		throw ParserError(err);
+	}
+
+	const ptr_tok_type* pRPN = &(rpn.GetData()[0]);
+	const ptr_val_type* pVar = m_vVar.data();
+
+	int sidx = -1;
+	std::size_t lenRPN = rpn.GetSize();
+	for (std::size_t i = 0; i < lenRPN; ++i)
+	{
+		IToken* pTok = pRPN[i].Get();
+		ECmdCode eCode = pTok->GetCode();
+
+		switch (eCode)
+		{
+		case cmSCRIPT_NEWLINE:
+			sidx = -1;
+			continue;
+
+		case cmVAL:
+		{
+			IValue* pVal = static_cast<IValue*>(pTok);
+
+			sidx++;
+			MUP_VERIFY(sidx < (int)m_vStackBuffer.size());
+			if (pVal->IsVariable())
+			{
+				pStack[sidx] = pVar[i];
+			}
+			else
+			{
+				ptr_val_type& val = pStack[sidx];
+				if (val->IsVariable())
+					val.Reset(m_cache.CreateFromCache());
+
+				*val = *(static_cast<IValue*>(pTok));
+			}
+		}
+		continue;
+
+		case  cmIC:
+		{
+			ICallback* pIdxOprt = static_cast<ICallback*>(pTok);
+			int nArgs = pIdxOprt->GetArgsPresent();
+			sidx -= nArgs - 1;
+			MUP_VERIFY(sidx >= 0);
+
+			ptr_val_type& idx = pStack[sidx];   // Pointer to the first index
+			ptr_val_type& val = pStack[--sidx];   // Pointer to the variable or value beeing indexed
+			pIdxOprt->Eval(val, &idx, nArgs);
+		}
+		continue;
+
+		case cmCBC:
+		case cmOPRT_POSTFIX:
+		case cmFUNC:
+		case cmOPRT_BIN:
+		case cmOPRT_INFIX:
+		{
+			ICallback* pFun = static_cast<ICallback*>(pTok);
+			int nArgs = pFun->GetArgsPresent();
+			sidx -= nArgs - 1;
+
+			// most likely cause: Comma in if-then-else sum(false?1,0,0:3)
+			if (sidx < 0)
+			{
+				ErrorContext err;
+				err.Expr = sExpr;
+				err.Errc = ecUNEXPECTED_COMMA;
+				err.Pos = nPos;
+				throw ParserError(err);
+			}
+
+			EvalCallback(pFun, pStack[sidx], nArgs, sExpr);
+		}
+		continue;
+
+		case cmFUSED:
+			sidx++;
+			MUP_VERIFY(sidx < (int)m_vStackBuffer.size());
+			EvalFused(static_cast<OprtFused*>(pTok), sidx, m_vFusedArg[i].data(), sExpr);
+			continue;
+
+		case cmSTORE:
+			MUP_VERIFY(sidx >= 0);
+			*m_vTempBuffer[static_cast<TokenTemp*>(pTok)->GetSlot()] = *pStack[sidx];
+			continue;
+
+		case cmLOAD:
+		{
+			sidx++;
+			MUP_VERIFY(sidx < (int)m_vStackBuffer.size());
+
+			ptr_val_type& val = pStack[sidx];
+			if (val->IsVariable())
+				val.Reset(m_cache.CreateFromCache());
+
+			*val = *m_vTempBuffer[static_cast<TokenTemp*>(pTok)->GetSlot()];
+		}
+		continue;
+
+		case cmIF:
+			MUP_VERIFY(sidx >= 0);
+			if (pStack[sidx--]->GetBool() == false)
+				i += static_cast<TokenIfThenElse*>(pTok)->GetOffset();
+			continue;
+
+		case cmELSE:
+		case cmJMP:
+			i += static_cast<TokenIfThenElse*>(pTok)->GetOffset();
+			continue;
+
+		case cmENDIF:
+			continue;
+
+		case cmSHORTCUT_BEGIN:
+			if (pTok->AsIPrecedence()->GetPri() == prLOGIC_OR)
+			{
+				// occur short circuit feature
+				if (pStack[sidx]->GetBool() == true) 
+				{
+					i += static_cast<IOprtBinShortcut*>(pTok)->GetOffset();
+				} else {
+					// pop stack ,becuase this value had used
+					--sidx;
+				}
+			}
+			else // logic and
+			{
+				// occur short circuit feature
+				if (pStack[sidx]->GetBool() == false) 
+				{
+					i += static_cast<IOprtBinShortcut*>(pTok)->GetOffset();
+				} else {
+					// pop stack ,becuase this value had used
+					--sidx;
+				}
+			}
+			continue;
+
+		case cmSHORTCUT_END:
+			continue;
+
+		default:
+		{
+			ErrorContext err;
+			err.Expr = sExpr;
+			err.Errc = ecINTERNAL_ERROR;
+			throw ParserError(err);
+		}
+		} // switch token
+	} // for all RPN tokens
+
+	return *pStack[0];
+}
+
+//---------------------------------------------------------------------------
+/** \brief Call a callback and convert its errors.
+	\param pFun The callback
+	\param val The stack item holding the first argument, receives the result
+	\param nArgs The number of arguments
+	\param sExpr The expression, used for error messages
+*/
+void EvalContext::EvalCallback(ICallback* pFun, ptr_val_type& val, int nArgs, const string_type& sExpr)
+{
+	try
+	{
+		if (val->IsVariable())
+		{
+			ptr_val_type buf(m_cache.CreateFromCache());
+			pFun->Eval(buf, &val, nArgs);
+			val = buf;
+		}
+		else
+		{
+			pFun->Eval(val, &val, nArgs);
+		}
+	}
+	catch (ParserError& exc)
+	{
+		// <ibg 20130131> Not too happy about that:
+		// Multiarg functions may throw specific error codes when evaluating.
+		// These codes would be converted to ecEVAL here. I omit the conversion
+		// for certain handpicked errors. (The reason this catch block exists is
+		// that not all exceptions contain proper metadata when thrown out of
+		// a function.)
+		if (exc.GetCode() == ecTOO_FEW_PARAMS ||
+			exc.GetCode() == ecDOMAIN_ERROR ||
+			exc.GetCode() == ecOVERFLOW ||
+			exc.GetCode() == ecINVALID_NUMBER_OF_PARAMETERS ||
+			exc.GetCode() == ecASSIGNEMENT_TO_VALUE)
+		{
+			exc.GetContext().Pos = pFun->GetExprPos();
+			throw;
+		}
+		// </ibg>
+		else
+		{
+			ErrorContext err;
+			err.Expr = sExpr;
+			err.Ident = pFun->GetIdent();
+			err.Errc = ecEVAL;
+			err.Pos = pFun->GetExprPos();
+			err.Hint = exc.GetMsg();
+			throw ParserError(err);
+		}
+	}
+	catch (MatrixError& /*exc*/)
+	{
+		ErrorContext err;
+		err.Expr = sExpr;
+		err.Ident = pFun->GetIdent();
+		err.Errc = ecMATRIX_DIMENSION_MISMATCH;
+		err.Pos = pFun->GetExprPos();
+		throw ParserError(err);
+	}
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate a fused token.
+	\param pFused The token
+	\param sidx The stack position receiving the result
+	\param pArg The values of the token bound to this context
+	\param sExpr The expression, used for error messages
+
+	If the token can't compute the result directly, its original tokens are 
+	evaluated on the stack starting at sidx. Results and errors are the same 
+	as if the tokens had not been fused.
+*/
+void EvalContext::EvalFused(const OprtFused* pFused, int sidx, const ptr_val_type* pArg, const string_type& sExpr)
+{
+	MUP_VERIFY(sidx >= 0 && sidx + pFused->GetStackSize() <= (int)m_vStackBuffer.size());
+
+	ptr_val_type* pStack = m_vStackBuffer.data();
+	if (pStack[sidx]->IsVariable())
+		pStack[sidx].Reset(m_cache.CreateFromCache());
+
+	if (pFused->EvalReal(pStack[sidx], pArg))
+		return;
+
+	for (const ptr_tok_type& tok : pFused->GetTokens())
+	{
+		if (tok->GetCode() == cmVAL)
+		{
+			const ptr_val_type& arg = *pArg++;
+			ptr_val_type& val = pStack[sidx++];
+			if (arg->IsVariable())
+			{
+				val = arg;
+			}
+			else
+			{
+				if (val->IsVariable())
+					val.Reset(m_cache.CreateFromCache());
+
+				*val = *arg;
+			}
+		}
+		else
+		{
+			ICallback* pFun = tok->AsICallback();
+			int nArgs = pFun->GetArgsPresent();
+			sidx -= nArgs;
+			EvalCallback(pFun, pStack[sidx], nArgs, sExpr);
+			++sidx;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+// Helper macros for the handlers of the threaded code
+#if defined(MUP_COMPUTED_GOTO)
+	#define MUP_HANDLER(CODE) lb_##CODE
+	#define MUP_NEXT goto *(++pCode)->pHandler
+	#define MUP_JUMP(TARGET) pCode = (TARGET); goto *pCode->pHandler
+#else
+	#define MUP_HANDLER(CODE) case CODE
+	#define MUP_NEXT ++pCode; continue
+	#define MUP_JUMP(TARGET) pCode = (TARGET); continue
+#endif
+
+// Binary operators compute real numbers directly and call the operator 
+// callback for all other types.
+#define MUP_BINARY_HANDLER(CODE, OP)                                      \
+	MUP_HANDLER(CODE):                                                    \
+		if (--sidx >= 0)                                                  \
+		{                                                                 \
+			ptr_val_type* pArg = &pStack[sidx];                           \
+			if (pArg[0]->IsNonComplexScalar() && pArg[1]->IsNonComplexScalar()) \
+			{                                                             \
+				float_type fVal1 = pArg[0]->GetFloat();                   \
+				float_type fVal2 = pArg[1]->GetFloat();                   \
+				if (pArg[0]->IsVariable())                                \
+					pArg[0].Reset(m_cache.CreateFromCache());             \
+				*pArg[0] = fVal1 OP fVal2;                                \
+				MUP_NEXT;                                                 \
+			}                                                             \
+		}                                                                 \
+		goto lbCallback;
+
+#if defined(MUP_COMPUTED_GOTO)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate an expression with the threaded code created by CompileCode.
+	\param sExpr The expression, used for error messages
+	\param nPos The position reported for misplaced commas
+
+	The results and errors are the same as those of the RPN interpreter.
+*/
+const IValue& EvalContext::ParseFromCode(const string_type& sExpr, int nPos)
+{
+	ptr_val_type* pStack = m_vStackBuffer.data();
+	const SCode* pCode = m_vCode.data();
+	int sidx = -1;
+
+#if defined(MUP_COMPUTED_GOTO)
+	// The order must match the ECode enumeration
+	static const void* const s_pHandler[] =
+	{
+		&&lb_cdVAR, &&lb_cdVAL, &&lb_cdLOAD, &&lb_cdSTORE, &&lb_cdCALL, &&lb_cdINDEX, &&lb_cdFUSED,
+		&&lb_cdADD, &&lb_cdSUB, &&lb_cdMUL, &&lb_cdDIV,
+		&&lb_cdLT, &&lb_cdGT, &&lb_cdLE, &&lb_cdGE, &&lb_cdEQ, &&lb_cdNEQ,
+		&&lb_cdIF, &&lb_cdJMP, &&lb_cdOR, &&lb_cdAND, &&lb_cdNEWLINE, &&lb_cdEND
+	};
+	static_assert(sizeof(s_pHandler) / sizeof(s_pHandler[0]) == cdEND + 1, "Handler table does not match ECode");
+
+	// Label addresses are only known inside of this function, so the code 
+	// created by CompileCode is completed on its first execution.
+	if (pCode->pHandler == nullptr)
+	{
+		for (SCode& code : m_vCode)
+			code.pHandler = s_pHandler[code.eCode];
+	}
+
+	goto *pCode->pHandler;
+#else
+	for (;;)
+	{
+		switch (pCode->eCode)
+		{
+#endif
+
+	MUP_HANDLER(cdNEWLINE):
+		sidx = -1;
+		MUP_NEXT;
+
+	MUP_HANDLER(cdVAR):
+		sidx++;
+		MUP_VERIFY(sidx < (int)m_vStackBuffer.size());
+		pStack[sidx] = *pCode->pVar;
+		MUP_NEXT;
+
+	MUP_HANDLER(cdVAL):
+		sidx++;
+		MUP_VERIFY(sidx < (int)m_vStackBuffer.size());
+		{
+			ptr_val_type& val = pStack[sidx];
+			if (val->IsVariable())
+				val.Reset(m_cache.CreateFromCache());
+
+			*val = *static_cast<IValue*>(pCode->pTok);
+		}
+		MUP_NEXT;
+
+	MUP_HANDLER(cdINDEX):
+		sidx -= pCode->nArgs - 1;
+		MUP_VERIFY(sidx >= 0);
+		{
+			ptr_val_type& idx = pStack[sidx];     // Pointer to the first index
+			ptr_val_type& val = pStack[--sidx];   // Pointer to the variable or value beeing indexed
+			static_cast<ICallback*>(pCode->pTok)->Eval(val, &idx, pCode->nArgs);
+		}
+		MUP_NEXT;
+
+	MUP_HANDLER(cdFUSED):
+		++sidx;
+		EvalFused(static_cast<OprtFused*>(pCode->pTok), sidx, m_vFusedArg[pCode->nArgs].data(), sExpr);
+		MUP_NEXT;
+
+	MUP_HANDLER(cdCALL):
+		sidx -= pCode->nArgs - 1;
+
+	lbCallback:
+		// most likely cause: Comma in if-then-else sum(false?1,0,0:3)
+		if (sidx < 0)
+		{
+			ErrorContext err;
+			err.Expr = sExpr;
+			err.Errc = ecUNEXPECTED_COMMA;
+			err.Pos = nPos;
+			throw ParserError(err);
+		}
+
+		EvalCallback(static_cast<ICallback*>(pCode->pTok), pStack[sidx], pCode->nArgs, sExpr);
+		MUP_NEXT;
+
+	MUP_BINARY_HANDLER(cdADD, +)
+	MUP_BINARY_HANDLER(cdSUB, -)
+	MUP_BINARY_HANDLER(cdMUL, *)
+	MUP_BINARY_HANDLER(cdDIV, /)
+	MUP_BINARY_HANDLER(cdLT, <)
+	MUP_BINARY_HANDLER(cdGT, >)
+	MUP_BINARY_HANDLER(cdLE, <=)
+	MUP_BINARY_HANDLER(cdGE, >=)
+	MUP_BINARY_HANDLER(cdEQ, ==)
+	MUP_BINARY_HANDLER(cdNEQ, !=)
+
+	MUP_HANDLER(cdSTORE):
+		MUP_VERIFY(sidx >= 0);
+		*m_vTempBuffer[pCode->nArgs] = *pStack[sidx];
+		MUP_NEXT;
+
+	MUP_HANDLER(cdLOAD):
+		sidx++;
+		MUP_VERIFY(sidx < (int)m_vStackBuffer.size());
+		{
+			ptr_val_type& val = pStack[sidx];
+			if (val->IsVariable())
+				val.Reset(m_cache.CreateFromCache());
+
+			*val = *m_vTempBuffer[pCode->nArgs];
+		}
+		MUP_NEXT;
+
+	MUP_HANDLER(cdIF):
+		MUP_VERIFY(sidx >= 0);
+		if (pStack[sidx--]->GetBool() == false)
+		{
+			MUP_JUMP(pCode->pJump);
+		}
+		MUP_NEXT;
+
+	MUP_HANDLER(cdJMP):
+		MUP_JUMP(pCode->pJump);
+
+	MUP_HANDLER(cdOR):
+		if (pStack[sidx]->GetBool() == true)
+		{
+			MUP_JUMP(pCode->pJump);
+		}
+		--sidx;
+		MUP_NEXT;
+
+	MUP_HANDLER(cdAND):
+		if (pStack[sidx]->GetBool() == false)
+		{
+			MUP_JUMP(pCode->pJump);
+		}
+		--sidx;
+		MUP_NEXT;
+
+	MUP_HANDLER(cdEND):
+		return *pStack[0];
+
+#if !defined(MUP_COMPUTED_GOTO)
+		} // switch instruction
+	} // for all instructions
+#endif
+}
+
+// Binary operators of the register code compute real numbers from their 
+// operands directly. For other types the operands are moved into consecutive
+// registers and the operator callback is called.
+#define MUP_REG_BINARY_HANDLER(CODE, OP)                                  \
+	MUP_HANDLER(CODE):                                                    \
+		{                                                                 \
+			const IValue* pVal1 = pCode->pArg[0]->Get();                  \
+			const IValue* pVal2 = pCode->pArg[1]->Get();                  \
+			if (pVal1->IsNonComplexScalar() && pVal2->IsNonComplexScalar()) \
+			{                                                             \
+				auto val = pVal1->GetFloat() OP pVal2->GetFloat();        \
+				if (pCode->bVarDst && (*pCode->pDst)->IsVariable())       \
+					pCode->pDst->Reset(m_cache.CreateFromCache());        \
+				**pCode->pDst = val;                                      \
+				MUP_NEXT;                                                 \
+			}                                                             \
+		}                                                                 \
+		goto lbBinaryCallback;
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate an expression with the register code created by CompileRegCode.
+	\param sExpr The expression, used for error messages
+
+	The results and errors are the same as those of the RPN interpreter.
+*/
+const IValue& EvalContext::ParseFromRegCode(const string_type& sExpr)
+{
+	const SRegCode* pCode = m_vRegCode.data();
+
+#if defined(MUP_COMPUTED_GOTO)
+	// The order must match the ERegCode enumeration
+	static const void* const s_pHandler[] =
+	{
+		&&lb_rgMOVPTR, &&lb_rgMOVVAL, &&lb_rgSTORE, &&lb_rgCALL, &&lb_rgINDEX, &&lb_rgFUSED,
+		&&lb_rgADD, &&lb_rgSUB, &&lb_rgMUL, &&lb_rgDIV,
+		&&lb_rgLT, &&lb_rgGT, &&lb_rgLE, &&lb_rgGE, &&lb_rgEQ, &&lb_rgNEQ,
+		&&lb_rgIF, &&lb_rgJMP, &&lb_rgOR, &&lb_rgAND, &&lb_rgEND
+	};
+	static_assert(sizeof(s_pHandler) / sizeof(s_pHandler[0]) == rgEND + 1, "Handler table does not match ERegCode");
+
+	if (pCode->pHandler == nullptr)
+	{
+		for (SRegCode& code : m_vRegCode)
+			code.pHandler = s_pHandler[code.eCode];
+	}
+
+	goto *pCode->pHandler;
+#else
+	for (;;)
+	{
+		switch (pCode->eCode)
+		{
+#endif
+
+	MUP_HANDLER(rgMOVPTR):
+		*pCode->pDst = *pCode->pArg[0];
+		MUP_NEXT;
+
+	MUP_HANDLER(rgMOVVAL):
+		if (pCode->bVarDst && (*pCode->pDst)->IsVariable())
+			pCode->pDst->Reset(m_cache.CreateFromCache());
+
+		**pCode->pDst = **pCode->pArg[0];
+		MUP_NEXT;
+
+	MUP_HANDLER(rgSTORE):
+		**pCode->pDst = **pCode->pArg[0];
+		MUP_NEXT;
+
+	MUP_HANDLER(rgCALL):
+		EvalCallback(static_cast<ICallback*>(pCode->pTok), *pCode->pDst, pCode->nArgs, sExpr);
+		MUP_NEXT;
+
+	MUP_HANDLER(rgINDEX):
+		static_cast<ICallback*>(pCode->pTok)->Eval(*pCode->pDst, pCode->pDst + 1, pCode->nArgs);
+		MUP_NEXT;
+
+	MUP_HANDLER(rgFUSED):
+		EvalFused(static_cast<OprtFused*>(pCode->pTok), (int)(pCode->pDst - m_vStackBuffer.data()), pCode->pArg[0], sExpr);
+		MUP_NEXT;
+
+	MUP_REG_BINARY_HANDLER(rgADD, +)
+	MUP_REG_BINARY_HANDLER(rgSUB, -)
+	MUP_REG_BINARY_HANDLER(rgMUL, *)
+	MUP_REG_BINARY_HANDLER(rgDIV, /)
+	MUP_REG_BINARY_HANDLER(rgLT, <)
+	MUP_REG_BINARY_HANDLER(rgGT, >)
+	MUP_REG_BINARY_HANDLER(rgLE, <=)
+	MUP_REG_BINARY_HANDLER(rgGE, >=)
+	MUP_REG_BINARY_HANDLER(rgEQ, ==)
+	MUP_REG_BINARY_HANDLER(rgNEQ, !=)
+
+	lbBinaryCallback:
+		{
+			ptr_val_type* pReg = pCode->pDst;
+			for (int k = 1; k >= 0; --k)
+			{
+				if (pCode->cArgMode[k] == 'p')
+				{
+					pReg[k] = *pCode->pArg[k];
+				}
+				else if (pCode->cArgMode[k] == 'v')
+				{
+					if (pReg[k]->IsVariable())
+						pReg[k].Reset(m_cache.CreateFromCache());
+
+					*pReg[k] = **pCode->pArg[k];
+				}
+			}
+
+			// The registers must not refer to variables afterwards since 
+			// the handlers above don't check them
+			try
+			{
+				EvalCallback(static_cast<ICallback*>(pCode->pTok), pReg[0], 2, sExpr);
+			}
+			catch (...)
+			{
+				for (int k = 0; k < 2; ++k)
+				{
+					if (pReg[k]->IsVariable())
+						pReg[k].Reset(m_cache.CreateFromCache());
+				}
+				throw;
+			}
+
+			for (int k = 0; k < 2; ++k)
+			{
+				if (pReg[k]->IsVariable())
+					pReg[k].Reset(m_cache.CreateFromCache());
+			}
+		}
+		MUP_NEXT;
+
+	MUP_HANDLER(rgIF):
+		if ((*pCode->pArg[0])->GetBool() == false)
+		{
+			MUP_JUMP(pCode->pJump);
+		}
+		MUP_NEXT;
+
+	MUP_HANDLER(rgJMP):
+		MUP_JUMP(pCode->pJump);
+
+	MUP_HANDLER(rgOR):
+		if ((*pCode->pArg[0])->GetBool() == true)
+		{
+			MUP_JUMP(pCode->pJump);
+		}
+		MUP_NEXT;
+
+	MUP_HANDLER(rgAND):
+		if ((*pCode->pArg[0])->GetBool() == false)
+		{
+			MUP_JUMP(pCode->pJump);
+		}
+		MUP_NEXT;
+
+	MUP_HANDLER(rgEND):
+		return *m_vStackBuffer[0];
+
+#if !defined(MUP_COMPUTED_GOTO)
+		} // switch instruction
+	} // for all instructions
+#endif
+}
+
+#if defined(MUP_COMPUTED_GOTO)
+	#pragma GCC diagnostic pop
+#endif
+
+#undef MUP_REG_BINARY_HANDLER
+#undef MUP_BINARY_HANDLER
+#undef MUP_JUMP
+#undef MUP_NEXT
+#undef MUP_HANDLER
+
+MUP_NAMESPACE_END
@@ -0,0 +1,217 @@
+#ifndef MUP_EVAL_CONTEXT_H
+#define MUP_EVAL_CONTEXT_H
+
+/** \file
+    \brief Definition of the per thread state used for evaluating expressions.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <memory>
+#include <vector>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+#include "mpValueCache.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief The mutable state needed for evaluating an expression.
+
+    An evaluation context owns the stack buffer, the temporary values of
+    shared subexpressions, the value cache and the buffer of the bytecode
+    engine. Use one context per thread for evaluating a CompiledExpression.
+    A context can be used with different expressions, its buffers are
+    recreated whenever the expression changes.
+
+    By default the variables of an expression refer to the same values as 
+    in the parser the expression was compiled by. Variables defined in a 
+    context replace them for all evaluations using this context. This 
+    allows threads to evaluate an expression with their own variable values.
+
+    The generic engine translates the RPN into threaded code. Each instruction 
+    holds the address of its handler and its operands, so no token has to be
+    decoded during evaluation. With GCC and Clang the handlers are chained by 
+    computed gotos, other compilers use a switch. The built in arithmetic 
+    operators and comparisons have their own handlers for real numbers and 
+    call the operator callback only for other types.
+
+    Alternatively the RPN is translated into register code. Each instruction
+    names its operands and its destination directly: variables, constants,
+    temporary slots and the stack items, which serve as registers. Values are
+    only moved into the registers when a callback needs its arguments in 
+    consecutive registers. Registers that can't refer to a variable are known
+    at compile time and written without checking.
+  */
+  class EvalContext
+  {
+  friend class ParserXBase;
+  friend class CompiledExpression;
+
+  public:
+
+    EvalContext();
+   ~EvalContext();
+
+    EvalContext(const EvalContext &ref) = delete;
+    EvalContext& operator=(const EvalContext &ref) = delete;
+
+    void DefineVar(const string_type &ident, const Variable &var);
+    void RemoveVar(const string_type &ident);
+    void ClearVar();
+    bool IsVarDefined(const string_type &ident) const;
+    void EnableThreadedCode(bool bStat);
+    bool IsThreadedCodeEnabled() const;
+    void EnableRegisterCode(bool bStat);
+    bool IsRegisterCodeEnabled() const;
+
+  private:
+
+    /** \brief Instructions of the threaded code. */
+    enum ECode
+    {
+      cdVAR,          ///< Push a variable
+      cdVAL,          ///< Push a constant
+      cdLOAD,         ///< Push a temporary value
+      cdSTORE,        ///< Copy the top of the stack into a temporary slot
+      cdCALL,         ///< Call a function or an operator
+      cdINDEX,        ///< Index operator
+      cdFUSED,        ///< Superinstruction, the RPN position of the token is stored in nArgs
+      cdADD,          ///< Built in binary operators
+      cdSUB,
+      cdMUL,
+      cdDIV,
+      cdLT,
+      cdGT,
+      cdLE,
+      cdGE,
+      cdEQ,
+      cdNEQ,
+      cdIF,           ///< Pop the condition, jump if it is false
+      cdJMP,
+      cdOR,           ///< Jump if the top of the stack is true, pop it otherwise
+      cdAND,          ///< Jump if the top of the stack is false, pop it otherwise
+      cdNEWLINE,      ///< Clear the stack
+      cdEND
+    };
+
+    /** \brief A single instruction of the threaded code. */
+    struct SCode
+    {
+      const void *pHandler;          ///< Address of the handler, used with computed gotos
+      ECode eCode;
+      int nArgs;                     ///< Number of arguments or temporary slot
+      union
+      {
+        IToken *pTok;                ///< Constant value or callback
+        const ptr_val_type *pVar;    ///< Variable owned by the context
+        const SCode *pJump;          ///< Next instruction if the jump is taken
+      };
+    };
+
+    /** \brief Instructions of the register code. */
+    enum ERegCode
+    {
+      rgMOVPTR,       ///< Let a register refer to a variable
+      rgMOVVAL,       ///< Copy a value into a register
+      rgSTORE,        ///< Copy a value into a temporary slot
+      rgCALL,         ///< Call a function or an operator, the arguments are in consecutive registers
+      rgINDEX,        ///< Index operator
+      rgFUSED,        ///< Superinstruction, pArg[0] points to the values of the token
+      rgADD,          ///< Built in binary operators
+      rgSUB,
+      rgMUL,
+      rgDIV,
+      rgLT,
+      rgGT,
+      rgLE,
+      rgGE,
+      rgEQ,
+      rgNEQ,
+      rgIF,           ///< Jump if the operand is false
+      rgJMP,
+      rgOR,           ///< Jump if the register is true
+      rgAND,          ///< Jump if the register is false
+      rgEND
+    };
+
+    /** \brief A single instruction of the register code. */
+    struct SRegCode
+    {
+      const void *pHandler;          ///< Address of the handler, used with computed gotos
+      ERegCode eCode;
+      int nArgs;                     ///< Number of arguments of a call
+      ptr_val_type *pDst;            ///< Destination register, holds the first argument of calls
+      const ptr_val_type *pArg[2];   ///< Operands
+      char cArgMode[2];              ///< Kind of the operands of binary operators: 'r' register, 'p' variable, 'v' value
+      bool bVarDst;                  ///< The destination may refer to a variable
+      union
+      {
+        IToken *pTok;                ///< Callback
+        const SRegCode *pJump;       ///< Next instruction if the jump is taken
+      };
+    };
+
+    void CompileCode(const RPN &rpn);
+    const IValue& ParseFromCode(const string_type &sExpr, int nPos);
+    void CompileRegCode(const RPN &rpn);
+    const IValue& ParseFromRegCode(const string_type &sExpr);
+    void EvalCallback(ICallback *pFun, ptr_val_type &val, int nArgs, const string_type &sExpr);
+    void EvalFused(const OprtFused *pFused, int sidx, const ptr_val_type *pArg, const string_type &sExpr);
+
+    void Init(const RPN &rpn, const RealEngine *pRealEngine);
+    void Reset();
+
+    const IValue& ParseFromRPN(const RPN &rpn, const string_type &sExpr, int nPos);
+    const IValue* ParseFromRealEngine(const RealEngine &engine, const JitEngine *pJit = nullptr);
+
+    var_maptype m_varDef;                 ///< Variables replacing the ones of the expression
+    std::shared_ptr<const void> m_pExpr;  ///< The compiled expression the buffers were created for
+    val_vec_type m_vVar;                  ///< Variable used by each RPN token or nullptr
+    std::vector<val_vec_type> m_vFusedArg;    ///< Values of each fused RPN token
+    val_vec_type m_vStackBuffer;
+    val_vec_type m_vTempBuffer;           ///< Temporary values of subexpressions shared by the optimizer
+    ValueCache m_cache;                   ///< A cache for recycling value items instead of deleting them
+    std::vector<const IValue*> m_vRealVar;    ///< Values of the variables used by the bytecode engine
+    std::vector<float_type> m_vRealBuffer;    ///< Variables, temporary values and stack of the bytecode engine
+    std::vector<SCode> m_vCode;           ///< Threaded code of the generic engine
+    std::vector<SRegCode> m_vRegCode;     ///< Register code of the generic engine
+    val_vec_type m_vConstReg;             ///< Constants used by the register code
+    bool m_bThreadedCode;                 ///< If this flag is set m_vCode is used by ParseFromRPN
+    bool m_bRegisterCode;                 ///< If this flag is set m_vRegCode is used by ParseFromRPN
+  };
+
+MUP_NAMESPACE_END
+
+#endif
@@ -0,0 +1,648 @@
+/** \file
+    \brief Implementation of a dependency graph of formulas.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpFormulaGraph.h"
+
+#include <algorithm>
+#include <set>
+
+#include "mpParserBase.h"
+#include "mpVariable.h"
+#include "mpIOprt.h"
+#include "mpOprtFused.h"
+#include "mpError.h"
+
+
+MUP_NAMESPACE_START
+
+namespace
+{
+	//---------------------------------------------------------------------------
+	/** \brief Find the variables read and written by an expression.
+		\param rpn The RPN of the expression
+		\param mapName The names of the variables used by the expression, keyed by their values
+		\param setIn Receives the names of the variables read
+		\param setOut Receives the names of the variables written
+
+		The RPN is walked while keeping track of the token that produced each 
+		stack item, so the left operand of an assignment operator is known. 
+		Indexing a variable produces an item that still refers to the variable.
+		A variable is not considered as read if it only appears as the left 
+		operand of the plain assignment operator. Jumps are ignored, the stack 
+		is adjusted as if both branches were taken.
+	*/
+	void FindVariables(const RPN &rpn, 
+		               const std::map<const IValue*, string_type> &mapName,
+		               std::set<string_type> &setIn,
+		               std::set<string_type> &setOut)
+	{
+		/** \brief The origin of a stack item. */
+		struct SItem
+		{
+			const Variable *pVar;   ///< Variable the item refers to or nullptr
+			std::size_t nTok;       ///< Position of the variable token in the RPN
+			bool bIndexed;
+		};
+
+		auto GetName = [&](const Variable *pVar) -> const string_type*
+		{
+			auto it = mapName.find(pVar->GetPtr());
+			return (it != mapName.end()) ? &it->second : nullptr;
+		};
+
+		const token_vec_type &vRPN = rpn.GetData();
+		std::vector<bool> vPureWrite(vRPN.size(), false);
+		std::vector<SItem> stItem;
+		auto Pop = [&](std::size_t n)
+		{
+			stItem.resize(stItem.size() - std::min(n, stItem.size()));
+		};
+
+		for (std::size_t i = 0; i < vRPN.size(); ++i)
+		{
+			const IToken *pTok = vRPN[i].Get();
+			switch (pTok->GetCode())
+			{
+			case cmSCRIPT_NEWLINE:
+				stItem.clear();
+				break;
+
+			case cmVAL:
+				if (static_cast<const IValue*>(pTok)->IsVariable())
+					stItem.push_back(SItem{ static_cast<const Variable*>(pTok), i, false });
+				else
+					stItem.push_back(SItem{ nullptr, i, false });
+				break;
+
+			case cmLOAD:
+			case cmFUSED:
+				stItem.push_back(SItem{ nullptr, i, false });
+				break;
+
+			case cmIC:
+				// The indices are consumed, the indexed item is replaced by the element
+				Pop(static_cast<const ICallback*>(pTok)->GetArgsPresent());
+				if (!stItem.empty())
+					stItem.back().bIndexed = true;
+				break;
+
+			case cmOPRT_BIN:
+			case cmCBC:
+			case cmOPRT_POSTFIX:
+			case cmFUNC:
+			case cmOPRT_INFIX:
+			{
+				int nArgs = static_cast<const ICallback*>(pTok)->GetArgsPresent();
+				if (pTok->GetCode() == cmOPRT_BIN && 
+					static_cast<const IOprtBin*>(pTok)->GetPri() == prASSIGN && 
+					nArgs == 2 && stItem.size() >= 2)
+				{
+					const SItem &item = stItem[stItem.size() - 2];
+					const string_type *pName = (item.pVar != nullptr) ? GetName(item.pVar) : nullptr;
+					if (pName != nullptr)
+					{
+						setOut.insert(*pName);
+						vPureWrite[item.nTok] = !item.bIndexed && pTok->GetIdent() == _T("=");
+					}
+				}
+
+				Pop(nArgs);
+				stItem.push_back(SItem{ nullptr, i, false });
+			}
+			break;
+
+			case cmIF:
+			case cmELSE:
+			case cmSHORTCUT_BEGIN:
+				Pop(1);
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		// All other occurrences of a variable read it
+		for (std::size_t i = 0; i < vRPN.size(); ++i)
+		{
+			const IToken *pTok = vRPN[i].Get();
+			if (pTok->GetCode() == cmFUSED)
+			{
+				for (const ptr_tok_type &tok : static_cast<const OprtFused*>(pTok)->GetTokens())
+				{
+					if (tok->GetCode() != cmVAL || !tok->AsIValue()->IsVariable())
+						continue;
+
+					const string_type *pName = GetName(static_cast<const Variable*>(tok.Get()));
+					if (pName != nullptr)
+						setIn.insert(*pName);
+				}
+			}
+			else if (pTok->GetCode() == cmVAL && static_cast<const IValue*>(pTok)->IsVariable() && !vPureWrite[i])
+			{
+				const string_type *pName = GetName(static_cast<const Variable*>(pTok));
+				if (pName != nullptr)
+					setIn.insert(*pName);
+			}
+		}
+	}
+} // namespace
+
+//---------------------------------------------------------------------------
+FormulaGraph::SFormula::SFormula(const CompiledExpression &a_Expr)
+	:m_expr(a_Expr)
+	,m_pCtx(new EvalContext)
+	,m_val()
+	,m_pResultVar()
+	,m_vIn()
+	,m_vOut()
+	,m_vSucc()
+	,m_nRank(0)
+	,m_nLevel(0)
+	,m_bConcurrent(true)
+	,m_bDirty(true)
+{}
+
+//---------------------------------------------------------------------------
+FormulaGraph::FormulaGraph()
+	:m_vFormula()
+	,m_vOrder()
+	,m_mapReader()
+	,m_mapWriter()
+	,m_queDirty()
+	,m_nDirty(0)
+	,m_bSorted(true)
+	,m_nThreads(1)
+	,m_pThreadPool()
+{}
+
+//---------------------------------------------------------------------------
+/** \brief Add the expression of a parser.
+	\param a_Parser The parser holding the expression
+	\param a_sResultVar Name of a parser variable receiving the result or an empty string
+	\return The index of the formula
+	\throw ParserError in case of syntax errors or if the result variable is not defined.
+
+	The expression is compiled, the parser may parse another expression 
+	afterwards. New formulas are dirty, they are evaluated by the next call
+	of Recompute.
+*/
+std::size_t FormulaGraph::AddFormula(const ParserXBase &a_Parser, const string_type &a_sResultVar)
+{
+	CompiledExpression expr(a_Parser);
+	SFormula formula(expr);
+
+	if (!a_sResultVar.empty())
+	{
+		var_maptype::const_iterator item = a_Parser.GetVar().find(a_sResultVar);
+		if (item == a_Parser.GetVar().end())
+			throw ParserError(ErrorContext(ecUNASSIGNABLE_TOKEN, -1, a_sResultVar));
+
+		formula.m_pResultVar = item->second;
+	}
+
+	// The variable tokens of the RPN are copies, they are identified by their values
+	std::map<const IValue*, string_type> mapName;
+	for (const auto &item : a_Parser.GetExprVar())
+		mapName[static_cast<const Variable*>(item.second.Get())->GetPtr()] = item.first;
+
+	std::set<string_type> setIn, setOut;
+	FindVariables(expr.GetRPN(), mapName, setIn, setOut);
+	if (!a_sResultVar.empty())
+		setOut.insert(a_sResultVar);
+
+	// The variables written by assignment operators are known to the graph, 
+	// other side effects are not
+	for (const ptr_tok_type &tok : expr.GetRPN().GetData())
+	{
+		ICallback *pFun = tok->AsICallback();
+		if (pFun != nullptr && !pFun->IsPure() && 
+			!(tok->GetCode() == cmOPRT_BIN && static_cast<IOprtBin*>(pFun)->GetPri() == prASSIGN))
+		{
+			formula.m_bConcurrent = false;
+			break;
+		}
+	}
+
+	std::size_t nIdx = m_vFormula.size();
+	formula.m_vIn.assign(setIn.begin(), setIn.end());
+	formula.m_vOut.assign(setOut.begin(), setOut.end());
+	for (const string_type &sVar : formula.m_vIn)
+		m_mapReader[sVar].push_back(nIdx);
+
+	for (const string_type &sVar : formula.m_vOut)
+		m_mapWriter[sVar].push_back(nIdx);
+
+	m_vFormula.push_back(std::move(formula));
+	++m_nDirty;
+	m_bSorted = false;
+	return nIdx;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Remove all formulas. */
+void FormulaGraph::Clear()
+{
+	m_vFormula.clear();
+	m_vOrder.clear();
+	m_mapReader.clear();
+	m_mapWriter.clear();
+	m_queDirty = rank_queue_type();
+	m_nDirty = 0;
+	m_bSorted = true;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Mark the formulas reading a variable as dirty.
+	\param a_sVar The name of a variable changed by the host.
+*/
+void FormulaGraph::SetDirty(const string_type &a_sVar)
+{
+	formula_map_type::const_iterator item = m_mapReader.find(a_sVar);
+	if (item == m_mapReader.end())
+		return;
+
+	for (std::size_t nIdx : item->second)
+		MarkDirty(nIdx);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Mark all formulas as dirty. */
+void FormulaGraph::SetAllDirty()
+{
+	for (std::size_t i = 0; i < m_vFormula.size(); ++i)
+		MarkDirty(i);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the dirty formulas and the formulas depending on them.
+	\return The number of formulas evaluated.
+	\throw ParserError if the formulas depend on each other cyclically or 
+	       if the evaluation of a formula fails. In the latter case the 
+		   formula stays dirty.
+
+	Results are assigned to the result variables right after the evaluation 
+	of a formula, so formulas depending on them see the new values.
+*/
+std::size_t FormulaGraph::Recompute()
+{
+	if (!m_bSorted)
+		Sort();
+
+	if (m_nThreads > 1)
+		return RecomputeConcurrent();
+
+	std::size_t nEval = 0;
+	while (!m_queDirty.empty())
+	{
+		std::size_t nIdx = m_vOrder[m_queDirty.top()];
+		Evaluate(nIdx);
+		m_queDirty.pop();
+
+		SFormula &formula = m_vFormula[nIdx];
+		formula.m_bDirty = false;
+		--m_nDirty;
+		++nEval;
+
+		for (std::size_t nSucc : formula.m_vSucc)
+			MarkDirty(nSucc);
+	}
+
+	return nEval;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Set the number of threads used by Recompute.
+	\param nThreads The number of threads including the calling thread. 0 selects 
+	                the number of hardware threads. 
+
+	The default is 1, Recompute does not create threads then.
+*/
+void FormulaGraph::SetThreads(int nThreads)
+{
+	if (nThreads < 0)
+		throw ParserError(ErrorContext(ecINVALID_PARAMETER, -1, _T("SetThreads")));
+
+	if (nThreads == 0)
+		nThreads = ThreadPool::GetHardwareThreads();
+
+	if (nThreads != m_nThreads)
+		m_pThreadPool.reset();
+
+	m_nThreads = nThreads;
+}
+
+//---------------------------------------------------------------------------
+int FormulaGraph::GetThreads() const
+{
+	return m_nThreads;
+}
+
+//---------------------------------------------------------------------------
+std::size_t FormulaGraph::GetSize() const
+{
+	return m_vFormula.size();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the number of formulas evaluated by the next call of Recompute
+		   without the ones depending on them. */
+std::size_t FormulaGraph::GetNumDirty() const
+{
+	return m_nDirty;
+}
+
+//---------------------------------------------------------------------------
+const string_type& FormulaGraph::GetExpr(std::size_t nIdx) const
+{
+	return m_vFormula.at(nIdx).m_expr.GetExpr();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the result of the last evaluation of a formula. 
+
+	The result is void if the formula was not evaluated yet.
+*/
+const IValue& FormulaGraph::GetResult(std::size_t nIdx) const
+{
+	return m_vFormula.at(nIdx).m_val;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the indices of the formulas in the order they are evaluated.
+	\throw ParserError if the formulas depend on each other cyclically.
+*/
+const std::vector<std::size_t>& FormulaGraph::GetOrder()
+{
+	if (!m_bSorted)
+		Sort();
+
+	return m_vOrder;
+}
+
+//---------------------------------------------------------------------------
+void FormulaGraph::MarkDirty(std::size_t nIdx)
+{
+	SFormula &formula = m_vFormula[nIdx];
+	if (formula.m_bDirty)
+		return;
+
+	formula.m_bDirty = true;
+	++m_nDirty;
+	if (m_bSorted)
+		m_queDirty.push(formula.m_nRank);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate a formula and assign its result variable. */
+void FormulaGraph::Evaluate(std::size_t nIdx)
+{
+	SFormula &formula = m_vFormula[nIdx];
+	formula.m_val = formula.m_expr.Eval(*formula.m_pCtx);
+	if (formula.m_pResultVar.Get() != nullptr)
+		*static_cast<Variable*>(formula.m_pResultVar.Get()) = formula.m_val;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the dirty formulas level by level using the thread pool.
+
+	The dirty formulas of the lowest level don't depend on each other. They 
+	are evaluated by the pool, the pool steals work between its threads. 
+	Formulas that are not allowed to run concurrently are evaluated by the 
+	calling thread afterwards. The formulas depending on the evaluated ones 
+	are marked dirty once the whole level is done.
+*/
+std::size_t FormulaGraph::RecomputeConcurrent()
+{
+	if (!m_pThreadPool)
+		m_pThreadPool.reset(new ThreadPool(m_nThreads));
+
+	std::size_t nEval = 0;
+	std::vector<std::size_t> vLevel;
+	std::vector<char> vDone;
+	while (!m_queDirty.empty())
+	{
+		vLevel.clear();
+		std::size_t nLevel = m_vFormula[m_vOrder[m_queDirty.top()]].m_nLevel;
+		while (!m_queDirty.empty() && m_vFormula[m_vOrder[m_queDirty.top()]].m_nLevel == nLevel)
+		{
+			vLevel.push_back(m_vOrder[m_queDirty.top()]);
+			m_queDirty.pop();
+		}
+
+		auto itSerial = std::stable_partition(vLevel.begin(), vLevel.end(), [this](std::size_t nIdx)
+		{
+			return m_vFormula[nIdx].m_bConcurrent;
+		});
+
+		// A single formula is not worth waking up the pool
+		std::size_t nConcurrent = itSerial - vLevel.begin();
+		if (nConcurrent == 1)
+			nConcurrent = 0;
+
+		vDone.assign(vLevel.size(), 0);
+		try
+		{
+			if (nConcurrent > 0)
+			{
+				m_pThreadPool->Run(nConcurrent, [&](int, std::size_t nTask)
+				{
+					Evaluate(vLevel[nTask]);
+					vDone[nTask] = 1;
+				});
+			}
+
+			for (std::size_t i = nConcurrent; i < vLevel.size(); ++i)
+			{
+				Evaluate(vLevel[i]);
+				vDone[i] = 1;
+			}
+		}
+		catch (...)
+		{
+			FinishLevel(vLevel, vDone);
+			throw;
+		}
+
+		nEval += FinishLevel(vLevel, vDone);
+	}
+
+	return nEval;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Update the dirty state after a level was evaluated.
+	\param vLevel The formulas of the level
+	\param vDone Nonzero for each formula evaluated successfully
+	\return The number of formulas evaluated successfully.
+
+	Formulas that were not evaluated because of an error stay dirty.
+*/
+std::size_t FormulaGraph::FinishLevel(const std::vector<std::size_t> &vLevel, const std::vector<char> &vDone)
+{
+	std::size_t nEval = 0;
+	for (std::size_t i = 0; i < vLevel.size(); ++i)
+	{
+		SFormula &formula = m_vFormula[vLevel[i]];
+		if (!vDone[i])
+		{
+			m_queDirty.push(formula.m_nRank);
+			continue;
+		}
+
+		formula.m_bDirty = false;
+		--m_nDirty;
+		++nEval;
+		for (std::size_t nSucc : formula.m_vSucc)
+			MarkDirty(nSucc);
+	}
+
+	return nEval;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the dependencies of the formulas and sort them topologically.
+	\throw ParserError if the formulas depend on each other cyclically.
+
+	A formula reading a variable depends on the formulas writing it. If it
+	writes the variable itself it depends on the formula writing it before.
+	The formulas are ordered by their levels and within a level by the order 
+	they were added in.
+*/
+void FormulaGraph::Sort()
+{
+	std::size_t nSize = m_vFormula.size();
+	for (SFormula &formula : m_vFormula)
+		formula.m_vSucc.clear();
+
+	for (const auto &item : m_mapWriter)
+	{
+		const std::vector<std::size_t> &vWriter = item.second;
+		for (std::size_t i = 1; i < vWriter.size(); ++i)
+			m_vFormula[vWriter[i - 1]].m_vSucc.push_back(vWriter[i]);
+
+		formula_map_type::const_iterator reader = m_mapReader.find(item.first);
+		if (reader == m_mapReader.end())
+			continue;
+
+		for (std::size_t nReader : reader->second)
+		{
+			if (std::find(vWriter.begin(), vWriter.end(), nReader) != vWriter.end())
+				continue;
+
+			for (std::size_t nWriter : vWriter)
+				m_vFormula[nWriter].m_vSucc.push_back(nReader);
+		}
+	}
+
+	std::vector<std::size_t> vInDegree(nSize, 0);
+	for (SFormula &formula : m_vFormula)
+	{
+		std::vector<std::size_t> &vSucc = formula.m_vSucc;
+		std::sort(vSucc.begin(), vSucc.end());
+		vSucc.erase(std::unique(vSucc.begin(), vSucc.end()), vSucc.end());
+		for (std::size_t nSucc : vSucc)
+			++vInDegree[nSucc];
+	}
+
+	// Kahn's algorithm, a level consists of the formulas that became ready
+	// after all formulas of the previous level were removed
+	std::vector<std::size_t> vReady, vNext;
+	for (std::size_t i = 0; i < nSize; ++i)
+	{
+		if (vInDegree[i] == 0)
+			vReady.push_back(i);
+	}
+
+	m_vOrder.clear();
+	for (std::size_t nLevel = 0; !vReady.empty(); ++nLevel)
+	{
+		std::sort(vReady.begin(), vReady.end());
+		vNext.clear();
+		for (std::size_t nIdx : vReady)
+		{
+			m_vFormula[nIdx].m_nRank = m_vOrder.size();
+			m_vFormula[nIdx].m_nLevel = nLevel;
+			m_vOrder.push_back(nIdx);
+			for (std::size_t nSucc : m_vFormula[nIdx].m_vSucc)
+			{
+				if (--vInDegree[nSucc] == 0)
+					vNext.push_back(nSucc);
+			}
+		}
+
+		vReady.swap(vNext);
+	}
+
+	if (m_vOrder.size() != nSize)
+	{
+		// Report a variable linking two formulas that could not be sorted
+		for (std::size_t i = 0; i < nSize; ++i)
+		{
+			if (vInDegree[i] == 0)
+				continue;
+
+			for (const string_type &sVar : m_vFormula[i].m_vIn)
+			{
+				formula_map_type::const_iterator writer = m_mapWriter.find(sVar);
+				if (writer == m_mapWriter.end())
+					continue;
+
+				for (std::size_t nWriter : writer->second)
+				{
+					if (nWriter == i || vInDegree[nWriter] == 0)
+						continue;
+
+					ErrorContext err(ecCYCLIC_DEPENDENCY, -1, sVar);
+					err.Expr = m_vFormula[i].m_expr.GetExpr();
+					throw ParserError(err);
+				}
+			}
+		}
+
+		throw ParserError(ErrorContext(ecCYCLIC_DEPENDENCY));
+	}
+
+	m_queDirty = rank_queue_type();
+	for (const SFormula &formula : m_vFormula)
+	{
+		if (formula.m_bDirty)
+			m_queDirty.push(formula.m_nRank);
+	}
+
+	m_bSorted = true;
+}
+
+MUP_NAMESPACE_END
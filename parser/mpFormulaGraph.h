@@ -0,0 +1,140 @@
+#ifndef MUP_FORMULA_GRAPH_H
+#define MUP_FORMULA_GRAPH_H
+
+/** \file
+    \brief Definition of a dependency graph of formulas.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <map>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+#include "mpValue.h"
+#include "mpEvalContext.h"
+#include "mpCompiledExpression.h"
+#include "mpThreadPool.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief A set of formulas reevaluated incrementally when variables change.
+
+    A formula is added from a parser holding its expression. The variables 
+    it reads are taken from ParserXBase::GetExprVar, the variables it writes
+    are the targets of its assignment operators and, optionally, a variable 
+    receiving its result. A formula reading a variable depends on all 
+    formulas writing it. Formulas writing the same variable are evaluated in 
+    the order they were added.
+
+    The host marks the variables it changed by SetDirty. Recompute then 
+    evaluates the formulas reading them in topological order, followed by 
+    the formulas depending on the variables written by these. All other 
+    formulas keep their results. Each formula has its own EvalContext, so 
+    switching between formulas doesn't recreate the evaluation buffers.
+
+    Formulas are sorted by levels: a formula depends only on formulas of 
+    lower levels. If more than one thread is set by SetThreads the dirty 
+    formulas of a level are evaluated concurrently by a ThreadPool. Formulas
+    calling volatile functions or operators other than the assignment 
+    operators are evaluated by the calling thread. Functions shared by the 
+    formulas must be thread safe.
+  */
+  class FormulaGraph
+  {
+  public:
+
+    FormulaGraph();
+
+    std::size_t AddFormula(const ParserXBase &a_Parser, const string_type &a_sResultVar = string_type());
+    void Clear();
+
+    void SetDirty(const string_type &a_sVar);
+    void SetAllDirty();
+    std::size_t Recompute();
+    void SetThreads(int nThreads);
+    int GetThreads() const;
+
+    std::size_t GetSize() const;
+    std::size_t GetNumDirty() const;
+    const string_type& GetExpr(std::size_t nIdx) const;
+    const IValue& GetResult(std::size_t nIdx) const;
+    const std::vector<std::size_t>& GetOrder();
+
+  private:
+
+    /** \brief A formula and the state of its last evaluation. */
+    struct SFormula
+    {
+      explicit SFormula(const CompiledExpression &a_Expr);
+
+      CompiledExpression m_expr;
+      std::unique_ptr<EvalContext> m_pCtx;
+      Value m_val;                        ///< Result of the last evaluation
+      ptr_tok_type m_pResultVar;          ///< Variable receiving the result or nullptr
+      std::vector<string_type> m_vIn;     ///< Names of the variables read
+      std::vector<string_type> m_vOut;    ///< Names of the variables written
+      std::vector<std::size_t> m_vSucc;   ///< Formulas depending on this one
+      std::size_t m_nRank;                ///< Position in the evaluation order
+      std::size_t m_nLevel;               ///< Length of the longest path of formulas leading to this one
+      bool m_bConcurrent;                 ///< True if the formula may be evaluated by any thread
+      bool m_bDirty;
+    };
+
+    typedef std::map<string_type, std::vector<std::size_t>> formula_map_type;
+    typedef std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<std::size_t>> rank_queue_type;
+
+    void MarkDirty(std::size_t nIdx);
+    void Evaluate(std::size_t nIdx);
+    std::size_t RecomputeConcurrent();
+    std::size_t FinishLevel(const std::vector<std::size_t> &vLevel, const std::vector<char> &vDone);
+    void Sort();
+
+    std::vector<SFormula> m_vFormula;
+    std::vector<std::size_t> m_vOrder;    ///< Formula indices in evaluation order
+    formula_map_type m_mapReader;         ///< Formulas reading a variable
+    formula_map_type m_mapWriter;         ///< Formulas writing a variable, in the order they were added
+    rank_queue_type m_queDirty;           ///< Ranks of the dirty formulas
+    std::size_t m_nDirty;
+    bool m_bSorted;                       ///< False if formulas were added since the last sort
+    int m_nThreads;
+    std::unique_ptr<ThreadPool> m_pThreadPool;
+  };
+
+MUP_NAMESPACE_END
+
+#endif
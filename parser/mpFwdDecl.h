@@ -46,7 +46,23 @@ MUP_NAMESPACE_START
   class IPrecedence;
   class IOprtIndex;
   class Value;
+  class Variable;
   class ValueCache;
+  class RPN;
+  class RPNCache;
+  class OprtFused;
+  class RealEngine;
+  class JitEngine;
+  class CodeGen;
+  class NativeCache;
+  class EvalContext;
+  class CompiledExpression;
+  class RPNArchive;
+  class RPNArchiveWriter;
+  class FormulaGraph;
+  class PreparedExpression;
+  class PreparedExpressionCache;
+  class TokenReader;
   template<typename T>
   class TokenPtr;
 
@@ -130,6 +130,20 @@ MUP_NAMESPACE_START
     m_nArgsPresent = argc;
   }
 
+  //------------------------------------------------------------------------------
+  /** \brief Returns true if the callback is free of side effects.
+
+    A pure callback returns the same result whenever it is called with the 
+    same arguments and does not change the state of the parser or its 
+    variables. Only pure callbacks are subject to constant folding and 
+    common subexpression elimination. Callbacks are pure by default, 
+    callbacks with side effects must be flagged with IToken::flVOLATILE.
+  */
+  bool ICallback::IsPure() const
+  {
+    return !IsFlagSet(flVOLATILE);
+  }
+
   //------------------------------------------------------------------------------
   int ICallback::GetArgsPresent() const
   {
@@ -69,6 +69,7 @@ MUP_NAMESPACE_START
         
       int GetArgc() const;
       int GetArgsPresent() const;
+      bool IsPure() const;
       void  SetParent(parent_type *a_pParent);
       void  SetNumArgsPresent(int argc);
 
@@ -62,6 +62,16 @@ MUP_NAMESPACE_START
       m_pTokenReader = pTokenReader;
     }
 
+    //--------------------------------------------------------------------------------------------
+    /** \brief Return the characters a value read by this reader can start with.
+        \return nullptr, values may start with any character unless a reader 
+                declares its start characters.
+    */
+    const char_type* IValueReader::GetStartChars() const
+    {
+      return nullptr;
+    }
+
     //--------------------------------------------------------------------------------------------
     const IToken* IValueReader::TokenHistory(std::size_t pos) const
     {
@@ -65,12 +65,14 @@ MUP_NAMESPACE_START
     virtual ~IValueReader();
 
     /** \brief Check a certain position in an expression for the presence of a value. 
+        \param a_sExpr View of the complete expression. The view is followed by a 
+                      terminating zero.
         \param a_iPos [in/out] Reference to an integer value representing the current 
                       position of the parser in the expression.
         \param a_Val If a value is found it is stored in a_Val
         \return true if a value was found
     */
-    virtual bool IsValue(const char_type *a_szExpr,
+    virtual bool IsValue(string_view_type a_sExpr,
                          int &a_iPos, 
                          Value &a_Val ) = 0;
 
@@ -78,6 +80,16 @@ MUP_NAMESPACE_START
         \return Pointer to the cloned value reader object.
     */
     virtual IValueReader* Clone(TokenReader *pParent) const = 0;
+
+    /** \brief Return the characters a value can start with. 
+
+      The token reader calls IsValue only at positions starting with one of 
+      these characters.
+
+      \return A zero terminated string or nullptr if a value may start with 
+              any character.
+    */
+    virtual const char_type* GetStartChars() const;
     
     /** \brief Assign this value reader object to a token 
                reader object. 
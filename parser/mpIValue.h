@@ -90,6 +90,7 @@ public:
 	virtual char_type GetType() const = 0;
 	virtual int GetRows() const = 0;
 	virtual int GetCols() const = 0;
+	virtual std::size_t GetVersion() const = 0;
 
 	virtual string_type ToString() const override;
 
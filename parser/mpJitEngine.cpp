@@ -0,0 +1,759 @@
+/** \file
+    \brief Implementation of the native code generator for real valued expressions.
+
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpJitEngine.h"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+	#define MUP_JIT_X64
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define MUP_DLOPEN
+	#include <dlfcn.h>
+#endif
+
+
+MUP_NAMESPACE_START
+
+#if defined(MUP_JIT_X64)
+
+namespace
+{
+	//---------------------------------------------------------------------------
+	/** \brief Emits the x86-64 instructions used by the code generator.
+
+		rbx holds the address of the buffer, r12 the address receiving the 
+		result. xmm0, xmm1, rax, rcx, rsi and rdi are used as scratch registers.
+		Memory operands are addressed by their index in the buffer.
+	*/
+	class Assembler
+	{
+	public:
+
+		enum ERegister { regRAX = 0, regRCX = 1, regRDI = 7 };
+
+		enum ECondition
+		{
+			ccAE = 0x83,    ///< unsigned above or equal
+			ccE  = 0x84,
+			ccNE = 0x85
+		};
+
+		explicit Assembler(std::vector<unsigned char>& vCode)
+			:m_vCode(vCode)
+		{}
+
+		std::size_t GetPos() const
+		{
+			return m_vCode.size();
+		}
+
+		// push rbx; push r12; sub rsp, 8; mov rbx, rdi; mov r12, rsi
+		void Prologue()
+		{
+			Emit({ 0x53, 0x41, 0x54, 0x48, 0x83, 0xEC, 0x08, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4 });
+		}
+
+		// mov eax, nRet; add rsp, 8; pop r12; pop rbx; ret
+		void Epilogue(int nRet)
+		{
+			if (nRet == 0)
+				Emit({ 0x31, 0xC0 });
+			else
+				Emit({ 0xB8, 0x01, 0x00, 0x00, 0x00 });
+
+			Emit({ 0x48, 0x83, 0xC4, 0x08, 0x41, 0x5C, 0x5B, 0xC3 });
+		}
+
+		// movsd xmm, [rbx + 8*nIdx]
+		void Load(int nXmm, int nIdx)
+		{
+			Emit({ 0xF2, 0x0F, 0x10, (unsigned char)(0x83 | (nXmm << 3)) });
+			Emit32(nIdx * (int)sizeof(float_type));
+		}
+
+		// movsd [rbx + 8*nIdx], xmm
+		void Store(int nXmm, int nIdx)
+		{
+			Emit({ 0xF2, 0x0F, 0x11, (unsigned char)(0x83 | (nXmm << 3)) });
+			Emit32(nIdx * (int)sizeof(float_type));
+		}
+
+		// movsd [r12], xmm0
+		void StoreResult()
+		{
+			Emit({ 0xF2, 0x41, 0x0F, 0x11, 0x04, 0x24 });
+		}
+
+		// lea rsi, [rbx + 8*nIdx]
+		void LeaRsi(int nIdx)
+		{
+			Emit({ 0x48, 0x8D, 0xB3 });
+			Emit32(nIdx * (int)sizeof(float_type));
+		}
+
+		// mov reg, imm64
+		void MovImm(ERegister eReg, std::uint64_t nVal)
+		{
+			Emit({ 0x48, (unsigned char)(0xB8 + eReg) });
+			for (int i = 0; i < 8; ++i)
+				m_vCode.push_back((unsigned char)(nVal >> (8 * i)));
+		}
+
+		// mov rax, imm64; movq xmm, rax
+		void LoadConst(int nXmm, float_type fVal)
+		{
+			std::uint64_t nBits;
+			std::memcpy(&nBits, &fVal, sizeof(nBits));
+			MovImm(regRAX, nBits);
+			Emit({ 0x66, 0x48, 0x0F, 0x6E, (unsigned char)(0xC0 | (nXmm << 3)) });
+		}
+
+		// movq rax, xmm0
+		void MovRaxXmm0()
+		{
+			Emit({ 0x66, 0x48, 0x0F, 0x7E, 0xC0 });
+		}
+
+		// movapd xmm1, xmm0
+		void CopyXmm0ToXmm1()
+		{
+			Emit({ 0x66, 0x0F, 0x28, 0xC8 });
+		}
+
+		// Scalar double operations (addsd 0x58, mulsd 0x59, subsd 0x5C, divsd 0x5E)
+		void OpSd(unsigned char nOp, int nDst, int nSrc)
+		{
+			Emit({ 0xF2, 0x0F, nOp, (unsigned char)(0xC0 | (nDst << 3) | nSrc) });
+		}
+
+		// Packed double operations (andpd 0x54, xorpd 0x57)
+		void OpPd(unsigned char nOp, int nDst, int nSrc)
+		{
+			Emit({ 0x66, 0x0F, nOp, (unsigned char)(0xC0 | (nDst << 3) | nSrc) });
+		}
+
+		// cmpsd xmm0, xmm1, nPred
+		void CmpSd(unsigned char nPred)
+		{
+			Emit({ 0xF2, 0x0F, 0xC2, 0xC1, nPred });
+		}
+
+		// call rax
+		void CallRax()
+		{
+			Emit({ 0xFF, 0xD0 });
+		}
+
+		// cmp rax, rcx
+		void CmpRaxRcx()
+		{
+			Emit({ 0x48, 0x39, 0xC8 });
+		}
+
+		// shl rax, 1
+		void ShlRax()
+		{
+			Emit({ 0x48, 0xD1, 0xE0 });
+		}
+
+		// test al, al
+		void TestAl()
+		{
+			Emit({ 0x84, 0xC0 });
+		}
+
+		/** \brief Emit a conditional jump, returns the position of its displacement. */
+		std::size_t Jcc(ECondition eCond)
+		{
+			Emit({ 0x0F, (unsigned char)eCond });
+			Emit32(0);
+			return GetPos() - 4;
+		}
+
+		// jmp rel32
+		std::size_t Jmp()
+		{
+			Emit({ 0xE9 });
+			Emit32(0);
+			return GetPos() - 4;
+		}
+
+		/** \brief Set the target of a jump. */
+		void Patch(std::size_t nDisp, std::size_t nTarget)
+		{
+			std::int32_t nRel = (std::int32_t)((std::int64_t)nTarget - (std::int64_t)(nDisp + 4));
+			std::memcpy(&m_vCode[nDisp], &nRel, sizeof(nRel));
+		}
+
+	private:
+
+		void Emit(std::initializer_list<unsigned char> bytes)
+		{
+			m_vCode.insert(m_vCode.end(), bytes.begin(), bytes.end());
+		}
+
+		void Emit32(int nVal)
+		{
+			for (int i = 0; i < 4; ++i)
+				m_vCode.push_back((unsigned char)((std::uint32_t)nVal >> (8 * i)));
+		}
+
+		std::vector<unsigned char>& m_vCode;
+	};
+
+	template<typename TFun>
+	std::uint64_t Address(TFun pFun)
+	{
+		return (std::uint64_t)reinterpret_cast<std::uintptr_t>(pFun);
+	}
+} // anonymous namespace
+
+#endif // MUP_JIT_X64
+
+//---------------------------------------------------------------------------
+JitEngine::JitEngine()
+	:m_pMem(nullptr)
+	, m_pLib(nullptr)
+	, m_nMemSize(0)
+	, m_nCodeSize(0)
+	, m_pFun(nullptr)
+	, m_vCallout()
+	, m_cResultType('f')
+{}
+
+//---------------------------------------------------------------------------
+JitEngine::~JitEngine()
+{
+	Reset();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if native code can be created on this platform. */
+bool JitEngine::IsSupported()
+{
+#if defined(MUP_JIT_X64)
+	return std::is_same<float_type, double>::value;
+#else
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+/** \brief Release the machine code. */
+void JitEngine::Reset()
+{
+#if defined(MUP_JIT_X64)
+	if (m_pMem != nullptr)
+		munmap(m_pMem, m_nMemSize);
+#endif
+
+#if defined(MUP_DLOPEN)
+	if (m_pLib != nullptr)
+		dlclose(m_pLib);
+#endif
+
+	m_pMem = nullptr;
+	m_pLib = nullptr;
+	m_nMemSize = 0;
+	m_nCodeSize = 0;
+	m_pFun = nullptr;
+	m_vCallout.clear();
+	m_cResultType = 'f';
+}
+
+//---------------------------------------------------------------------------
+/** \brief Exchange the machine code of two engines. */
+void JitEngine::Swap(JitEngine& ref)
+{
+	std::swap(m_pMem, ref.m_pMem);
+	std::swap(m_pLib, ref.m_pLib);
+	std::swap(m_nMemSize, ref.m_nMemSize);
+	std::swap(m_nCodeSize, ref.m_nCodeSize);
+	std::swap(m_pFun, ref.m_pFun);
+	m_vCallout.swap(ref.m_vCallout);
+	std::swap(m_cResultType, ref.m_cResultType);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create machine code for the bytecode of a RealEngine.
+	\return false if the bytecode can't be translated.
+
+	The machine code does not refer to the engine, it may be changed or 
+	destroyed afterwards.
+*/
+bool JitEngine::Compile(const RealEngine& engine)
+{
+	Reset();
+
+	if (!IsSupported() || !engine.IsValid())
+		return false;
+
+#if defined(MUP_JIT_X64)
+	std::vector<unsigned char> vCode;
+	if (!CompileCode(engine, vCode))
+	{
+		Reset();
+		return false;
+	}
+
+	long nPageSize = sysconf(_SC_PAGESIZE);
+	std::size_t nPage = (nPageSize > 0) ? (std::size_t)nPageSize : 4096;
+	std::size_t nSize = (vCode.size() + nPage - 1) / nPage * nPage;
+	void* pMem = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pMem == MAP_FAILED)
+	{
+		Reset();
+		return false;
+	}
+
+	m_pMem = pMem;
+	m_nMemSize = nSize;
+	std::memcpy(m_pMem, vCode.data(), vCode.size());
+
+	// Memory is never writable and executable at the same time
+	if (mprotect(m_pMem, m_nMemSize, PROT_READ | PROT_EXEC) != 0)
+	{
+		Reset();
+		return false;
+	}
+
+	m_nCodeSize = vCode.size();
+	m_pFun = reinterpret_cast<fun_type>(m_pMem);
+	m_cResultType = engine.GetResultType();
+	return true;
+#else
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+/** \brief Bind a function created by CodeGen::Generate from a shared library.
+	\param engine The bytecode engine the code was generated from
+	\param sFile Path of the shared library
+	\param sSymbol Name of the function
+	\return false if the library can't be opened or does not contain the function.
+
+	The library stays open until Reset is called.
+*/
+bool JitEngine::Load(const RealEngine& engine, const std::string& sFile, const std::string& sSymbol)
+{
+	Reset();
+
+	if (!engine.IsValid())
+		return false;
+
+#if defined(MUP_DLOPEN)
+	m_pLib = dlopen(sFile.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (m_pLib == nullptr)
+		return false;
+
+	void* pSym = dlsym(m_pLib, sSymbol.c_str());
+	if (pSym == nullptr)
+	{
+		Reset();
+		return false;
+	}
+
+	m_pFun = reinterpret_cast<fun_type>(pSym);
+	m_cResultType = engine.GetResultType();
+	return true;
+#else
+	static_cast<void>(sFile);
+	static_cast<void>(sSymbol);
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+/** \brief Translate the instructions of the bytecode engine.
+
+	The stack depth of every instruction is known at compile time. All 
+	stack items except the top one are kept in the stack area of the buffer.
+	The top of the stack is kept in xmm0, which is also the first argument 
+	and the return value of the called functions.
+*/
+bool JitEngine::CompileCode(const RealEngine& engine, std::vector<unsigned char>& vCode)
+{
+#if defined(MUP_JIT_X64)
+	typedef RealEngine::SInstr SInstr;
+
+	const std::vector<SInstr>& vInstr = engine.m_vInstr;
+	const int nTemp = (int)engine.m_vVar.size();          // Index of the first temporary value
+	const int nStack = nTemp + engine.m_nTempSlots;       // Index of the first stack item
+	const std::size_t nSize = vInstr.size();
+
+	std::vector<int> vDepth(nSize + 1, -1);               // Stack depth at jump targets
+	std::vector<std::size_t> vPos(nSize + 1, 0);          // Code position of each instruction
+	std::vector<std::pair<std::size_t, std::size_t>> vJump;   // Jumps and their target instruction
+	std::vector<std::size_t> vFail;                       // Jumps to the failure exit
+
+	m_vCallout.reserve(nSize);
+
+	Assembler a(vCode);
+	a.Prologue();
+
+	int d = 0;              // Stack depth
+	bool bReachable = true;
+
+	// Keep the top of the stack in xmm0 when pushing a new value
+	auto Push = [&]()
+	{
+		if (d > 0)
+			a.Store(0, nStack + d - 1);
+		++d;
+	};
+
+	// Reload the new top of the stack after popping
+	auto Pop = [&]()
+	{
+		--d;
+		if (d > 0)
+			a.Load(0, nStack + d - 1);
+	};
+
+	auto JumpTo = [&](std::size_t nDisp, std::size_t nTarget, int nDepth)
+	{
+		if (nTarget > nSize || (vDepth[nTarget] >= 0 && vDepth[nTarget] != nDepth))
+			return false;
+
+		vDepth[nTarget] = nDepth;
+		vJump.push_back(std::make_pair(nDisp, nTarget));
+		return true;
+	};
+
+	// Strength reduced operators fail if the top of the stack is not finite
+	auto FailIfNotFinite = [&]()
+	{
+		a.MovRaxXmm0();
+		a.ShlRax();
+		a.MovImm(Assembler::regRCX, 0xFFE0000000000000ULL);
+		a.CmpRaxRcx();
+		vFail.push_back(a.Jcc(Assembler::ccAE));
+	};
+
+	// Leaves the flags of comparing the top of the stack with 1
+	auto CmpTrue = [&]()
+	{
+		a.MovRaxXmm0();
+		a.MovImm(Assembler::regRCX, 0x3FF0000000000000ULL);
+		a.CmpRaxRcx();
+	};
+
+	for (std::size_t i = 0; i <= nSize; ++i)
+	{
+		if (vDepth[i] >= 0)
+		{
+			if (bReachable && vDepth[i] != d)
+				return false;
+
+			d = vDepth[i];
+			bReachable = true;
+		}
+		else if (!bReachable)
+			return false;
+
+		vPos[i] = a.GetPos();
+		if (i == nSize)
+			break;
+
+		const SInstr& instr = vInstr[i];
+		int nArgs = 0;     // Number of stack items used by the instruction
+		switch (instr.eCode)
+		{
+		case RealEngine::opVAL:   Push(); a.LoadConst(0, instr.fVal); continue;
+		case RealEngine::opVAR:   Push(); a.Load(0, instr.nIdx); continue;
+		case RealEngine::opLOAD:  Push(); a.Load(0, nTemp + instr.nIdx); continue;
+		case RealEngine::opSTORE: nArgs = 1; break;
+		case RealEngine::opNEG:
+		case RealEngine::opNEG_CMPLX:
+		case RealEngine::opFUN1:
+		case RealEngine::opFUN1_CMPLX:
+		case RealEngine::opIF:
+		case RealEngine::opOR:
+		case RealEngine::opAND:
+		case RealEngine::opIDENTITY:
+		case RealEngine::opADD_ZERO:
+		case RealEngine::opPOW_INT:
+		case RealEngine::opMUL_CONST:
+		case RealEngine::opDIV_CONST:
+			nArgs = 1;
+			break;
+
+		case RealEngine::opJMP:
+			break;
+
+		default:
+			nArgs = 2;
+			break;
+		}
+
+		if (d < nArgs)
+			return false;
+
+		switch (instr.eCode)
+		{
+		case RealEngine::opSTORE:
+			a.Store(0, nTemp + instr.nIdx);
+			break;
+
+		// Binary operators compute xmm0 = [stack] op xmm0
+		case RealEngine::opADD:
+		case RealEngine::opSUB:
+		case RealEngine::opMUL:
+		case RealEngine::opDIV:
+		case RealEngine::opMUL_CMPLX:
+		{
+			unsigned char nOp = 0x58;
+			switch (instr.eCode)
+			{
+			case RealEngine::opSUB: nOp = 0x5C; break;
+			case RealEngine::opDIV: nOp = 0x5E; break;
+			case RealEngine::opMUL:
+			case RealEngine::opMUL_CMPLX: nOp = 0x59; break;
+			default: break;
+			}
+
+			a.CopyXmm0ToXmm1();
+			a.Load(0, nStack + d - 2);
+			a.OpSd(nOp, 0, 1);
+			--d;
+
+			// The real part of a complex product differs if it is zero or not finite
+			if (instr.eCode == RealEngine::opMUL_CMPLX)
+			{
+				a.MovRaxXmm0();
+				a.ShlRax();
+				vFail.push_back(a.Jcc(Assembler::ccE));
+				a.MovImm(Assembler::regRCX, 0xFFE0000000000000ULL);
+				a.CmpRaxRcx();
+				vFail.push_back(a.Jcc(Assembler::ccAE));
+			}
+		}
+		break;
+
+		// Comparisons create a mask of all bits and select the bits of 1.0 
+		// with it. a>b and a>=b are computed as b<a and b<=a.
+		case RealEngine::opLT:
+		case RealEngine::opLE:
+		case RealEngine::opEQ:
+		case RealEngine::opNEQ:
+		case RealEngine::opGT:
+		case RealEngine::opGE:
+		{
+			unsigned char nPred = 0;
+			switch (instr.eCode)
+			{
+			case RealEngine::opLT:
+			case RealEngine::opGT:  nPred = 1; break;
+			case RealEngine::opLE:
+			case RealEngine::opGE:  nPred = 2; break;
+			case RealEngine::opNEQ: nPred = 4; break;
+			default: break;
+			}
+
+			if (instr.eCode == RealEngine::opGT || instr.eCode == RealEngine::opGE)
+			{
+				a.Load(1, nStack + d - 2);
+			}
+			else
+			{
+				a.CopyXmm0ToXmm1();
+				a.Load(0, nStack + d - 2);
+			}
+
+			a.CmpSd(nPred);
+			a.LoadConst(1, 1);
+			a.OpPd(0x54, 0, 1);
+			--d;
+		}
+		break;
+
+		case RealEngine::opNEG:
+		case RealEngine::opNEG_CMPLX:
+			a.LoadConst(1, -0.0);
+			a.OpPd(0x57, 0, 1);
+
+			// -0 is replaced by 0: -v + 0 is 0 for v==0 and -v otherwise
+			if (instr.eCode == RealEngine::opNEG_CMPLX)
+			{
+				a.OpPd(0x57, 1, 1);
+				a.OpSd(0x58, 0, 1);
+			}
+			break;
+
+		case RealEngine::opFUN1:
+			a.MovImm(Assembler::regRAX, Address(instr.pFun1));
+			a.CallRax();
+			break;
+
+		case RealEngine::opFUN2:
+			a.CopyXmm0ToXmm1();
+			a.Load(0, nStack + d - 2);
+			a.MovImm(Assembler::regRAX, Address(instr.pFun2));
+			a.CallRax();
+			--d;
+			break;
+
+		// Instructions that may fail are executed by RealEngine::EvalCallout
+		// on the stack area of the buffer
+		case RealEngine::opPOW:
+		case RealEngine::opPOW_CMPLX:
+		case RealEngine::opFUN1_CMPLX:
+		case RealEngine::opFUN2_CMPLX:
+			m_vCallout.push_back(instr);
+			a.Store(0, nStack + d - 1);
+			a.LeaRsi(nStack + d - nArgs);
+			a.MovImm(Assembler::regRDI, Address(&m_vCallout.back()));
+			a.MovImm(Assembler::regRAX, Address(&RealEngine::EvalCallout));
+			a.CallRax();
+			a.TestAl();
+			vFail.push_back(a.Jcc(Assembler::ccE));
+			d -= nArgs - 1;
+			a.Load(0, nStack + d - 1);
+			break;
+
+		case RealEngine::opIF:
+			CmpTrue();
+			Pop();
+			if (!JumpTo(a.Jcc(Assembler::ccNE), instr.nIdx, d))
+				return false;
+			break;
+
+		case RealEngine::opJMP:
+			if (!JumpTo(a.Jmp(), instr.nIdx, d))
+				return false;
+			bReachable = false;
+			break;
+
+		case RealEngine::opOR:
+		case RealEngine::opAND:
+			CmpTrue();
+			if (!JumpTo(a.Jcc((instr.eCode == RealEngine::opOR) ? Assembler::ccE : Assembler::ccNE), instr.nIdx, d))
+				return false;
+			Pop();
+			break;
+
+		case RealEngine::opIDENTITY:
+			FailIfNotFinite();
+			break;
+
+		case RealEngine::opADD_ZERO:
+			FailIfNotFinite();
+			a.OpPd(0x57, 1, 1);
+			a.OpSd(0x58, 0, 1);
+			break;
+
+		case RealEngine::opPOW_INT:
+			if (instr.nIdx < 2 || instr.nIdx > 5)
+				return false;
+
+			FailIfNotFinite();
+			a.CopyXmm0ToXmm1();
+			for (int k = 1; k < instr.nIdx; ++k)
+				a.OpSd(0x59, 0, 1);
+			break;
+
+		case RealEngine::opMUL_CONST:
+		case RealEngine::opDIV_CONST:
+			FailIfNotFinite();
+			a.LoadConst(1, instr.fVal);
+			a.OpSd((instr.eCode == RealEngine::opMUL_CONST) ? 0x59 : 0x5E, 0, 1);
+			break;
+
+		default:
+			return false;
+		}
+	}
+
+	if (!bReachable || d != 1)
+		return false;
+
+	a.StoreResult();
+	a.Epilogue(1);
+
+	std::size_t nFail = a.GetPos();
+	a.Epilogue(0);
+
+	for (const auto& jump : vJump)
+		a.Patch(jump.first, vPos[jump.second]);
+
+	for (std::size_t nDisp : vFail)
+		a.Patch(nDisp, nFail);
+
+	return true;
+#else
+	(void)engine;
+	(void)vCode;
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the expression with the machine code.
+	\param pBuf A buffer of RealEngine::GetBufferSize() values starting with the values of the variables.
+	\param fRes Receives the result.
+	\return false if the expression must be evaluated by the generic engine (see RealEngine::Eval).
+*/
+bool JitEngine::Eval(float_type* pBuf, float_type& fRes) const
+{
+	if (m_pFun == nullptr || m_pFun(pBuf, &fRes) == 0)
+		return false;
+
+	return RealEngine::CheckResult(m_cResultType, fRes);
+}
+
+//---------------------------------------------------------------------------
+bool JitEngine::IsValid() const
+{
+	return m_pFun != nullptr;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the size of the machine code in bytes. */
+std::size_t JitEngine::GetCodeSize() const
+{
+	return m_nCodeSize;
+}
+
+MUP_NAMESPACE_END
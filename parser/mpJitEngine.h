@@ -0,0 +1,106 @@
+#ifndef MUP_JIT_ENGINE_H
+#define MUP_JIT_ENGINE_H
+
+/** \file
+    \brief Definition of the native code generator for real valued expressions.
+
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <string>
+#include <vector>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+#include "mpRealEngine.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief Translates the bytecode of a RealEngine into x86-64 machine code.
+
+    The machine code is written into memory pages obtained by mmap which are
+    made executable after the code is complete. It uses the buffer layout of
+    RealEngine::Eval (variables, temporary values, stack). The top of the 
+    stack is kept in a register. Functions of the built in packages are 
+    called by their address, so results are bit identical to the bytecode 
+    engine. If an intermediate result can't be computed the machine code 
+    returns and Eval fails just like RealEngine::Eval does.
+
+    Native code is created for the System V ABI on x86-64 only. On other 
+    platforms, and for bytecode the code generator does not support, Compile 
+    fails and the expression must be evaluated by the interpreters.
+
+    Alternatively Load binds a function created by CodeGen and compiled into
+    a shared library (see NativeCache).
+  */
+  class JitEngine
+  {
+  public:
+
+    JitEngine();
+   ~JitEngine();
+
+    JitEngine(const JitEngine &ref) = delete;
+    JitEngine& operator=(const JitEngine &ref) = delete;
+
+    static bool IsSupported();
+
+    bool Compile(const RealEngine &engine);
+    bool Load(const RealEngine &engine, const std::string &sFile, const std::string &sSymbol);
+    void Reset();
+    void Swap(JitEngine &ref);
+    bool Eval(float_type *pBuf, float_type &fRes) const;
+
+    bool IsValid() const;
+    std::size_t GetCodeSize() const;
+
+  private:
+
+    typedef int (*fun_type)(float_type *pBuf, float_type *pRes);
+
+    bool CompileCode(const RealEngine &engine, std::vector<unsigned char> &vCode);
+
+    void *m_pMem;                 ///< Executable memory holding the machine code
+    void *m_pLib;                 ///< Handle of a shared library opened by Load
+    std::size_t m_nMemSize;
+    std::size_t m_nCodeSize;
+    fun_type m_pFun;
+    std::vector<RealEngine::SInstr> m_vCallout;   ///< Instructions executed by RealEngine::EvalCallout
+    char_type m_cResultType;      ///< Result type of the bytecode
+  };
+
+MUP_NAMESPACE_END
+
+#endif
@@ -0,0 +1,437 @@
+/** \file
+    \brief Implementation of a cache of expressions compiled to native code by the system compiler.
+
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpNativeCache.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include "mpCodeGen.h"
+#include "mpJitEngine.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define MUP_NATIVE_CACHE
+	#include <fcntl.h>
+	#include <spawn.h>
+	#include <sys/stat.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+
+	#if defined(__APPLE__)
+		#include <crt_externs.h>
+		#define environ (*_NSGetEnviron())
+	#else
+		extern char **environ;
+	#endif
+#endif
+
+
+MUP_NAMESPACE_START
+
+//---------------------------------------------------------------------------
+/** \brief Create a cache using a directory for the generated files.
+	\param sDir The directory. It is created if it does not exist.
+*/
+NativeCache::NativeCache(const std::string& sDir)
+	:m_sDir(sDir)
+	, m_sCompiler("c++")
+	, m_vCompilerArgs({ "-std=c++11", "-O2", "-ffp-contract=off", "-shared", "-fPIC" })
+	, m_nBuilds(0)
+	, m_mtx()
+	, m_cvBuild()
+	, m_setBuild()
+	, m_mapLib()
+{}
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if shared libraries can be loaded on this platform. */
+bool NativeCache::IsSupported()
+{
+#if defined(MUP_NATIVE_CACHE)
+	return CodeGen::IsSupported();
+#else
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+/** \brief Set the compiler used to build a shared library.
+	\param sProgram The compiler, it is searched in PATH.
+	\param vArgs The options of the compiler.
+
+	The compiler is called with vArgs followed by "-o <library> <source>". 
+	It is started directly, not by a shell. Floating point contraction must 
+	be disabled to get the same results as the interpreters.
+*/
+void NativeCache::SetCompiler(const std::string& sProgram, const std::vector<std::string>& vArgs)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_sCompiler = sProgram;
+	m_vCompilerArgs = vArgs;
+}
+
+//---------------------------------------------------------------------------
+std::string NativeCache::GetCompiler() const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_sCompiler;
+}
+
+//---------------------------------------------------------------------------
+std::vector<std::string> NativeCache::GetCompilerArgs() const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_vCompilerArgs;
+}
+
+//---------------------------------------------------------------------------
+const std::string& NativeCache::GetDirectory() const
+{
+	return m_sDir;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns a compiled expression evaluated by native code.
+	\param a_Expr The expression
+	\return A copy of the expression using native code or a_Expr if it can't be compiled.
+
+	The library is looked up in memory first, then in the cache directory.
+	If it does not exist the compiler is called. The lock is not held while
+	a library is built or loaded. Threads loading the same library wait for
+	the thread building it, other threads are not blocked.
+*/
+CompiledExpression NativeCache::Load(const CompiledExpression& a_Expr)
+{
+	if (!IsSupported() || !a_Expr.IsRealEngineUsed())
+		return a_Expr;
+
+	const RealEngine& engine = a_Expr.m_pData->m_realEngine;
+
+	// The key does not depend on the expression string, "a+b" and "a + b" 
+	// share a library
+	std::string sCode;
+	if (!CodeGen::Generate(engine, "mup_expr", std::string(), sCode))
+		return a_Expr;
+
+	std::vector<std::string> vCmd;
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		vCmd.push_back(m_sCompiler);
+		vCmd.insert(vCmd.end(), m_vCompilerArgs.begin(), m_vCompilerArgs.end());
+	}
+
+	std::string sKey = sCode;
+	for (const std::string& sArg : vCmd)
+		sKey += "\n" + sArg;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mtx);
+		for (;;)
+		{
+			auto it = m_mapLib.find(sKey);
+			if (it != m_mapLib.end())
+				return CompiledExpression(a_Expr, it->second);
+
+			if (m_setBuild.insert(sKey).second)
+				break;
+
+			m_cvBuild.wait(lock);
+		}
+	}
+
+	// Files are shared by all processes using the directory, the hash must 
+	// be collision resistant since a collision runs the code of another 
+	// expression
+	const std::string sHash = GetHash(sKey);
+	const std::string sSymbol = "mup_expr_" + sHash;
+	const std::string sFile = m_sDir + "/mup_" + sHash;
+
+	std::shared_ptr<JitEngine> pNative;
+	bool bBuilt = false;
+	try
+	{
+		if (CheckDirectory())
+		{
+			pNative = std::make_shared<JitEngine>();
+			if (!IsPrivate(sFile + ".so", false) || !pNative->Load(engine, sFile + ".so", sSymbol))
+			{
+				std::string sComment;
+				for (char_type c : a_Expr.GetExpr())
+					sComment += (c >= 32 && c < 127) ? static_cast<char>(c) : '?';
+
+				bBuilt = CodeGen::Generate(engine, sSymbol, sComment, sCode) && Build(vCmd, sCode, sFile);
+				if (!bBuilt || !pNative->Load(engine, sFile + ".so", sSymbol))
+					pNative.reset();
+			}
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_setBuild.erase(sKey);
+		m_cvBuild.notify_all();
+		throw;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_setBuild.erase(sKey);
+	m_cvBuild.notify_all();
+	if (bBuilt)
+		++m_nBuilds;
+
+	if (pNative == nullptr)
+		return a_Expr;
+
+	m_mapLib[sKey] = pNative;
+	return CompiledExpression(a_Expr, pNative);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the cache directory and check that nobody else can write to it. */
+bool NativeCache::CheckDirectory() const
+{
+#if defined(MUP_NATIVE_CACHE)
+	if (mkdir(m_sDir.c_str(), 0700) != 0 && errno != EEXIST)
+		return false;
+
+	return IsPrivate(m_sDir, true);
+#else
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if a file is owned by the user of the process and 
+		   nobody else can write to it.
+	\param sPath The path of the file
+	\param bDir True if the file must be a directory, false if it must be a regular file
+
+	Symbolic links are not followed.
+*/
+bool NativeCache::IsPrivate(const std::string& sPath, bool bDir)
+{
+#if defined(MUP_NATIVE_CACHE)
+	struct stat st;
+	if (lstat(sPath.c_str(), &st) != 0)
+		return false;
+
+	return (bDir ? S_ISDIR(st.st_mode) : S_ISREG(st.st_mode)) &&
+		st.st_uid == geteuid() &&
+		(st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+#else
+	static_cast<void>(sPath);
+	static_cast<void>(bDir);
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+/** \brief Write the code into a file and build a shared library.
+	\param vCmd The compiler followed by its options
+	\param sCode The C++ code
+	\param sFile The path of the files without extension
+
+	The library is built under a temporary name and renamed afterwards, so
+	other processes never open an incomplete library. The output of the 
+	compiler is discarded.
+*/
+bool NativeCache::Build(const std::vector<std::string>& vCmd, const std::string& sCode, const std::string& sFile)
+{
+#if defined(MUP_NATIVE_CACHE)
+	const std::string sSource = sFile + ".cpp";
+	const std::string sTemp = sFile + "." + std::to_string(getpid()) + ".tmp";
+	{
+		std::ofstream file(sSource.c_str(), std::ios::out | std::ios::trunc);
+		file << sCode;
+		if (!file.good())
+			return false;
+	}
+
+	std::vector<char*> vArgv;
+	for (const std::string& sArg : vCmd)
+		vArgv.push_back(const_cast<char*>(sArg.c_str()));
+
+	std::string sOut = "-o";
+	vArgv.push_back(const_cast<char*>(sOut.c_str()));
+	vArgv.push_back(const_cast<char*>(sTemp.c_str()));
+	vArgv.push_back(const_cast<char*>(sSource.c_str()));
+	vArgv.push_back(nullptr);
+
+	posix_spawn_file_actions_t actions;
+	if (posix_spawn_file_actions_init(&actions) != 0)
+		return false;
+
+	posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+	posix_spawn_file_actions_adddup2(&actions, 1, 2);
+
+	pid_t pid = 0;
+	int nStat = posix_spawnp(&pid, vArgv[0], &actions, nullptr, vArgv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+
+	bool bOk = (nStat == 0);
+	if (bOk)
+	{
+		pid_t nRet;
+		while ((nRet = waitpid(pid, &nStat, 0)) < 0 && errno == EINTR)
+			;
+
+		bOk = nRet == pid && WIFEXITED(nStat) && WEXITSTATUS(nStat) == 0;
+	}
+
+	// The mode of the library depends on the umask, it must not be writable 
+	// by others to be loaded
+	if (!bOk || 
+		chmod(sTemp.c_str(), 0700) != 0 || 
+		std::rename(sTemp.c_str(), (sFile + ".so").c_str()) != 0)
+	{
+		std::remove(sTemp.c_str());
+		return false;
+	}
+
+	return true;
+#else
+	static_cast<void>(vCmd);
+	static_cast<void>(sCode);
+	static_cast<void>(sFile);
+	return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the SHA-256 hash of a string as hex number (FIPS 180-4). */
+std::string NativeCache::GetHash(const std::string& sCode)
+{
+	static const std::uint32_t k[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+	std::uint32_t h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+	// The message is padded with 0x80, zeros and its length in bits to a 
+	// multiple of 64 bytes
+	std::string sMsg = sCode;
+	const std::uint64_t nBits = static_cast<std::uint64_t>(sCode.size()) * 8;
+	sMsg += static_cast<char>(0x80);
+	while (sMsg.size() % 64 != 56)
+		sMsg += '\0';
+
+	for (int i = 7; i >= 0; --i)
+		sMsg += static_cast<char>((nBits >> (i * 8)) & 0xff);
+
+	auto rotr = [](std::uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+	for (std::size_t nBlock = 0; nBlock < sMsg.size(); nBlock += 64)
+	{
+		std::uint32_t w[64];
+		for (int i = 0; i < 16; ++i)
+		{
+			const unsigned char* p = reinterpret_cast<const unsigned char*>(&sMsg[nBlock + i * 4]);
+			w[i] = (std::uint32_t)p[0] << 24 | (std::uint32_t)p[1] << 16 | (std::uint32_t)p[2] << 8 | p[3];
+		}
+
+		for (int i = 16; i < 64; ++i)
+		{
+			std::uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			std::uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+		for (int i = 0; i < 64; ++i)
+		{
+			std::uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+			std::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			hh = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+		h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+	}
+
+	std::ostringstream ss;
+	ss << std::hex << std::setfill('0');
+	for (std::uint32_t n : h)
+		ss << std::setw(8) << n;
+
+	return ss.str();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of libraries loaded by the cache. */
+std::size_t NativeCache::GetSize() const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_mapLib.size();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of libraries built by the compiler. */
+std::size_t NativeCache::GetNumBuilds() const
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return m_nBuilds;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Forget the loaded libraries. 
+
+	Libraries are closed when the last expression using them is destroyed.
+	Files in the cache directory are kept.
+*/
+void NativeCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_mapLib.clear();
+}
+
+MUP_NAMESPACE_END
@@ -0,0 +1,113 @@
+#ifndef MUP_NATIVE_CACHE_H
+#define MUP_NATIVE_CACHE_H
+
+/** \file
+    \brief Definition of a cache of expressions compiled to native code by the system compiler.
+
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+#include "mpCompiledExpression.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief Compiles expressions to shared libraries and loads them at runtime.
+
+    The C++ code created by CodeGen is written into the cache directory and
+    built with the system compiler. The library is then opened with dlopen.
+    Files are named after the SHA-256 hash of the generated code and the 
+    compiler command. Expressions with the same bytecode share a library, 
+    also across processes using the same directory. Libraries that were loaded once are 
+    kept open until the cache is destroyed or cleared.
+
+    Libraries in the directory are executed by the process. The directory 
+    is created with mode 0700 and is not used if it belongs to another user
+    or if others can write to it. 
+
+    Building a library takes a compiler run, so this only pays off for 
+    expressions that are evaluated very often. Expressions that can't be 
+    compiled are evaluated by the interpreters.
+  */
+  class NativeCache
+  {
+  public:
+
+    explicit NativeCache(const std::string &sDir);
+
+    NativeCache(const NativeCache &ref) = delete;
+    NativeCache& operator=(const NativeCache &ref) = delete;
+
+    static bool IsSupported();
+
+    void SetCompiler(const std::string &sProgram, const std::vector<std::string> &vArgs);
+    std::string GetCompiler() const;
+    std::vector<std::string> GetCompilerArgs() const;
+    const std::string& GetDirectory() const;
+
+    CompiledExpression Load(const CompiledExpression &a_Expr);
+    std::size_t GetSize() const;
+    std::size_t GetNumBuilds() const;
+    void Clear();
+
+  private:
+
+    static std::string GetHash(const std::string &sCode);
+    static bool IsPrivate(const std::string &sPath, bool bDir);
+    static bool Build(const std::vector<std::string> &vCmd, const std::string &sCode, const std::string &sFile);
+    bool CheckDirectory() const;
+
+    const std::string m_sDir;
+    std::string m_sCompiler;
+    std::vector<std::string> m_vCompilerArgs;
+    std::size_t m_nBuilds;        ///< Number of libraries built by the compiler
+    mutable std::mutex m_mtx;
+    std::condition_variable m_cvBuild;  ///< Signalled when a library was built
+    std::set<std::string> m_setBuild;   ///< Keys of the libraries being built by other threads
+    std::map<std::string, std::shared_ptr<const JitEngine>> m_mapLib;  ///< Libraries by the code and the compiler command
+  };
+
+MUP_NAMESPACE_END
+
+#endif
@@ -0,0 +1,366 @@
+/*
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     / 
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \ 
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, 
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice, 
+     this list of conditions and the following disclaimer in the documentation 
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mpOprtFused.h"
+
+#include <cmath>
+#include <typeinfo>
+
+#include "mpValue.h"
+#include "mpOprtCmplx.h"
+#include "mpOprtNonCmplx.h"
+#include "mpOprtBinCommon.h"
+
+
+MUP_NAMESPACE_START
+
+  namespace
+  {
+    /** \brief Operations computed directly for real scalar arguments. */
+    enum EOprt
+    {
+      opADD,
+      opSUB,
+      opMUL,
+      opMUL_CMPLX,
+      opDIV,
+      opLT,
+      opGT,
+      opLE,
+      opGE,
+      opEQ,
+      opNEQ
+    };
+
+    //------------------------------------------------------------------------------
+    /** \brief Returns the operation of a built in binary operator or -1. 
+    
+      User defined operators and derived classes are never fused since they 
+      may compute something else.
+    */
+    int GetOprt(const IToken *pTok)
+    {
+      if (pTok->GetCode() != cmOPRT_BIN || const_cast<IToken*>(pTok)->AsICallback()->GetArgsPresent() != 2)
+        return -1;
+
+      const std::type_info &type = typeid(*pTok);
+      if (type == typeid(OprtAdd) || type == typeid(OprtAddCmplx))
+        return opADD;
+      else if (type == typeid(OprtSub) || type == typeid(OprtSubCmplx))
+        return opSUB;
+      else if (type == typeid(OprtMul))
+        return opMUL;
+      else if (type == typeid(OprtMulCmplx))
+        return opMUL_CMPLX;
+      else if (type == typeid(OprtDiv) || type == typeid(OprtDivCmplx))
+        return opDIV;
+      else if (type == typeid(OprtLT))
+        return opLT;
+      else if (type == typeid(OprtGT))
+        return opGT;
+      else if (type == typeid(OprtLE))
+        return opLE;
+      else if (type == typeid(OprtGE))
+        return opGE;
+      else if (type == typeid(OprtEQ))
+        return opEQ;
+      else if (type == typeid(OprtNEQ))
+        return opNEQ;
+      else
+        return -1;
+    }
+  } // anonymous namespace
+
+  //------------------------------------------------------------------------------
+  OprtFused::OprtFused(EKind eKind, const token_vec_type &vTok, bool bFma)
+    :ICallback(cmFUSED, vTok.back()->GetIdent().c_str(), 0)
+    ,m_eKind(eKind)
+    ,m_vTok(vTok)
+    ,m_nOprt()
+    ,m_nOperands(0)
+    ,m_bFma(bFma && (eKind == fsMUL_ADD || eKind == fsADD_MUL))
+    ,m_vStack()
+  {
+    for (int i = 0; i < GetStackSize(); ++i)
+      m_vStack.push_back(ptr_val_type(new Value));
+
+    int nOprt = 0;
+    m_nOprt[0] = m_nOprt[1] = -1;
+    for (const ptr_tok_type &tok : m_vTok)
+    {
+      if (tok->GetCode() == cmVAL)
+        ++m_nOperands;
+      else 
+        m_nOprt[nOprt++] = GetOprt(tok.Get());
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Copy constructor. The copy doesn't share tokens with the original. */
+  OprtFused::OprtFused(const OprtFused &ref)
+    :ICallback(ref)
+    ,m_eKind(ref.m_eKind)
+    ,m_vTok()
+    ,m_nOprt()
+    ,m_nOperands(ref.m_nOperands)
+    ,m_bFma(ref.m_bFma)
+    ,m_vStack()
+  {
+    for (int i = 0; i < GetStackSize(); ++i)
+      m_vStack.push_back(ptr_val_type(new Value));
+
+    m_nOprt[0] = ref.m_nOprt[0];
+    m_nOprt[1] = ref.m_nOprt[1];
+    for (const ptr_tok_type &tok : ref.m_vTok)
+    {
+      // Copies of values and variables don't keep the identifier
+      IToken *pTok = tok->Clone();
+      pTok->SetIdent(tok->GetIdent());
+      pTok->SetExprPos(tok->GetExprPos());
+      m_vTok.push_back(ptr_tok_type(pTok));
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Create a superinstruction for a sequence of RPN tokens.
+      \param vTok The tokens in RPN order.
+      \param bFma True if x*y+z may be computed with a single rounding.
+      \return The new token or nullptr if the sequence can't be fused.
+
+    Supported sequences are: value value binop, variable function,
+    value value mul value add and value value value mul add. Only the built 
+    in arithmetic operators and comparisons are fused with values, any pure 
+    function or infix operator with a single argument is fused with a 
+    variable.
+  */
+  ICallback* OprtFused::Create(const token_vec_type &vTok, bool bFma)
+  {
+    auto IsVal = [&](std::size_t i) { return vTok[i]->GetCode() == cmVAL; };
+
+    switch (vTok.size())
+    {
+    case 2:
+      {
+        ECmdCode eCode = vTok[1]->GetCode();
+        ICallback *pFun = vTok[1]->AsICallback();
+        if (!IsVal(0) || !vTok[0]->AsIValue()->IsVariable() ||
+            (eCode != cmFUNC && eCode != cmOPRT_INFIX && eCode != cmOPRT_POSTFIX) ||
+            pFun->GetArgsPresent() != 1 || 
+            !pFun->IsPure())
+          return nullptr;
+
+        return new OprtFused(fsUNARY, vTok, false);
+      }
+
+    case 3:
+      if (!IsVal(0) || !IsVal(1) || GetOprt(vTok[2].Get()) < 0)
+        return nullptr;
+
+      return new OprtFused(fsBINARY, vTok, false);
+
+    case 5:
+      {
+        // x y * z + or z x y * +
+        EKind eKind = IsVal(2) ? fsADD_MUL : fsMUL_ADD;
+        std::size_t nMul = (eKind == fsADD_MUL) ? 3 : 2;
+        if (!IsVal(0) || !IsVal(1) || (eKind == fsMUL_ADD && !IsVal(3)) || GetOprt(vTok[4].Get()) != opADD)
+          return nullptr;
+
+        // The complex multiplication creates a complex number, it can only 
+        // be added by the complex addition
+        int nMulOprt = GetOprt(vTok[nMul].Get());
+        if (nMulOprt != opMUL && (nMulOprt != opMUL_CMPLX || typeid(*vTok[4]) != typeid(OprtAddCmplx)))
+          return nullptr;
+
+        return new OprtFused(eKind, vTok, bFma);
+      }
+
+    default:
+      return nullptr;
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Evaluate the tokens with the values passed as arguments.
+      \param ret Receives the result.
+      \param a_pArg The values in the order they appear in the RPN.
+  */
+  void OprtFused::Eval(ptr_val_type &ret, const ptr_val_type *a_pArg, int)
+  {
+    if (EvalReal(ret, a_pArg))
+      return;
+
+    // Anything else is handled by the original callbacks. Constants are 
+    // copied into the stack of the token since callbacks may overwrite their
+    // first argument. Results are never written into a variable.
+    ptr_val_type vStack[3];
+    int sidx = -1, nArg = 0;
+    for (const ptr_tok_type &tok : m_vTok)
+    {
+      if (tok->GetCode() == cmVAL)
+      {
+        const ptr_val_type &arg = a_pArg[nArg++];
+        ptr_val_type &val = vStack[++sidx];
+        if (arg->IsVariable())
+        {
+          val = arg;
+        }
+        else
+        {
+          val = m_vStack[sidx];
+          *val = *arg;
+        }
+      }
+      else
+      {
+        ICallback *pFun = tok->AsICallback();
+        int nArgs = pFun->GetArgsPresent();
+        sidx -= nArgs - 1;
+
+        ptr_val_type buf(m_vStack[sidx]);
+        pFun->Eval(buf, &vStack[sidx], nArgs);
+        vStack[sidx] = buf;
+      }
+    }
+
+    *ret = *vStack[0];
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Compute the result if all arguments are real scalars.
+      \param ret Receives the result, must not be a variable.
+      \param a_pArg The values in the order they appear in the RPN.
+      \return false if the result must be computed by the original callbacks. 
+
+    The results are assigned with the same type the original callbacks 
+    would use. Only the complex multiplication assigns a complex number, 
+    it is computed directly only as part of a sum.
+  */
+  bool OprtFused::EvalReal(ptr_val_type &ret, const ptr_val_type *a_pArg) const
+  {
+    if (m_eKind == fsUNARY)
+      return false;
+
+    for (int i = 0; i < m_nOperands; ++i)
+    {
+      if (!a_pArg[i]->IsNonComplexScalar())
+        return false;
+    }
+
+    if (m_eKind == fsBINARY)
+    {
+      float_type x = a_pArg[0]->GetFloat();
+      float_type y = a_pArg[1]->GetFloat();
+      switch (m_nOprt[0])
+      {
+      case opADD: *ret = x + y; return true;
+      case opSUB: *ret = x - y; return true;
+      case opMUL: *ret = x * y; return true;
+      case opDIV: *ret = x / y; return true;
+      case opLT:  *ret = x < y; return true;
+      case opGT:  *ret = x > y; return true;
+      case opLE:  *ret = x <= y; return true;
+      case opGE:  *ret = x >= y; return true;
+      case opEQ:  *ret = x == y; return true;
+      case opNEQ: *ret = x != y; return true;
+
+      // The complex multiplication is left to the original operator
+      default:    return false;
+      }
+    }
+
+    bool bAddMul = m_eKind == fsADD_MUL;
+    float_type x = a_pArg[bAddMul ? 1 : 0]->GetFloat();
+    float_type y = a_pArg[bAddMul ? 2 : 1]->GetFloat();
+    float_type z = a_pArg[bAddMul ? 0 : 2]->GetFloat();
+    float_type p = x * y;
+
+    // A complex product has the same real part unless it is zero (sign of 
+    // zero) or not finite (nan imaginary part), see RealEngine. Its 
+    // imaginary part is zero, so the complex addition computes a real sum.
+    if (m_nOprt[0] == opMUL_CMPLX && (p == 0 || !std::isfinite(p)))
+      return false;
+
+    *ret = m_bFma ? std::fma(x, y, z) : (bAddMul ? z + p : p + z);
+    return true;
+  }
+
+  //------------------------------------------------------------------------------
+  OprtFused::EKind OprtFused::GetKind() const
+  {
+    return m_eKind;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns the original tokens in RPN order. */
+  const token_vec_type& OprtFused::GetTokens() const
+  {
+    return m_vTok;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns the number of values expected as arguments by Eval. */
+  int OprtFused::GetNumOperands() const
+  {
+    return m_nOperands;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns the number of stack items needed to evaluate the original tokens. */
+  int OprtFused::GetStackSize() const
+  {
+    switch (m_eKind)
+    {
+    case fsUNARY:   return 1;
+    case fsADD_MUL: return 3;
+    default:        return 2;
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns true if x*y+z is computed with a single rounding. */
+  bool OprtFused::IsFmaEnabled() const
+  {
+    return m_bFma;
+  }
+
+  //------------------------------------------------------------------------------
+  const char_type* OprtFused::GetDesc() const
+  {
+    return const_cast<IToken*>(m_vTok.back().Get())->AsICallback()->GetDesc();
+  }
+
+  //------------------------------------------------------------------------------
+  IToken* OprtFused::Clone() const
+  {
+    return new OprtFused(*this);
+  }
+
+MUP_NAMESPACE_END
@@ -0,0 +1,107 @@
+/*
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     / 
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \ 
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, 
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice, 
+     this list of conditions and the following disclaimer in the documentation 
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef MP_OPRT_FUSED_H
+#define MP_OPRT_FUSED_H
+
+/** \file 
+    \brief Definition of the superinstructions created by the optimizer.
+*/
+
+#include "mpICallback.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief A short sequence of RPN tokens evaluated in a single step.
+
+    Objects of this type are created by the optimizer. They replace a built 
+    in binary operator applied to two values (a+1, a<b), a function or infix 
+    operator applied to a variable (sin(a), -a) and a multiplication whose 
+    result is added to a value (a*b+c, c+a*b). The values are taken out of 
+    the RPN, the token has no arguments on the stack. 
+
+    The evaluation context passes the values in the order they appeared in 
+    the RPN as arguments (see EvalContext), so variables are bound per 
+    context just like the variables of the RPN. Real scalar arguments are 
+    computed directly. Any other argument is passed to the original 
+    callbacks in the original order, so types, results and error messages 
+    don't change.
+
+    If fused multiply add is enabled a*b+c is computed by std::fma with a 
+    single rounding. The result may then differ from the unfused expression 
+    in the last bit.
+
+    Eval evaluates the original callbacks on values owned by the token, so 
+    a token must not be evaluated by several threads at once. Evaluation 
+    contexts use their own stack instead (see EvalContext::EvalFused).
+  */
+  class OprtFused : public ICallback
+  {
+  public:
+
+    enum EKind
+    {
+      fsBINARY,    ///< x op y
+      fsUNARY,     ///< f(x)
+      fsMUL_ADD,   ///< x*y + z
+      fsADD_MUL    ///< z + x*y
+    };
+
+    static ICallback* Create(const token_vec_type &vTok, bool bFma);
+
+    virtual void Eval(ptr_val_type &ret, const ptr_val_type *a_pArg, int a_iArgc) override;
+    virtual const char_type* GetDesc() const override;
+    virtual IToken* Clone() const override;
+
+    bool EvalReal(ptr_val_type &ret, const ptr_val_type *a_pArg) const;
+    EKind GetKind() const;
+    const token_vec_type& GetTokens() const;
+    int GetNumOperands() const;
+    int GetStackSize() const;
+    bool IsFmaEnabled() const;
+
+  private:
+
+    OprtFused(EKind eKind, const token_vec_type &vTok, bool bFma);
+    OprtFused(const OprtFused &ref);
+
+    EKind m_eKind;
+    token_vec_type m_vTok;  ///< The original tokens in RPN order
+    int m_nOprt[2];         ///< Real valued operations of the callbacks or -1
+    int m_nOperands;        ///< Number of values in m_vTok
+    bool m_bFma;            ///< Compute x*y+z with a single rounding
+    val_vec_type m_vStack;  ///< Stack used by Eval if the original callbacks are called
+  }; // class OprtFused
+
+MUP_NAMESPACE_END
+
+#endif
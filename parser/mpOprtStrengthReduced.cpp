@@ -0,0 +1,285 @@
+/*
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     / 
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \ 
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, 
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice, 
+     this list of conditions and the following disclaimer in the documentation 
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "mpOprtStrengthReduced.h"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+#include "mpValue.h"
+#include "mpOprtCmplx.h"
+#include "mpOprtNonCmplx.h"
+
+
+MUP_NAMESPACE_START
+
+  //------------------------------------------------------------------------------
+  OprtStrengthReduced::OprtStrengthReduced(EKind eKind, 
+                                           const ICallback *pOprt, 
+                                           const IValue *pVal, 
+                                           bool bConstLeft, 
+                                           float_type fVal)
+    :ICallback(cmFUNC, pOprt->GetIdent().c_str(), 1)
+    ,m_eKind(eKind)
+    ,m_pOprt(pOprt->Clone())
+    ,m_pVal((pVal != nullptr) ? new Value(*pVal) : nullptr)
+    ,m_fVal(fVal)
+    ,m_bConstLeft(bConstLeft)
+    ,m_bCmplxResult(dynamic_cast<const OprtMulCmplx*>(pOprt) != nullptr || 
+                    dynamic_cast<const OprtSignCmplx*>(pOprt) != nullptr)
+  {}
+
+  //------------------------------------------------------------------------------
+  /** \brief Copy constructor. The copy doesn't share tokens with the original. */
+  OprtStrengthReduced::OprtStrengthReduced(const OprtStrengthReduced &ref)
+    :ICallback(ref)
+    ,m_eKind(ref.m_eKind)
+    ,m_pOprt(ref.m_pOprt->Clone())
+    ,m_pVal((ref.m_pVal.Get() != nullptr) ? new Value(*ref.m_pVal) : nullptr)
+    ,m_fVal(ref.m_fVal)
+    ,m_bConstLeft(ref.m_bConstLeft)
+    ,m_bCmplxResult(ref.m_bCmplxResult)
+  {}
+
+  //------------------------------------------------------------------------------
+  /** \brief Create a reduced form of a binary operator with a constant operand.
+      \param pOprt The binary operator.
+      \param val The constant operand.
+      \param bConstLeft True if the constant is the left operand.
+      \return The new operator or nullptr if there is no cheaper form.
+
+    Only the built in arithmetic operators of the complex and the non complex 
+    package are considered. User defined operators are never replaced.
+  */
+  ICallback* OprtStrengthReduced::Create(const ICallback *pOprt, const IValue &val, bool bConstLeft)
+  {
+    if (!val.IsNonComplexScalar() || !std::isfinite(val.GetFloat()))
+      return nullptr;
+
+    float_type v = val.GetFloat();
+
+    if (dynamic_cast<const OprtMul*>(pOprt) || dynamic_cast<const OprtMulCmplx*>(pOprt))
+    {
+      if (v == 1)
+        return new OprtStrengthReduced(rdIDENTITY, pOprt, &val, bConstLeft, v);
+    }
+    else if (dynamic_cast<const OprtAdd*>(pOprt) || dynamic_cast<const OprtAddCmplx*>(pOprt))
+    {
+      // x + (-0) is x, but x + 0 turns -0 into 0
+      if (v == 0)
+        return new OprtStrengthReduced(std::signbit(v) ? rdIDENTITY : rdADD_ZERO, pOprt, &val, bConstLeft, v);
+    }
+    else if (bConstLeft)
+    {
+      // The remaining operators are not commutative
+      return nullptr;
+    }
+    else if (dynamic_cast<const OprtSub*>(pOprt) || dynamic_cast<const OprtSubCmplx*>(pOprt))
+    {
+      if (v == 0)
+        return new OprtStrengthReduced(std::signbit(v) ? rdADD_ZERO : rdIDENTITY, pOprt, &val, false, v);
+    }
+    else if (dynamic_cast<const OprtDiv*>(pOprt) || dynamic_cast<const OprtDivCmplx*>(pOprt))
+    {
+      if (v == 0)
+        return nullptr;
+
+      // Multiplying with the reciprocal gives the same result only if the 
+      // reciprocal is exact. This is the case for powers of two.
+      int nExp;
+      float_type r = 1 / v;
+      if (std::fabs(std::frexp(v, &nExp)) == 0.5 && std::isnormal(r))
+        return new OprtStrengthReduced(rdMUL, pOprt, &val, false, r);
+
+      return new OprtStrengthReduced(rdDIV, pOprt, &val, false, v);
+    }
+    else if (dynamic_cast<const OprtPow*>(pOprt))
+    {
+      // OprtPow multiplies for these exponents. OprtPowCmplx and x^0.5 use 
+      // std::pow whose result may differ in the last bit.
+      if (v >= 2 && v <= 5 && v == std::floor(v))
+        return new OprtStrengthReduced(rdPOW_INT, pOprt, &val, false, v);
+    }
+
+    return nullptr;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Create a replacement for two consecutive sign operators.
+      \return The new operator or nullptr if the operators are not the built in 
+              sign operator.
+  */
+  ICallback* OprtStrengthReduced::CreateDoubleNegation(const ICallback *pSign1, const ICallback *pSign2)
+  {
+    bool bSign = dynamic_cast<const OprtSign*>(pSign1) && dynamic_cast<const OprtSign*>(pSign2);
+    bool bSignCmplx = dynamic_cast<const OprtSignCmplx*>(pSign1) && dynamic_cast<const OprtSignCmplx*>(pSign2);
+    if (!bSign && !bSignCmplx)
+      return nullptr;
+
+    return new OprtStrengthReduced(rdNEG_NEG, pSign1, nullptr, false, 0);
+  }
+
+  //------------------------------------------------------------------------------
+  void OprtStrengthReduced::Eval(ptr_val_type &ret, const ptr_val_type *a_pArg, int)
+  {
+    const IValue *arg = a_pArg[0].Get();
+    if (arg->IsNonComplexScalar() && std::isfinite(arg->GetFloat()))
+    {
+      float_type x = arg->GetFloat();
+      switch (m_eKind)
+      {
+      case rdIDENTITY: 
+          Assign(ret, x); 
+          return;
+
+      case rdADD_ZERO: 
+          Assign(ret, (x == 0) ? 0 : x);
+          return;
+
+      case rdPOW_INT:
+          // Same evaluation order as OprtPow
+          switch ((int)m_fVal)
+          {
+          case 2:  Assign(ret, x*x); return;
+          case 3:  Assign(ret, x*x*x); return;
+          case 4:  Assign(ret, x*x*x*x); return;
+          case 5:  Assign(ret, x*x*x*x*x); return;
+          }
+          break;
+
+      case rdMUL:
+          Assign(ret, x * m_fVal);
+          return;
+
+      case rdDIV:
+          Assign(ret, x / m_fVal);
+          return;
+
+      case rdNEG_NEG:
+          // The complex sign operator never creates -0
+          Assign(ret, (m_bCmplxResult && x == 0) ? 0 : x);
+          return;
+      }
+    }
+
+    // Anything else is handled by the original operator
+    ICallback *pOprt = m_pOprt->AsICallback();
+    if (m_eKind == rdNEG_NEG)
+    {
+      pOprt->Eval(ret, a_pArg, 1);
+      pOprt->Eval(ret, &ret, 1);
+    }
+    else
+    {
+      // The operand is copied since the reference counter of m_pVal must 
+      // not change if the token is evaluated by several threads (see 
+      // CompiledExpression).
+      ptr_val_type val(new Value(*m_pVal));
+      if (m_bConstLeft)
+      {
+        ptr_val_type vArg[2] = { val, a_pArg[0] };
+        pOprt->Eval(ret, vArg, 2);
+      }
+      else
+      {
+        ptr_val_type vArg[2] = { a_pArg[0], val };
+        pOprt->Eval(ret, vArg, 2);
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Assign a result using the same type conversion as the original operator. */
+  void OprtStrengthReduced::Assign(ptr_val_type &ret, float_type val) const
+  {
+    if (m_bCmplxResult)
+      *ret = cmplx_type(val, 0);
+    else
+      *ret = val;
+  }
+
+  //------------------------------------------------------------------------------
+  OprtStrengthReduced::EKind OprtStrengthReduced::GetKind() const
+  {
+    return m_eKind;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns the original operator. 
+  
+    In case of a double negation this is the first sign operator.
+  */
+  const ICallback* OprtStrengthReduced::GetOperator() const
+  {
+    return m_pOprt->AsICallback();
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns true if the constant is the left operand of the original operator. */
+  bool OprtStrengthReduced::IsConstLeft() const
+  {
+    return m_bConstLeft;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns the constant operand or nullptr in case of a double negation. */
+  const IValue* OprtStrengthReduced::GetConst() const
+  {
+    return m_pVal.Get();
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns the exponent, divisor or factor used for real arguments. */
+  float_type OprtStrengthReduced::GetOperand() const
+  {
+    return m_fVal;
+  }
+
+  //------------------------------------------------------------------------------
+  /** \brief Returns true if the original operator assigns its result as a complex number. */
+  bool OprtStrengthReduced::HasComplexResult() const
+  {
+    return m_bCmplxResult;
+  }
+
+  //------------------------------------------------------------------------------
+  const char_type* OprtStrengthReduced::GetDesc() const
+  {
+    return m_pOprt->AsICallback()->GetDesc();
+  }
+
+  //------------------------------------------------------------------------------
+  IToken* OprtStrengthReduced::Clone() const
+  {
+    return new OprtStrengthReduced(*this);
+  }
+
+MUP_NAMESPACE_END
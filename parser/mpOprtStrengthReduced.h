@@ -0,0 +1,104 @@
+/*
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     / 
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \ 
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without 
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice, 
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice, 
+     this list of conditions and the following disclaimer in the documentation 
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND 
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+  POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef MP_OPRT_STRENGTH_REDUCED_H
+#define MP_OPRT_STRENGTH_REDUCED_H
+
+/** \file 
+    \brief Definition of the operator created by the optimizer for strength reduction. 
+*/
+
+#include "mpICallback.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief A built in operator applied to a constant operand in a cheaper form.
+
+    Objects of this type are created by the optimizer. They replace 
+    expressions like x^2, x^0.5, x/c, x*1, x+0 or -(-x). Real scalar 
+    arguments are evaluated directly, the results are bit identical to 
+    the original operator with the exception of integer powers in the 
+    complex package: They are computed by repeated multiplication, just 
+    like in the non complex package, instead of calling std::pow. Any 
+    other argument is passed to the original operator, so types, complex 
+    results and error messages don't change.
+  */
+  class OprtStrengthReduced : public ICallback
+  {
+  public:
+
+    enum EKind
+    {
+      rdIDENTITY,  ///< x*1, 1*x, x-0 
+      rdADD_ZERO,  ///< x+0, 0+x; same as identity except -0 becomes 0
+      rdPOW_INT,   ///< x^n for n in [2, 5]; repeated multiplication
+      rdMUL,       ///< x/c with 1/c being exact; multiplication with 1/c
+      rdDIV,       ///< x/c 
+      rdNEG_NEG    ///< -(-x)
+    };
+
+    static ICallback* Create(const ICallback *pOprt, const IValue &val, bool bConstLeft);
+    static ICallback* CreateDoubleNegation(const ICallback *pSign1, const ICallback *pSign2);
+
+    virtual void Eval(ptr_val_type &ret, const ptr_val_type *a_pArg, int a_iArgc) override;
+    virtual const char_type* GetDesc() const override;
+    virtual IToken* Clone() const override;
+
+    EKind GetKind() const;
+    const ICallback* GetOperator() const;
+    bool IsConstLeft() const;
+    const IValue* GetConst() const;
+    float_type GetOperand() const;
+    bool HasComplexResult() const;
+
+  private:
+
+    OprtStrengthReduced(EKind eKind, 
+                        const ICallback *pOprt, 
+                        const IValue *pVal, 
+                        bool bConstLeft, 
+                        float_type fVal);
+    OprtStrengthReduced(const OprtStrengthReduced &ref);
+
+    void Assign(ptr_val_type &ret, float_type val) const;
+
+    EKind m_eKind;
+    ptr_tok_type m_pOprt;  ///< The original operator
+    ptr_val_type m_pVal;   ///< The constant operand of the original operator
+    float_type m_fVal;     ///< Exponent, divisor or factor used by the fast path
+    bool m_bConstLeft;     ///< True if the constant is the left operand
+    bool m_bCmplxResult;   ///< True if the original operator assigns its result as a complex number
+  }; // class OprtStrengthReduced
+
+MUP_NAMESPACE_END
+
+#endif
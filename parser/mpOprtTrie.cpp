@@ -0,0 +1,117 @@
+/** \file
+    \brief Implementation of a prefix tree for the longest match of operator names.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpOprtTrie.h"
+
+
+MUP_NAMESPACE_START
+
+//---------------------------------------------------------------------------
+OprtTrie::OprtTrie()
+	:m_vNode(1, SNode{ nullptr, {} })
+{}
+
+//---------------------------------------------------------------------------
+void OprtTrie::Clear()
+{
+	m_vNode.assign(1, SNode{ nullptr, {} });
+}
+
+//---------------------------------------------------------------------------
+void OprtTrie::Insert(const string_type &a_sName, const ptr_tok_type *a_pTok)
+{
+	std::size_t nNode = 0;
+	for (char_type c : a_sName)
+	{
+		std::size_t nNext = 0;
+		for (const auto &child : m_vNode[nNode].m_vChild)
+		{
+			if (child.first == c)
+			{
+				nNext = child.second;
+				break;
+			}
+		}
+
+		if (nNext == 0)
+		{
+			nNext = m_vNode.size();
+			m_vNode[nNode].m_vChild.push_back(std::make_pair(c, nNext));
+			m_vNode.push_back(SNode{ nullptr, {} });
+		}
+
+		nNode = nNext;
+	}
+
+	m_vNode[nNode].m_pTok = a_pTok;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Find the longest operator name the token starts with.
+	\param a_sTok The token
+	\param a_nLen [out] The length of the operator name
+	\return The operator definition or nullptr if no name matches.
+*/
+const ptr_tok_type* OprtTrie::Find(string_view_type a_sTok, std::size_t &a_nLen) const
+{
+	const ptr_tok_type *pTok = nullptr;
+	std::size_t nNode = 0;
+	for (std::size_t i = 0; i < a_sTok.length(); ++i)
+	{
+		std::size_t nNext = 0;
+		for (const auto &child : m_vNode[nNode].m_vChild)
+		{
+			if (child.first == a_sTok[i])
+			{
+				nNext = child.second;
+				break;
+			}
+		}
+
+		if (nNext == 0)
+			break;
+
+		nNode = nNext;
+		if (m_vNode[nNode].m_pTok != nullptr)
+		{
+			pTok = m_vNode[nNode].m_pTok;
+			a_nLen = i + 1;
+		}
+	}
+
+	return pTok;
+}
+
+MUP_NAMESPACE_END
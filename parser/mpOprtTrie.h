@@ -0,0 +1,89 @@
+#ifndef MUP_OPRT_TRIE_H
+#define MUP_OPRT_TRIE_H
+
+/** \file
+    \brief Definition of a prefix tree for the longest match of operator names.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <utility>
+#include <vector>
+
+#include "mpTypes.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief A prefix tree of operator names.
+
+    The token reader extracts a sequence of operator characters and looks 
+    for the longest operator name it starts with. The tree finds it in 
+    O(token length) instead of comparing the token with every definition.
+    It refers to the entries of the operator map it was built from and must 
+    be rebuilt whenever the map changes.
+  */
+  class OprtTrie
+  {
+  public:
+
+    OprtTrie();
+
+    /** \brief Rebuild the tree from a map of operator definitions. */
+    template<typename TMap>
+    void Build(const TMap &a_mapOprt)
+    {
+      Clear();
+      for (const auto &item : a_mapOprt)
+        Insert(item.first, &item.second);
+    }
+
+    void Clear();
+    const ptr_tok_type* Find(string_view_type a_sTok, std::size_t &a_nLen) const;
+
+  private:
+
+    struct SNode
+    {
+      const ptr_tok_type *m_pTok;                           ///< Operator ending at this node or nullptr
+      std::vector<std::pair<char_type, std::size_t>> m_vChild;  ///< Next character and index of the child node
+    };
+
+    void Insert(const string_type &a_sName, const ptr_tok_type *a_pTok);
+
+    std::vector<SNode> m_vNode;   ///< The nodes, the first one is the root
+  }; // class OprtTrie
+
+MUP_NAMESPACE_END
+
+#endif
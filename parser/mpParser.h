@@ -39,6 +39,7 @@
 //--- Parser framework -----------------------------------------------------
 #include "mpDefines.h"
 #include "mpParserBase.h"
+#include "mpCompiledExpression.h"
 
 
 MUP_NAMESPACE_START
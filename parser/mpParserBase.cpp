@@ -35,14 +35,17 @@
 #include "mpParserBase.h"
 
 #include <cmath>
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <sstream>
+#include <system_error>
 
 #include "utGeneric.h"
 #include "mpDefines.h"
 #include "mpIfThenElse.h"
 #include "mpScriptTokens.h"
+#include "mpTempTokens.h"
 #include "mpOprtBinShortcut.h"
 
 using namespace std;
@@ -81,6 +84,9 @@ const char_type* g_sCmdCode[] = {
 	_T("SCR_ELIF         "),
 	_T("SCR_ENDIF        "),
 	_T("SCR_FUNC         "),
+	_T("STORE            "),
+	_T("LOAD             "),
+	_T("FUSED            "),
 	_T("UNKNOWN          "),
 	nullptr };
 
@@ -124,8 +130,25 @@ ParserXBase::ParserXBase()
 	, m_sInfixOprtChars()
 	, m_bIsQueryingExprVar(false)
 	, m_bAutoCreateVar(false)
+	, m_bEnableRealEngine(true)
 	, m_rpn()
-	, m_vStackBuffer()
+	, m_realEngine()
+	, m_jitEngine()
+	, m_eJitMode(jitNONE)
+	, m_nTierUpThreshold(1000)
+	, m_nEvalCount(0)
+	, m_pTierUp()
+	, m_tierUpThread()
+	, m_evalCtx()
+	, m_nBatchThreads(1)
+	, m_pThreadPool()
+	, m_rpnCache()
+	, m_nDefGeneration(0)
+	, m_bEnableMemo(false)
+	, m_bMemoValid(false)
+	, m_bMemoVolatile(false)
+	, m_valMemo()
+	, m_vMemoVar()
 {
 	InitTokenReader();
 }
@@ -151,8 +174,25 @@ ParserXBase::ParserXBase(const ParserXBase& a_Parser)
 	, m_sOprtChars()
 	, m_sInfixOprtChars()
 	, m_bAutoCreateVar()
+	, m_bEnableRealEngine(true)
 	, m_rpn()
-	, m_vStackBuffer()
+	, m_realEngine()
+	, m_jitEngine()
+	, m_eJitMode(jitNONE)
+	, m_nTierUpThreshold(1000)
+	, m_nEvalCount(0)
+	, m_pTierUp()
+	, m_tierUpThread()
+	, m_evalCtx()
+	, m_nBatchThreads(1)
+	, m_pThreadPool()
+	, m_rpnCache()
+	, m_nDefGeneration(0)
+	, m_bEnableMemo(false)
+	, m_bMemoValid(false)
+	, m_bMemoVolatile(false)
+	, m_valMemo()
+	, m_vMemoVar()
 {
 	m_pTokenReader.reset(new TokenReader(this));
 	Assign(a_Parser);
@@ -164,11 +204,7 @@ ParserXBase::ParserXBase(const ParserXBase& a_Parser)
 	  */
 ParserXBase::~ParserXBase()
 {
-	// It is important to release the stack buffer before
-	// releasing the value cache. Since it may contain
-	// Values referencing the cache.
-	m_vStackBuffer.clear();
-	m_cache.ReleaseAll();
+	JoinTierUp();
 }
 
 //---------------------------------------------------------------------------
@@ -219,11 +255,29 @@ void ParserXBase::Assign(const ParserXBase& ref)
 	m_sInfixOprtChars = ref.m_sInfixOprtChars;
 
 	m_bAutoCreateVar = ref.m_bAutoCreateVar;
+	m_rpn.EnableOptimizer(ref.m_rpn.IsOptimizerEnabled());
+	m_rpn.EnableFusedMultiplyAdd(ref.m_rpn.IsFusedMultiplyAddEnabled());
+	m_bEnableRealEngine = ref.m_bEnableRealEngine;
+	m_realEngine.EnableSimdMath(ref.m_realEngine.IsSimdMathEnabled());
+	m_eJitMode = ref.m_eJitMode;
+	m_nTierUpThreshold = ref.m_nTierUpThreshold;
+	m_evalCtx.EnableThreadedCode(ref.m_evalCtx.IsThreadedCodeEnabled());
+	m_evalCtx.EnableRegisterCode(ref.m_evalCtx.IsRegisterCodeEnabled());
+	m_nBatchThreads = ref.m_nBatchThreads;
+	m_rpnCache.SetCapacity(ref.m_rpnCache.GetCapacity());
+	m_rpnCache.Clear();
+	++m_nDefGeneration;
+	m_bEnableMemo = ref.m_bEnableMemo;
 
 	// Things that should not be copied:
-	// - m_vStackBuffer
-	// - m_cache
 	// - m_rpn
+	// - m_realEngine
+	// - m_jitEngine
+	// - m_pTierUp
+	// - m_evalCtx
+	// - m_pThreadPool
+	// - the entries of m_rpnCache
+	// - the memoized result
 }
 
 //---------------------------------------------------------------------------
@@ -242,9 +296,179 @@ void ParserXBase::Assign(const ParserXBase& ref)
 	  */
 const IValue& ParserXBase::Eval() const
 {
+	if (m_bEnableMemo)
+		return EvalMemoized();
+
 	return (this->*m_pParserEngine)();
 }
 
+//---------------------------------------------------------------------------
+/** \brief Evaluate the expression for many sets of variable values.
+	  \param a_Columns Binds variable names to arrays with a value for each row
+	  \param a_pRes Receives the result of each row
+	  \param a_nRows The number of rows
+	  \throw ParserError if a name is not a variable or if a result is not a number.
+
+	  Variables without a column keep their current value for all rows. Complex
+	  results are stored as their real part (see IValue::GetFloat). If the
+	  expression is evaluated by the bytecode engine for real numbers, each
+	  instruction is applied to a block of rows before the next instruction is
+	  executed. Otherwise the rows are evaluated one by one. The variables with
+	  a column are not changed.
+
+	  If more than one thread is set by SetBatchThreads the rows are split into
+	  chunks evaluated by a thread pool. Each thread uses its own evaluation 
+	  context. The results are identical to the serial evaluation, errors are
+	  reported for the first row that fails. Expressions with side effects (i.e.
+	  assignments) are always evaluated serially.
+	  */
+void ParserXBase::EvalBatch(const column_maptype& a_Columns, float_type* a_pRes, std::size_t a_nRows) const
+{
+	if (m_pParserEngine == &ParserXBase::ParseFromString)
+		CreateEngine();
+
+	// A batch is evaluated often by definition
+	if (m_pParserEngine == &ParserXBase::ParseTiered)
+		FinishTierUp();
+
+	std::vector<IValue*> vBound;
+	std::vector<const float_type*> vColumn;
+	for (const auto& item : a_Columns)
+	{
+		var_maptype::const_iterator it = m_varDef.find(item.first);
+		if (it == m_varDef.end())
+			throw ParserError(ErrorContext(ecUNASSIGNABLE_TOKEN, -1, item.first));
+
+		vBound.push_back(static_cast<Variable*>(it->second.Get())->GetPtr());
+		vColumn.push_back(item.second);
+	}
+
+	// Arrays with the values of the variables used by the bytecode engine.
+	// Variables without a column are repeated for each row of a block.
+	const std::vector<const IValue*>& vVar = m_realEngine.GetVar();
+	const int nBlock = RealEngine::c_nBlockSize;
+	bool bBlockwise = m_pParserEngine == &ParserXBase::ParseFromRealEngine;
+	std::vector<int> vColIdx(vVar.size(), -1);
+	std::vector<float_type> vConst(vVar.size() * nBlock);
+	for (std::size_t k = 0; bBlockwise && k < vVar.size(); ++k)
+	{
+		std::vector<IValue*>::const_iterator it = std::find(vBound.begin(), vBound.end(), vVar[k]);
+		if (it != vBound.end())
+		{
+			vColIdx[k] = (int)(it - vBound.begin());
+			continue;
+		}
+
+		if (!vVar[k]->IsNonComplexScalar())
+			bBlockwise = false;
+		else
+			std::fill(&vConst[k * nBlock], &vConst[k * nBlock] + nBlock, vVar[k]->GetFloat());
+	}
+
+	// The state of a thread: Variables with a column are bound to values
+	// owned by the thread.
+	struct SWorker
+	{
+		EvalContext ctx;
+		std::vector<Value> vVal;
+		std::vector<float_type> vBuf;
+		std::vector<const float_type*> vCol;
+	};
+
+	auto InitWorker = [&](SWorker& w)
+	{
+		w.vVal.resize(vBound.size());
+		for (const auto& item : m_varDef)
+		{
+			IValue* pVal = static_cast<Variable*>(item.second.Get())->GetPtr();
+			std::vector<IValue*>::const_iterator it = std::find(vBound.begin(), vBound.end(), pVal);
+			if (it != vBound.end())
+				w.ctx.DefineVar(item.first, Variable(&w.vVal[it - vBound.begin()]));
+		}
+
+		w.ctx.EnableThreadedCode(m_evalCtx.IsThreadedCodeEnabled());
+		w.ctx.EnableRegisterCode(m_evalCtx.IsRegisterCodeEnabled());
+		w.ctx.Init(m_rpn, nullptr);
+		if (bBlockwise)
+		{
+			w.vBuf.resize(m_realEngine.GetBlockBufferSize());
+			w.vCol.resize(vVar.size());
+		}
+	};
+
+	// Evaluate a single row with the generic engine
+	auto EvalRow = [&](SWorker& w, std::size_t nRow)
+	{
+		for (std::size_t i = 0; i < vBound.size(); ++i)
+			w.vVal[i] = vColumn[i][nRow];
+
+		const IValue& val = w.ctx.ParseFromRPN(m_rpn, m_pTokenReader->GetExpr(), m_pTokenReader->GetPos());
+		if (val.GetType() != 'b' && !val.IsScalar())
+			throw ParserError(ErrorContext(ecTYPE_CONFLICT, -1, val.ToString(), val.GetType(), 'f', -1));
+
+		return val.GetFloat();
+	};
+
+	auto EvalRows = [&](SWorker& w, std::size_t nBegin, std::size_t nEnd)
+	{
+		if (!bBlockwise)
+		{
+			for (std::size_t nRow = nBegin; nRow < nEnd; ++nRow)
+				a_pRes[nRow] = EvalRow(w, nRow);
+
+			return;
+		}
+
+		for (std::size_t nFirst = nBegin; nFirst < nEnd; nFirst += nBlock)
+		{
+			int nRows = (int)std::min<std::size_t>(nBlock, nEnd - nFirst);
+			for (std::size_t k = 0; k < vVar.size(); ++k)
+				w.vCol[k] = (vColIdx[k] >= 0) ? vColumn[vColIdx[k]] + nFirst : &vConst[k * nBlock];
+
+			if (m_realEngine.EvalBlock(w.vCol.data(), nRows, w.vBuf.data(), a_pRes + nFirst))
+				continue;
+
+			// Intermediate results of some row are not real numbers
+			for (int r = 0; r < nRows; ++r)
+				a_pRes[nFirst + r] = EvalRow(w, nFirst + r);
+		}
+	};
+
+	// Chunks are a multiple of the block size, so blocks are the same as 
+	// in the serial evaluation.
+	const std::size_t nChunk = 32 * nBlock;
+	const std::size_t nChunks = (a_nRows + nChunk - 1) / nChunk;
+	bool bParallel = m_nBatchThreads != 1 && nChunks > 1 &&
+		std::all_of(m_rpn.GetData().begin(), m_rpn.GetData().end(), [](const ptr_tok_type& tok)
+		{
+			return tok->AsICallback() == nullptr || tok->AsICallback()->IsPure();
+		});
+
+	if (!bParallel)
+	{
+		SWorker w;
+		InitWorker(w);
+		EvalRows(w, 0, a_nRows);
+		return;
+	}
+
+	if (!m_pThreadPool)
+		m_pThreadPool.reset(new ThreadPool(m_nBatchThreads));
+
+	std::vector<std::unique_ptr<SWorker>> vWorker(m_pThreadPool->GetNumThreads());
+	m_pThreadPool->Run(nChunks, [&](int nWorker, std::size_t nTask)
+	{
+		std::unique_ptr<SWorker>& w = vWorker[nWorker];
+		if (!w)
+		{
+			w.reset(new SWorker);
+			InitWorker(*w);
+		}
+
+		EvalRows(*w, nTask * nChunk, std::min(a_nRows, (nTask + 1) * nChunk));
+	});
+}
+
 //---------------------------------------------------------------------------
 /** \brief Return the strings of all Operator identifiers.
 	  \return Returns a pointer to the c_DefaultOprt array of const char *.
@@ -264,6 +488,7 @@ const char_type** ParserXBase::GetOprtDef() const
 void ParserXBase::DefineNameChars(const char_type* a_szCharset)
 {
 	m_sNameChars = a_szCharset;
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -275,6 +500,7 @@ void ParserXBase::DefineNameChars(const char_type* a_szCharset)
 void ParserXBase::DefineOprtChars(const char_type* a_szCharset)
 {
 	m_sOprtChars = a_szCharset;
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -286,6 +512,7 @@ void ParserXBase::DefineOprtChars(const char_type* a_szCharset)
 void ParserXBase::DefineInfixOprtChars(const char_type* a_szCharset)
 {
 	m_sInfixOprtChars = a_szCharset;
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -339,11 +566,16 @@ void ParserXBase::InitTokenReader()
 	  */
 void ParserXBase::ReInit() const
 {
+	JoinTierUp();
 	m_pParserEngine = &ParserXBase::ParseFromString;
 	m_pTokenReader->ReInit();
 	m_rpn.Reset();
-	m_vStackBuffer.clear();
+	m_realEngine.Reset();
+	m_jitEngine.Reset();
+	m_evalCtx.Reset();
 	m_nPos = 0;
+	m_bMemoValid = false;
+	m_vMemoVar.clear();
 }
 
 //---------------------------------------------------------------------------
@@ -364,6 +596,7 @@ void ParserXBase::AddPackage(IPackage* p)
 void ParserXBase::AddValueReader(IValueReader* a_pReader)
 {
 	m_pTokenReader->AddValueReader(a_pReader);
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -409,6 +642,7 @@ void ParserXBase::DefineVar(const string_type& ident, const Variable& var)
 	CheckForEntityExistence(ident, ecVARIABLE_DEFINED);
 
 	m_varDef[ident] = ptr_tok_type(var.Clone());
+	++m_nDefGeneration;
 }
 
 void ParserXBase::CheckForEntityExistence(const string_type& ident, EErrorCodes error_code)
@@ -438,6 +672,7 @@ void ParserXBase::DefineConst(const string_type& ident, const Value& val)
 	CheckForEntityExistence(ident, ecCONSTANT_DEFINED);
 
 	m_valDef[ident] = ptr_tok_type(val.Clone());
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -455,6 +690,7 @@ void ParserXBase::DefineFun(const ptr_cal_type& fun)
 
 	fun->SetParent(this);
 	m_FunDef[fun->GetIdent()] = ptr_tok_type(fun->Clone());
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -468,6 +704,8 @@ void ParserXBase::DefineOprt(const TokenPtr<IOprtBin>& oprt)
 
 	oprt->SetParent(this);
 	m_OprtDef[oprt->GetIdent()] = ptr_tok_type(oprt->Clone());
+	m_pTokenReader->InvalidateOprtTrie();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -481,6 +719,8 @@ void ParserXBase::DefineOprt(const TokenPtr<IOprtBinShortcut> &oprt)
 
 	//oprt->SetParent(this);
 	m_OprtShortcutDef[oprt->GetIdent()] = ptr_tok_type(oprt->Clone());
+	m_pTokenReader->InvalidateOprtTrie();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -497,6 +737,8 @@ void ParserXBase::DefinePostfixOprt(const TokenPtr<IOprtPostfix>& oprt)
 	// Operator is not added yet, add it.
 	oprt->SetParent(this);
 	m_PostOprtDef[oprt->GetIdent()] = ptr_tok_type(oprt->Clone());
+	m_pTokenReader->InvalidateOprtTrie();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -512,6 +754,8 @@ void ParserXBase::DefineInfixOprt(const TokenPtr<IOprtInfix>& oprt)
 	// Function is not added yet, add it.
 	oprt->SetParent(this);
 	m_InfixOprtDef[oprt->GetIdent()] = ptr_tok_type(oprt->Clone());
+	m_pTokenReader->InvalidateOprtTrie();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -519,6 +763,7 @@ void ParserXBase::RemoveVar(const string_type& ident)
 {
 	m_varDef.erase(ident);
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -526,6 +771,7 @@ void ParserXBase::RemoveConst(const string_type& ident)
 {
 	m_valDef.erase(ident);
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -533,6 +779,7 @@ void ParserXBase::RemoveFun(const string_type& ident)
 {
 	m_FunDef.erase(ident);
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -540,21 +787,27 @@ void ParserXBase::RemoveOprt(const string_type& ident)
 {
 	m_OprtDef.erase(ident);
 	m_OprtShortcutDef.erase(ident);
+	m_pTokenReader->InvalidateOprtTrie();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
 void ParserXBase::RemovePostfixOprt(const string_type& ident)
 {
 	m_PostOprtDef.erase(ident);
+	m_pTokenReader->InvalidateOprtTrie();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
 void ParserXBase::RemoveInfixOprt(const string_type& ident)
 {
 	m_InfixOprtDef.erase(ident);
+	m_pTokenReader->InvalidateOprtTrie();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //---------------------------------------------------------------------------
@@ -642,6 +895,56 @@ const string_type& ParserXBase::GetExpr() const
 	return m_pTokenReader->GetExpr();
 }
 
+//---------------------------------------------------------------------------
+/** \brief Return the reverse polish notation of the current expression.
+
+	The RPN is created by the first call to Eval() or GetExprVar() after
+	the expression was set.
+*/
+const RPN& ParserXBase::GetRPN() const
+{
+	return m_rpn;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Set the number of expressions whose RPN is kept by the parser.
+	\param nSize The maximum number of expressions, zero disables the cache.
+
+	If the cache is enabled, setting an expression that was parsed before 
+	reuses its RPN instead of running the token reader again. The least
+	recently used expressions are dropped first. Entries become invalid when
+	variables, constants, functions, operators, value readers or optimizer
+	settings are changed. The cache is disabled by default.
+*/
+void ParserXBase::SetRPNCacheSize(std::size_t nSize)
+{
+	m_rpnCache.SetCapacity(nSize);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the cache of parsed expressions with its hit and miss counts. */
+const RPNCache& ParserXBase::GetRPNCache() const
+{
+	return m_rpnCache;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the bytecode engine for real valued expressions.
+
+	The engine is valid only if the current expression was compiled for it.
+*/
+const RealEngine& ParserXBase::GetRealEngine() const
+{
+	return m_realEngine;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the machine code of the current expression. */
+const JitEngine& ParserXBase::GetJitEngine() const
+{
+	return m_jitEngine;
+}
+
 //---------------------------------------------------------------------------
 /** \brief Get the version number of muParserX.
 	  \return A string containing the version number of muParserX.
@@ -756,6 +1059,15 @@ void ParserXBase::CreateRPN() const
 
 	ReInit();
 
+	// Skip the token reader if the expression was parsed before
+	const RPNCache::SEntry* pEntry = m_rpnCache.Find(m_pTokenReader->GetExpr(), m_nDefGeneration);
+	if (pEntry != nullptr)
+	{
+		m_rpn = pEntry->m_rpn.Clone();
+		m_pTokenReader->Restore(pEntry->m_nPos, pEntry->m_UsedVar);
+		return;
+	}
+
 	for (;;)
 	{
 		pTokPrev = pTok;
@@ -1009,6 +1321,10 @@ void ParserXBase::CreateRPN() const
 	{
 		Error(ecUNEXPECTED_COMMA, -1);
 	}
+
+	// Undefined variables are accepted while the variables are queried
+	if (!m_bIsQueryingExprVar)
+		m_rpnCache.Insert(m_pTokenReader->GetExpr(), m_nDefGeneration, m_rpn, m_pTokenReader->GetUsedVar(), m_pTokenReader->GetPos());
 }
 
 //---------------------------------------------------------------------------
@@ -1020,209 +1336,210 @@ void ParserXBase::CreateRPN() const
 	  #m_pParseFormula will be changed to the second parse routine the uses bytecode instead of string parsing.
 	  */
 const IValue& ParserXBase::ParseFromString() const
+{
+	CreateEngine();
+	return (this->*m_pParserEngine)();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the RPN and select the engine used for its evaluation. */
+void ParserXBase::CreateEngine() const
 {
 	CreateRPN();
 
-	// Umsachalten auf RPN
-	m_vStackBuffer.assign(m_rpn.GetRequiredStackSize(), ptr_val_type());
-	for (std::size_t i = 0; i < m_vStackBuffer.size(); ++i)
+	// Start with the generic engine, ParseTiered compiles the expression 
+	// once it has been evaluated often enough
+	if (m_eJitMode == jitTIERED && m_bEnableRealEngine)
 	{
-		Value* pValue = new Value;
-		pValue->BindToCache(&m_cache);
-		m_vStackBuffer[i].Reset(pValue);
+		m_evalCtx.Init(m_rpn, nullptr);
+		m_pParserEngine = &ParserXBase::ParseTiered;
+		return;
 	}
 
-	m_pParserEngine = &ParserXBase::ParseFromRPN;
+	// Use the bytecode engine if the expression computes a real number
+	bool bRealEngine = m_bEnableRealEngine && m_realEngine.Compile(m_rpn);
+	m_evalCtx.Init(m_rpn, (bRealEngine) ? &m_realEngine : nullptr);
+	m_pParserEngine = (bRealEngine) ? &ParserXBase::ParseFromRealEngine : &ParserXBase::ParseFromRPN;
 
-	return (this->*m_pParserEngine)();
+	// Translate the bytecode into machine code if requested
+	if (bRealEngine && m_eJitMode == jitNATIVE && m_jitEngine.Compile(m_realEngine))
+		m_pParserEngine = &ParserXBase::ParseFromJit;
+
+	// Collect what EvalMemoized needs to know whether the result can change
+	m_vMemoVar.clear();
+	for (const auto& item : m_pTokenReader->GetUsedVar())
+		m_vMemoVar.push_back(std::make_pair(item.second->AsIValue(), (std::size_t)0));
+
+	// Variables are flagged as volatile too, they are handled by their versions
+	m_bMemoVolatile = std::any_of(m_rpn.GetData().begin(), m_rpn.GetData().end(), [](const ptr_tok_type& tok)
+	{
+		return tok->AsIValue() == nullptr && tok->IsFlagSet(IToken::flVOLATILE);
+	});
 }
 
 //---------------------------------------------------------------------------
-const IValue& ParserXBase::ParseFromRPN() const
+/** \brief Evaluate the expression with the bytecode engine for real numbers.
+
+	Falls back to ParseFromRPN if a variable does not contain a real number
+	or if the result can't be computed by the bytecode engine.
+*/
+const IValue& ParserXBase::ParseFromRealEngine() const
+{
+	const IValue* pVal = m_evalCtx.ParseFromRealEngine(m_realEngine);
+	return (pVal != nullptr) ? *pVal : ParseFromRPN();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the expression with the machine code created by Compile.
+
+	Falls back to ParseFromRPN in the same cases as ParseFromRealEngine.
+*/
+const IValue& ParserXBase::ParseFromJit() const
 {
-	ptr_val_type* pStack = &m_vStackBuffer[0];
-	if (m_rpn.GetSize() == 0)
+	const IValue* pVal = m_evalCtx.ParseFromRealEngine(m_realEngine, &m_jitEngine);
+	return (pVal != nullptr) ? *pVal : ParseFromRPN();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the expression with the generic engine and count the evaluations.
+
+	When the count reaches the threshold set by SetTierUpThreshold the bytecode
+	and the machine code are created by another thread. The evaluation continues
+	with the generic engine until the compiler thread is finished. Then the 
+	parse function is replaced by ParseFromJit or ParseFromRealEngine.
+*/
+const IValue& ParserXBase::ParseTiered() const
+{
+	if (m_pTierUp == nullptr)
+	{
+		if (++m_nEvalCount >= m_nTierUpThreshold)
+			StartTierUp();
+	}
+	else if (m_pTierUp->m_bDone.load(std::memory_order_acquire))
 	{
-		// Passiert bei leeren strings oder solchen, die nur Leerzeichen enthalten
-		ErrorContext err;
-		err.Expr = m_pTokenReader->GetExpr();
-		err.Errc = ecUNEXPECTED_EOF;
-		err.Pos = 0;
-		throw ParserError(err);
+		FinishTierUp();
+		return (this->*m_pParserEngine)();
 	}
 
-	const ptr_tok_type* pRPN = &(m_rpn.GetData()[0]);
+	return ParseFromRPN();
+}
 
-	int sidx = -1;
-	std::size_t lenRPN = m_rpn.GetSize();
-	for (std::size_t i = 0; i < lenRPN; ++i)
-	{
-		IToken* pTok = pRPN[i].Get();
-		ECmdCode eCode = pTok->GetCode();
+//---------------------------------------------------------------------------
+/** \brief Evaluate the expression if one of its variables changed.
+
+	The result of each evaluation is copied together with the versions of 
+	the variables used by the expression (see IValue::GetVersion). The 
+	versions are taken after the evaluation, reading matrix elements during
+	the evaluation counts as modification. Expressions containing volatile 
+	tokens, i.e. functions like rnd or the assignment operators, are always 
+	evaluated.
+*/
+const IValue& ParserXBase::EvalMemoized() const
+{
+	if (m_pParserEngine == &ParserXBase::ParseFromString)
+		CreateEngine();
 
-		switch (eCode)
+	if (m_bMemoValid && std::all_of(m_vMemoVar.begin(), m_vMemoVar.end(), [](const std::pair<const IValue*, std::size_t>& var)
 		{
-		case cmSCRIPT_NEWLINE:
-			sidx = -1;
-			continue;
+			return var.first->GetVersion() == var.second;
+		}))
+	{
+		return m_valMemo;
+	}
 
-		case cmVAL:
-		{
-			IValue* pVal = static_cast<IValue*>(pTok);
+	const IValue& val = (this->*m_pParserEngine)();
+	if (m_bMemoVolatile)
+		return val;
 
-			sidx++;
-			MUP_VERIFY(sidx < (int)m_vStackBuffer.size());
-			if (pVal->IsVariable())
-			{
-				pStack[sidx].Reset(pVal);
-			}
-			else
-			{
-				ptr_val_type& val = pStack[sidx];
-				if (val->IsVariable())
-					val.Reset(m_cache.CreateFromCache());
+	m_valMemo = val;
+	for (auto& var : m_vMemoVar)
+		var.second = var.first->GetVersion();
 
-				*val = *(static_cast<IValue*>(pTok));
-			}
-		}
-		continue;
+	m_bMemoValid = true;
+	return m_valMemo;
+}
 
-		case  cmIC:
+//---------------------------------------------------------------------------
+/** \brief Start compiling a copy of the RPN in another thread. 
+
+	If no thread can be created the expression is compiled right away.
+*/
+void ParserXBase::StartTierUp() const
+{
+	m_pTierUp.reset(new STierUp());
+	m_pTierUp->m_rpn = m_rpn.Clone();
+	m_pTierUp->m_realEngine.EnableSimdMath(m_realEngine.IsSimdMathEnabled());
+	m_pTierUp->m_bRealEngine = false;
+	m_pTierUp->m_bDone.store(false);
+
+	STierUp* pTierUp = m_pTierUp.get();
+	auto compile = [pTierUp]()
+	{
+		try
 		{
-			ICallback* pIdxOprt = static_cast<ICallback*>(pTok);
-			int nArgs = pIdxOprt->GetArgsPresent();
-			sidx -= nArgs - 1;
-			MUP_VERIFY(sidx >= 0);
-
-			ptr_val_type& idx = pStack[sidx];   // Pointer to the first index
-			ptr_val_type& val = pStack[--sidx];   // Pointer to the variable or value beeing indexed
-			pIdxOprt->Eval(val, &idx, nArgs);
+			pTierUp->m_bRealEngine = pTierUp->m_realEngine.Compile(pTierUp->m_rpn);
+			if (pTierUp->m_bRealEngine)
+				pTierUp->m_jitEngine.Compile(pTierUp->m_realEngine);
 		}
-		continue;
-
-		case cmCBC:
-		case cmOPRT_POSTFIX:
-		case cmFUNC:
-		case cmOPRT_BIN:
-		case cmOPRT_INFIX:
+		catch (...)
 		{
-			ICallback* pFun = static_cast<ICallback*>(pTok);
-			int nArgs = pFun->GetArgsPresent();
-			sidx -= nArgs - 1;
+			pTierUp->m_bRealEngine = false;
+		}
 
-			// most likely cause: Comma in if-then-else sum(false?1,0,0:3)
-			if (sidx < 0)
-			{
-				ErrorContext err;
-				err.Expr = m_pTokenReader->GetExpr();
-				err.Errc = ecUNEXPECTED_COMMA;
-				err.Pos = m_pTokenReader->GetPos();
-				throw ParserError(err);
-			}
+		pTierUp->m_bDone.store(true, std::memory_order_release);
+	};
 
-			ptr_val_type& val = pStack[sidx];
-			try
-			{
-				if (val->IsVariable())
-				{
-					ptr_val_type buf(m_cache.CreateFromCache());
-					pFun->Eval(buf, &val, nArgs);
-					val = buf;
-				}
-				else
-				{
-					pFun->Eval(val, &val, nArgs);
-				}
-			}
-			catch (ParserError& exc)
-			{
-				// <ibg 20130131> Not too happy about that:
-				// Multiarg functions may throw specific error codes when evaluating.
-				// These codes would be converted to ecEVAL here. I omit the conversion
-				// for certain handpicked errors. (The reason this catch block exists is
-				// that not all exceptions contain proper metadata when thrown out of
-				// a function.)
-				if (exc.GetCode() == ecTOO_FEW_PARAMS ||
-					exc.GetCode() == ecDOMAIN_ERROR ||
-					exc.GetCode() == ecOVERFLOW ||
-					exc.GetCode() == ecINVALID_NUMBER_OF_PARAMETERS ||
-					exc.GetCode() == ecASSIGNEMENT_TO_VALUE)
-				{
-					exc.GetContext().Pos = pFun->GetExprPos();
-					throw;
-				}
-				// </ibg>
-				else
-				{
-					ErrorContext err;
-					err.Expr = m_pTokenReader->GetExpr();
-					err.Ident = pFun->GetIdent();
-					err.Errc = ecEVAL;
-					err.Pos = pFun->GetExprPos();
-					err.Hint = exc.GetMsg();
-					throw ParserError(err);
-				}
-			}
-			catch (MatrixError& /*exc*/)
-			{
-				ErrorContext err;
-				err.Expr = m_pTokenReader->GetExpr();
-				err.Ident = pFun->GetIdent();
-				err.Errc = ecMATRIX_DIMENSION_MISMATCH;
-				err.Pos = pFun->GetExprPos();
-				throw ParserError(err);
-			}
-		}
-		continue;
+	try
+	{
+		m_tierUpThread = std::thread(compile);
+	}
+	catch (const std::system_error&)
+	{
+		compile();
+	}
+}
 
-		case cmIF:
-			MUP_VERIFY(sidx >= 0);
-			if (pStack[sidx--]->GetBool() == false)
-				i += static_cast<TokenIfThenElse*>(pTok)->GetOffset();
-			continue;
+//---------------------------------------------------------------------------
+/** \brief Wait for the compiler thread and switch to the compiled engine. 
 
-		case cmELSE:
-		case cmJMP:
-			i += static_cast<TokenIfThenElse*>(pTok)->GetOffset();
-			continue;
+	Starts the compilation if it was not started yet.
+*/
+void ParserXBase::FinishTierUp() const
+{
+	if (m_pTierUp == nullptr)
+		StartTierUp();
 
-		case cmENDIF:
-			continue;
+	if (m_tierUpThread.joinable())
+		m_tierUpThread.join();
 
-		case cmSHORTCUT_BEGIN:
-			if (pTok->AsIPrecedence()->GetPri() == prLOGIC_OR)
-			{
-				// occur short circuit feature
-				if (pStack[sidx]->GetBool() == true) 
-				{
-					i += static_cast<IOprtBinShortcut*>(pTok)->GetOffset();
-				} else {
-					// pop stack ,becuase this value had used
-					--sidx;
-				}
-			}
-			else // logic and
-			{
-				// occur short circuit feature
-				if (pStack[sidx]->GetBool() == false) 
-				{
-					i += static_cast<IOprtBinShortcut*>(pTok)->GetOffset();
-				} else {
-					// pop stack ,becuase this value had used
-					--sidx;
-				}
-			}
-			continue;
+	if (m_pTierUp->m_bRealEngine)
+	{
+		m_realEngine = m_pTierUp->m_realEngine;
+		m_jitEngine.Swap(m_pTierUp->m_jitEngine);
+		m_evalCtx.Init(m_rpn, &m_realEngine);
+		m_pParserEngine = (m_jitEngine.IsValid()) ? &ParserXBase::ParseFromJit : &ParserXBase::ParseFromRealEngine;
+	}
+	else
+		m_pParserEngine = &ParserXBase::ParseFromRPN;
 
-		case cmSHORTCUT_END:
-			continue;
+	m_pTierUp.reset();
+}
 
-		default:
-			Error(ecINTERNAL_ERROR);
-		} // switch token
-	} // for all RPN tokens
+//---------------------------------------------------------------------------
+/** \brief Wait for the compiler thread and discard its result. */
+void ParserXBase::JoinTierUp() const
+{
+	if (m_tierUpThread.joinable())
+		m_tierUpThread.join();
 
-	return *pStack[0];
+	m_pTierUp.reset();
+	m_nEvalCount = 0;
+}
+
+//---------------------------------------------------------------------------
+const IValue& ParserXBase::ParseFromRPN() const
+{
+	return m_evalCtx.ParseFromRPN(m_rpn, m_pTokenReader->GetExpr(), m_pTokenReader->GetPos());
 }
 
 //---------------------------------------------------------------------------
@@ -1247,6 +1564,7 @@ void ParserXBase::ClearVar()
 	m_varDef.clear();
 	m_valDynVarShadow.clear();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //------------------------------------------------------------------------------
@@ -1269,6 +1587,7 @@ void ParserXBase::ClearFun()
 {
 	m_FunDef.clear();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //------------------------------------------------------------------------------
@@ -1281,6 +1600,7 @@ void ParserXBase::ClearConst()
 {
 	m_valDef.clear();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //------------------------------------------------------------------------------
@@ -1290,7 +1610,9 @@ void ParserXBase::ClearConst()
 void ParserXBase::ClearPostfixOprt()
 {
 	m_PostOprtDef.clear();
+	m_pTokenReader->InvalidateOprtTrie();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //------------------------------------------------------------------------------
@@ -1301,7 +1623,9 @@ void ParserXBase::ClearOprt()
 {
 	m_OprtDef.clear();
 	m_OprtShortcutDef.clear();
+	m_pTokenReader->InvalidateOprtTrie();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //------------------------------------------------------------------------------
@@ -1311,7 +1635,9 @@ void ParserXBase::ClearOprt()
 void ParserXBase::ClearInfixOprt()
 {
 	m_InfixOprtDef.clear();
+	m_pTokenReader->InvalidateOprtTrie();
 	ReInit();
+	++m_nDefGeneration;
 }
 
 //------------------------------------------------------------------------------
@@ -1321,9 +1647,222 @@ void ParserXBase::EnableAutoCreateVar(bool bStat)
 }
 
 //------------------------------------------------------------------------------
+/** \brief Enable or disable the expression optimizer.
+
+	If the optimizer is enabled constant subexpressions are evaluated once
+	while the RPN is created and repeated subexpressions are evaluated only
+	once per evaluation. The setting takes effect the next time the
+	expression is parsed. Callbacks with side effects or non deterministic
+	results must be flagged with IToken::flVOLATILE in order to prevent
+	them from beeing evaluated at compile time or merged (see
+	ICallback::IsPure).
+*/
 void ParserXBase::EnableOptimizer(bool bStat)
 {
 	m_rpn.EnableOptimizer(bStat);
+	++m_nDefGeneration;
+}
+
+//------------------------------------------------------------------------------
+bool ParserXBase::IsOptimizerEnabled() const
+{
+	return m_rpn.IsOptimizerEnabled();
+}
+
+//------------------------------------------------------------------------------
+/** \brief Compute fused multiplications and additions with a single rounding.
+
+	The optimizer fuses x*y+z and z+x*y into a single token. If this option
+	is enabled the real valued result is computed by std::fma which may 
+	differ from the separately rounded result in the last bit. The setting 
+	takes effect the next time the expression is parsed with the optimizer
+	enabled.
+*/
+void ParserXBase::EnableFusedMultiplyAdd(bool bStat)
+{
+	m_rpn.EnableFusedMultiplyAdd(bStat);
+	++m_nDefGeneration;
+}
+
+//------------------------------------------------------------------------------
+bool ParserXBase::IsFusedMultiplyAddEnabled() const
+{
+	return m_rpn.IsFusedMultiplyAddEnabled();
+}
+
+//------------------------------------------------------------------------------
+/** \brief Enable or disable the bytecode engine for real valued expressions.
+
+	If enabled, expressions that use only real numbers and the built in 
+	arithmetic operators, comparisons and functions are evaluated by a
+	bytecode engine working on plain floating point numbers (see RealEngine). 
+	The engine is enabled by default. The setting takes effect the next time 
+	the expression is parsed.
+*/
+void ParserXBase::EnableRealEngine(bool bStat)
+{
+	m_bEnableRealEngine = bStat;
+}
+
+//------------------------------------------------------------------------------
+bool ParserXBase::IsRealEngineEnabled() const
+{
+	return m_bEnableRealEngine;
+}
+
+//------------------------------------------------------------------------------
+/** \brief Enable or disable vectorized math functions in EvalBatch.
+
+	If enabled, EvalBatch computes sin, cos, exp, the logarithms, sqrt and abs
+	with the SIMD functions of SimdMath. Their results may differ from Eval by
+	an ULP or two. Disabled by default.
+*/
+void ParserXBase::EnableSimdMath(bool bStat)
+{
+	m_realEngine.EnableSimdMath(bStat);
+}
+
+//------------------------------------------------------------------------------
+bool ParserXBase::IsSimdMathEnabled() const
+{
+	return m_realEngine.IsSimdMathEnabled();
+}
+
+//------------------------------------------------------------------------------
+/** \brief Enable or disable the threaded code of the generic engine.
+
+	If enabled, the generic engine translates the RPN into a flat array of 
+	instructions holding the addresses of their handlers (see EvalContext).
+	Results are identical in both modes. Enabled by default.
+*/
+void ParserXBase::EnableThreadedCode(bool bStat)
+{
+	m_evalCtx.EnableThreadedCode(bStat);
+	ReInit();
+}
+
+//------------------------------------------------------------------------------
+bool ParserXBase::IsThreadedCodeEnabled() const
+{
+	return m_evalCtx.IsThreadedCodeEnabled();
+}
+
+//------------------------------------------------------------------------------
+/** \brief Enable or disable the register code of the generic engine.
+
+	If enabled, the generic engine translates the RPN into register code 
+	instead of threaded code (see EvalContext). The instructions refer to 
+	variables and constants directly instead of pushing them onto the stack.
+	Results are identical in all modes. Disabled by default.
+*/
+void ParserXBase::EnableRegisterCode(bool bStat)
+{
+	m_evalCtx.EnableRegisterCode(bStat);
+	ReInit();
+}
+
+//------------------------------------------------------------------------------
+bool ParserXBase::IsRegisterCodeEnabled() const
+{
+	return m_evalCtx.IsRegisterCodeEnabled();
+}
+
+//------------------------------------------------------------------------------
+/** \brief Enable or disable the memoization of results.
+
+	If enabled, Eval returns the result of the previous evaluation as long as
+	none of the variables used by the expression was modified. Functions and
+	operators with side effects or results not depending on their arguments 
+	only must be flagged with IToken::flVOLATILE, expressions using them are
+	always evaluated. Disabled by default.
+*/
+void ParserXBase::EnableMemoization(bool bStat)
+{
+	m_bEnableMemo = bStat;
+	ReInit();
+}
+
+//------------------------------------------------------------------------------
+bool ParserXBase::IsMemoizationEnabled() const
+{
+	return m_bEnableMemo;
+}
+
+//------------------------------------------------------------------------------
+/** \brief Select how the expression is translated and translate it.
+	\param eMode jitNATIVE creates machine code for real valued expressions, 
+	             jitNONE uses the interpreters only. jitTIERED starts with the
+	             generic engine and creates bytecode and machine code once the 
+	             expression was evaluated often (see SetTierUpThreshold).
+	\return true if the expression is evaluated by machine code.
+	\throw ParserError in case of syntax errors.
+
+	The mode is kept for expressions set later. Machine code is created for 
+	expressions the bytecode engine can evaluate (see EnableRealEngine), if
+	the platform is supported (see JitEngine::IsSupported). Otherwise the 
+	interpreters are used. Results are identical in all modes.
+*/
+bool ParserXBase::Compile(EJitMode eMode)
+{
+	m_eJitMode = eMode;
+	ReInit();
+	CreateEngine();
+	return m_pParserEngine == &ParserXBase::ParseFromJit;
+}
+
+//------------------------------------------------------------------------------
+EJitMode ParserXBase::GetJitMode() const
+{
+	return m_eJitMode;
+}
+
+//------------------------------------------------------------------------------
+/** \brief Set the number of evaluations after which an expression is compiled
+		   in jitTIERED mode.
+	\param nEvals The number of evaluations by Eval, at least 1. The default is 1000.
+
+	Expressions evaluated only a few times are never compiled. EvalBatch and
+	CompiledExpression compile the expression right away.
+*/
+void ParserXBase::SetTierUpThreshold(int nEvals)
+{
+	if (nEvals < 1)
+		throw ParserError(ErrorContext(ecINVALID_PARAMETER, -1, _T("SetTierUpThreshold")));
+
+	m_nTierUpThreshold = nEvals;
+}
+
+//------------------------------------------------------------------------------
+int ParserXBase::GetTierUpThreshold() const
+{
+	return m_nTierUpThreshold;
+}
+
+//------------------------------------------------------------------------------
+/** \brief Set the number of threads used by EvalBatch.
+	\param nThreads The number of threads including the calling thread. 0 selects 
+	                the number of hardware threads. 
+
+	The default is 1, EvalBatch does not create threads then.
+*/
+void ParserXBase::SetBatchThreads(int nThreads)
+{
+	if (nThreads < 0)
+		throw ParserError(ErrorContext(ecINVALID_PARAMETER, -1, _T("SetBatchThreads")));
+
+	if (nThreads == 0)
+		nThreads = ThreadPool::GetHardwareThreads();
+
+	if (nThreads != m_nBatchThreads)
+		m_pThreadPool.reset();
+
+	m_nBatchThreads = nThreads;
+}
+
+//------------------------------------------------------------------------------
+int ParserXBase::GetBatchThreads() const
+{
+	return m_nBatchThreads;
 }
 
 //---------------------------------------------------------------------------
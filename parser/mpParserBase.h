@@ -40,7 +40,10 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <vector>
 #include <memory>
+#include <atomic>
+#include <thread>
 
 #include "mpIOprt.h"
 #include "mpIOprtBinShortcut.h"
@@ -53,7 +56,11 @@
 #include "mpVariable.h"
 #include "mpTypes.h"
 #include "mpRPN.h"
-#include "mpValueCache.h"
+#include "mpRealEngine.h"
+#include "mpJitEngine.h"
+#include "mpEvalContext.h"
+#include "mpThreadPool.h"
+#include "mpRPNCache.h"
 
 MUP_NAMESPACE_START
   
@@ -67,6 +74,10 @@ MUP_NAMESPACE_START
   class ParserXBase
   {
   friend class TokenReader;
+  friend class CompiledExpression;
+  friend class RPNArchive;
+  friend class PreparedExpression;
+  friend class PreparedExpressionCache;
 
   private:
 
@@ -86,6 +97,7 @@ MUP_NAMESPACE_START
     virtual ~ParserXBase();
     
     const IValue& Eval() const;
+    void EvalBatch(const column_maptype &a_Columns, float_type *a_pRes, std::size_t a_nRows) const;
 
     void SetExpr(const string_type &a_sExpr);
     void AddValueReader(IValueReader *a_pReader);
@@ -128,6 +140,9 @@ MUP_NAMESPACE_START
     const val_maptype& GetConst() const;
     const fun_maptype& GetFunDef() const;
     const string_type& GetExpr() const;
+    const RPN& GetRPN() const;
+    const RealEngine& GetRealEngine() const;
+    const JitEngine& GetJitEngine() const;
 
     const char_type ** GetOprtDef() const;
     void DefineNameChars(const char_type *a_szCharset);
@@ -136,7 +151,28 @@ MUP_NAMESPACE_START
     
     void EnableAutoCreateVar(bool bStat);
     void EnableOptimizer(bool bStat);
+    void EnableFusedMultiplyAdd(bool bStat);
+    void EnableRealEngine(bool bStat);
+    void EnableSimdMath(bool bStat);
+    void EnableThreadedCode(bool bStat);
+    void EnableRegisterCode(bool bStat);
+    void EnableMemoization(bool bStat);
     bool IsAutoCreateVarEnabled() const;
+    bool IsOptimizerEnabled() const;
+    bool IsFusedMultiplyAddEnabled() const;
+    bool IsRealEngineEnabled() const;
+    bool IsSimdMathEnabled() const;
+    bool IsThreadedCodeEnabled() const;
+    bool IsRegisterCodeEnabled() const;
+    bool IsMemoizationEnabled() const;
+    bool Compile(EJitMode eMode);
+    EJitMode GetJitMode() const;
+    void SetTierUpThreshold(int nEvals);
+    int GetTierUpThreshold() const;
+    void SetBatchThreads(int nThreads);
+    int GetBatchThreads() const;
+    void SetRPNCacheSize(std::size_t nSize);
+    const RPNCache& GetRPNCache() const;
 
     const char_type* ValidNameChars() const;
     const char_type* ValidOprtChars() const;
@@ -161,9 +197,20 @@ MUP_NAMESPACE_START
 
   private:
 
+    /** \brief Compilation of an expression promoted by ParseTiered. */
+    struct STierUp
+    {
+      RPN m_rpn;                    ///< Copy of the RPN, the compiler thread does not touch the parser
+      RealEngine m_realEngine;
+      JitEngine m_jitEngine;
+      bool m_bRealEngine;           ///< True if m_realEngine was compiled successfully
+      std::atomic<bool> m_bDone;    ///< Set by the compiler thread when it is finished
+    };
+
     void  ReInit() const;
     void  ClearExpr();
     void  CreateRPN() const;
+    void  CreateEngine() const;
     void  StackDump(const Stack<ptr_tok_type> &a_stOprt) const;
 
     // Used by by DefineVar and DefineConst methods
@@ -179,6 +226,13 @@ MUP_NAMESPACE_START
     void ApplyRemainingOprt(Stack<ptr_tok_type> &a_stOpt) const;
     const IValue& ParseFromString() const; 
     const IValue& ParseFromRPN() const; 
+    const IValue& ParseFromRealEngine() const;
+    const IValue& ParseFromJit() const;
+    const IValue& ParseTiered() const;
+    const IValue& EvalMemoized() const;
+    void StartTierUp() const;
+    void FinishTierUp() const;
+    void JoinTierUp() const;
 
     /** \brief Pointer to the parser function. 
     
@@ -217,10 +271,26 @@ MUP_NAMESPACE_START
     mutable bool m_bIsQueryingExprVar;    
 
     mutable bool m_bAutoCreateVar;      ///< If this flag is set unknown variables will be defined automatically
+    bool m_bEnableRealEngine;           ///< If this flag is set real valued expressions are evaluated by m_realEngine
 
     mutable RPN m_rpn;                  ///< reverse polish notation
-    mutable val_vec_type m_vStackBuffer;
-    mutable ValueCache m_cache;         ///< A cache for recycling value items instead of deleting them
+    mutable RealEngine m_realEngine;    ///< Bytecode for real valued expressions
+    mutable JitEngine m_jitEngine;      ///< Machine code created from m_realEngine
+    EJitMode m_eJitMode;                ///< Set by Compile
+    int m_nTierUpThreshold;             ///< Evaluations before an expression is compiled in jitTIERED mode
+    mutable int m_nEvalCount;           ///< Evaluations by ParseTiered since the expression was parsed
+    mutable std::unique_ptr<STierUp> m_pTierUp;   ///< Compilation started by ParseTiered
+    mutable std::thread m_tierUpThread;           ///< Thread compiling m_pTierUp
+    mutable EvalContext m_evalCtx;      ///< Stack buffer and value cache used by Eval
+    int m_nBatchThreads;                ///< Number of threads used by EvalBatch
+    mutable std::unique_ptr<ThreadPool> m_pThreadPool;  ///< Created by EvalBatch if more than one thread is used
+    mutable RPNCache m_rpnCache;        ///< RPN of previously parsed expressions
+    std::size_t m_nDefGeneration;       ///< Incremented when definitions affecting the RPN are changed
+    bool m_bEnableMemo;                 ///< If this flag is set Eval returns the last result if no variable changed
+    mutable bool m_bMemoValid;          ///< True if m_valMemo holds the result of the current expression
+    mutable bool m_bMemoVolatile;       ///< True if the expression contains volatile tokens
+    mutable Value m_valMemo;            ///< Result of the last evaluation
+    mutable std::vector<std::pair<const IValue*, std::size_t>> m_vMemoVar;  ///< Variables of the expression and their versions at the last evaluation
 
   };
 } // namespace mu
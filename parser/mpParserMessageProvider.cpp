@@ -104,6 +104,8 @@ MUP_NAMESPACE_START
     m_vErrMsg[ecVARIABLE_DEFINED]             = _T("Variable \"$IDENT$\" is already defined.");
     m_vErrMsg[ecCONSTANT_DEFINED]             = _T("Constant \"$IDENT$\" is already defined.");
     m_vErrMsg[ecFUNOPRT_DEFINED]              = _T("Function/operator \"$IDENT$\" is already defined.");
+    m_vErrMsg[ecINVALID_ARCHIVE]              = _T("Invalid or incompatible archive of compiled expressions.");
+    m_vErrMsg[ecCYCLIC_DEPENDENCY]            = _T("Cyclic dependency of formulas found at variable \"$IDENT$\".");
   }
 
 #if defined(MUP_USE_WIDE_STRING)
@@ -175,6 +177,8 @@ MUP_NAMESPACE_START
     m_vErrMsg[ecVARIABLE_DEFINED]             = _T("Die Variable \"$IDENT$\" is bereits definiert.");
     m_vErrMsg[ecCONSTANT_DEFINED]             = _T("Die Konstante \"$IDENT$\" is bereits definiert.");
     m_vErrMsg[ecFUNOPRT_DEFINED]              = _T("Ein Element mit der Bezeichnung \"$IDENT$\" ist bereits definiert.");
+    m_vErrMsg[ecINVALID_ARCHIVE]              = _T("Ungültiges oder inkompatibles Archiv kompilierter Ausdrücke.");
+    m_vErrMsg[ecCYCLIC_DEPENDENCY]            = _T("Zyklische Abhängigkeit von Formeln bei der Variablen \"$IDENT$\" gefunden.");
   }
 #endif // MUP_USE_WIDE_STRING
 
@@ -0,0 +1,263 @@
+/** \file
+    \brief Implementation of expressions with parameterized numeric literals.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpPreparedExpression.h"
+
+#include <functional>
+
+#include "mpParserBase.h"
+#include "mpTokenReader.h"
+#include "mpVariable.h"
+
+
+MUP_NAMESPACE_START
+
+namespace
+{
+	//---------------------------------------------------------------------------
+	string_type ParamName(std::size_t nIdx)
+	{
+		stringstream_type ss;
+		ss << _T("_lit") << nIdx;
+		return ss.str();
+	}
+} // namespace
+
+//---------------------------------------------------------------------------
+/** \brief Return the shape of an expression.
+	\param a_Parser The parser defining the tokens of the expression
+	\param a_sExpr The expression
+	\param a_pLiteral Receives the values of the literals replaced by parameters or nullptr
+	\throw ParserError in case of syntax errors found by the token reader.
+*/
+string_type PreparedExpression::GetShape(const ParserXBase &a_Parser, const string_type &a_sExpr, std::vector<float_type> *a_pLiteral)
+{
+	std::unique_ptr<TokenReader> pReader(a_Parser.m_pTokenReader->Clone(const_cast<ParserXBase*>(&a_Parser)));
+	return Normalize(*pReader, a_Parser, a_sExpr, a_pLiteral);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Replace the numeric literals of an expression by parameters.
+
+	The tokens are read but no RPN is created. Literals are the real and 
+	integer values read by the value readers of the parser. Constants, 
+	strings and boolean values are kept. A space is inserted if the next 
+	character could otherwise become part of the parameter name, i.e. for 
+	postfix operators like "m" in "3m".
+*/
+string_type PreparedExpression::Normalize(TokenReader &a_Reader, const ParserXBase &a_Parser, const string_type &a_sExpr, std::vector<float_type> *a_pLiteral)
+{
+	if (a_pLiteral != nullptr)
+		a_pLiteral->clear();
+
+	const string_type sNameChars = a_Parser.ValidNameChars();
+	string_type sShape;
+	sShape.reserve(a_sExpr.length() + 16);
+
+	a_Reader.SetExpr(a_sExpr);
+	std::size_t nLast = 0, nParam = 0;
+	for (;;)
+	{
+		ptr_tok_type tok = a_Reader.ReadNextToken();
+		if (tok->GetCode() == cmEOE)
+			break;
+
+		if (tok->GetCode() != cmVAL)
+			continue;
+
+		const IValue *pVal = tok->AsIValue();
+		if (pVal->IsVariable() || !pVal->IsNonComplexScalar() || a_Parser.IsConstDefined(tok->GetIdent()))
+			continue;
+
+		std::size_t nPos = tok->GetExprPos(), 
+			        nEnd = a_Reader.GetPos();
+		sShape.append(a_sExpr, nLast, nPos - nLast);
+		sShape += ParamName(nParam++);
+		if (nEnd < a_sExpr.length() && sNameChars.find(a_sExpr[nEnd]) != string_type::npos)
+			sShape += _T(' ');
+
+		if (a_pLiteral != nullptr)
+			a_pLiteral->push_back(pVal->GetFloat());
+
+		nLast = nEnd;
+	}
+
+	sShape.append(a_sExpr, nLast, string_type::npos);
+	return sShape;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Compile a shape with a copy of the parser defining the parameters.
+	\param a_Parser The parser
+	\param a_sShape The shape
+	\param a_pParam The values bound to the parameters
+	\param a_vLiteral The initial values of the parameters
+*/
+CompiledExpression PreparedExpression::Compile(const ParserXBase &a_Parser, const string_type &a_sShape, Value *a_pParam, const std::vector<float_type> &a_vLiteral)
+{
+	ParserXBase parser(a_Parser);
+	for (std::size_t i = 0; i < a_vLiteral.size(); ++i)
+	{
+		// The bytecode engine is selected by the types of the variables
+		a_pParam[i] = a_vLiteral[i];
+		parser.DefineVar(ParamName(i), Variable(&a_pParam[i]));
+	}
+
+	parser.SetExpr(a_sShape);
+	return CompiledExpression(parser);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the shape of an expression and compile it.
+	\param a_Parser The parser defining the tokens of the expression
+	\param a_sExpr The expression
+	\throw ParserError in case of syntax errors or if a parameter name is used 
+	       by the parser.
+*/
+PreparedExpression::PreparedExpression(const ParserXBase &a_Parser, const string_type &a_sExpr)
+	:m_vLiteral()
+	,m_sShape(GetShape(a_Parser, a_sExpr, &m_vLiteral))
+	,m_nHash(std::hash<string_type>()(m_sShape))
+	,m_pParam(new Value[m_vLiteral.size()])
+	,m_expr(Compile(a_Parser, m_sShape, m_pParam.get(), m_vLiteral))
+{}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate an instance of the shape.
+	\param a_Ctx The evaluation context
+	\param a_pParam The values of the parameters, GetNumParams values are read.
+	\return The result. It remains valid until the context is used for
+	        the next evaluation.
+*/
+const IValue& PreparedExpression::Eval(EvalContext &a_Ctx, const float_type *a_pParam) const
+{
+	for (std::size_t i = 0; i < m_vLiteral.size(); ++i)
+		m_pParam[i] = a_pParam[i];
+
+	return m_expr.Eval(a_Ctx);
+}
+
+//---------------------------------------------------------------------------
+const string_type& PreparedExpression::GetShape() const
+{
+	return m_sShape;
+}
+
+//---------------------------------------------------------------------------
+std::size_t PreparedExpression::GetHash() const
+{
+	return m_nHash;
+}
+
+//---------------------------------------------------------------------------
+std::size_t PreparedExpression::GetNumParams() const
+{
+	return m_vLiteral.size();
+}
+
+//---------------------------------------------------------------------------
+string_type PreparedExpression::GetParamName(std::size_t nIdx) const
+{
+	return ParamName(nIdx);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the literals of the expression the shape was created from. */
+const std::vector<float_type>& PreparedExpression::GetLiterals() const
+{
+	return m_vLiteral;
+}
+
+//---------------------------------------------------------------------------
+const CompiledExpression& PreparedExpression::GetCompiledExpression() const
+{
+	return m_expr;
+}
+
+//---------------------------------------------------------------------------
+//
+//  class PreparedExpressionCache
+//
+//---------------------------------------------------------------------------
+
+PreparedExpressionCache::PreparedExpressionCache(const ParserXBase &a_Parser)
+	:m_parser(a_Parser)
+	,m_pReader(a_Parser.m_pTokenReader->Clone(const_cast<ParserXBase*>(&a_Parser)))
+	,m_mapShape()
+	,m_nSize(0)
+{}
+
+//---------------------------------------------------------------------------
+PreparedExpressionCache::~PreparedExpressionCache()
+{}
+
+//---------------------------------------------------------------------------
+/** \brief Find or create the shape of an expression.
+	\param a_sExpr The expression
+	\param a_vLiteral Receives the literals of the expression, they are the 
+	                  parameters to be passed to PreparedExpression::Eval.
+	\throw ParserError in case of syntax errors.
+*/
+std::shared_ptr<const PreparedExpression> PreparedExpressionCache::Prepare(const string_type &a_sExpr, std::vector<float_type> &a_vLiteral)
+{
+	string_type sShape = PreparedExpression::Normalize(*m_pReader, m_parser, a_sExpr, &a_vLiteral);
+	shape_vec_type &vShape = m_mapShape[std::hash<string_type>()(sShape)];
+	for (const std::shared_ptr<const PreparedExpression> &pShape : vShape)
+	{
+		if (pShape->GetShape() == sShape)
+			return pShape;
+	}
+
+	std::shared_ptr<const PreparedExpression> pShape = std::make_shared<PreparedExpression>(m_parser, a_sExpr);
+	vShape.push_back(pShape);
+	++m_nSize;
+	return pShape;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the number of shapes. */
+std::size_t PreparedExpressionCache::GetSize() const
+{
+	return m_nSize;
+}
+
+//---------------------------------------------------------------------------
+void PreparedExpressionCache::Clear()
+{
+	m_mapShape.clear();
+	m_nSize = 0;
+}
+
+MUP_NAMESPACE_END
@@ -0,0 +1,131 @@
+#ifndef MUP_PREPARED_EXPRESSION_H
+#define MUP_PREPARED_EXPRESSION_H
+
+/** \file
+    \brief Definition of expressions with parameterized numeric literals.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+#include "mpValue.h"
+#include "mpCompiledExpression.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief The shape of an expression compiled with its numeric literals 
+             replaced by parameters.
+
+    Expressions differing only in their numeric literals, i.e. "x*0.37+y*1.2"
+    and "x*0.41+y*0.9", have the same shape. The shape is the expression 
+    with the literals replaced by the reserved parameter names _lit0, _lit1, 
+    and so on. It is compiled once, each instance of the shape is a vector 
+    of parameter values passed to Eval. Literals are never folded with each 
+    other by the optimizer.
+
+    The parameters are bound to values owned by the prepared expression. 
+    Eval assigns them before the evaluation, so a prepared expression must 
+    not be evaluated by several threads at the same time. Threads may 
+    instead bind the parameter names (see GetParamName) to their own values
+    with EvalContext::DefineVar and evaluate GetCompiledExpression.
+  */
+  class PreparedExpression
+  {
+  friend class PreparedExpressionCache;
+
+  public:
+
+    static string_type GetShape(const ParserXBase &a_Parser, const string_type &a_sExpr, std::vector<float_type> *a_pLiteral = nullptr);
+
+    PreparedExpression(const ParserXBase &a_Parser, const string_type &a_sExpr);
+
+    const IValue& Eval(EvalContext &a_Ctx, const float_type *a_pParam) const;
+
+    const string_type& GetShape() const;
+    std::size_t GetHash() const;
+    std::size_t GetNumParams() const;
+    string_type GetParamName(std::size_t nIdx) const;
+    const std::vector<float_type>& GetLiterals() const;
+    const CompiledExpression& GetCompiledExpression() const;
+
+  private:
+
+    static string_type Normalize(TokenReader &a_Reader, const ParserXBase &a_Parser, const string_type &a_sExpr, std::vector<float_type> *a_pLiteral);
+    static CompiledExpression Compile(const ParserXBase &a_Parser, const string_type &a_sShape, Value *a_pParam, const std::vector<float_type> &a_vLiteral);
+
+    std::vector<float_type> m_vLiteral;   ///< Literals of the expression used for creating the shape
+    string_type m_sShape;
+    std::size_t m_nHash;                  ///< Hash of m_sShape
+    std::unique_ptr<Value[]> m_pParam;    ///< Values bound to the parameters
+    CompiledExpression m_expr;
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief A catalog of prepared expressions looked up by their shapes.
+
+    Prepare reads the tokens of an expression to find its shape and its 
+    literals, but creates neither the RPN nor the bytecode if the shape is 
+    known. Shapes are stored by the hash of their normalized token stream.
+    The parser must outlive the cache, changed definitions of the parser 
+    require clearing it.
+  */
+  class PreparedExpressionCache
+  {
+  public:
+
+    explicit PreparedExpressionCache(const ParserXBase &a_Parser);
+   ~PreparedExpressionCache();
+
+    std::shared_ptr<const PreparedExpression> Prepare(const string_type &a_sExpr, std::vector<float_type> &a_vLiteral);
+    std::size_t GetSize() const;
+    void Clear();
+
+  private:
+
+    typedef std::vector<std::shared_ptr<const PreparedExpression>> shape_vec_type;
+
+    const ParserXBase &m_parser;
+    std::unique_ptr<TokenReader> m_pReader;   ///< Token reader used for finding the shapes
+    std::unordered_map<std::size_t, shape_vec_type> m_mapShape;
+    std::size_t m_nSize;
+  };
+
+MUP_NAMESPACE_END
+
+#endif
@@ -31,6 +31,9 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <map>
 
 #include "mpRPN.h"
 #include "mpIToken.h"
@@ -40,6 +43,12 @@
 #include "mpStack.h"
 #include "mpIfThenElse.h"
 #include "mpScriptTokens.h"
+#include "mpValue.h"
+#include "mpVariable.h"
+#include "mpTempTokens.h"
+#include "mpOprtStrengthReduced.h"
+#include "mpOprtFused.h"
+#include "mpMatrixError.h"
 
 MUP_NAMESPACE_START
 
@@ -49,7 +58,9 @@ RPN::RPN()
 	, m_nStackPos(-1)
 	, m_nLine(0)
 	, m_nMaxStackPos(0)
+	, m_nTempSlots(0)
 	, m_bEnableOptimizer(false)
+	, m_bEnableFma(false)
 {}
 
 //---------------------------------------------------------------------------
@@ -101,23 +112,56 @@ void RPN::Pop(int num)
 	}
 }
 
+//---------------------------------------------------------------------------
+/** \brief Returns a copy of the RPN with copies of all tokens.
+
+	The tokens of an RPN are reference counted. A copy that doesn't share 
+	its tokens with this object can be used by another thread.
+*/
+RPN RPN::Clone() const
+{
+	RPN rpn(*this);
+	for (std::size_t i = 0; i < rpn.m_vRPN.size(); ++i)
+	{
+		// Copies of values and variables don't keep the identifier
+		IToken* pTok = m_vRPN[i]->Clone();
+		pTok->SetIdent(m_vRPN[i]->GetIdent());
+		pTok->SetExprPos(m_vRPN[i]->GetExprPos());
+		rpn.m_vRPN[i] = ptr_tok_type(pTok);
+	}
+
+	return rpn;
+}
+
 //---------------------------------------------------------------------------
 void RPN::Reset()
 {
 	m_vRPN.clear();
 	m_nStackPos = -1;
 	m_nMaxStackPos = 0;
+	m_nTempSlots = 0;
 	m_nLine = 0;
 }
 
 //---------------------------------------------------------------------------
-/** \brief
+/** \brief Finalize the RPN after the last token has been added.
 
-	At the moment this will only ass the jump distances to the if-else clauses
-	found in the expression.
+	If the optimizer is enabled constant subexpressions are folded first,
+	operators with constant operands are replaced by cheaper forms,
+	repeated subexpressions are replaced by temporaries and short token 
+	sequences are fused. Afterwards the jump distances of the if-else clauses and the short
+	circuit operators found in the expression are computed.
 */
 void RPN::Finalize()
 {
+	if (m_bEnableOptimizer)
+	{
+		FoldConstants();
+		ReduceStrength();
+		EliminateCommonSubexpressions();
+		FuseInstructions();
+	}
+
 	// Determine the if-then-else jump offsets
 	Stack<int> stIf, stElse;
 	Stack<int> stScBeg;
@@ -156,12 +200,603 @@ void RPN::Finalize()
 	}
 }
 
+//---------------------------------------------------------------------------
+/** \brief Replace callbacks with constant arguments by their result.
+
+	A callback is evaluated at compile time if all of its arguments are
+	non volatile values (literals or parser constants) and the callback
+	itself is pure. Since arguments are always placed
+	directly in front of the callback consuming them it is sufficient to
+	check the tail of the token vector created so far. Jump tokens of
+	if-then-else clauses and short circuit operators are never values, so
+	folding can't reach across a branch.
+
+	Callbacks throwing an error are not folded. The error will be reported
+	during evaluation exactly as it would be without the optimizer.
+*/
+void RPN::FoldConstants()
+{
+	token_vec_type vOut;
+	vOut.reserve(m_vRPN.size());
+
+	for (std::size_t i = 0; i < m_vRPN.size(); ++i)
+	{
+		const ptr_tok_type& tok = m_vRPN[i];
+
+		ECmdCode eCode = tok->GetCode();
+		if ((eCode != cmFUNC &&
+			 eCode != cmOPRT_BIN &&
+			 eCode != cmOPRT_INFIX &&
+			 eCode != cmOPRT_POSTFIX &&
+			 eCode != cmCBC) ||
+			!tok->AsICallback()->IsPure())
+		{
+			vOut.push_back(tok);
+			continue;
+		}
+
+		ICallback* pFun = tok->AsICallback();
+		MUP_VERIFY(pFun != nullptr);
+
+		int nArgs = pFun->GetArgsPresent();
+		bool bConst = nArgs >= 0 && nArgs <= (int)vOut.size();
+		for (int j = 1; bConst && j <= nArgs; ++j)
+		{
+			const ptr_tok_type& arg = vOut[vOut.size() - j];
+			bConst = arg->GetCode() == cmVAL && !arg->IsFlagSet(IToken::flVOLATILE);
+		}
+
+		if (!bConst)
+		{
+			vOut.push_back(tok);
+			continue;
+		}
+
+		// Evaluate the callback the same way ParseFromRPN does. The first argument
+		// slot receives the result. Parameterless functions still need a slot.
+		val_vec_type vArg(std::max(nArgs, 1));
+		if (nArgs == 0)
+			vArg[0].Reset(new Value);
+
+		for (int j = 0; j < nArgs; ++j)
+			vArg[j].Reset(new Value(*vOut[vOut.size() - nArgs + j]->AsIValue()));
+
+		try
+		{
+			pFun->Eval(vArg[0], &vArg[0], nArgs);
+		}
+		catch (ParserError&)
+		{
+			vOut.push_back(tok);
+			continue;
+		}
+		catch (MatrixError&)
+		{
+			vOut.push_back(tok);
+			continue;
+		}
+
+		// Values are loaded with IValue::operator= which derives the type from the 
+		// number. Results whose type would change that way (e.g. an infinite real 
+		// number becoming an integer) are not folded so the optimizer can't change 
+		// the result type.
+		Value valLoad;
+		static_cast<IValue&>(valLoad) = *vArg[0];
+		if (valLoad.GetType() != vArg[0]->GetType())
+		{
+			vOut.push_back(tok);
+			continue;
+		}
+
+		vArg[0]->SetExprPos(pFun->GetExprPos());
+		vOut.resize(vOut.size() - nArgs);
+		vOut.push_back(ptr_tok_type(vArg[0].Get()));
+	}
+
+	m_vRPN.swap(vOut);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if the token is a value that can't change. */
+static bool IsConstValue(const ptr_tok_type& tok)
+{
+	return tok->GetCode() == cmVAL && !tok->IsFlagSet(IToken::flVOLATILE);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Find the first token of the operand ending at a given position.
+	\return The position of the first token or -1 if the operand contains
+	        tokens other than values and callbacks.
+*/
+static int FindOperandStart(const token_vec_type& vRPN, int nEnd)
+{
+	int nMissing = 1;
+	for (int i = nEnd; i >= 0; --i)
+	{
+		const IToken* pTok = vRPN[i].Get();
+		switch (pTok->GetCode())
+		{
+		case cmVAL:
+		case cmLOAD:
+			--nMissing;
+			break;
+
+		case cmFUNC:
+		case cmCBC:
+		case cmOPRT_BIN:
+		case cmOPRT_INFIX:
+		case cmOPRT_POSTFIX:
+			nMissing += const_cast<IToken*>(pTok)->AsICallback()->GetArgsPresent() - 1;
+			break;
+
+		case cmIC:
+			nMissing += const_cast<IToken*>(pTok)->AsICallback()->GetArgsPresent();
+			break;
+
+		case cmSTORE:
+			break;
+
+		default:
+			return -1;
+		}
+
+		if (nMissing == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Replace operators with a constant operand by cheaper forms.
+
+	The rewrite rules are implemented in OprtStrengthReduced: small integer
+	powers, division by a constant, x*1, x+0, x-0 and -(-x). Fast
+	paths are used for real scalars only, any other argument is evaluated
+	by the original operator.
+*/
+void RPN::ReduceStrength()
+{
+	token_vec_type vOut;
+	vOut.reserve(m_vRPN.size());
+
+	for (std::size_t i = 0; i < m_vRPN.size(); ++i)
+	{
+		const ptr_tok_type& tok = m_vRPN[i];
+		ICallback* pReduced = nullptr;
+
+		if (tok->GetCode() == cmOPRT_BIN && vOut.size() >= 2)
+		{
+			if (IsConstValue(vOut.back()))
+			{
+				pReduced = OprtStrengthReduced::Create(tok->AsICallback(), *vOut.back()->AsIValue(), false);
+				if (pReduced != nullptr)
+					vOut.pop_back();
+			}
+			else
+			{
+				int nStart = FindOperandStart(vOut, (int)vOut.size() - 1);
+				if (nStart > 0 && IsConstValue(vOut[nStart - 1]))
+				{
+					pReduced = OprtStrengthReduced::Create(tok->AsICallback(), *vOut[nStart - 1]->AsIValue(), true);
+					if (pReduced != nullptr)
+						vOut.erase(vOut.begin() + nStart - 1);
+				}
+			}
+		}
+		else if (tok->GetCode() == cmOPRT_INFIX && vOut.size() >= 2 && vOut.back()->GetCode() == cmOPRT_INFIX)
+		{
+			pReduced = OprtStrengthReduced::CreateDoubleNegation(vOut.back()->AsICallback(), tok->AsICallback());
+			if (pReduced != nullptr)
+				vOut.pop_back();
+		}
+
+		if (pReduced != nullptr)
+		{
+			pReduced->SetExprPos(tok->GetExprPos());
+			vOut.push_back(ptr_tok_type(pReduced));
+		}
+		else
+		{
+			vOut.push_back(tok);
+		}
+	}
+
+	m_vRPN.swap(vOut);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Check if two value tokens can be used interchangeably.
+
+	Variables are identical if they are bound to the same value object.
+	Constants must be of the same type and have the same value. Unlike
+	IValue::operator== this will distinguish between 0 and -0.
+*/
+static bool IsSameValue(const IValue* pVal1, const IValue* pVal2)
+{
+	if (pVal1->IsVariable() || pVal2->IsVariable())
+	{
+		return pVal1->IsVariable() && pVal2->IsVariable() &&
+			static_cast<const Variable*>(pVal1)->GetPtr() == static_cast<const Variable*>(pVal2)->GetPtr();
+	}
+
+	if (pVal1->GetType() != pVal2->GetType())
+		return false;
+
+	switch (pVal1->GetType())
+	{
+	case 'i':
+	case 'f':
+	case 'c':
+	{
+		const cmplx_type& v1 = pVal1->GetComplex();
+		const cmplx_type& v2 = pVal2->GetComplex();
+		return v1 == v2 &&
+			std::signbit(v1.real()) == std::signbit(v2.real()) &&
+			std::signbit(v1.imag()) == std::signbit(v2.imag());
+	}
+
+	case 'b': return pVal1->GetBool() == pVal2->GetBool();
+	case 's': return pVal1->GetString() == pVal2->GetString();
+	default:  return false;
+	}
+}
+
+//---------------------------------------------------------------------------
+/** \brief Compute repeated subexpressions only once.
+
+	Each subexpression is given a number by hashing the callback identifier
+	together with the numbers of its arguments. Subexpressions with the same
+	number are identical. The first occurrence of a repeated subexpression
+	is followed by a cmSTORE token saving its result in a temporary slot,
+	all following occurrences are replaced by a cmLOAD token.
+
+	Only subexpressions made of pure callbacks are considered. A callback
+	with side effects (i.e. an assignment) may change the value of any
+	variable, so subexpressions evaluated before it are never reused after
+	it. The first occurrence must be evaluated unconditionally, i.e. it may
+	not be part of an if-then-else branch or the right hand side of a short
+	circuit operator. Larger subexpressions are handled first so that
+	subexpressions inside of a replaced occurrence are not stored needlessly.
+*/
+void RPN::EliminateCommonSubexpressions()
+{
+	typedef std::pair<string_type, std::vector<int>> node_key_type;
+
+	struct Entry
+	{
+		int nNum;            ///< Number of the subexpression; -1 if it can't be reused
+		std::size_t nStart;  ///< Position of the first token of the subexpression
+	};
+
+	const std::size_t nSize = m_vRPN.size();
+	std::vector<int> vNum(nSize, -1);
+	std::vector<std::size_t> vStart(nSize, 0);
+	std::vector<bool> vCond(nSize, false);
+
+	std::vector<const IValue*> vLeaf;
+	std::map<node_key_type, int> mapNode;
+	std::vector<Entry> stArg;
+	int nDepth = 0, nNextNum = 0;
+
+	auto GetLeafNum = [&](const IValue* pVal)
+	{
+		for (std::size_t j = 0; j < vLeaf.size(); ++j)
+		{
+			if (vLeaf[j] != nullptr && IsSameValue(vLeaf[j], pVal))
+				return (int)j;
+		}
+
+		vLeaf.resize(nNextNum + 1, nullptr);
+		vLeaf[nNextNum] = pVal;
+		return nNextNum++;
+	};
+
+	for (std::size_t i = 0; i < nSize; ++i)
+	{
+		IToken* pTok = m_vRPN[i].Get();
+		ECmdCode eCode = pTok->GetCode();
+
+		switch (eCode)
+		{
+		case cmVAL:
+		{
+			Entry e = { GetLeafNum(pTok->AsIValue()), i };
+			stArg.push_back(e);
+		}
+		break;
+
+		case cmIC:
+		case cmCBC:
+		case cmFUNC:
+		case cmOPRT_BIN:
+		case cmOPRT_INFIX:
+		case cmOPRT_POSTFIX:
+		{
+			ICallback* pFun = pTok->AsICallback();
+			int nArgs = pFun->GetArgsPresent();
+
+			// The index operator consumes the indexed value in addition to its arguments
+			int nPop = (eCode == cmIC) ? nArgs + 1 : nArgs;
+			if (nPop < 0 || nPop > (int)stArg.size())
+				return;
+
+			node_key_type key(pFun->GetIdent(), std::vector<int>(1, eCode));
+			bool bReusable = pFun->IsPure() && eCode != cmIC;
+			Entry e = { -1, i };
+			for (std::size_t j = stArg.size() - nPop; j < stArg.size(); ++j)
+			{
+				bReusable &= stArg[j].nNum != -1;
+				key.second.push_back(stArg[j].nNum);
+			}
+
+			// Operators created by strength reduction have the identifier of the
+			// original operator. They are distinguished by their constant operand.
+			const OprtStrengthReduced* pReduced = dynamic_cast<const OprtStrengthReduced*>(pFun);
+			if (pReduced != nullptr)
+			{
+				key.second.push_back(pReduced->GetKind());
+				key.second.push_back((pReduced->GetConst() != nullptr) ? GetLeafNum(pReduced->GetConst()) : -1);
+			}
+
+			if (nPop > 0)
+				e.nStart = stArg[stArg.size() - nPop].nStart;
+
+			stArg.resize(stArg.size() - nPop);
+
+			if (!pFun->IsPure())
+			{
+				// Side effects invalidate all subexpressions seen so far
+				vLeaf.assign(vLeaf.size(), nullptr);
+				mapNode.clear();
+			}
+			else if (bReusable)
+			{
+				std::map<node_key_type, int>::const_iterator it = mapNode.find(key);
+				if (it != mapNode.end())
+				{
+					e.nNum = it->second;
+				}
+				else
+				{
+					e.nNum = nNextNum++;
+					mapNode[key] = e.nNum;
+				}
+
+				vNum[i] = e.nNum;
+				vStart[i] = e.nStart;
+				vCond[i] = nDepth > 0;
+			}
+
+			stArg.push_back(e);
+		}
+		break;
+
+		case cmIF:
+		case cmSHORTCUT_BEGIN:
+			if (stArg.empty())
+				return;
+
+			stArg.pop_back();
+			++nDepth;
+			break;
+
+		case cmELSE:
+			if (stArg.empty())
+				return;
+
+			stArg.pop_back();
+			break;
+
+		case cmENDIF:
+		case cmSHORTCUT_END:
+			if (stArg.empty())
+				return;
+
+			stArg.back().nNum = -1;
+			--nDepth;
+			break;
+
+		case cmSCRIPT_NEWLINE:
+			stArg.clear();
+			break;
+
+		default:
+			return;
+		}
+	}
+
+	// Collect the positions of all occurrences of each subexpression and
+	// sort the subexpressions by decreasing size.
+	std::map<int, std::vector<std::size_t>> mapOcc;
+	for (std::size_t i = 0; i < nSize; ++i)
+	{
+		if (vNum[i] != -1 && i > vStart[i])
+			mapOcc[vNum[i]].push_back(i);
+	}
+
+	std::vector<const std::vector<std::size_t>*> vOcc;
+	for (std::map<int, std::vector<std::size_t>>::const_iterator it = mapOcc.begin(); it != mapOcc.end(); ++it)
+	{
+		if (it->second.size() > 1)
+			vOcc.push_back(&it->second);
+	}
+
+	if (vOcc.empty())
+		return;
+
+	std::stable_sort(vOcc.begin(), vOcc.end(),
+		[&vStart](const std::vector<std::size_t>* p1, const std::vector<std::size_t>* p2)
+		{
+			return (*p1)[0] - vStart[(*p1)[0]] > (*p2)[0] - vStart[(*p2)[0]];
+		});
+
+	std::vector<bool> vReplaced(nSize, false);
+	std::vector<int> vStore(nSize, -1), vLoad(nSize, -1);
+	std::vector<std::size_t> vLoadEnd(nSize, 0);
+
+	for (std::size_t k = 0; k < vOcc.size(); ++k)
+	{
+		const std::vector<std::size_t>& occ = *vOcc[k];
+
+		// Find the first occurrence that is evaluated unconditionally and
+		// not part of a subexpression that was already replaced
+		std::size_t j = 0;
+		while (j < occ.size() && (vReplaced[occ[j]] || vCond[occ[j]]))
+			++j;
+
+		int nSlot = -1;
+		for (std::size_t l = j + 1; l < occ.size(); ++l)
+		{
+			std::size_t nEnd = occ[l];
+			if (vReplaced[nEnd])
+				continue;
+
+			if (nSlot == -1)
+			{
+				nSlot = m_nTempSlots++;
+				vStore[occ[j]] = nSlot;
+			}
+
+			vLoad[vStart[nEnd]] = nSlot;
+			vLoadEnd[vStart[nEnd]] = nEnd;
+			std::fill(vReplaced.begin() + vStart[nEnd], vReplaced.begin() + nEnd + 1, true);
+		}
+	}
+
+	token_vec_type vOut;
+	vOut.reserve(nSize + m_nTempSlots);
+	for (std::size_t i = 0; i < nSize; ++i)
+	{
+		if (vLoad[i] != -1)
+		{
+			ptr_tok_type tok(new TokenTemp(cmLOAD, vLoad[i]));
+			i = vLoadEnd[i];
+			tok->SetExprPos(m_vRPN[i]->GetExprPos());
+			vOut.push_back(tok);
+			continue;
+		}
+
+		vOut.push_back(m_vRPN[i]);
+		if (vStore[i] != -1)
+		{
+			ptr_tok_type tok(new TokenTemp(cmSTORE, vStore[i]));
+			tok->SetExprPos(m_vRPN[i]->GetExprPos());
+			vOut.push_back(tok);
+		}
+	}
+
+	m_vRPN.swap(vOut);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Replace short token sequences by superinstructions.
+
+	Two values followed by a built in binary operator, a variable followed 
+	by a function with a single argument and the product of two values added 
+	to a value are replaced by a single OprtFused token holding the values. 
+	The sequences contain nothing but values and the callbacks consuming 
+	them, so no jump can target a position inside of them. Volatile values 
+	are never fused since the evaluation context copies the constants of 
+	a fused token once.
+*/
+void RPN::FuseInstructions()
+{
+	token_vec_type vOut;
+	vOut.reserve(m_vRPN.size());
+
+	auto IsFusable = [](const ptr_tok_type& tok)
+	{
+		return tok->GetCode() == cmVAL && 
+			(tok->AsIValue()->IsVariable() || !tok->IsFlagSet(IToken::flVOLATILE));
+	};
+
+	for (std::size_t i = 0; i < m_vRPN.size(); ++i)
+	{
+		const ptr_tok_type& tok = m_vRPN[i];
+		ECmdCode eCode = tok->GetCode();
+		ICallback* pFused = nullptr;
+		std::size_t nPop = 0;
+
+		if (eCode == cmOPRT_BIN && vOut.size() >= 2)
+		{
+			// Two values or a fused binary operator and a value
+			token_vec_type vSeq;
+			for (std::size_t k = vOut.size() - 2; k < vOut.size(); ++k)
+			{
+				const ptr_tok_type& arg = vOut[k];
+				if (IsFusable(arg))
+				{
+					vSeq.push_back(arg);
+				}
+				else if (arg->GetCode() == cmFUSED && static_cast<OprtFused*>(arg.Get())->GetKind() == OprtFused::fsBINARY)
+				{
+					const token_vec_type& vTok = static_cast<OprtFused*>(arg.Get())->GetTokens();
+					vSeq.insert(vSeq.end(), vTok.begin(), vTok.end());
+				}
+				else
+				{
+					vSeq.clear();
+					break;
+				}
+			}
+
+			if (!vSeq.empty())
+			{
+				vSeq.push_back(tok);
+				pFused = OprtFused::Create(vSeq, m_bEnableFma);
+				nPop = 2;
+			}
+		}
+		else if ((eCode == cmFUNC || eCode == cmOPRT_INFIX || eCode == cmOPRT_POSTFIX) && !vOut.empty() && IsFusable(vOut.back()))
+		{
+			token_vec_type vSeq;
+			vSeq.push_back(vOut.back());
+			vSeq.push_back(tok);
+			pFused = OprtFused::Create(vSeq, m_bEnableFma);
+			nPop = 1;
+		}
+
+		if (pFused != nullptr)
+		{
+			pFused->SetExprPos(tok->GetExprPos());
+			vOut.resize(vOut.size() - nPop);
+			vOut.push_back(ptr_tok_type(pFused));
+		}
+		else
+		{
+			vOut.push_back(tok);
+		}
+	}
+
+	m_vRPN.swap(vOut);
+}
+
 //---------------------------------------------------------------------------
 void  RPN::EnableOptimizer(bool bStat)
 {
 	m_bEnableOptimizer = bStat;
 }
 
+//---------------------------------------------------------------------------
+bool RPN::IsOptimizerEnabled() const
+{
+	return m_bEnableOptimizer;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Allow the optimizer to compute x*y+z with a single rounding (see OprtFused). */
+void RPN::EnableFusedMultiplyAdd(bool bStat)
+{
+	m_bEnableFma = bStat;
+}
+
+//---------------------------------------------------------------------------
+bool RPN::IsFusedMultiplyAddEnabled() const
+{
+	return m_bEnableFma;
+}
+
 //---------------------------------------------------------------------------
 std::size_t RPN::GetSize() const
 {
@@ -180,6 +815,13 @@ int RPN::GetRequiredStackSize() const
 	return m_nMaxStackPos + 1;
 }
 
+//---------------------------------------------------------------------------
+/** \brief Returns the number of temporary slots used by cmSTORE and cmLOAD tokens. */
+int RPN::GetNumTempSlots() const
+{
+	return m_nTempSlots;
+}
+
 //---------------------------------------------------------------------------
 void RPN::AsciiDump() const
 {
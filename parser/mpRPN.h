@@ -44,6 +44,8 @@ MUP_NAMESPACE_START
   */
   class RPN
   {
+  friend class RPNArchive;
+
   public:
     
     RPN();
@@ -55,20 +57,32 @@ MUP_NAMESPACE_START
     void Reset();
     void Finalize();
     void AsciiDump() const;
+    RPN Clone() const;
 
     const token_vec_type& GetData() const;
     std::size_t GetSize() const;
 
     int GetRequiredStackSize() const;
+    int GetNumTempSlots() const;
     void EnableOptimizer(bool bStat);
+    bool IsOptimizerEnabled() const;
+    void EnableFusedMultiplyAdd(bool bStat);
+    bool IsFusedMultiplyAddEnabled() const;
 
   private:
 
+    void FoldConstants();
+    void ReduceStrength();
+    void EliminateCommonSubexpressions();
+    void FuseInstructions();
+
     token_vec_type m_vRPN;
     int m_nStackPos;
     int m_nLine;
     int m_nMaxStackPos;
+    int m_nTempSlots;
     bool m_bEnableOptimizer;
+    bool m_bEnableFma;
   };
 
 MUP_NAMESPACE_END
@@ -0,0 +1,817 @@
+/** \file
+    \brief Implementation of a binary format for compiled expressions.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpRPNArchive.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mpParserBase.h"
+#include "mpIfThenElse.h"
+#include "mpScriptTokens.h"
+#include "mpTempTokens.h"
+#include "mpOprtIndex.h"
+#include "mpOprtMatrix.h"
+#include "mpOprtBinShortcut.h"
+#include "mpOprtStrengthReduced.h"
+#include "mpOprtFused.h"
+
+
+MUP_NAMESPACE_START
+
+namespace
+{
+	const char c_szMagic[8] = { 'M', 'U', 'P', 'X', 'R', 'P', 'N', 0 };
+	const std::uint32_t c_nVersion = 1;
+	const std::uint32_t c_nByteOrder = 0x01020304;
+
+	/** \brief The header at the start of an archive. */
+	struct SFileHeader
+	{
+		char m_szMagic[8];
+		std::uint32_t m_nVersion;
+		std::uint32_t m_nByteOrder;     ///< c_nByteOrder in the byte order of the writer
+		std::uint32_t m_nCharSize;      ///< sizeof(char_type) of the writer
+		std::uint32_t m_nFloatSize;     ///< sizeof(float_type) of the writer
+		std::uint32_t m_nExpr;          ///< Number of expressions
+		std::uint32_t m_nReserved;
+		std::uint64_t m_nDirOffset;     ///< Offset of the table with the offsets of the expression records
+		std::uint64_t m_nSize;          ///< Size of the archive in bytes
+	};
+
+	/** \brief The header of an expression record. 
+	
+		It is followed by the tokens, the constants and the string table. The 
+		string table starts with the expression.
+	*/
+	struct SExprHeader
+	{
+		std::uint32_t m_nTokens;        ///< Number of tokens including the tokens of fused tokens
+		std::uint32_t m_nConst;         ///< Number of constants including matrix elements
+		std::uint32_t m_nChars;         ///< Size of the string table in characters
+		std::uint32_t m_nExprLen;       ///< Length of the expression
+		std::int32_t m_nPos;            ///< Position of the token reader after parsing
+		std::int32_t m_nStackSize;      ///< Required stack size of the RPN
+		std::int32_t m_nTempSlots;      ///< Temporary slots of the RPN
+		std::int32_t m_nReserved[3];
+	};
+
+	/** \brief Kinds of tokens, they define the meaning of STokenRec::m_nArg. */
+	enum ETokenKind
+	{
+		tkCONST,            ///< Constant; index of the constant
+		tkVAR,              ///< Variable of the parser
+		tkFUNC,             ///< Function of the parser; number of arguments
+		tkOPRT_BIN,         ///< Binary operator of the parser; number of arguments
+		tkOPRT_INFIX,       ///< Infix operator of the parser; number of arguments
+		tkOPRT_POSTFIX,     ///< Postfix operator of the parser; number of arguments
+		tkINDEX,            ///< Index operator; number of arguments
+		tkARRAY,            ///< Creation of an array; number of arguments
+		tkSHORTCUT_BEGIN,   ///< Short circuit operator of the parser; jump offset
+		tkSHORTCUT_END,     ///< End of a short circuit operator; jump offset, 1 for the logical or
+		tkIF_ELSE,          ///< If then else tokens; jump offset
+		tkNEWLINE,          ///< Newline; stack offset
+		tkTEMP,             ///< cmSTORE or cmLOAD; temporary slot
+		tkREDUCED,          ///< Binary operator in reduced form; index of the constant, 1 if the constant is left
+		tkREDUCED_SIGN,     ///< Double negation by an infix operator of the parser
+		tkFUSED             ///< Fused tokens; number of tokens following, 1 if FMA is enabled
+	};
+
+	/** \brief A token of an expression record. */
+	struct STokenRec
+	{
+		std::int32_t m_nKind;           ///< ETokenKind
+		std::int32_t m_nCode;           ///< ECmdCode
+		std::int32_t m_nPos;            ///< Position in the expression
+		std::int32_t m_nFlags;          ///< IToken flags
+		std::int32_t m_nArg[2];         ///< Depends on the kind
+		std::uint32_t m_nName;          ///< Offset of the identifier in the string table
+		std::uint32_t m_nNameLen;
+	};
+
+	/** \brief A constant of an expression record. 
+
+		Matrices are followed by their elements in row major order.
+	*/
+	struct SConstRec
+	{
+		std::int32_t m_nType;           ///< Type of the value
+		std::int32_t m_nArg[2];         ///< Offset and length of strings, rows and columns of matrices
+		std::int32_t m_nReserved;
+		float_type m_fVal[2];           ///< Real and imaginary part of scalars
+	};
+
+	//---------------------------------------------------------------------------
+	void InvalidArchive()
+	{
+		throw ParserError(ErrorContext(ecINVALID_ARCHIVE));
+	}
+
+	//---------------------------------------------------------------------------
+	/** \brief Check the jump offsets, newline offsets and stack size read from an archive.
+		\param vRPN The tokens of the expression.
+		\param nStackSize The stack size stored in the archive.
+
+		The offsets must be the ones RPN::Finalize computes, i.e. each if, else
+		and short circuit operator jumps to its matching token. The stack size
+		must not be less than the depth the tokens reach while the expression 
+		is evaluated.
+	*/
+	void CheckTokens(const token_vec_type &vRPN, int nStackSize)
+	{
+		std::vector<int> stIf, stElse, stScBeg;
+		std::vector<int> stDepth;   // Stack depth after the condition of pending if-else clauses
+		int nDepth = 0, nMaxDepth = 0;
+		for (int i = 0; i < (int)vRPN.size(); ++i)
+		{
+			IToken *pTok = vRPN[i].Get();
+			switch (pTok->GetCode())
+			{
+			case cmVAL:
+			case cmLOAD:
+				++nDepth;
+				break;
+
+			case cmFUSED:
+				// The original tokens are evaluated on the stack
+				nMaxDepth = std::max(nMaxDepth, nDepth + static_cast<OprtFused*>(pTok)->GetStackSize());
+				++nDepth;
+				break;
+
+			case cmIC:
+			case cmFUNC:
+			case cmOPRT_BIN:
+			case cmOPRT_INFIX:
+			case cmOPRT_POSTFIX:
+			case cmCBC:
+			{
+				// The index operator replaces the indexed value and its indices
+				int nArgs = pTok->AsICallback()->GetArgsPresent();
+				if (nArgs < 0)
+					InvalidArchive();
+
+				nDepth -= (pTok->GetCode() == cmIC) ? nArgs : nArgs - 1;
+			}
+			break;
+
+			case cmIF:
+				stIf.push_back(i);
+				stDepth.push_back(--nDepth);
+				break;
+
+			case cmELSE:
+				if (stIf.empty() || static_cast<TokenIfThenElse*>(vRPN[stIf.back()].Get())->GetOffset() != i - stIf.back())
+					InvalidArchive();
+
+				// The else branch starts with the stack of the condition
+				stIf.pop_back();
+				stElse.push_back(i);
+				nDepth = stDepth.back();
+				stDepth.pop_back();
+				break;
+
+			case cmENDIF:
+				if (stElse.empty() || static_cast<TokenIfThenElse*>(vRPN[stElse.back()].Get())->GetOffset() != i - stElse.back())
+					InvalidArchive();
+
+				stElse.pop_back();
+				break;
+
+			case cmSHORTCUT_BEGIN:
+				stScBeg.push_back(i);
+				--nDepth;
+				break;
+
+			case cmSHORTCUT_END:
+				if (stScBeg.empty() || static_cast<IOprtBinShortcut*>(vRPN[stScBeg.back()].Get())->GetOffset() != i - stScBeg.back())
+					InvalidArchive();
+
+				stScBeg.pop_back();
+				break;
+
+			case cmSCRIPT_NEWLINE:
+			{
+				int nOfs = static_cast<TokenNewline*>(pTok)->GetStackOffset();
+				if (nOfs < 0 || nOfs > nDepth)
+					InvalidArchive();
+
+				nDepth = 0;
+			}
+			break;
+
+			default:
+				break;
+			}
+
+			if (nDepth < 0)
+				InvalidArchive();
+
+			nMaxDepth = std::max(nMaxDepth, nDepth);
+		}
+
+		if (!stIf.empty() || !stElse.empty() || !stScBeg.empty() || nStackSize < nMaxDepth)
+			InvalidArchive();
+	}
+
+	//---------------------------------------------------------------------------
+	template<typename T>
+	void Append(std::vector<char> &vData, const T *pData, std::size_t nCount)
+	{
+		const char *p = reinterpret_cast<const char*>(pData);
+		vData.insert(vData.end(), p, p + nCount * sizeof(T));
+	}
+
+	//---------------------------------------------------------------------------
+	/** \brief Creates the tokens, constants and strings of an expression record. */
+	class RecordWriter
+	{
+	public:
+
+		std::uint32_t AddString(const string_type &s)
+		{
+			std::uint32_t nOfs = (std::uint32_t)m_vChars.size();
+			m_vChars.insert(m_vChars.end(), s.begin(), s.end());
+			return nOfs;
+		}
+
+		int AddConst(const IValue &val)
+		{
+			int nIdx = (int)m_vConst.size();
+			SConstRec rec = {};
+			rec.m_nType = val.GetType();
+			switch (val.GetType())
+			{
+			case 's':
+				rec.m_nArg[0] = (std::int32_t)AddString(val.GetString());
+				rec.m_nArg[1] = (std::int32_t)val.GetString().length();
+				m_vConst.push_back(rec);
+				break;
+
+			case 'm':
+			{
+				const matrix_type &m = val.GetArray();
+				rec.m_nArg[0] = m.GetRows();
+				rec.m_nArg[1] = m.GetCols();
+				m_vConst.push_back(rec);
+				for (int i = 0; i < m.GetRows(); ++i)
+				{
+					for (int j = 0; j < m.GetCols(); ++j)
+						AddConst(m.At(i, j));
+				}
+			}
+			break;
+
+			case 'c':
+				rec.m_fVal[1] = val.GetImag();
+				// fall through
+
+			default:
+				rec.m_fVal[0] = val.GetFloat();
+				m_vConst.push_back(rec);
+			}
+
+			return nIdx;
+		}
+
+		void AddToken(const ptr_tok_type &tok)
+		{
+			STokenRec rec = {};
+			rec.m_nCode = tok->GetCode();
+			rec.m_nPos = tok->GetExprPos();
+			rec.m_nFlags = tok->IsFlagSet(IToken::flVOLATILE) ? IToken::flVOLATILE : IToken::flNONE;
+			rec.m_nName = AddString(tok->GetIdent());
+			rec.m_nNameLen = (std::uint32_t)tok->GetIdent().length();
+
+			const OprtStrengthReduced *pReduced = dynamic_cast<const OprtStrengthReduced*>(tok.Get());
+			if (pReduced != nullptr)
+			{
+				bool bSign = pReduced->GetKind() == OprtStrengthReduced::rdNEG_NEG;
+				rec.m_nKind = (bSign) ? tkREDUCED_SIGN : tkREDUCED;
+				rec.m_nName = AddString(pReduced->GetOperator()->GetIdent());
+				rec.m_nNameLen = (std::uint32_t)pReduced->GetOperator()->GetIdent().length();
+				rec.m_nArg[0] = (bSign) ? -1 : AddConst(*pReduced->GetConst());
+				rec.m_nArg[1] = pReduced->IsConstLeft();
+				m_vTok.push_back(rec);
+				return;
+			}
+
+			switch (tok->GetCode())
+			{
+			case cmVAL:
+				if (tok->AsIValue()->IsVariable())
+				{
+					rec.m_nKind = tkVAR;
+				}
+				else
+				{
+					rec.m_nKind = tkCONST;
+					rec.m_nArg[0] = AddConst(*tok->AsIValue());
+				}
+				break;
+
+			case cmFUNC:          rec.m_nKind = tkFUNC;         break;
+			case cmOPRT_BIN:      rec.m_nKind = tkOPRT_BIN;     break;
+			case cmOPRT_INFIX:    rec.m_nKind = tkOPRT_INFIX;   break;
+			case cmOPRT_POSTFIX:  rec.m_nKind = tkOPRT_POSTFIX; break;
+			case cmIC:            rec.m_nKind = tkINDEX;        break;
+			case cmCBC:           rec.m_nKind = tkARRAY;        break;
+
+			case cmSHORTCUT_BEGIN:
+			case cmSHORTCUT_END:
+			{
+				const IOprtBinShortcut *pShortcut = static_cast<const IOprtBinShortcut*>(tok.Get());
+				rec.m_nKind = (tok->GetCode() == cmSHORTCUT_BEGIN) ? tkSHORTCUT_BEGIN : tkSHORTCUT_END;
+				rec.m_nArg[0] = pShortcut->GetOffset();
+				rec.m_nArg[1] = pShortcut->GetPri() == prLOGIC_OR;
+			}
+			break;
+
+			case cmIF:
+			case cmELSE:
+			case cmENDIF:
+				rec.m_nKind = tkIF_ELSE;
+				rec.m_nArg[0] = static_cast<const TokenIfThenElse*>(tok.Get())->GetOffset();
+				break;
+
+			case cmSCRIPT_NEWLINE:
+				rec.m_nKind = tkNEWLINE;
+				rec.m_nArg[0] = static_cast<const TokenNewline*>(tok.Get())->GetStackOffset();
+				break;
+
+			case cmSTORE:
+			case cmLOAD:
+				rec.m_nKind = tkTEMP;
+				rec.m_nArg[0] = static_cast<const TokenTemp*>(tok.Get())->GetSlot();
+				break;
+
+			case cmFUSED:
+			{
+				const OprtFused *pFused = static_cast<const OprtFused*>(tok.Get());
+				rec.m_nKind = tkFUSED;
+				rec.m_nArg[0] = (std::int32_t)pFused->GetTokens().size();
+				rec.m_nArg[1] = pFused->IsFmaEnabled();
+				m_vTok.push_back(rec);
+				for (const ptr_tok_type &tokFused : pFused->GetTokens())
+					AddToken(tokFused);
+			}
+			return;
+
+			default:
+				throw ParserError(ErrorContext(ecINTERNAL_ERROR, tok->GetExprPos(), tok->GetIdent()));
+			}
+
+			if (rec.m_nKind >= tkFUNC && rec.m_nKind <= tkARRAY)
+				rec.m_nArg[0] = tok->AsICallback()->GetArgsPresent();
+
+			m_vTok.push_back(rec);
+		}
+
+		std::vector<STokenRec> m_vTok;
+		std::vector<SConstRec> m_vConst;
+		std::vector<char_type> m_vChars;
+	};
+
+	//---------------------------------------------------------------------------
+	/** \brief Create a token by cloning a definition of the parser.
+		\throw ParserError if the parser does not define the identifier.
+	*/
+	template<typename TMap>
+	ptr_tok_type CloneDef(const TMap &map, const string_type &sIdent, int nPos, const string_type &sExpr)
+	{
+		auto it = map.find(sIdent);
+		if (it == map.end())
+		{
+			ErrorContext err(ecUNASSIGNABLE_TOKEN, nPos, sIdent);
+			err.Expr = sExpr;
+			throw ParserError(err);
+		}
+
+		return ptr_tok_type(it->second->Clone());
+	}
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+//
+// class RPNArchiveWriter
+//
+//---------------------------------------------------------------------------
+
+RPNArchiveWriter::RPNArchiveWriter()
+	:m_vData(sizeof(SFileHeader))
+	,m_vOffset()
+{}
+
+//---------------------------------------------------------------------------
+/** \brief Add an expression to the archive.
+	\return The index of the expression in the archive.
+*/
+std::size_t RPNArchiveWriter::Add(const CompiledExpression &a_Expr)
+{
+	const RPN &rpn = a_Expr.GetRPN();
+
+	RecordWriter rec;
+	rec.AddString(a_Expr.GetExpr());
+	for (const ptr_tok_type &tok : rpn.GetData())
+		rec.AddToken(tok);
+
+	SExprHeader hdr = {};
+	hdr.m_nTokens = (std::uint32_t)rec.m_vTok.size();
+	hdr.m_nConst = (std::uint32_t)rec.m_vConst.size();
+	hdr.m_nChars = (std::uint32_t)rec.m_vChars.size();
+	hdr.m_nExprLen = (std::uint32_t)a_Expr.GetExpr().length();
+	hdr.m_nPos = a_Expr.m_pData->m_nPos;
+	hdr.m_nStackSize = rpn.GetRequiredStackSize();
+	hdr.m_nTempSlots = rpn.GetNumTempSlots();
+
+	m_vOffset.push_back(m_vData.size());
+	Append(m_vData, &hdr, 1);
+	Append(m_vData, rec.m_vTok.data(), rec.m_vTok.size());
+	Append(m_vData, rec.m_vConst.data(), rec.m_vConst.size());
+	Append(m_vData, rec.m_vChars.data(), rec.m_vChars.size());
+	m_vData.resize((m_vData.size() + 7) & ~(std::size_t)7);
+
+	return m_vOffset.size() - 1;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of expressions in the archive. */
+std::size_t RPNArchiveWriter::GetSize() const
+{
+	return m_vOffset.size();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the archive, i.e. for writing it to a file. */
+std::vector<char> RPNArchiveWriter::GetData() const
+{
+	std::vector<char> vData(m_vData);
+
+	SFileHeader hdr = {};
+	std::memcpy(hdr.m_szMagic, c_szMagic, sizeof(c_szMagic));
+	hdr.m_nVersion = c_nVersion;
+	hdr.m_nByteOrder = c_nByteOrder;
+	hdr.m_nCharSize = sizeof(char_type);
+	hdr.m_nFloatSize = sizeof(float_type);
+	hdr.m_nExpr = (std::uint32_t)m_vOffset.size();
+	hdr.m_nDirOffset = vData.size();
+	Append(vData, m_vOffset.data(), m_vOffset.size());
+	hdr.m_nSize = vData.size();
+	std::memcpy(vData.data(), &hdr, sizeof(hdr));
+
+	return vData;
+}
+
+//---------------------------------------------------------------------------
+//
+// class RPNArchive
+//
+//---------------------------------------------------------------------------
+
+/** \brief Pointers to the parts of an expression record. */
+struct RPNArchive::SRecord
+{
+	const SExprHeader *m_pHeader;
+	const STokenRec *m_pTok;
+	const SConstRec *m_pConst;
+	const char_type *m_pChars;
+
+	string_type GetString(std::uint32_t nOfs, std::uint32_t nLen) const
+	{
+		if (nOfs > m_pHeader->m_nChars || nLen > m_pHeader->m_nChars - nOfs)
+			InvalidArchive();
+
+		return string_type(m_pChars + nOfs, nLen);
+	}
+
+	ptr_val_type CreateValue(std::size_t &nIdx) const
+	{
+		if (nIdx >= m_pHeader->m_nConst)
+			InvalidArchive();
+
+		const SConstRec &rec = m_pConst[nIdx++];
+		float_type v = rec.m_fVal[0];
+		switch (rec.m_nType)
+		{
+		case 's':
+			return ptr_val_type(new Value(GetString((std::uint32_t)rec.m_nArg[0], (std::uint32_t)rec.m_nArg[1])));
+
+		case 'b':
+			return ptr_val_type(new Value(v != 0));
+
+		case 'c':
+			return ptr_val_type(new Value(cmplx_type(v, rec.m_fVal[1])));
+
+		case 'i':
+		case 'f':
+		{
+			// Find out which constructor recreates the type of the constant
+			ptr_val_type val(new Value(v));
+			if (val->GetType() != rec.m_nType)
+				val.Reset(new Value(cmplx_type(v, 0)));
+
+			return val;
+		}
+
+		case 'm':
+		{
+			if (rec.m_nArg[0] < 0 || rec.m_nArg[1] < 0 || (std::uint64_t)rec.m_nArg[0] * rec.m_nArg[1] > m_pHeader->m_nConst)
+				InvalidArchive();
+
+			matrix_type m(rec.m_nArg[0], rec.m_nArg[1], Value((float_type)0));
+			for (int i = 0; i < rec.m_nArg[0]; ++i)
+			{
+				for (int j = 0; j < rec.m_nArg[1]; ++j)
+					m.At(i, j) = Value(*CreateValue(nIdx));
+			}
+
+			return ptr_val_type(new Value(m));
+		}
+
+		default:
+			return ptr_val_type(new Value((char_type)rec.m_nType));
+		}
+	}
+};
+
+//---------------------------------------------------------------------------
+/** \brief Create a view of an archive.
+	\param a_pData The archive, aligned to 8 bytes.
+	\param a_nSize The size of the archive in bytes.
+	\throw ParserError if the data is not an archive or if it was created by
+		   a different version or on a machine with a different byte order.
+*/
+RPNArchive::RPNArchive(const void *a_pData, std::size_t a_nSize)
+	:m_pData(static_cast<const char*>(a_pData))
+	,m_nSize(a_nSize)
+	,m_nExpr(0)
+	,m_pOffset(nullptr)
+{
+	if (m_pData == nullptr || reinterpret_cast<std::uintptr_t>(m_pData) % 8 != 0 || m_nSize < sizeof(SFileHeader))
+		InvalidArchive();
+
+	const SFileHeader *pHeader = reinterpret_cast<const SFileHeader*>(m_pData);
+	if (std::memcmp(pHeader->m_szMagic, c_szMagic, sizeof(c_szMagic)) != 0 ||
+		pHeader->m_nVersion != c_nVersion ||
+		pHeader->m_nByteOrder != c_nByteOrder ||
+		pHeader->m_nCharSize != sizeof(char_type) ||
+		pHeader->m_nFloatSize != sizeof(float_type) ||
+		pHeader->m_nSize > m_nSize ||
+		pHeader->m_nDirOffset % 8 != 0 ||
+		pHeader->m_nDirOffset > pHeader->m_nSize ||
+		(pHeader->m_nSize - pHeader->m_nDirOffset) / sizeof(std::uint64_t) < pHeader->m_nExpr)
+	{
+		InvalidArchive();
+	}
+
+	m_nSize = (std::size_t)pHeader->m_nSize;
+	m_nExpr = pHeader->m_nExpr;
+	m_pOffset = reinterpret_cast<const std::uint64_t*>(m_pData + pHeader->m_nDirOffset);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of expressions in the archive. */
+std::size_t RPNArchive::GetSize() const
+{
+	return m_nExpr;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the expression string of an expression in the archive. */
+string_type RPNArchive::GetExpr(std::size_t a_nIdx) const
+{
+	SRecord rec = GetRecord(a_nIdx);
+	return rec.GetString(0, rec.m_pHeader->m_nExprLen);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Load an expression without parsing it.
+	\param a_nIdx The index of the expression in the archive.
+	\param a_Parser The parser defining the variables, functions and operators.
+	\throw ParserError if the parser does not define a name used by the 
+		   expression or if the archive is damaged.
+
+	Like the expressions compiled by the parser, the expression is evaluated
+	by the bytecode engine if it computes a real number and if the engine is
+	enabled in the parser.
+*/
+CompiledExpression RPNArchive::Load(std::size_t a_nIdx, const ParserXBase &a_Parser) const
+{
+	SRecord rec = GetRecord(a_nIdx);
+
+	std::shared_ptr<CompiledExpression::SData> pData = std::make_shared<CompiledExpression::SData>();
+	pData->m_sExpr = rec.GetString(0, rec.m_pHeader->m_nExprLen);
+	pData->m_nPos = rec.m_pHeader->m_nPos;
+
+	RPN &rpn = pData->m_rpn;
+	std::size_t nIdx = 0;
+	while (nIdx < rec.m_pHeader->m_nTokens)
+		rpn.m_vRPN.push_back(CreateToken(rec, nIdx, pData->m_sExpr, a_Parser));
+
+	if (rec.m_pHeader->m_nStackSize < 1 || rec.m_pHeader->m_nTempSlots < 0)
+		InvalidArchive();
+
+	CheckTokens(rpn.m_vRPN, rec.m_pHeader->m_nStackSize);
+
+	rpn.m_nMaxStackPos = rec.m_pHeader->m_nStackSize - 1;
+	rpn.m_nTempSlots = rec.m_pHeader->m_nTempSlots;
+
+	pData->m_bRealEngine = false;
+	if (a_Parser.m_bEnableRealEngine)
+	{
+		pData->m_realEngine.EnableSimdMath(a_Parser.m_realEngine.IsSimdMathEnabled());
+		pData->m_bRealEngine = pData->m_realEngine.Compile(rpn);
+	}
+
+	return CompiledExpression(pData);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the parts of an expression record after checking its size. */
+RPNArchive::SRecord RPNArchive::GetRecord(std::size_t a_nIdx) const
+{
+	if (a_nIdx >= m_nExpr)
+		InvalidArchive();
+
+	std::uint64_t nOfs = m_pOffset[a_nIdx];
+	if (nOfs % 8 != 0 || nOfs > m_nSize || m_nSize - nOfs < sizeof(SExprHeader))
+		InvalidArchive();
+
+	const SExprHeader *pHeader = reinterpret_cast<const SExprHeader*>(m_pData + nOfs);
+	std::uint64_t nSize = sizeof(SExprHeader) 
+		+ (std::uint64_t)pHeader->m_nTokens * sizeof(STokenRec)
+		+ (std::uint64_t)pHeader->m_nConst * sizeof(SConstRec)
+		+ (std::uint64_t)pHeader->m_nChars * sizeof(char_type);
+	if (m_nSize - nOfs < nSize || pHeader->m_nExprLen > pHeader->m_nChars)
+		InvalidArchive();
+
+	SRecord rec;
+	rec.m_pHeader = pHeader;
+	rec.m_pTok = reinterpret_cast<const STokenRec*>(pHeader + 1);
+	rec.m_pConst = reinterpret_cast<const SConstRec*>(rec.m_pTok + pHeader->m_nTokens);
+	rec.m_pChars = reinterpret_cast<const char_type*>(rec.m_pConst + pHeader->m_nConst);
+	return rec;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the token at a position of an expression record.
+	\param rec The expression record.
+	\param nIdx The index of the token, incremented by the number of tokens read.
+	\param sExpr The expression, used for error messages.
+	\param a_Parser The parser defining the names.
+*/
+ptr_tok_type RPNArchive::CreateToken(const SRecord &rec, std::size_t &nIdx, const string_type &sExpr, const ParserXBase &a_Parser) const
+{
+	if (nIdx >= rec.m_pHeader->m_nTokens)
+		InvalidArchive();
+
+	const STokenRec &tokRec = rec.m_pTok[nIdx++];
+	const string_type sIdent = rec.GetString(tokRec.m_nName, tokRec.m_nNameLen);
+	const int nPos = tokRec.m_nPos;
+
+	ptr_tok_type tok;
+	switch (tokRec.m_nKind)
+	{
+	case tkCONST:
+	{
+		std::size_t nConst = (std::size_t)(std::uint32_t)tokRec.m_nArg[0];
+		tok = ptr_tok_type(rec.CreateValue(nConst).Get());
+	}
+	break;
+
+	case tkVAR:           tok = CloneDef(a_Parser.m_varDef, sIdent, nPos, sExpr);        break;
+	case tkFUNC:          tok = CloneDef(a_Parser.m_FunDef, sIdent, nPos, sExpr);        break;
+	case tkOPRT_BIN:      tok = CloneDef(a_Parser.m_OprtDef, sIdent, nPos, sExpr);       break;
+	case tkOPRT_INFIX:    tok = CloneDef(a_Parser.m_InfixOprtDef, sIdent, nPos, sExpr);  break;
+	case tkOPRT_POSTFIX:  tok = CloneDef(a_Parser.m_PostOprtDef, sIdent, nPos, sExpr);   break;
+	case tkINDEX:         tok = ptr_tok_type(new OprtIndex());                           break;
+	case tkARRAY:         tok = ptr_tok_type(new OprtCreateArray());                     break;
+
+	case tkSHORTCUT_BEGIN:
+	case tkSHORTCUT_END:
+	{
+		if (tokRec.m_nKind == tkSHORTCUT_BEGIN)
+			tok = CloneDef(a_Parser.m_OprtShortcutDef, sIdent, nPos, sExpr);
+		else if (tokRec.m_nArg[1] != 0)
+			tok = ptr_tok_type(new OprtShortcutLogicOrEnd());
+		else
+			tok = ptr_tok_type(new OprtShortcutLogicAndEnd());
+
+		static_cast<IOprtBinShortcut*>(tok.Get())->SetOffset(tokRec.m_nArg[0]);
+	}
+	break;
+
+	case tkIF_ELSE:
+		if (tokRec.m_nCode != cmIF && tokRec.m_nCode != cmELSE && tokRec.m_nCode != cmENDIF)
+			InvalidArchive();
+
+		tok = ptr_tok_type(new TokenIfThenElse((ECmdCode)tokRec.m_nCode));
+		static_cast<TokenIfThenElse*>(tok.Get())->SetOffset(tokRec.m_nArg[0]);
+		break;
+
+	case tkNEWLINE:
+		tok = ptr_tok_type(new TokenNewline());
+		static_cast<TokenNewline*>(tok.Get())->SetStackOffset(tokRec.m_nArg[0]);
+		break;
+
+	case tkTEMP:
+		if ((tokRec.m_nCode != cmSTORE && tokRec.m_nCode != cmLOAD) || tokRec.m_nArg[0] < 0 || tokRec.m_nArg[0] >= rec.m_pHeader->m_nTempSlots)
+			InvalidArchive();
+
+		tok = ptr_tok_type(new TokenTemp((ECmdCode)tokRec.m_nCode, tokRec.m_nArg[0]));
+		break;
+
+	case tkREDUCED:
+	case tkREDUCED_SIGN:
+	{
+		bool bSign = tokRec.m_nKind == tkREDUCED_SIGN;
+		ptr_tok_type oprt = (bSign) 
+			? CloneDef(a_Parser.m_InfixOprtDef, sIdent, nPos, sExpr) 
+			: CloneDef(a_Parser.m_OprtDef, sIdent, nPos, sExpr);
+		ICallback *pOprt = oprt->AsICallback();
+		pOprt->SetNumArgsPresent((bSign) ? 1 : 2);
+
+		ICallback *pReduced = nullptr;
+		if (bSign)
+		{
+			pReduced = OprtStrengthReduced::CreateDoubleNegation(pOprt, pOprt);
+		}
+		else
+		{
+			std::size_t nConst = (std::size_t)(std::uint32_t)tokRec.m_nArg[0];
+			ptr_val_type val = rec.CreateValue(nConst);
+			pReduced = OprtStrengthReduced::Create(pOprt, *val, tokRec.m_nArg[1] != 0);
+		}
+
+		// The parser defines a different operator
+		if (pReduced == nullptr)
+			throw ParserError(ErrorContext(ecUNASSIGNABLE_TOKEN, nPos, sIdent));
+
+		tok = ptr_tok_type(pReduced);
+	}
+	break;
+
+	case tkFUSED:
+	{
+		if (tokRec.m_nArg[0] < 0)
+			InvalidArchive();
+
+		token_vec_type vTok;
+		for (int i = 0; i < tokRec.m_nArg[0]; ++i)
+			vTok.push_back(CreateToken(rec, nIdx, sExpr, a_Parser));
+
+		ICallback *pFused = OprtFused::Create(vTok, tokRec.m_nArg[1] != 0);
+		if (pFused == nullptr)
+			throw ParserError(ErrorContext(ecUNASSIGNABLE_TOKEN, nPos, sIdent));
+
+		tok = ptr_tok_type(pFused);
+	}
+	break;
+
+	default:
+		InvalidArchive();
+	}
+
+	if (tokRec.m_nKind >= tkFUNC && tokRec.m_nKind <= tkARRAY)
+		tok->AsICallback()->SetNumArgsPresent(tokRec.m_nArg[0]);
+
+	if (tokRec.m_nFlags & IToken::flVOLATILE)
+		tok->AddFlags(IToken::flVOLATILE);
+
+	tok->SetIdent(sIdent);
+	tok->SetExprPos(nPos);
+	return tok;
+}
+
+MUP_NAMESPACE_END
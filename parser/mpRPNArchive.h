@@ -0,0 +1,111 @@
+#ifndef MUP_RPN_ARCHIVE_H
+#define MUP_RPN_ARCHIVE_H
+
+/** \file
+    \brief Definition of a binary format for compiled expressions.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <cstdint>
+#include <vector>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+#include "mpCompiledExpression.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief Creates an archive of compiled expressions.
+
+    The archive stores the RPN of each expression after the optimizer was
+    applied: the tokens with their jump offsets, the constants, the names 
+    of variables, functions and operators and the required stack size. It
+    does not store the bytecode or the machine code. The data is written in
+    the byte order of the writing machine and can be read by RPNArchive.
+  */
+  class RPNArchiveWriter
+  {
+  public:
+
+    RPNArchiveWriter();
+
+    std::size_t Add(const CompiledExpression &a_Expr);
+    std::size_t GetSize() const;
+    std::vector<char> GetData() const;
+
+  private:
+
+    std::vector<char> m_vData;            ///< Header and expression records
+    std::vector<std::uint64_t> m_vOffset; ///< Offsets of the expression records
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Read only view of an archive created by RPNArchiveWriter.
+
+    The archive is read in place, the memory is not copied. It may be a
+    file mapped into memory by mmap and must stay valid as long as the view
+    is used. Its address must be aligned to 8 bytes.
+
+    Loading an expression binds the names of its variables, functions and 
+    operators to the definitions of a parser without reading the expression 
+    string. The parser must define all of them, the definitions may differ
+    from the ones of the parser that compiled the expression.
+  */
+  class RPNArchive
+  {
+  public:
+
+    RPNArchive(const void *a_pData, std::size_t a_nSize);
+
+    std::size_t GetSize() const;
+    string_type GetExpr(std::size_t a_nIdx) const;
+    CompiledExpression Load(std::size_t a_nIdx, const ParserXBase &a_Parser) const;
+
+  private:
+
+    struct SRecord;
+
+    SRecord GetRecord(std::size_t a_nIdx) const;
+    ptr_tok_type CreateToken(const SRecord &rec, std::size_t &nIdx, const string_type &sExpr, const ParserXBase &a_Parser) const;
+
+    const char *m_pData;
+    std::size_t m_nSize;
+    std::size_t m_nExpr;                  ///< Number of expressions
+    const std::uint64_t *m_pOffset;       ///< Offsets of the expression records
+  };
+
+MUP_NAMESPACE_END
+
+#endif
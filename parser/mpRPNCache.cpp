@@ -0,0 +1,169 @@
+/** \file
+    \brief Implementation of a cache of parsed expressions.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpRPNCache.h"
+
+
+MUP_NAMESPACE_START
+
+//---------------------------------------------------------------------------
+/** \brief Create a cache.
+	\param nCapacity The maximum number of expressions, zero disables the cache.
+*/
+RPNCache::RPNCache(std::size_t nCapacity)
+	:m_nCapacity(nCapacity)
+	,m_nHits(0)
+	,m_nMisses(0)
+	,m_lstEntry()
+	,m_mapEntry()
+{}
+
+//---------------------------------------------------------------------------
+/** \brief Set the maximum number of expressions.
+
+	The least recently used entries are removed if there are more entries. 
+	A capacity of zero disables the cache.
+*/
+void RPNCache::SetCapacity(std::size_t nCapacity)
+{
+	m_nCapacity = nCapacity;
+	Shrink();
+}
+
+//---------------------------------------------------------------------------
+std::size_t RPNCache::GetCapacity() const
+{
+	return m_nCapacity;
+}
+
+//---------------------------------------------------------------------------
+std::size_t RPNCache::GetSize() const
+{
+	return m_lstEntry.size();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the number of lookups that found an entry. */
+std::size_t RPNCache::GetHits() const
+{
+	return m_nHits;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Return the number of lookups that did not find an entry. 
+
+	Lookups of an expression parsed with older parser definitions count as 
+	misses. Lookups are not counted while the cache is disabled.
+*/
+std::size_t RPNCache::GetMisses() const
+{
+	return m_nMisses;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Look up an expression.
+	\param sExpr The expression.
+	\param nGeneration The current generation of the parser definitions.
+	\return The entry or nullptr. The entry is valid until the cache is modified.
+*/
+const RPNCache::SEntry* RPNCache::Find(const string_type &sExpr, std::size_t nGeneration)
+{
+	if (m_nCapacity == 0)
+		return nullptr;
+
+	auto it = m_mapEntry.find(sExpr);
+	if (it == m_mapEntry.end() || it->second->m_nGeneration != nGeneration)
+	{
+		++m_nMisses;
+		return nullptr;
+	}
+
+	++m_nHits;
+	m_lstEntry.splice(m_lstEntry.begin(), m_lstEntry, it->second);
+	return &m_lstEntry.front();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Store the parse results of an expression.
+
+	An existing entry for the expression is replaced. The RPN is copied.
+*/
+void RPNCache::Insert(const string_type &sExpr, std::size_t nGeneration, const RPN &rpn, const var_maptype &usedVar, int nPos)
+{
+	if (m_nCapacity == 0)
+		return;
+
+	auto it = m_mapEntry.find(sExpr);
+	if (it != m_mapEntry.end())
+	{
+		m_lstEntry.splice(m_lstEntry.begin(), m_lstEntry, it->second);
+	}
+	else
+	{
+		m_lstEntry.push_front(SEntry());
+		m_lstEntry.front().m_sExpr = sExpr;
+		m_mapEntry[sExpr] = m_lstEntry.begin();
+	}
+
+	SEntry &entry = m_lstEntry.front();
+	entry.m_nGeneration = nGeneration;
+	entry.m_rpn = rpn.Clone();
+	entry.m_UsedVar = usedVar;
+	entry.m_nPos = nPos;
+	Shrink();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Remove all entries and reset the statistics. */
+void RPNCache::Clear()
+{
+	m_lstEntry.clear();
+	m_mapEntry.clear();
+	m_nHits = 0;
+	m_nMisses = 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Remove the least recently used entries exceeding the capacity. */
+void RPNCache::Shrink()
+{
+	while (m_lstEntry.size() > m_nCapacity)
+	{
+		m_mapEntry.erase(m_lstEntry.back().m_sExpr);
+		m_lstEntry.pop_back();
+	}
+}
+
+MUP_NAMESPACE_END
@@ -0,0 +1,100 @@
+#ifndef MUP_RPN_CACHE_H
+#define MUP_RPN_CACHE_H
+
+/** \file
+    \brief Definition of a cache of parsed expressions.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <list>
+#include <map>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+#include "mpIToken.h"
+#include "mpRPN.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief Least recently used cache of the RPN created for expressions.
+
+    Used by ParserXBase to skip the token reader when an expression is set 
+    again. Entries are keyed by the expression string and the generation of
+    the parser definitions. An entry created before variables, constants, 
+    functions or operators were changed is treated as a miss. The cache 
+    holds copies of the RPN, evaluating an expression does not modify them.
+  */
+  class RPNCache
+  {
+  public:
+
+    /** \brief The parse results stored for an expression. */
+    struct SEntry
+    {
+      string_type m_sExpr;
+      std::size_t m_nGeneration;  ///< Generation of the parser definitions used by the RPN
+      RPN m_rpn;
+      var_maptype m_UsedVar;      ///< Variables used by the expression
+      int m_nPos;                 ///< Position of the token reader after parsing
+    };
+
+    explicit RPNCache(std::size_t nCapacity = 0);
+
+    void SetCapacity(std::size_t nCapacity);
+    std::size_t GetCapacity() const;
+    std::size_t GetSize() const;
+    std::size_t GetHits() const;
+    std::size_t GetMisses() const;
+
+    const SEntry* Find(const string_type &sExpr, std::size_t nGeneration);
+    void Insert(const string_type &sExpr, std::size_t nGeneration, const RPN &rpn, const var_maptype &usedVar, int nPos);
+    void Clear();
+
+  private:
+
+    typedef std::list<SEntry> entry_list_type;
+
+    void Shrink();
+
+    std::size_t m_nCapacity;      ///< Maximum number of entries, zero disables the cache
+    std::size_t m_nHits;
+    std::size_t m_nMisses;
+    entry_list_type m_lstEntry;   ///< Entries, the most recently used first
+    std::map<string_type, entry_list_type::iterator> m_mapEntry;
+  };
+
+MUP_NAMESPACE_END
+
+#endif
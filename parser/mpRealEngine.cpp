@@ -0,0 +1,1104 @@
+/** \file
+    \brief Implementation of the bytecode engine for real valued expressions.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+#include "mpRealEngine.h"
+
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <typeinfo>
+
+#include "mpRPN.h"
+#include "mpICallback.h"
+#include "mpIOprtBinShortcut.h"
+#include "mpIfThenElse.h"
+#include "mpVariable.h"
+#include "mpTempTokens.h"
+#include "mpOprtStrengthReduced.h"
+#include "mpOprtFused.h"
+#include "mpOprtNonCmplx.h"
+#include "mpOprtCmplx.h"
+#include "mpOprtBinCommon.h"
+#include "mpFuncNonCmplx.h"
+#include "mpFuncCmplx.h"
+#include "mpSimdMath.h"
+
+MUP_NAMESPACE_START
+
+namespace
+{
+	//---------------------------------------------------------------------------
+	/** \brief Real functions of the built in packages.
+
+		Each entry computes exactly what the Eval function of the callback
+		computes for a real argument. (Note that FunTan is the sine function
+		and FunSin the tangent.) Some functions have a vectorized version used
+		by EvalBlock if SIMD math is enabled. The C++ code of each entry is
+		used by CodeGen, %1 and %2 stand for the arguments.
+	*/
+	const struct
+	{
+		const std::type_info& Type;
+		float_type(*pFun)(float_type);
+		const char* szCode;
+		SimdMath::fun_type pSimdFun;
+	}
+	s_Fun1[] =
+	{
+		{ typeid(FunTan),      [](float_type v) { return std::sin(v); }, "std::sin(%1)", SimdMath::Sin },
+		{ typeid(FunCos),      [](float_type v) { return std::cos(v); }, "std::cos(%1)", SimdMath::Cos },
+		{ typeid(FunSin),      [](float_type v) { return std::tan(v); }, "std::tan(%1)", nullptr },
+		{ typeid(FunASin),     [](float_type v) { return std::asin(v); }, "std::asin(%1)", nullptr },
+		{ typeid(FunACos),     [](float_type v) { return std::acos(v); }, "std::acos(%1)", nullptr },
+		{ typeid(FunATan),     [](float_type v) { return std::atan(v); }, "std::atan(%1)", nullptr },
+		{ typeid(FunSinH),     [](float_type v) { return std::sinh(v); }, "std::sinh(%1)", nullptr },
+		{ typeid(FunCosH),     [](float_type v) { return std::cosh(v); }, "std::cosh(%1)", nullptr },
+		{ typeid(FunTanH),     [](float_type v) { return std::tanh(v); }, "std::tanh(%1)", nullptr },
+		{ typeid(FunASinH),    [](float_type v) { return std::asinh(v); }, "std::asinh(%1)", nullptr },
+		{ typeid(FunACosH),    [](float_type v) { return std::acosh(v); }, "std::acosh(%1)", nullptr },
+		{ typeid(FunATanH),    [](float_type v) { return std::atanh(v); }, "std::atanh(%1)", nullptr },
+		{ typeid(FunLog),      [](float_type v) { return std::log(v); }, "std::log(%1)", SimdMath::Log },
+		{ typeid(FunLog10),    [](float_type v) { return std::log10(v); }, "std::log10(%1)", SimdMath::Log10 },
+		{ typeid(FunLog2),     [](float_type v) { return std::log2(v); }, "std::log2(%1)", SimdMath::Log2 },
+		{ typeid(FunLn),       [](float_type v) { return std::log(v); }, "std::log(%1)", SimdMath::Log },
+		{ typeid(FunSqrt),     [](float_type v) { return std::sqrt(v); }, "std::sqrt(%1)", SimdMath::Sqrt },
+		{ typeid(FunCbrt),     [](float_type v) { return std::cbrt(v); }, "std::cbrt(%1)", nullptr },
+		{ typeid(FunExp),      [](float_type v) { return std::exp(v); }, "std::exp(%1)", SimdMath::Exp },
+		{ typeid(FunAbs),      [](float_type v) { return std::fabs(v); }, "std::fabs(%1)", SimdMath::Abs },
+		{ typeid(OprtSignPos), [](float_type v) { return v; }, "%1", nullptr },
+		{ typeid(FunCmplxSin), [](float_type v) { return std::sin(v); }, "std::sin(%1)", SimdMath::Sin },
+		{ typeid(FunCmplxCos), [](float_type v) { return std::cos(v); }, "std::cos(%1)", SimdMath::Cos },
+		{ typeid(FunCmplxTan), [](float_type v) { return std::tan(v); }, "std::tan(%1)", nullptr },
+		{ typeid(FunCmplxReal),[](float_type v) { return v; }, "%1", nullptr },
+		// The imaginary part of a real value is zero
+		{ typeid(FunCmplxAbs), [](float_type v) { return std::sqrt(v*v); }, "std::sqrt(%1*%1)", nullptr }
+	};
+
+	const struct
+	{
+		const std::type_info& Type;
+		float_type(*pFun)(float_type, float_type);
+		const char* szCode;
+	}
+	s_Fun2[] =
+	{
+		{ typeid(FunPow),       [](float_type v1, float_type v2) { return std::pow(v1, v2); }, "std::pow(%1, %2)" },
+		{ typeid(FunHypot),     [](float_type v1, float_type v2) { return std::hypot(v1, v2); }, "std::hypot(%1, %2)" },
+		{ typeid(FunAtan2),     [](float_type v1, float_type v2) { return std::atan2(v1, v2); }, "std::atan2(%1, %2)" },
+		{ typeid(FunFmod),      [](float_type v1, float_type v2) { return std::fmod(v1, v2); }, "std::fmod(%1, %2)" },
+		{ typeid(FunRemainder), [](float_type v1, float_type v2) { return std::remainder(v1, v2); }, "std::remainder(%1, %2)" }
+	};
+
+	//---------------------------------------------------------------------------
+	/** \brief Functions of the complex package that always compute complex values.
+
+		The engine calls them with a zero imaginary part and uses the real part
+		of the result, provided its imaginary part is zero.
+	*/
+	const struct
+	{
+		const std::type_info& Type;
+		cmplx_type(*pFun)(const cmplx_type&);
+		const char* szCode;
+	}
+	s_CmplxFun1[] =
+	{
+		{ typeid(FunCmplxSqrt),  [](const cmplx_type& v) { return std::sqrt(v); }, "std::sqrt(%1)" },
+		{ typeid(FunCmplxExp),   [](const cmplx_type& v) { return std::exp(v); }, "std::exp(%1)" },
+		{ typeid(FunCmplxLn),    [](const cmplx_type& v) { return std::log(v); }, "std::log(%1)" },
+		{ typeid(FunCmplxLog),   [](const cmplx_type& v) { return std::log(v); }, "std::log(%1)" },
+		{ typeid(FunCmplxLog10), [](const cmplx_type& v) { return std::log10(v); }, "std::log10(%1)" },
+		{ typeid(FunCmplxLog2),  [](const cmplx_type& v) { return std::log(v) * (float_type)1.0 / std::log((float_type)2.0); }, "std::log(%1) * (float_type)1.0 / std::log((float_type)2.0)" },
+		{ typeid(FunCmplxSinH),  [](const cmplx_type& v) { return std::sinh(v); }, "std::sinh(%1)" },
+		{ typeid(FunCmplxCosH),  [](const cmplx_type& v) { return std::cosh(v); }, "std::cosh(%1)" },
+		{ typeid(FunCmplxTanH),  [](const cmplx_type& v) { return std::tanh(v); }, "std::tanh(%1)" }
+	};
+
+	//---------------------------------------------------------------------------
+	/** \brief Combine the static types of the two branches of an if-then-else clause.
+
+		Static types of numbers are 'f' for values assigned as real numbers, 'c' for
+		values assigned as complex numbers, 'n' for constants whose type does not
+		depend on the kind of assignment, 'v' for variables and 'x' for values 
+		assigned either way. Booleans are 'b'.
+	*/
+	char_type MergeType(char_type t1, char_type t2)
+	{
+		if (t1 == 'v' || t2 == 'v')
+			return 'v';
+
+		if (t1 == t2 || t2 == 'n')
+			return t1;
+
+		if (t1 == 'n')
+			return t2;
+
+		return 'x';
+	}
+
+	//---------------------------------------------------------------------------
+	/** \brief Power operator of the non complex package (same as OprtPow). */
+	inline float_type PowReal(float_type a, float_type b)
+	{
+		int ib = (int)b;
+		if (b - ib != 0)
+			return std::pow(a, b);
+
+		switch (ib)
+		{
+		case 1:  return a;
+		case 2:  return a * a;
+		case 3:  return a * a * a;
+		case 4:  return a * a * a * a;
+		case 5:  return a * a * a * a * a;
+		default: return std::pow(a, ib);
+		}
+	}
+
+	//---------------------------------------------------------------------------
+	template<typename TFun>
+	inline void ApplyBlock(float_type* pArg, int nRows, TFun fun)
+	{
+		for (int r = 0; r < nRows; ++r)
+			pArg[r] = fun(pArg[r]);
+	}
+
+	//---------------------------------------------------------------------------
+	template<typename TFun>
+	inline void ApplyBlock(float_type* pArg1, const float_type* pArg2, int nRows, TFun fun)
+	{
+		for (int r = 0; r < nRows; ++r)
+			pArg1[r] = fun(pArg1[r], pArg2[r]);
+	}
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+RealEngine::RealEngine()
+	:m_vInstr()
+	, m_vVar()
+	, m_nTempSlots(0)
+	, m_nStackSize(0)
+	, m_bHasJumps(false)
+	, m_bSimdMath(false)
+	, m_cResultType(0)
+{}
+
+//---------------------------------------------------------------------------
+/** \brief Enable or disable the vectorized math functions in EvalBlock.
+
+	SimdMath functions are faster but their results may differ from the
+	standard library by an ULP or two (see SimdMath). The setting is kept
+	when the engine is reset or compiled.
+*/
+void RealEngine::EnableSimdMath(bool bStat)
+{
+	m_bSimdMath = bStat;
+}
+
+//---------------------------------------------------------------------------
+bool RealEngine::IsSimdMathEnabled() const
+{
+	return m_bSimdMath;
+}
+
+//---------------------------------------------------------------------------
+void RealEngine::Reset()
+{
+	m_vInstr.clear();
+	m_vVar.clear();
+	m_nTempSlots = 0;
+	m_nStackSize = 0;
+	m_bHasJumps = false;
+	m_cResultType = 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the bytecode from the RPN of an expression.
+	\return true if the expression can be evaluated by this engine.
+*/
+bool RealEngine::Compile(const RPN& rpn)
+{
+	Reset();
+
+	if (!CompileRPN(rpn))
+	{
+		Reset();
+		return false;
+	}
+
+	m_bHasJumps = std::any_of(m_vInstr.begin(), m_vInstr.end(), [](const SInstr& instr)
+	{
+		return instr.eCode == opIF || instr.eCode == opJMP || instr.eCode == opOR || instr.eCode == opAND;
+	});
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool RealEngine::CompileRPN(const RPN& rpn)
+{
+	const token_vec_type& vRPN = rpn.GetData();
+	if (vRPN.empty())
+		return false;
+
+	std::vector<char_type> vType;                  // Static types of the values on the stack
+	std::vector<char_type> vBranchType;            // Types of the first branch of pending conditionals
+	std::vector<char_type> vTempType(rpn.GetNumTempSlots(), 'x');
+	std::vector<int> vPos(vRPN.size() + 1, 0);     // Position of the instructions of each RPN token
+	std::size_t nMaxStack = 0;
+
+	for (std::size_t i = 0; i < vRPN.size(); ++i)
+	{
+		vPos[i] = (int)m_vInstr.size();
+
+		const IToken* pTok = vRPN[i].Get();
+		switch (pTok->GetCode())
+		{
+		case cmVAL:
+			if (!CompileValue(static_cast<const IValue*>(pTok), vType))
+				return false;
+			break;
+
+		// The stack of the original tokens may be larger than the result
+		case cmFUSED:
+			nMaxStack = std::max(nMaxStack, vType.size() + 3);
+			if (!CompileFused(static_cast<const OprtFused*>(pTok), vType))
+				return false;
+			break;
+
+		case cmSTORE:
+		{
+			int nSlot = static_cast<const TokenTemp*>(pTok)->GetSlot();
+			if (vType.empty())
+				return false;
+
+			AddInstr(opSTORE, nSlot);
+			vTempType[nSlot] = vType.back();
+		}
+		break;
+
+		case cmLOAD:
+		{
+			int nSlot = static_cast<const TokenTemp*>(pTok)->GetSlot();
+			AddInstr(opLOAD, nSlot);
+			vType.push_back(vTempType[nSlot]);
+		}
+		break;
+
+		case cmFUNC:
+		case cmOPRT_BIN:
+		case cmOPRT_INFIX:
+			if (!CompileCallback(static_cast<const ICallback*>(pTok), vType))
+				return false;
+			break;
+
+		case cmIF:
+			if (vType.empty() || vType.back() != 'b')
+				return false;
+
+			vType.pop_back();
+			AddInstr(opIF, (int)i + static_cast<const TokenIfThenElse*>(pTok)->GetOffset() + 1);
+			break;
+
+		case cmELSE:
+			if (vType.empty())
+				return false;
+
+			vBranchType.push_back(vType.back());
+			vType.pop_back();
+			AddInstr(opJMP, (int)i + static_cast<const TokenIfThenElse*>(pTok)->GetOffset() + 1);
+			break;
+
+		case cmENDIF:
+			if (vType.empty() || vBranchType.empty())
+				return false;
+
+			// A branch may return a boolean only if the other one does so too
+			if ((vType.back() == 'b') != (vBranchType.back() == 'b'))
+				return false;
+
+			vType.back() = MergeType(vType.back(), vBranchType.back());
+			vBranchType.pop_back();
+			break;
+
+		case cmSHORTCUT_BEGIN:
+		{
+			if (vType.empty() || vType.back() != 'b')
+				return false;
+
+			vType.pop_back();
+			vBranchType.push_back('b');
+
+			const IOprtBinShortcut* pOprt = static_cast<const IOprtBinShortcut*>(pTok);
+			AddInstr((pOprt->GetPri() == prLOGIC_OR) ? opOR : opAND, (int)i + pOprt->GetOffset() + 1);
+		}
+		break;
+
+		case cmSHORTCUT_END:
+			if (vType.empty() || vType.back() != 'b' || vBranchType.empty())
+				return false;
+
+			vBranchType.pop_back();
+			break;
+
+		default:
+			return false;
+		}
+
+		nMaxStack = std::max(nMaxStack, vType.size());
+	}
+
+	vPos[vRPN.size()] = (int)m_vInstr.size();
+
+	if (vType.size() != 1)
+		return false;
+
+	switch (vType[0])
+	{
+	case 'n':
+	case 'f': m_cResultType = 'f'; break;
+	case 'c': m_cResultType = 'c'; break;
+	case 'x': m_cResultType = 'x'; break;
+	case 'b': m_cResultType = 'b'; break;
+
+	// The type of a variable can't be recreated
+	default:
+		return false;
+	}
+
+	// Jump targets are RPN positions up to now
+	for (SInstr& instr : m_vInstr)
+	{
+		if (instr.eCode == opIF || instr.eCode == opJMP || instr.eCode == opOR || instr.eCode == opAND)
+			instr.nIdx = vPos[instr.nIdx];
+	}
+
+	m_nTempSlots = rpn.GetNumTempSlots();
+	m_nStackSize = (int)nMaxStack;
+	return true;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the instruction for a value.
+	\param pVal The value or variable.
+	\param vType The static types of the values on the stack.
+	\return false if the value is not a real number.
+*/
+bool RealEngine::CompileValue(const IValue* pVal, std::vector<char_type>& vType)
+{
+	if (pVal->IsVariable())
+	{
+		const IValue* pBound = static_cast<const Variable*>(pVal)->GetPtr();
+		std::size_t nIdx = std::find(m_vVar.begin(), m_vVar.end(), pBound) - m_vVar.begin();
+		if (nIdx == m_vVar.size())
+			m_vVar.push_back(pBound);
+
+		AddInstr(opVAR, (int)nIdx);
+		vType.push_back('v');
+	}
+	else if (pVal->GetType() == 'b')
+	{
+		AddInstr(opVAL).fVal = pVal->GetFloat();
+		vType.push_back('b');
+	}
+	else if (pVal->IsNonComplexScalar())
+	{
+		// Find out which assignment would recreate the type of the constant
+		float_type v = pVal->GetFloat();
+		bool bReal = pVal->GetType() == ((v == (int_type)v) ? 'i' : 'f');
+		bool bCmplx = pVal->GetType() == ((std::floor(v) == v) ? 'i' : 'f');
+
+		AddInstr(opVAL).fVal = v;
+		vType.push_back((bReal && bCmplx) ? 'n' : (bReal ? 'f' : (bCmplx ? 'c' : 'v')));
+	}
+	else
+		return false;
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the instructions for a token fused by the optimizer.
+	\param pFused The fused token.
+	\param vType The static types of the values on the stack.
+	\return false if the tokens are not supported.
+
+	The bytecode is not dispatched per RPN token, so the original tokens are
+	compiled one by one. Only a fused multiply add needs an instruction of 
+	its own.
+*/
+bool RealEngine::CompileFused(const OprtFused* pFused, std::vector<char_type>& vType)
+{
+	const token_vec_type& vTok = pFused->GetTokens();
+	if (!pFused->IsFmaEnabled())
+	{
+		for (const ptr_tok_type& tok : vTok)
+		{
+			bool bStat = (tok->GetCode() == cmVAL) 
+				? CompileValue(tok->AsIValue(), vType) 
+				: CompileCallback(tok->AsICallback(), vType);
+			if (!bStat)
+				return false;
+		}
+
+		return true;
+	}
+
+	// x*y+z and z+x*y are both computed as fma(x, y, z)
+	bool bAddMul = pFused->GetKind() == OprtFused::fsADD_MUL;
+	const std::size_t nPos[2][3] = { { 0, 1, 3 }, { 1, 2, 0 } };
+	for (std::size_t nIdx : nPos[bAddMul])
+	{
+		if (!CompileValue(vTok[nIdx]->AsIValue(), vType) || vType.back() == 'b')
+			return false;
+	}
+
+	AddInstr(opFMA, (typeid(*vTok[bAddMul ? 3 : 2]) == typeid(OprtMulCmplx)) ? 1 : 0);
+	vType.resize(vType.size() - 3);
+	vType.push_back('f');
+	return true;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create the instruction for a function or an operator.
+	\param pCallback The callback.
+	\param vType The static types of the values on the stack.
+	\return false if the callback is not supported.
+
+	Only the callbacks of the built in packages are supported. They are
+	identified by their exact type since derived classes may change the
+	result.
+*/
+bool RealEngine::CompileCallback(const ICallback* pCallback, std::vector<char_type>& vType)
+{
+	int nArgs = pCallback->GetArgsPresent();
+	if (!pCallback->IsPure() || nArgs < 1 || nArgs > 2 || (int)vType.size() < nArgs)
+		return false;
+
+	for (int i = 0; i < nArgs; ++i)
+	{
+		if (vType[vType.size() - 1 - i] == 'b')
+			return false;
+	}
+
+	const std::type_info& type = typeid(*pCallback);
+	char_type cType = 'f';
+
+	if (type == typeid(OprtStrengthReduced))
+	{
+		const OprtStrengthReduced* pOprt = static_cast<const OprtStrengthReduced*>(pCallback);
+		switch (pOprt->GetKind())
+		{
+		case OprtStrengthReduced::rdIDENTITY: AddInstr(opIDENTITY); break;
+		case OprtStrengthReduced::rdADD_ZERO: AddInstr(opADD_ZERO); break;
+		case OprtStrengthReduced::rdPOW_INT:  AddInstr(opPOW_INT, (int)pOprt->GetOperand()); break;
+		case OprtStrengthReduced::rdMUL:      AddInstr(opMUL_CONST).fVal = pOprt->GetOperand(); break;
+		case OprtStrengthReduced::rdDIV:      AddInstr(opDIV_CONST).fVal = pOprt->GetOperand(); break;
+
+		// The complex sign operator never creates -0
+		case OprtStrengthReduced::rdNEG_NEG:  AddInstr(pOprt->HasComplexResult() ? opADD_ZERO : opIDENTITY); break;
+		default:
+			return false;
+		}
+
+		if (pOprt->HasComplexResult())
+			cType = 'c';
+	}
+	else if (nArgs == 2)
+	{
+		if (type == typeid(OprtAdd) || type == typeid(OprtAddCmplx))
+			AddInstr(opADD);
+		else if (type == typeid(OprtSub) || type == typeid(OprtSubCmplx))
+			AddInstr(opSUB);
+		else if (type == typeid(OprtMul))
+			AddInstr(opMUL);
+		else if (type == typeid(OprtMulCmplx))
+		{
+			AddInstr(opMUL_CMPLX);
+			cType = 'c';
+		}
+		else if (type == typeid(OprtDiv) || type == typeid(OprtDivCmplx))
+			AddInstr(opDIV);
+		else if (type == typeid(OprtPow))
+			AddInstr(opPOW);
+		else if (type == typeid(OprtPowCmplx))
+			AddInstr(opPOW_CMPLX);
+		else if (type == typeid(FunCmplxPow))
+		{
+			SInstr& instr = AddInstr(opFUN2_CMPLX);
+			instr.pCmplxFun2 = [](const cmplx_type& v1, const cmplx_type& v2) { return std::pow(v1, v2); };
+			instr.szCode = "std::pow(%1, %2)";
+			cType = 'c';
+		}
+		else
+		{
+			const EOpcode eCmp[] = { opLT, opGT, opLE, opGE, opEQ, opNEQ };
+			const std::type_info* pCmp[] = { &typeid(OprtLT), &typeid(OprtGT), &typeid(OprtLE), &typeid(OprtGE), &typeid(OprtEQ), &typeid(OprtNEQ) };
+			std::size_t nCmp = std::find_if(std::begin(pCmp), std::end(pCmp), [&](const std::type_info* p) { return *p == type; }) - std::begin(pCmp);
+			auto itFun = std::find_if(std::begin(s_Fun2), std::end(s_Fun2), [&](const decltype(s_Fun2[0])& f) { return f.Type == type; });
+
+			if (nCmp < std::size(pCmp))
+			{
+				AddInstr(eCmp[nCmp]);
+				cType = 'b';
+			}
+			else if (itFun != std::end(s_Fun2))
+			{
+				SInstr& instr = AddInstr(opFUN2);
+				instr.pFun2 = itFun->pFun;
+				instr.szCode = itFun->szCode;
+			}
+			else
+				return false;
+		}
+	}
+	else
+	{
+		auto itFun = std::find_if(std::begin(s_Fun1), std::end(s_Fun1), [&](const decltype(s_Fun1[0])& f) { return f.Type == type; });
+		auto itCmplxFun = std::find_if(std::begin(s_CmplxFun1), std::end(s_CmplxFun1), [&](const decltype(s_CmplxFun1[0])& f) { return f.Type == type; });
+
+		if (type == typeid(OprtSign))
+			AddInstr(opNEG);
+		else if (type == typeid(OprtSignCmplx))
+		{
+			AddInstr(opNEG_CMPLX);
+			cType = 'c';
+		}
+		else if (itFun != std::end(s_Fun1))
+		{
+			SInstr& instr = AddInstr(opFUN1);
+			instr.pFun1 = itFun->pFun;
+			instr.szCode = itFun->szCode;
+			instr.pSimdFun = itFun->pSimdFun;
+		}
+		else if (itCmplxFun != std::end(s_CmplxFun1))
+		{
+			SInstr& instr = AddInstr(opFUN1_CMPLX);
+			instr.pCmplxFun1 = itCmplxFun->pFun;
+			instr.szCode = itCmplxFun->szCode;
+			cType = 'c';
+		}
+		else
+			return false;
+	}
+
+	vType.resize(vType.size() - nArgs);
+	vType.push_back(cType);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+RealEngine::SInstr& RealEngine::AddInstr(EOpcode eCode, int nIdx)
+{
+	SInstr instr;
+	instr.eCode = eCode;
+	instr.nIdx = nIdx;
+	instr.fVal = 0;
+	instr.szCode = nullptr;
+	instr.pSimdFun = nullptr;
+	m_vInstr.push_back(instr);
+	return m_vInstr.back();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the bytecode.
+	\param pBuf A buffer of GetBufferSize() values starting with the values of the variables.
+	\param fRes Receives the result.
+	\return false if the result is not a real number or not exactly the number computed
+			by the generic engine. The expression must then be evaluated by the generic engine.
+*/
+bool RealEngine::Eval(float_type* pBuf, float_type& fRes) const
+{
+	const float_type* pVar = pBuf;
+	float_type* pTemp = pBuf + m_vVar.size();
+	float_type* pStack = pTemp + m_nTempSlots;
+	const SInstr* pInstr = m_vInstr.data();
+	const std::size_t nSize = m_vInstr.size();
+
+	int sidx = -1;
+	for (std::size_t i = 0; i < nSize; ++i)
+	{
+		const SInstr& instr = pInstr[i];
+		switch (instr.eCode)
+		{
+		case opVAL:   pStack[++sidx] = instr.fVal; continue;
+		case opVAR:   pStack[++sidx] = pVar[instr.nIdx]; continue;
+		case opLOAD:  pStack[++sidx] = pTemp[instr.nIdx]; continue;
+		case opSTORE: pTemp[instr.nIdx] = pStack[sidx]; continue;
+
+		case opADD:   --sidx; pStack[sidx] = pStack[sidx] + pStack[sidx + 1]; continue;
+		case opSUB:   --sidx; pStack[sidx] = pStack[sidx] - pStack[sidx + 1]; continue;
+		case opMUL:   --sidx; pStack[sidx] = pStack[sidx] * pStack[sidx + 1]; continue;
+		case opDIV:   --sidx; pStack[sidx] = pStack[sidx] / pStack[sidx + 1]; continue;
+		case opNEG:   pStack[sidx] = -pStack[sidx]; continue;
+
+		case opMUL_CMPLX:
+		{
+			// A complex multiplication yields the same real part unless the
+			// product is zero (sign of zero) or not finite (nan imaginary part)
+			--sidx;
+			float_type v = pStack[sidx] * pStack[sidx + 1];
+			if (v == 0 || !std::isfinite(v))
+				return false;
+
+			pStack[sidx] = v;
+		}
+		continue;
+
+		case opPOW:
+		case opPOW_CMPLX:
+		case opFUN2_CMPLX:
+			--sidx;
+			if (!EvalCallout(instr, &pStack[sidx]))
+				return false;
+			continue;
+
+		case opFUN1_CMPLX:
+			if (!EvalCallout(instr, &pStack[sidx]))
+				return false;
+			continue;
+
+		case opNEG_CMPLX:
+			pStack[sidx] = (pStack[sidx] == 0) ? 0 : -pStack[sidx];
+			continue;
+
+		case opLT:  --sidx; pStack[sidx] = (pStack[sidx] <  pStack[sidx + 1]) ? 1 : 0; continue;
+		case opGT:  --sidx; pStack[sidx] = (pStack[sidx] >  pStack[sidx + 1]) ? 1 : 0; continue;
+		case opLE:  --sidx; pStack[sidx] = (pStack[sidx] <= pStack[sidx + 1]) ? 1 : 0; continue;
+		case opGE:  --sidx; pStack[sidx] = (pStack[sidx] >= pStack[sidx + 1]) ? 1 : 0; continue;
+		case opEQ:  --sidx; pStack[sidx] = (pStack[sidx] == pStack[sidx + 1]) ? 1 : 0; continue;
+		case opNEQ: --sidx; pStack[sidx] = (pStack[sidx] != pStack[sidx + 1]) ? 1 : 0; continue;
+
+		case opFUN1:
+			pStack[sidx] = instr.pFun1(pStack[sidx]);
+			continue;
+
+		case opFUN2:
+			--sidx;
+			pStack[sidx] = instr.pFun2(pStack[sidx], pStack[sidx + 1]);
+			continue;
+
+		case opFMA:
+		{
+			sidx -= 2;
+			float_type v = pStack[sidx] * pStack[sidx + 1];
+			if (instr.nIdx != 0 && (v == 0 || !std::isfinite(v)))
+				return false;
+
+			pStack[sidx] = std::fma(pStack[sidx], pStack[sidx + 1], pStack[sidx + 2]);
+		}
+		continue;
+
+		case opIF:
+			if (pStack[sidx--] != 1)
+				i = instr.nIdx - 1;
+			continue;
+
+		case opJMP:
+			i = instr.nIdx - 1;
+			continue;
+
+		case opOR:
+			if (pStack[sidx] == 1)
+				i = instr.nIdx - 1;
+			else
+				--sidx;
+			continue;
+
+		case opAND:
+			if (pStack[sidx] != 1)
+				i = instr.nIdx - 1;
+			else
+				--sidx;
+			continue;
+
+		// Strength reduced operators pass arguments that are not finite
+		// to the original operator
+		default:
+		{
+			float_type v = pStack[sidx];
+			if (!std::isfinite(v))
+				return false;
+
+			switch (instr.eCode)
+			{
+			case opIDENTITY:
+				break;
+
+			case opADD_ZERO:
+				pStack[sidx] = (v == 0) ? 0 : v;
+				break;
+
+			case opPOW_INT:
+				switch (instr.nIdx)
+				{
+				case 2:  pStack[sidx] = v * v; break;
+				case 3:  pStack[sidx] = v * v * v; break;
+				case 4:  pStack[sidx] = v * v * v * v; break;
+				case 5:  pStack[sidx] = v * v * v * v * v; break;
+				default: return false;
+				}
+				break;
+
+			case opMUL_CONST:
+				pStack[sidx] = v * instr.fVal;
+				break;
+
+			case opDIV_CONST:
+				pStack[sidx] = v / instr.fVal;
+				break;
+
+			default:
+				return false;
+			}
+		}
+		continue;
+		} // switch opcode
+	} // for all instructions
+
+	// Assignments as real or complex number give different types for
+	// infinite and very large numbers.
+	fRes = pStack[0];
+	return CheckResult(m_cResultType, fRes);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Execute an instruction computing powers or complex functions.
+	\param instr The instruction (opPOW, opPOW_CMPLX, opFUN1_CMPLX or opFUN2_CMPLX)
+	\param pArg The arguments, receives the result
+	\return false if the result is not a real number.
+*/
+bool RealEngine::EvalCallout(const SInstr& instr, float_type* pArg)
+{
+	switch (instr.eCode)
+	{
+	case opPOW:
+		pArg[0] = PowReal(pArg[0], pArg[1]);
+		return true;
+
+	case opPOW_CMPLX:
+		// OprtPowCmplx computes a complex power if the result may be complex
+		if (pArg[0] < 0 && pArg[1] != static_cast<int_type>(pArg[1]))
+			return false;
+
+		pArg[0] = std::pow(pArg[0], pArg[1]);
+		return true;
+
+	case opFUN1_CMPLX:
+	case opFUN2_CMPLX:
+	{
+		cmplx_type v = (instr.eCode == opFUN1_CMPLX) 
+			? instr.pCmplxFun1(cmplx_type(pArg[0], 0)) 
+			: instr.pCmplxFun2(cmplx_type(pArg[0], 0), cmplx_type(pArg[1], 0));
+		if (v.imag() != 0)
+			return false;
+
+		pArg[0] = v.real();
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+//---------------------------------------------------------------------------
+/** \brief Check if the final result has the type the generic engine would assign. */
+bool RealEngine::CheckResult(char_type cResultType, float_type fRes)
+{
+	// Assignments as real or complex number give different types for
+	// infinite and very large numbers.
+	return cResultType != 'x' || (fRes == (int_type)fRes) == (std::floor(fRes) == fRes);
+}
+
+//---------------------------------------------------------------------------
+/** \brief Evaluate the expression for a block of rows.
+	\param pCol Values of the variables, one array with nRows values for each variable
+	\param nRows Number of rows, at most c_nBlockSize
+	\param pBuf Buffer with GetBlockBufferSize() values
+	\param pRes Receives the results
+	\return false if the result of any row can't be computed by this engine.
+
+	Each stack slot holds the values of all rows. Conditional code may take
+	a different path for each row and is evaluated row by row.
+*/
+bool RealEngine::EvalBlock(const float_type* const* pCol, int nRows, float_type* pBuf, float_type* pRes) const
+{
+	const std::size_t nVar = m_vVar.size();
+	if (m_bHasJumps)
+	{
+		for (int r = 0; r < nRows; ++r)
+		{
+			for (std::size_t k = 0; k < nVar; ++k)
+				pBuf[k] = pCol[k][r];
+
+			if (!Eval(pBuf, pRes[r]))
+				return false;
+		}
+
+		return true;
+	}
+
+	const int n = nRows;
+	float_type* pTemp = pBuf;
+	float_type* pStack = pTemp + m_nTempSlots * c_nBlockSize;
+	float_type* pTop = pStack;   // values of the top of the stack
+	int nTop = -1;
+	for (const SInstr& instr : m_vInstr)
+	{
+		switch (instr.eCode)
+		{
+		case opVAL:
+			pTop = pStack + (++nTop) * c_nBlockSize;
+			std::fill(pTop, pTop + n, instr.fVal);
+			continue;
+
+		case opVAR:
+			pTop = pStack + (++nTop) * c_nBlockSize;
+			std::copy(pCol[instr.nIdx], pCol[instr.nIdx] + n, pTop);
+			continue;
+
+		case opLOAD:
+			pTop = pStack + (++nTop) * c_nBlockSize;
+			std::copy(pTemp + instr.nIdx * c_nBlockSize, pTemp + instr.nIdx * c_nBlockSize + n, pTop);
+			continue;
+
+		case opSTORE:
+			std::copy(pTop, pTop + n, pTemp + instr.nIdx * c_nBlockSize);
+			continue;
+
+		case opADD: pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return a + b; }); continue;
+		case opSUB: pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return a - b; }); continue;
+		case opMUL: pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return a * b; }); continue;
+		case opDIV: pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return a / b; }); continue;
+		case opNEG: ApplyBlock(pTop, n, [](float_type v) { return -v; }); continue;
+
+		case opMUL_CMPLX:
+			pTop = pStack + (--nTop) * c_nBlockSize;
+			ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return a * b; });
+			for (int r = 0; r < n; ++r)
+			{
+				if (pTop[r] == 0 || !std::isfinite(pTop[r]))
+					return false;
+			}
+			continue;
+
+		case opPOW:
+			pTop = pStack + (--nTop) * c_nBlockSize;
+			ApplyBlock(pTop, pTop + c_nBlockSize, n, PowReal);
+			continue;
+
+		case opPOW_CMPLX:
+		{
+			pTop = pStack + (--nTop) * c_nBlockSize;
+			const float_type* pArg = pTop + c_nBlockSize;
+			for (int r = 0; r < n; ++r)
+			{
+				if (pTop[r] < 0 && pArg[r] != static_cast<int_type>(pArg[r]))
+					return false;
+			}
+
+			ApplyBlock(pTop, pArg, n, [](float_type a, float_type b) { return std::pow(a, b); });
+		}
+		continue;
+
+		case opNEG_CMPLX:
+			ApplyBlock(pTop, n, [](float_type v) { return (v == 0) ? 0 : -v; });
+			continue;
+
+		case opLT:  pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return (a <  b) ? 1 : 0; }); continue;
+		case opGT:  pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return (a >  b) ? 1 : 0; }); continue;
+		case opLE:  pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return (a <= b) ? 1 : 0; }); continue;
+		case opGE:  pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return (a >= b) ? 1 : 0; }); continue;
+		case opEQ:  pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return (a == b) ? 1 : 0; }); continue;
+		case opNEQ: pTop = pStack + (--nTop) * c_nBlockSize; ApplyBlock(pTop, pTop + c_nBlockSize, n, [](float_type a, float_type b) { return (a != b) ? 1 : 0; }); continue;
+
+		case opFUN1:
+			if (m_bSimdMath && instr.pSimdFun)
+				instr.pSimdFun(pTop, n);
+			else
+				ApplyBlock(pTop, n, instr.pFun1);
+			continue;
+
+		case opFUN2:
+			pTop = pStack + (--nTop) * c_nBlockSize;
+			ApplyBlock(pTop, pTop + c_nBlockSize, n, instr.pFun2);
+			continue;
+
+		case opFMA:
+		{
+			nTop -= 2;
+			pTop = pStack + nTop * c_nBlockSize;
+			const float_type* pArg1 = pTop + c_nBlockSize;
+			const float_type* pArg2 = pArg1 + c_nBlockSize;
+			for (int r = 0; r < n; ++r)
+			{
+				float_type v = pTop[r] * pArg1[r];
+				if (instr.nIdx != 0 && (v == 0 || !std::isfinite(v)))
+					return false;
+
+				pTop[r] = std::fma(pTop[r], pArg1[r], pArg2[r]);
+			}
+		}
+		continue;
+
+		case opFUN1_CMPLX:
+			for (int r = 0; r < n; ++r)
+			{
+				cmplx_type v = instr.pCmplxFun1(cmplx_type(pTop[r], 0));
+				if (v.imag() != 0)
+					return false;
+
+				pTop[r] = v.real();
+			}
+			continue;
+
+		case opFUN2_CMPLX:
+		{
+			pTop = pStack + (--nTop) * c_nBlockSize;
+			const float_type* pArg = pTop + c_nBlockSize;
+			for (int r = 0; r < n; ++r)
+			{
+				cmplx_type v = instr.pCmplxFun2(cmplx_type(pTop[r], 0), cmplx_type(pArg[r], 0));
+				if (v.imag() != 0)
+					return false;
+
+				pTop[r] = v.real();
+			}
+		}
+		continue;
+
+		// Strength reduced operators pass arguments that are not finite
+		// to the original operator
+		default:
+			for (int r = 0; r < n; ++r)
+			{
+				if (!std::isfinite(pTop[r]))
+					return false;
+			}
+
+			switch (instr.eCode)
+			{
+			case opIDENTITY:
+				break;
+
+			case opADD_ZERO:
+				ApplyBlock(pTop, n, [](float_type v) { return (v == 0) ? 0 : v; });
+				break;
+
+			case opPOW_INT:
+				switch (instr.nIdx)
+				{
+				case 2:  ApplyBlock(pTop, n, [](float_type v) { return v * v; }); break;
+				case 3:  ApplyBlock(pTop, n, [](float_type v) { return v * v * v; }); break;
+				case 4:  ApplyBlock(pTop, n, [](float_type v) { return v * v * v * v; }); break;
+				case 5:  ApplyBlock(pTop, n, [](float_type v) { return v * v * v * v * v; }); break;
+				default: return false;
+				}
+				break;
+
+			case opMUL_CONST:
+			{
+				const float_type f = instr.fVal;
+				ApplyBlock(pTop, n, [f](float_type v) { return v * f; });
+			}
+			break;
+
+			case opDIV_CONST:
+			{
+				const float_type f = instr.fVal;
+				ApplyBlock(pTop, n, [f](float_type v) { return v / f; });
+			}
+			break;
+
+			default:
+				return false;
+			}
+			continue;
+		} // switch opcode
+	} // for all instructions
+
+	std::copy(pTop, pTop + n, pRes);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if an expression was compiled successfully. */
+bool RealEngine::IsValid() const
+{
+	return !m_vInstr.empty();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of instructions. */
+std::size_t RealEngine::GetSize() const
+{
+	return m_vInstr.size();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of values required by the buffer passed to Eval. */
+int RealEngine::GetBufferSize() const
+{
+	return (int)m_vVar.size() + m_nTempSlots + m_nStackSize;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of values required by the buffer passed to EvalBlock. */
+int RealEngine::GetBlockBufferSize() const
+{
+	return std::max((m_nTempSlots + m_nStackSize) * c_nBlockSize, GetBufferSize());
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns how the result must be assigned to a value.
+
+	'f' for a real number, 'c' for a complex number and 'b' for a boolean.
+	The type decides whether a large or infinite number becomes an integer.
+	'x' means the result may be assigned either way. Eval fails for numbers 
+	that would get different types.
+*/
+char_type RealEngine::GetResultType() const
+{
+	return m_cResultType;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the values bound to the variables in the order expected by Eval. */
+const std::vector<const IValue*>& RealEngine::GetVar() const
+{
+	return m_vVar;
+}
+
+MUP_NAMESPACE_END
@@ -0,0 +1,172 @@
+#ifndef MUP_REAL_ENGINE_H
+#define MUP_REAL_ENGINE_H
+
+/** \file
+    \brief Definition of the bytecode engine for real valued expressions.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <vector>
+
+#include "mpFwdDecl.h"
+#include "mpTypes.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief A bytecode engine for expressions with real valued results.
+
+    The bytecode is compiled from the final RPN of an expression. This is
+    only possible if the expression is made of numbers, variables and the
+    arithmetic operators, comparisons and functions of the complex and the
+    non complex package. The engine works on a plain array of float_type
+    values. It does not create Value objects and does not call virtual
+    functions. Results are bit identical to the generic engine.
+
+    EvalBlock evaluates the expression for up to c_nBlockSize rows at once.
+    Each instruction is applied to all rows of the block before the next
+    instruction is executed. With SIMD math enabled it uses the vectorized
+    functions of SimdMath.
+
+    The values of the variables must be copied into the buffer passed to
+    Eval before each evaluation. Evaluation fails if an intermediate result
+    would not be a real number (i.e. sqrt(-1) in the complex package). The
+    caller must then use the generic engine instead.
+  */
+  class RealEngine
+  {
+  friend class JitEngine;
+  friend class CodeGen;
+
+  public:
+
+    static const int c_nBlockSize = 128;   ///< Maximum number of rows passed to EvalBlock
+
+    RealEngine();
+
+    bool Compile(const RPN &rpn);
+    void Reset();
+    void EnableSimdMath(bool bStat);
+    bool IsSimdMathEnabled() const;
+    bool Eval(float_type *pBuf, float_type &fRes) const;
+    bool EvalBlock(const float_type *const *pCol, int nRows, float_type *pBuf, float_type *pRes) const;
+
+    bool IsValid() const;
+    std::size_t GetSize() const;
+    int GetBufferSize() const;
+    int GetBlockBufferSize() const;
+    char_type GetResultType() const;
+    const std::vector<const IValue*>& GetVar() const;
+
+  private:
+
+    typedef float_type (*fun1_type)(float_type);
+    typedef float_type (*fun2_type)(float_type, float_type);
+    typedef cmplx_type (*cmplx_fun1_type)(const cmplx_type&);
+    typedef cmplx_type (*cmplx_fun2_type)(const cmplx_type&, const cmplx_type&);
+
+    enum EOpcode
+    {
+      opVAL,          ///< Push a constant
+      opVAR,          ///< Push a variable
+      opLOAD,         ///< Push a temporary value
+      opSTORE,        ///< Copy the top of the stack into a temporary slot
+      opADD,
+      opSUB,
+      opMUL,
+      opMUL_CMPLX,    ///< Multiplication of the complex package
+      opDIV,
+      opPOW,          ///< Power operator of the non complex package
+      opPOW_CMPLX,    ///< Power operator of the complex package
+      opNEG,
+      opNEG_CMPLX,    ///< Sign operator of the complex package
+      opLT,
+      opGT,
+      opLE,
+      opGE,
+      opEQ,
+      opNEQ,
+      opFUN1,         ///< Real function with one argument
+      opFUN2,         ///< Real function with two arguments
+      opFUN1_CMPLX,   ///< Complex function with one argument
+      opFUN2_CMPLX,   ///< Complex function with two arguments
+      opIF,           ///< Pop the condition, jump if it is false
+      opJMP,
+      opOR,           ///< Jump if the top of the stack is true, pop it otherwise
+      opAND,          ///< Jump if the top of the stack is false, pop it otherwise
+      opIDENTITY,     ///< Strength reduced operators (see OprtStrengthReduced)
+      opADD_ZERO,
+      opPOW_INT,
+      opMUL_CONST,
+      opDIV_CONST,
+      opFMA           ///< x*y+z with a single rounding; nIdx is 1 for the complex multiplication
+    };
+
+    /** \brief A single instruction. */
+    struct SInstr
+    {
+      EOpcode eCode;
+      int nIdx;        ///< Variable index, temporary slot, exponent or jump target
+      union
+      {
+        float_type fVal;             ///< Constant value, factor or divisor
+        fun1_type pFun1;
+        fun2_type pFun2;
+        cmplx_fun1_type pCmplxFun1;
+        cmplx_fun2_type pCmplxFun2;
+      };
+      const char *szCode;                  ///< C++ code of the function for CodeGen or nullptr
+      void (*pSimdFun)(float_type*, int);  ///< Vectorized version of pFun1 or nullptr
+    };
+
+    bool CompileRPN(const RPN &rpn);
+    bool CompileValue(const IValue *pVal, std::vector<char_type> &vType);
+    bool CompileFused(const OprtFused *pFused, std::vector<char_type> &vType);
+    bool CompileCallback(const ICallback *pCallback, std::vector<char_type> &vType);
+    SInstr& AddInstr(EOpcode eCode, int nIdx = 0);
+    static bool CheckResult(char_type cResultType, float_type fRes);
+    static bool EvalCallout(const SInstr &instr, float_type *pArg);
+
+    std::vector<SInstr> m_vInstr;
+    std::vector<const IValue*> m_vVar;  ///< Values bound to the variables used by the expression
+    int m_nTempSlots;
+    int m_nStackSize;
+    bool m_bHasJumps;                   ///< Conditional code is evaluated row by row by EvalBlock
+    bool m_bSimdMath;                   ///< Use SimdMath functions in EvalBlock
+    char_type m_cResultType;            ///< 'f', 'c', 'x' or 'b' depending on how the result is assigned
+  };
+
+MUP_NAMESPACE_END
+
+#endif
@@ -0,0 +1,308 @@
+/** \file
+    \brief Vectorized math kernels used by SimdMath.
+
+    This file has no include guard. mpSimdMath.cpp includes it once for each
+    instruction set after defining vec_type, mask_type, c_nLanes, the
+    functions operating on them and MUP_SIMD_TARGET.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+  //---------------------------------------------------------------------------
+  /** \brief Apply a kernel to c_nLanes values.
+
+    Lanes rejected by the kernel are computed by the scalar function.
+  */
+  template<typename TKernel>
+  MUP_SIMD_TARGET inline void ApplyLanes(float_type *pVal)
+  {
+    vec_type x = Load(pVal);
+    mask_type bReject;
+    Store(pVal, TKernel::Eval(x, bReject));
+
+    int nBits = MaskBits(bReject);
+    if (nBits == 0)
+      return;
+
+    float_type arg[c_nLanes];
+    Store(arg, x);
+    for (int i = 0; i < c_nLanes; ++i)
+    {
+      if (nBits & (1 << i))
+        pVal[i] = TKernel::Scalar(arg[i]);
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  template<typename TKernel>
+  MUP_SIMD_TARGET void Apply(float_type *pVal, int nCount)
+  {
+    int i = 0;
+    for (; i + c_nLanes <= nCount; i += c_nLanes)
+      ApplyLanes<TKernel>(pVal + i);
+
+    if (i == nCount)
+      return;
+
+    // Pad the remaining values so that all values get the same treatment
+    float_type buf[c_nLanes];
+    for (int k = 0; k < c_nLanes; ++k)
+      buf[k] = (i + k < nCount) ? pVal[i + k] : 1;
+
+    ApplyLanes<TKernel>(buf);
+    for (int k = 0; i + k < nCount; ++k)
+      pVal[i + k] = buf[k];
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Round to the nearest integer, valid for |x| < 2^51. */
+  MUP_SIMD_TARGET inline vec_type Round(vec_type x)
+  {
+    const vec_type vMagic = Set(6755399441055744.0);   // 1.5 * 2^52
+    return Sub(Add(x, vMagic), vMagic);
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief exp(x) for |x| <= 708 (fdlibm e_exp.c). */
+  struct ExpKernel
+  {
+    MUP_SIMD_TARGET static vec_type Eval(vec_type x, mask_type &bReject)
+    {
+      bReject = NotLessEqual(Abs(x), Set(708));
+
+      // x = k*ln2 + r with |r| <= 0.5*ln2, the low bits of kMagic contain k
+      const vec_type vMagic = Set(6755399441055744.0);
+      vec_type kMagic = Add(Mul(x, Set(1.44269504088896338700e+00)), vMagic);
+      vec_type k = Sub(kMagic, vMagic);
+      vec_type hi = Sub(x, Mul(k, Set(6.93147180369123816490e-01)));
+      vec_type lo = Mul(k, Set(1.90821492927058770002e-10));
+      vec_type r = Sub(hi, lo);
+
+      vec_type t = Mul(r, r);
+      vec_type p = MulAdd(t, Set(4.13813679705723846039e-08), Set(-1.65339022054652515390e-06));
+      p = MulAdd(t, p, Set(6.61375632143793436117e-05));
+      p = MulAdd(t, p, Set(-2.77777777770155933842e-03));
+      p = MulAdd(t, p, Set(1.66666666666666019037e-01));
+      vec_type c = Sub(r, Mul(t, p));
+      vec_type y = Sub(Set(1), Sub(Sub(lo, Div(Mul(r, c), Sub(Set(2), c))), hi));
+
+      // Multiply with 2^k by adding k to the exponent
+      return AddBits(y, ShiftLeft52(kMagic));
+    }
+
+    static float_type Scalar(float_type x) { return std::exp(x); }
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Split the logarithm of normal positive numbers (fdlibm e_log.c).
+
+    log(x) = k*ln2 + log(1+f) with log(1+f) = f - (hfsq - sR)
+  */
+  MUP_SIMD_TARGET inline void LogReduce(vec_type x, mask_type &bReject, vec_type &k, vec_type &f, vec_type &hfsq, vec_type &sR)
+  {
+    bReject = Or(Less(x, Set(std::numeric_limits<float_type>::min())),
+                 NotLessEqual(x, Set(std::numeric_limits<float_type>::max())));
+
+    // x = 2^k * m with sqrt(2)/2 < m < sqrt(2)
+    vec_type e = Sub(Or(ShiftRight52(x), SetBits(0x4330000000000000ULL)), Set(4503599627370496.0));
+    vec_type m = Or(And(x, SetBits(0x000FFFFFFFFFFFFFULL)), SetBits(0x3FF0000000000000ULL));
+    mask_type bHigh = Less(Set(1.41421356237309504880), m);
+    m = Select(bHigh, Mul(m, Set(0.5)), m);
+    k = Sub(Select(bHigh, Add(e, Set(1)), e), Set(1023));
+    f = Sub(m, Set(1));
+
+    vec_type s = Div(f, Add(Set(2), f));
+    vec_type z = Mul(s, s);
+    vec_type w = Mul(z, z);
+    vec_type t1 = Mul(w, MulAdd(w, MulAdd(w, Set(1.531383769920937332e-01), Set(2.222219843214978396e-01)), Set(3.999999999940941908e-01)));
+    vec_type t2 = MulAdd(w, MulAdd(w, Set(1.479819860511658591e-01), Set(1.818357216161805012e-01)), Set(2.857142874366239149e-01));
+    t2 = Mul(z, MulAdd(w, t2, Set(6.666666666666735130e-01)));
+    hfsq = Mul(Set(0.5), Mul(f, f));
+    sR = Mul(s, Add(hfsq, Add(t2, t1)));
+  }
+
+  //---------------------------------------------------------------------------
+  struct LogKernel
+  {
+    MUP_SIMD_TARGET static vec_type Eval(vec_type x, mask_type &bReject)
+    {
+      vec_type k, f, hfsq, sR;
+      LogReduce(x, bReject, k, f, hfsq, sR);
+      vec_type lo = MulAdd(k, Set(1.90821492927058770002e-10), sR);
+      return Sub(Mul(k, Set(6.93147180369123816490e-01)), Sub(Sub(hfsq, lo), f));
+    }
+
+    static float_type Scalar(float_type x) { return std::log(x); }
+  };
+
+  //---------------------------------------------------------------------------
+  struct Log2Kernel
+  {
+    MUP_SIMD_TARGET static vec_type Eval(vec_type x, mask_type &bReject)
+    {
+      vec_type k, f, hfsq, sR;
+      LogReduce(x, bReject, k, f, hfsq, sR);
+      vec_type lnm = Sub(f, Sub(hfsq, sR));
+      return MulAdd(lnm, Set(1.44269504088896338700e+00), k);
+    }
+
+    static float_type Scalar(float_type x) { return std::log2(x); }
+  };
+
+  //---------------------------------------------------------------------------
+  struct Log10Kernel
+  {
+    MUP_SIMD_TARGET static vec_type Eval(vec_type x, mask_type &bReject)
+    {
+      vec_type k, f, hfsq, sR;
+      LogReduce(x, bReject, k, f, hfsq, sR);
+      vec_type lnm = Sub(f, Sub(hfsq, sR));
+      vec_type lo = MulAdd(k, Set(3.69423907715893078616e-13), Mul(lnm, Set(4.34294481903251816668e-01)));
+      return MulAdd(k, Set(3.01029995663611771306e-01), lo);
+    }
+
+    static float_type Scalar(float_type x) { return std::log10(x); }
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Reduce x to y0 + y1 in [-pi/4, pi/4] and the quadrant q in 0..3.
+
+    Uses the pi/2 split of fdlibm (e_rem_pio2.c) with 33 bit parts, so
+    products with n < 2^20 are exact. Arguments close to a multiple of pi/2
+    would lose precision and are rejected.
+  */
+  MUP_SIMD_TARGET inline void ReducePio2(vec_type x, mask_type &bReject, vec_type &y0, vec_type &y1, vec_type &q)
+  {
+    vec_type n = Round(Mul(x, Set(6.36619772367581382433e-01)));
+    q = Sub(n, Mul(Set(4), Round(Sub(Mul(n, Set(0.25)), Set(0.375)))));
+
+    vec_type t = Sub(x, Mul(n, Set(1.57079632673412561417e+00)));
+    vec_type w = Mul(n, Set(6.07710050630396597660e-11));
+
+    // r + e = t - w exactly (TwoSum)
+    vec_type r = Sub(t, w);
+    vec_type bb = Sub(r, t);
+    vec_type e = Sub(Sub(t, Sub(r, bb)), Add(w, bb));
+    e = Sub(e, Mul(n, Set(2.02226624871116645580e-21)));
+    e = Sub(e, Mul(n, Set(8.47842766036889956997e-32)));
+
+    y0 = Add(r, e);
+    y1 = Add(Sub(r, y0), e);
+    bReject = Or(NotLessEqual(Abs(x), Set(1e5)), Less(Abs(y0), Set(1e-12)));
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief sin(x + y) for |x| <= pi/4 (fdlibm k_sin.c). */
+  MUP_SIMD_TARGET inline vec_type KernelSin(vec_type x, vec_type y)
+  {
+    vec_type z = Mul(x, x);
+    vec_type v = Mul(z, x);
+    vec_type r = MulAdd(z, Set(1.58969099521155010221e-10), Set(-2.50507602534068634195e-08));
+    r = MulAdd(z, r, Set(2.75573137070700676789e-06));
+    r = MulAdd(z, r, Set(-1.98412698298579493134e-04));
+    r = MulAdd(z, r, Set(8.33333333332248946124e-03));
+    vec_type s = Sub(Mul(z, Sub(Mul(Set(0.5), y), Mul(v, r))), y);
+    return Sub(x, Sub(s, Mul(v, Set(-1.66666666666666324348e-01))));
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief cos(x + y) for |x| <= pi/4 (fdlibm k_cos.c). */
+  MUP_SIMD_TARGET inline vec_type KernelCos(vec_type x, vec_type y)
+  {
+    vec_type z = Mul(x, x);
+    vec_type r = MulAdd(z, Set(-1.13596475577881948265e-11), Set(2.08757232129817482790e-09));
+    r = MulAdd(z, r, Set(-2.75573143513906633035e-07));
+    r = MulAdd(z, r, Set(2.48015872894767294178e-05));
+    r = MulAdd(z, r, Set(-1.38888888888741095749e-03));
+    r = MulAdd(z, r, Set(4.16666666666666019037e-02));
+    r = Sub(Mul(z, Mul(z, r)), Mul(x, y));
+    vec_type hz = Mul(Set(0.5), z);
+    vec_type vSmall = Sub(Set(1), Sub(hz, r));
+
+    // For |x| >= 0.3 subtract a part of hz exactly to keep the precision
+    vec_type ax = Abs(x);
+    vec_type qx = Select(Less(Set(0.78125), ax), Set(0.28125), And(Mul(ax, Set(0.25)), SetBits(0xFFFFFFFF00000000ULL)));
+    vec_type vLarge = Sub(Sub(Set(1), qx), Sub(Sub(hz, qx), r));
+    return Select(Less(ax, Set(0.3)), vSmall, vLarge);
+  }
+
+  //---------------------------------------------------------------------------
+  struct SinKernel
+  {
+    MUP_SIMD_TARGET static vec_type Eval(vec_type x, mask_type &bReject)
+    {
+      vec_type y0, y1, q;
+      ReducePio2(x, bReject, y0, y1, q);
+      vec_type v = Select(Or(Equal(q, Set(1)), Equal(q, Set(3))), KernelCos(y0, y1), KernelSin(y0, y1));
+      return Select(LessEqual(Set(2), q), Xor(v, Set(-0.0)), v);
+    }
+
+    static float_type Scalar(float_type x) { return std::sin(x); }
+  };
+
+  //---------------------------------------------------------------------------
+  struct CosKernel
+  {
+    MUP_SIMD_TARGET static vec_type Eval(vec_type x, mask_type &bReject)
+    {
+      vec_type y0, y1, q;
+      ReducePio2(x, bReject, y0, y1, q);
+      vec_type v = Select(Or(Equal(q, Set(1)), Equal(q, Set(3))), KernelSin(y0, y1), KernelCos(y0, y1));
+      return Select(Or(Equal(q, Set(1)), Equal(q, Set(2))), Xor(v, Set(-0.0)), v);
+    }
+
+    static float_type Scalar(float_type x) { return std::cos(x); }
+  };
+
+  //---------------------------------------------------------------------------
+  struct SqrtKernel
+  {
+    MUP_SIMD_TARGET static vec_type Eval(vec_type x, mask_type &bReject)
+    {
+      bReject = NoLanes();
+      return Sqrt(x);
+    }
+
+    static float_type Scalar(float_type x) { return std::sqrt(x); }
+  };
+
+  //---------------------------------------------------------------------------
+  struct AbsKernel
+  {
+    MUP_SIMD_TARGET static vec_type Eval(vec_type x, mask_type &bReject)
+    {
+      bReject = NoLanes();
+      return Abs(x);
+    }
+
+    static float_type Scalar(float_type x) { return std::fabs(x); }
+  };
@@ -0,0 +1,289 @@
+/** \file
+    \brief Implementation of vectorized math functions used for batch evaluation.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+#include "mpSimdMath.h"
+
+#include <cmath>
+#include <atomic>
+#include <limits>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #define MUP_SIMD_X86
+  #include <immintrin.h>
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #endif
+#endif
+
+MUP_NAMESPACE_START
+
+#if defined(MUP_SIMD_X86)
+
+// GCC and clang need a target attribute for functions using instructions
+// not enabled by the compiler flags.
+#if defined(__GNUC__)
+  #define MUP_SIMD_ATTR(TARGET) __attribute__((target(TARGET)))
+#else
+  #define MUP_SIMD_ATTR(TARGET)
+#endif
+
+//------------------------------------------------------------------------------
+namespace sse2
+{
+  #define MUP_SIMD_TARGET MUP_SIMD_ATTR("sse2")
+
+  typedef __m128d vec_type;
+  typedef __m128d mask_type;
+  const int c_nLanes = 2;
+
+  MUP_SIMD_TARGET inline vec_type Load(const float_type *p) { return _mm_loadu_pd(p); }
+  MUP_SIMD_TARGET inline void Store(float_type *p, vec_type v) { _mm_storeu_pd(p, v); }
+  MUP_SIMD_TARGET inline vec_type Set(float_type v) { return _mm_set1_pd(v); }
+  MUP_SIMD_TARGET inline vec_type SetBits(std::uint64_t v) { return _mm_castsi128_pd(_mm_set1_epi64x((long long)v)); }
+  MUP_SIMD_TARGET inline vec_type Add(vec_type a, vec_type b) { return _mm_add_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Sub(vec_type a, vec_type b) { return _mm_sub_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Mul(vec_type a, vec_type b) { return _mm_mul_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Div(vec_type a, vec_type b) { return _mm_div_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type MulAdd(vec_type a, vec_type b, vec_type c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+  MUP_SIMD_TARGET inline vec_type Sqrt(vec_type a) { return _mm_sqrt_pd(a); }
+  MUP_SIMD_TARGET inline vec_type And(vec_type a, vec_type b) { return _mm_and_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Or(vec_type a, vec_type b) { return _mm_or_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Xor(vec_type a, vec_type b) { return _mm_xor_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Abs(vec_type a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+  MUP_SIMD_TARGET inline vec_type AddBits(vec_type a, vec_type b) { return _mm_castsi128_pd(_mm_add_epi64(_mm_castpd_si128(a), _mm_castpd_si128(b))); }
+  MUP_SIMD_TARGET inline vec_type ShiftLeft52(vec_type a) { return _mm_castsi128_pd(_mm_slli_epi64(_mm_castpd_si128(a), 52)); }
+  MUP_SIMD_TARGET inline vec_type ShiftRight52(vec_type a) { return _mm_castsi128_pd(_mm_srli_epi64(_mm_castpd_si128(a), 52)); }
+  MUP_SIMD_TARGET inline mask_type Less(vec_type a, vec_type b) { return _mm_cmplt_pd(a, b); }
+  MUP_SIMD_TARGET inline mask_type LessEqual(vec_type a, vec_type b) { return _mm_cmple_pd(a, b); }
+  MUP_SIMD_TARGET inline mask_type NotLessEqual(vec_type a, vec_type b) { return _mm_cmpnle_pd(a, b); }
+  MUP_SIMD_TARGET inline mask_type Equal(vec_type a, vec_type b) { return _mm_cmpeq_pd(a, b); }
+  MUP_SIMD_TARGET inline mask_type NoLanes() { return _mm_setzero_pd(); }
+  MUP_SIMD_TARGET inline vec_type Select(mask_type m, vec_type a, vec_type b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+  MUP_SIMD_TARGET inline int MaskBits(mask_type m) { return _mm_movemask_pd(m); }
+
+  #include "mpSimdKernels.h"
+  #undef MUP_SIMD_TARGET
+} // namespace sse2
+
+//------------------------------------------------------------------------------
+namespace avx2
+{
+  #define MUP_SIMD_TARGET MUP_SIMD_ATTR("avx2,fma")
+
+  typedef __m256d vec_type;
+  typedef __m256d mask_type;
+  const int c_nLanes = 4;
+
+  MUP_SIMD_TARGET inline vec_type Load(const float_type *p) { return _mm256_loadu_pd(p); }
+  MUP_SIMD_TARGET inline void Store(float_type *p, vec_type v) { _mm256_storeu_pd(p, v); }
+  MUP_SIMD_TARGET inline vec_type Set(float_type v) { return _mm256_set1_pd(v); }
+  MUP_SIMD_TARGET inline vec_type SetBits(std::uint64_t v) { return _mm256_castsi256_pd(_mm256_set1_epi64x((long long)v)); }
+  MUP_SIMD_TARGET inline vec_type Add(vec_type a, vec_type b) { return _mm256_add_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Sub(vec_type a, vec_type b) { return _mm256_sub_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Mul(vec_type a, vec_type b) { return _mm256_mul_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Div(vec_type a, vec_type b) { return _mm256_div_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type MulAdd(vec_type a, vec_type b, vec_type c) { return _mm256_fmadd_pd(a, b, c); }
+  MUP_SIMD_TARGET inline vec_type Sqrt(vec_type a) { return _mm256_sqrt_pd(a); }
+  MUP_SIMD_TARGET inline vec_type And(vec_type a, vec_type b) { return _mm256_and_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Or(vec_type a, vec_type b) { return _mm256_or_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Xor(vec_type a, vec_type b) { return _mm256_xor_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Abs(vec_type a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+  MUP_SIMD_TARGET inline vec_type AddBits(vec_type a, vec_type b) { return _mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(a), _mm256_castpd_si256(b))); }
+  MUP_SIMD_TARGET inline vec_type ShiftLeft52(vec_type a) { return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(a), 52)); }
+  MUP_SIMD_TARGET inline vec_type ShiftRight52(vec_type a) { return _mm256_castsi256_pd(_mm256_srli_epi64(_mm256_castpd_si256(a), 52)); }
+  MUP_SIMD_TARGET inline mask_type Less(vec_type a, vec_type b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+  MUP_SIMD_TARGET inline mask_type LessEqual(vec_type a, vec_type b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+  MUP_SIMD_TARGET inline mask_type NotLessEqual(vec_type a, vec_type b) { return _mm256_cmp_pd(a, b, _CMP_NLE_UQ); }
+  MUP_SIMD_TARGET inline mask_type Equal(vec_type a, vec_type b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+  MUP_SIMD_TARGET inline mask_type NoLanes() { return _mm256_setzero_pd(); }
+  MUP_SIMD_TARGET inline vec_type Select(mask_type m, vec_type a, vec_type b) { return _mm256_blendv_pd(b, a, m); }
+  MUP_SIMD_TARGET inline int MaskBits(mask_type m) { return _mm256_movemask_pd(m); }
+
+  #include "mpSimdKernels.h"
+  #undef MUP_SIMD_TARGET
+} // namespace avx2
+
+//------------------------------------------------------------------------------
+namespace avx512
+{
+  #define MUP_SIMD_TARGET MUP_SIMD_ATTR("avx512f")
+
+  typedef __m512d vec_type;
+  typedef __mmask8 mask_type;
+  const int c_nLanes = 8;
+
+  // Bitwise operations on doubles require AVX-512DQ, the integer versions only AVX-512F.
+  // The zero masked versions of sqrt and the shifts avoid false uninitialized value
+  // warnings of GCC in the unmasked intrinsics.
+  MUP_SIMD_TARGET inline __m512i Bits(vec_type a) { return _mm512_castpd_si512(a); }
+  MUP_SIMD_TARGET inline vec_type Real(__m512i a) { return _mm512_castsi512_pd(a); }
+
+  MUP_SIMD_TARGET inline vec_type Load(const float_type *p) { return _mm512_loadu_pd(p); }
+  MUP_SIMD_TARGET inline void Store(float_type *p, vec_type v) { _mm512_storeu_pd(p, v); }
+  MUP_SIMD_TARGET inline vec_type Set(float_type v) { return _mm512_set1_pd(v); }
+  MUP_SIMD_TARGET inline vec_type SetBits(std::uint64_t v) { return Real(_mm512_set1_epi64((long long)v)); }
+  MUP_SIMD_TARGET inline vec_type Add(vec_type a, vec_type b) { return _mm512_add_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Sub(vec_type a, vec_type b) { return _mm512_sub_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Mul(vec_type a, vec_type b) { return _mm512_mul_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type Div(vec_type a, vec_type b) { return _mm512_div_pd(a, b); }
+  MUP_SIMD_TARGET inline vec_type MulAdd(vec_type a, vec_type b, vec_type c) { return _mm512_fmadd_pd(a, b, c); }
+  MUP_SIMD_TARGET inline vec_type Sqrt(vec_type a) { return _mm512_maskz_sqrt_pd(0xFF, a); }
+  MUP_SIMD_TARGET inline vec_type And(vec_type a, vec_type b) { return Real(_mm512_and_si512(Bits(a), Bits(b))); }
+  MUP_SIMD_TARGET inline vec_type Or(vec_type a, vec_type b) { return Real(_mm512_or_si512(Bits(a), Bits(b))); }
+  MUP_SIMD_TARGET inline vec_type Xor(vec_type a, vec_type b) { return Real(_mm512_xor_si512(Bits(a), Bits(b))); }
+  MUP_SIMD_TARGET inline vec_type Abs(vec_type a) { return And(a, SetBits(0x7FFFFFFFFFFFFFFFULL)); }
+  MUP_SIMD_TARGET inline vec_type AddBits(vec_type a, vec_type b) { return Real(_mm512_add_epi64(Bits(a), Bits(b))); }
+  MUP_SIMD_TARGET inline vec_type ShiftLeft52(vec_type a) { return Real(_mm512_maskz_slli_epi64(0xFF, Bits(a), 52)); }
+  MUP_SIMD_TARGET inline vec_type ShiftRight52(vec_type a) { return Real(_mm512_maskz_srli_epi64(0xFF, Bits(a), 52)); }
+  MUP_SIMD_TARGET inline mask_type Less(vec_type a, vec_type b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+  MUP_SIMD_TARGET inline mask_type LessEqual(vec_type a, vec_type b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+  MUP_SIMD_TARGET inline mask_type NotLessEqual(vec_type a, vec_type b) { return _mm512_cmp_pd_mask(a, b, _CMP_NLE_UQ); }
+  MUP_SIMD_TARGET inline mask_type Equal(vec_type a, vec_type b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+  MUP_SIMD_TARGET inline mask_type Or(mask_type a, mask_type b) { return (mask_type)(a | b); }
+  MUP_SIMD_TARGET inline mask_type NoLanes() { return 0; }
+  MUP_SIMD_TARGET inline vec_type Select(mask_type m, vec_type a, vec_type b) { return _mm512_mask_blend_pd(m, b, a); }
+  MUP_SIMD_TARGET inline int MaskBits(mask_type m) { return m; }
+
+  #include "mpSimdKernels.h"
+  #undef MUP_SIMD_TARGET
+} // namespace avx512
+
+#endif // MUP_SIMD_X86
+
+namespace
+{
+  //---------------------------------------------------------------------------
+  ESimdLevel DetectCpuLevel()
+  {
+#if defined(MUP_SIMD_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return simdAVX512;
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return simdAVX2;
+
+    return simdSSE2;
+#elif defined(MUP_SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int nMaxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool bOsxsave = (info[2] & (1 << 27)) != 0;
+    bool bFma = (info[2] & (1 << 12)) != 0;
+
+    // The operating system must save the AVX (and AVX-512) registers
+    unsigned long long nXcr0 = bOsxsave ? _xgetbv(0) : 0;
+    if (nMaxLeaf >= 7 && (nXcr0 & 0x6) == 0x6)
+    {
+      __cpuidex(info, 7, 0);
+      if ((nXcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)))
+        return simdAVX512;
+
+      if (bFma && (info[1] & (1 << 5)))
+        return simdAVX2;
+    }
+
+    return simdSSE2;
+#else
+    return simdNONE;
+#endif
+  }
+
+  /** \brief The instruction set selected by SimdMath::SetLevel, -1 if not set. */
+  std::atomic<int> s_nLevel(-1);
+} // anonymous namespace
+
+#if defined(MUP_SIMD_X86)
+  #define MUP_SIMD_DISPATCH(KERNEL)                                 \
+      case simdAVX512: avx512::Apply<avx512::KERNEL>(pVal, nCount); return; \
+      case simdAVX2:   avx2::Apply<avx2::KERNEL>(pVal, nCount); return;     \
+      case simdSSE2:   sse2::Apply<sse2::KERNEL>(pVal, nCount); return;
+#else
+  #define MUP_SIMD_DISPATCH(KERNEL)
+#endif
+
+#define MUP_SIMD_FUNC(FUNC, KERNEL, SCALAR)                           \
+    void SimdMath::FUNC(float_type *pVal, int nCount)                 \
+    {                                                                 \
+      switch (GetLevel())                                             \
+      {                                                               \
+      MUP_SIMD_DISPATCH(KERNEL)                                       \
+      default:                                                        \
+        for (int i = 0; i < nCount; ++i)                              \
+          pVal[i] = SCALAR(pVal[i]);                                  \
+      }                                                               \
+    }
+
+  MUP_SIMD_FUNC(Sin,   SinKernel,   std::sin)
+  MUP_SIMD_FUNC(Cos,   CosKernel,   std::cos)
+  MUP_SIMD_FUNC(Exp,   ExpKernel,   std::exp)
+  MUP_SIMD_FUNC(Log,   LogKernel,   std::log)
+  MUP_SIMD_FUNC(Log2,  Log2Kernel,  std::log2)
+  MUP_SIMD_FUNC(Log10, Log10Kernel, std::log10)
+  MUP_SIMD_FUNC(Sqrt,  SqrtKernel,  std::sqrt)
+  MUP_SIMD_FUNC(Abs,   AbsKernel,   std::fabs)
+#undef MUP_SIMD_FUNC
+#undef MUP_SIMD_DISPATCH
+
+//------------------------------------------------------------------------------
+/** \brief Returns the best instruction set supported by the CPU. */
+ESimdLevel SimdMath::GetCpuLevel()
+{
+  static const ESimdLevel eLevel = DetectCpuLevel();
+  return eLevel;
+}
+
+//------------------------------------------------------------------------------
+/** \brief Returns the instruction set used by the vectorized functions. */
+ESimdLevel SimdMath::GetLevel()
+{
+  int nLevel = s_nLevel.load(std::memory_order_relaxed);
+  return (nLevel < 0) ? GetCpuLevel() : (ESimdLevel)nLevel;
+}
+
+//------------------------------------------------------------------------------
+/** \brief Select the instruction set used by the vectorized functions.
+
+  Levels not supported by the CPU are replaced by the best supported one.
+  This affects all threads.
+*/
+void SimdMath::SetLevel(ESimdLevel eLevel)
+{
+  s_nLevel.store((eLevel > GetCpuLevel()) ? GetCpuLevel() : eLevel, std::memory_order_relaxed);
+}
+
+MUP_NAMESPACE_END
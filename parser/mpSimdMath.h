@@ -0,0 +1,101 @@
+#ifndef MUP_SIMD_MATH_H
+#define MUP_SIMD_MATH_H
+
+/** \file
+    \brief Definition of vectorized math functions used for batch evaluation.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include "mpTypes.h"
+
+
+MUP_NAMESPACE_START
+
+  /** \brief Instruction sets used by SimdMath. */
+  enum ESimdLevel
+  {
+    simdNONE = 0,   ///< Scalar functions of the C++ standard library
+    simdSSE2,       ///< 2 values per instruction
+    simdAVX2,       ///< 4 values per instruction, requires AVX2 and FMA
+    simdAVX512      ///< 8 values per instruction, requires AVX-512F
+  };
+
+  //---------------------------------------------------------------------------
+  /** \brief Vectorized versions of the real functions of the built in packages.
+
+    Each function replaces nCount values of an array by its function values.
+    The best instruction set supported by the CPU is detected at runtime.
+    Without SIMD support (or on other platforms than x86-64) the functions of
+    the standard library are used.
+
+    The vectorized functions are based on the algorithms of fdlibm. Arguments
+    outside of the range given below (including infinite numbers and NaN) are
+    passed to the standard library, so special values give the same results as
+    the scalar functions. The maximum errors measured against correctly rounded
+    results are:
+
+    <table>
+    <tr><th>Function</th><th>Range</th><th>Max. error</th></tr>
+    <tr><td>Sqrt, Abs</td><td>all values</td><td>0 ULP (exact)</td></tr>
+    <tr><td>Exp</td><td>|x| <= 708</td><td>1 ULP</td></tr>
+    <tr><td>Log</td><td>normal positive numbers</td><td>1 ULP</td></tr>
+    <tr><td>Log2, Log10</td><td>normal positive numbers</td><td>2 ULP</td></tr>
+    <tr><td>Sin, Cos</td><td>1e-12 <= |x| <= 1e5</td><td>1 ULP</td></tr>
+    </table>
+
+    Results may differ from the standard library in the last bit, and between
+    instruction sets since AVX2 and AVX-512 use fused multiply add.
+  */
+  class SimdMath
+  {
+  public:
+
+    typedef void (*fun_type)(float_type *pVal, int nCount);
+
+    static void Sin(float_type *pVal, int nCount);
+    static void Cos(float_type *pVal, int nCount);
+    static void Exp(float_type *pVal, int nCount);
+    static void Log(float_type *pVal, int nCount);
+    static void Log2(float_type *pVal, int nCount);
+    static void Log10(float_type *pVal, int nCount);
+    static void Sqrt(float_type *pVal, int nCount);
+    static void Abs(float_type *pVal, int nCount);
+
+    static ESimdLevel GetCpuLevel();
+    static ESimdLevel GetLevel();
+    static void SetLevel(ESimdLevel eLevel);
+  };
+
+MUP_NAMESPACE_END
+
+#endif
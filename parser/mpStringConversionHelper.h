@@ -31,11 +31,27 @@
 #ifndef MP_STRING_CONVERSION_HELPER_H
 #define MP_STRING_CONVERSION_HELPER_H
 
-#include <cstdlib>   // for strtod
-#include <cwchar>    // for wcstof
+#include <cmath>     // for ldexp
+#include <cstdint>   // for uint64_t
 #include <cstring>   // for strlen
+#include <cwchar>    // for wcslen
+#include <limits>    // for infinity, quiet_NaN
+#include <string>
 #include <type_traits>  // for enable_if, is_floating_point
 
+#if defined(__has_include)
+    #if __has_include(<charconv>)
+        #include <charconv>  // for from_chars
+    #endif
+#endif
+
+// std::from_chars for double is missing in older standard libraries 
+// (i.e. libc++ before version 17)
+#if !defined(__cpp_lib_to_chars)
+    #include <locale>    // for locale::classic
+    #include <sstream>   // for istringstream
+#endif
+
 MUP_NAMESPACE_START
 
 template <typename TChar>
@@ -48,10 +64,98 @@ class StringConversionHelper
             return StrLenImpl(str, std::integral_constant<bool, std::is_same<TChar, char>::value>());
         }
 
+        /** \brief Parse a floating point number independent of the locale.
+
+            Accepts the decimal and hexadecimal numbers, "inf", "infinity" and "nan" 
+            read by strtod in the "C" locale. Decimal numbers with up to 19 significant 
+            digits whose value and power of ten are exactly representable are 
+            converted with a single multiplication or division; all other decimal 
+            numbers are converted by std::from_chars. All results are correctly 
+            rounded.
+
+            \param str The zero terminated string
+            \param parsedLen [out] The number of characters read
+            \param success [out] true if a number was read
+        */
         static double ParseDouble(const TChar* str, int &parsedLen, bool& success) 
         {
             static_assert(std::is_same<TChar, char>::value || std::is_same<TChar, wchar_t>::value, "TChar must be either char or wchar_t");
-            return ParseDoubleImpl(str, parsedLen, success, std::integral_constant<bool, std::is_same<TChar, char>::value>());
+
+            const TChar *p = str;
+            while (*p == ' ' || (*p >= '\t' && *p <= '\r'))
+                ++p;
+
+            bool bNeg = (*p == '-');
+            if (*p == '-' || *p == '+')
+                ++p;
+
+            if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && 
+                (IsHexDigit(p[2]) || (p[2] == '.' && IsHexDigit(p[3]))))
+            {
+                return ParseHex(str, p + 2, bNeg, parsedLen, success);
+            }
+
+            const TChar *pNum = p;
+            std::uint64_t nMant = 0;
+            int nSig = 0, nExp = 0;
+            bool bDigits = false, bInexact = false;
+
+            for (; IsDigit(*p); ++p)
+                AddDigit(*p - '0', false, nMant, nSig, nExp, bInexact, bDigits);
+
+            if (*p == '.')
+            {
+                for (++p; IsDigit(*p); ++p)
+                    AddDigit(*p - '0', true, nMant, nSig, nExp, bInexact, bDigits);
+            }
+
+            if (!bDigits)
+                return ParseSpecial(str, pNum, bNeg, parsedLen, success);
+
+            // The exponent is only read if it has digits
+            if (*p == 'e' || *p == 'E')
+            {
+                const TChar *q = p + 1;
+                bool bNegExp = (*q == '-');
+                if (*q == '-' || *q == '+')
+                    ++q;
+
+                if (IsDigit(*q))
+                {
+                    int nVal = 0;
+                    for (; IsDigit(*q); ++q)
+                    {
+                        if (nVal < 100000)
+                            nVal = nVal * 10 + (*q - '0');
+                    }
+
+                    nExp += (bNegExp) ? -nVal : nVal;
+                    p = q;
+                }
+            }
+
+            parsedLen = static_cast<int>(p - str);
+            success = true;
+
+            double val;
+            if (nMant == 0)
+            {
+                val = 0;
+            }
+            else if (!bInexact && nMant <= (std::uint64_t(1) << 53) && nExp >= -22 && nExp <= 22)
+            {
+                // Both the mantissa and the power of ten are exact, the result is 
+                // rounded once.
+                static const double fPow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+                                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+                val = (nExp < 0) ? (double)nMant / fPow10[-nExp] : (double)nMant * fPow10[nExp];
+            }
+            else
+            {
+                val = ParseSlow(pNum, p, nSig + nExp > 0);
+            }
+
+            return (bNeg) ? -val : val;
         }
 
     private:
@@ -65,22 +169,237 @@ class StringConversionHelper
             return std::wcslen(str);
         }
 
-        static double ParseDoubleImpl(const char* str, int &parsedLen, bool& success, std::true_type) 
+        static bool IsDigit(TChar c)
+        {
+            return c >= '0' && c <= '9';
+        }
+
+        static int HexDigit(TChar c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            else if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            else
+                return -1;
+        }
+
+        static bool IsHexDigit(TChar c)
+        {
+            return HexDigit(c) >= 0;
+        }
+
+        /** \brief Add a digit to the mantissa, only the first 19 significant digits are kept. */
+        static void AddDigit(int d, bool bFrac, std::uint64_t &nMant, int &nSig, int &nExp, bool &bInexact, bool &bDigits)
+        {
+            bDigits = true;
+            if (nSig < 19)
+            {
+                if (nMant != 0 || d != 0)
+                {
+                    nMant = nMant * 10 + d;
+                    ++nSig;
+                }
+
+                if (bFrac)
+                    --nExp;
+            }
+            else
+            {
+                bInexact |= (d != 0);
+                if (!bFrac)
+                    ++nExp;
+            }
+        }
+
+        /** \brief Convert the characters of a decimal number with std::from_chars. 
+        
+            If std::from_chars is not available the number is read by a stream 
+            using the "C" locale.
+        */
+        static double ParseSlow(const TChar *pBegin, const TChar *pEnd, bool bOverflow)
         {
-            char* endptr;
-            double value = std::strtod(str, &endptr);
-            success = (endptr != str);
-            parsedLen = endptr - str;
-            return value;
+            double val = 0;
+#if defined(__cpp_lib_to_chars)
+            std::from_chars_result res;
+            if constexpr (std::is_same<TChar, char>::value)
+            {
+                res = std::from_chars(pBegin, pEnd, val);
+            }
+            else
+            {
+                // Only digits, '.', 'e' and signs were read, they are plain ASCII
+                std::string sNum(pBegin, pEnd);
+                res = std::from_chars(sNum.data(), sNum.data() + sNum.length(), val);
+            }
+
+            if (res.ec == std::errc::result_out_of_range)
+                val = (bOverflow) ? std::numeric_limits<double>::infinity() : 0;
+#else
+            std::istringstream ss(std::string(pBegin, pEnd));
+            ss.imbue(std::locale::classic());
+            ss >> val;
+
+            // Streams fail if the number is out of range, denormal numbers may 
+            // be kept
+            if (ss.fail())
+                val = (bOverflow) ? std::numeric_limits<double>::infinity() : ((std::fabs(val) < 1) ? val : 0);
+#endif
+
+            return val;
         }
 
-        static double ParseDoubleImpl(const wchar_t* str, int &parsedLen, bool& success, std::false_type) 
+        /** \brief Read a hexadecimal number like strtod, i.e. 0x1.8p3.
+            \param str The start of the string
+            \param p The first character after "0x"
+            \param bNeg True if the number has a minus sign
+            \param parsedLen [out] The number of characters read
+            \param success [out] Always true
+
+            The first 15 significant digits are kept in the mantissa, any digit
+            after them only decides the rounding.
+        */
+        static double ParseHex(const TChar *str, const TChar *p, bool bNeg, int &parsedLen, bool &success)
         {
-            wchar_t* endptr;
-            double value = std::wcstod(str, &endptr);
-            success = (endptr != str);
-            parsedLen = endptr - str;
-            return value;
+            std::uint64_t nMant = 0;
+            int nSig = 0, nExp = 0;
+            bool bSticky = false;
+
+            for (bool bFrac = false; ; ++p)
+            {
+                if (*p == '.' && !bFrac)
+                {
+                    bFrac = true;
+                    continue;
+                }
+
+                int d = HexDigit(*p);
+                if (d < 0)
+                    break;
+
+                if (nSig < 15)
+                {
+                    if (nMant != 0 || d != 0)
+                    {
+                        nMant = nMant * 16 + d;
+                        ++nSig;
+                    }
+
+                    if (bFrac)
+                        nExp -= 4;
+                }
+                else
+                {
+                    bSticky |= (d != 0);
+                    if (!bFrac)
+                        nExp += 4;
+                }
+            }
+
+            // The binary exponent is only read if it has digits
+            if (*p == 'p' || *p == 'P')
+            {
+                const TChar *q = p + 1;
+                bool bNegExp = (*q == '-');
+                if (*q == '-' || *q == '+')
+                    ++q;
+
+                if (IsDigit(*q))
+                {
+                    int nVal = 0;
+                    for (; IsDigit(*q); ++q)
+                    {
+                        if (nVal < 100000)
+                            nVal = nVal * 10 + (*q - '0');
+                    }
+
+                    nExp += (bNegExp) ? -nVal : nVal;
+                    p = q;
+                }
+            }
+
+            parsedLen = static_cast<int>(p - str);
+            success = true;
+
+            double val = 0;
+            if (nMant != 0)
+            {
+                // Number of bits of the mantissa and of the result. Denormal 
+                // numbers have less than 53 bits.
+                int nBits = 0;
+                while (nBits < 64 && (nMant >> nBits) != 0)
+                    ++nBits;
+
+                int nTopExp = nExp + nBits - 1;
+                int nResBits = (nTopExp >= -1022) ? 53 : 53 - (-1022 - nTopExp);
+                if (nTopExp > 1023)
+                {
+                    val = std::numeric_limits<double>::infinity();
+                }
+                else if (nResBits >= 0)
+                {
+                    // Round to nearest, ties to even
+                    int nShift = nBits - nResBits;
+                    if (nShift > 0)
+                    {
+                        std::uint64_t nRem = nMant & ((std::uint64_t(1) << nShift) - 1);
+                        std::uint64_t nHalf = std::uint64_t(1) << (nShift - 1);
+                        nMant >>= nShift;
+                        nExp += nShift;
+                        if (nRem > nHalf || (nRem == nHalf && (bSticky || (nMant & 1) != 0)))
+                            ++nMant;
+                    }
+
+                    val = std::ldexp(static_cast<double>(nMant), nExp);
+                }
+            }
+
+            return (bNeg) ? -val : val;
+        }
+
+        /** \brief Read "inf", "infinity" or "nan" ignoring the case. */
+        static double ParseSpecial(const TChar *str, const TChar *p, bool bNeg, int &parsedLen, bool &success)
+        {
+            double val;
+            int len = 0;
+            if (Match(p, "infinity"))
+            {
+                val = std::numeric_limits<double>::infinity();
+                len = 8;
+            }
+            else if (Match(p, "inf"))
+            {
+                val = std::numeric_limits<double>::infinity();
+                len = 3;
+            }
+            else if (Match(p, "nan"))
+            {
+                val = std::numeric_limits<double>::quiet_NaN();
+                len = 3;
+            }
+            else
+            {
+                parsedLen = 0;
+                success = false;
+                return 0;
+            }
+
+            parsedLen = static_cast<int>(p + len - str);
+            success = true;
+            return (bNeg) ? -val : val;
+        }
+
+        static bool Match(const TChar *p, const char *szLower)
+        {
+            for (; *szLower; ++p, ++szLower)
+            {
+                if (*p != *szLower && *p != *szLower - 'a' + 'A')
+                    return false;
+            }
+
+            return true;
         }
 };
 
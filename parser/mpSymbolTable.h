@@ -0,0 +1,297 @@
+#ifndef MUP_SYMBOL_TABLE_H
+#define MUP_SYMBOL_TABLE_H
+
+/** \file
+    \brief Definition of the hash table used for the symbols of the parser.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "mpDefines.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief A sorted map of named symbols with a hash index for lookups by 
+             string view.
+
+    The symbols are kept in a std::map, iteration follows the alphabetical 
+    order of the names and the iterators are those of std::map. Each name is
+    stored once, in the map entry. The hash index refers to the entries by 
+    views of their names, so a token extracted from the expression is looked 
+    up without creating a string and without string comparisons. All changes 
+    go through the table so the index stays in sync with the map.
+
+    Names are not interned into integer ids stored in the tokens. Tokens are 
+    copied between parsers and compiled expressions that don't share a 
+    table, and clients identify them by IToken::GetIdent.
+  */
+  template<typename TChar, typename TVal>
+  class SymbolTable
+  {
+  public:
+
+    typedef std::basic_string<TChar> key_type;
+    typedef std::basic_string_view<TChar> view_type;
+
+  private:
+
+    // The transparent comparator allows lookups by views
+    typedef std::map<key_type, TVal, std::less<>> map_type;
+    typedef std::unordered_map<view_type, typename map_type::iterator> index_type;
+
+    map_type m_map;           ///< The symbols, owning their names
+    index_type m_mapIndex;    ///< Views of the names referring to the entries
+
+    //---------------------------------------------------------------------------
+    void Reindex()
+    {
+      m_mapIndex.clear();
+      m_mapIndex.reserve(m_map.size());
+      for (auto it = m_map.begin(); it != m_map.end(); ++it)
+        m_mapIndex.emplace(view_type(it->first), it);
+    }
+
+  public:
+
+    typedef TVal mapped_type;
+    typedef typename map_type::value_type value_type;
+    typedef typename map_type::size_type size_type;
+    typedef typename map_type::key_compare key_compare;
+    typedef typename map_type::iterator iterator;
+    typedef typename map_type::const_iterator const_iterator;
+    typedef typename map_type::reverse_iterator reverse_iterator;
+    typedef typename map_type::const_reverse_iterator const_reverse_iterator;
+
+    //---------------------------------------------------------------------------
+    SymbolTable()
+      :m_map()
+      ,m_mapIndex()
+    {}
+
+    //---------------------------------------------------------------------------
+    SymbolTable(const SymbolTable &a_Table)
+      :m_map(a_Table.m_map)
+      ,m_mapIndex()
+    {
+      Reindex();
+    }
+
+    //---------------------------------------------------------------------------
+    /** \brief Move a table, the entries and with them the views of the index stay valid. */
+    SymbolTable(SymbolTable &&a_Table) = default;
+
+    //---------------------------------------------------------------------------
+    SymbolTable& operator=(const SymbolTable &a_Table)
+    {
+      if (&a_Table != this)
+      {
+        m_map = a_Table.m_map;
+        Reindex();
+      }
+
+      return *this;
+    }
+
+    //---------------------------------------------------------------------------
+    SymbolTable& operator=(SymbolTable &&a_Table) = default;
+
+    //---------------------------------------------------------------------------
+    iterator begin()                        { return m_map.begin(); }
+    const_iterator begin() const            { return m_map.begin(); }
+    const_iterator cbegin() const           { return m_map.cbegin(); }
+    iterator end()                          { return m_map.end(); }
+    const_iterator end() const              { return m_map.end(); }
+    const_iterator cend() const             { return m_map.cend(); }
+    reverse_iterator rbegin()               { return m_map.rbegin(); }
+    const_reverse_iterator rbegin() const   { return m_map.rbegin(); }
+    reverse_iterator rend()                 { return m_map.rend(); }
+    const_reverse_iterator rend() const     { return m_map.rend(); }
+
+    //---------------------------------------------------------------------------
+    size_type size() const       { return m_map.size(); }
+    size_type max_size() const   { return m_map.max_size(); }
+    bool empty() const           { return m_map.empty(); }
+    key_compare key_comp() const { return m_map.key_comp(); }
+
+    //---------------------------------------------------------------------------
+    void clear()
+    {
+      m_mapIndex.clear();
+      m_map.clear();
+    }
+
+    //---------------------------------------------------------------------------
+    void swap(SymbolTable &a_Table)
+    {
+      m_map.swap(a_Table.m_map);
+      m_mapIndex.swap(a_Table.m_mapIndex);
+    }
+
+    //---------------------------------------------------------------------------
+    /** \brief Reserve space in the index for a number of symbols. */
+    void reserve(size_type a_nSize)
+    {
+      m_mapIndex.reserve(a_nSize);
+    }
+
+    //---------------------------------------------------------------------------
+    iterator find(view_type a_sName)
+    {
+      auto item = m_mapIndex.find(a_sName);
+      return (item != m_mapIndex.end()) ? item->second : m_map.end();
+    }
+
+    //---------------------------------------------------------------------------
+    const_iterator find(view_type a_sName) const
+    {
+      auto item = m_mapIndex.find(a_sName);
+      return (item != m_mapIndex.end()) ? const_iterator(item->second) : m_map.end();
+    }
+
+    //---------------------------------------------------------------------------
+    size_type count(view_type a_sName) const
+    {
+      return m_mapIndex.count(a_sName);
+    }
+
+    //---------------------------------------------------------------------------
+    iterator lower_bound(view_type a_sName)                { return m_map.lower_bound(a_sName); }
+    const_iterator lower_bound(view_type a_sName) const    { return m_map.lower_bound(a_sName); }
+    iterator upper_bound(view_type a_sName)                { return m_map.upper_bound(a_sName); }
+    const_iterator upper_bound(view_type a_sName) const    { return m_map.upper_bound(a_sName); }
+
+    std::pair<iterator, iterator> equal_range(view_type a_sName)                   { return m_map.equal_range(a_sName); }
+    std::pair<const_iterator, const_iterator> equal_range(view_type a_sName) const { return m_map.equal_range(a_sName); }
+
+    //---------------------------------------------------------------------------
+    TVal& at(view_type a_sName)
+    {
+      iterator it = find(a_sName);
+      if (it == m_map.end())
+        throw std::out_of_range("SymbolTable::at");
+
+      return it->second;
+    }
+
+    //---------------------------------------------------------------------------
+    const TVal& at(view_type a_sName) const
+    {
+      const_iterator it = find(a_sName);
+      if (it == m_map.end())
+        throw std::out_of_range("SymbolTable::at");
+
+      return it->second;
+    }
+
+    //---------------------------------------------------------------------------
+    /** \brief Return the symbol of a name, a default constructed symbol is added if the name is new. */
+    TVal& operator[](view_type a_sName)
+    {
+      auto item = m_mapIndex.find(a_sName);
+      if (item != m_mapIndex.end())
+        return item->second->second;
+
+      return emplace(key_type(a_sName), TVal()).first->second;
+    }
+
+    //---------------------------------------------------------------------------
+    std::pair<iterator, bool> insert(const value_type &a_Val)
+    {
+      return emplace(a_Val.first, a_Val.second);
+    }
+
+    //---------------------------------------------------------------------------
+    template<typename... TArgs>
+    std::pair<iterator, bool> emplace(TArgs&&... a_Args)
+    {
+      std::pair<iterator, bool> res = m_map.emplace(std::forward<TArgs>(a_Args)...);
+      if (res.second)
+        m_mapIndex.emplace(view_type(res.first->first), res.first);
+
+      return res;
+    }
+
+    //---------------------------------------------------------------------------
+    size_type erase(view_type a_sName)
+    {
+      auto item = m_mapIndex.find(a_sName);
+      if (item == m_mapIndex.end())
+        return 0;
+
+      // The index key views the name of the entry, drop it first
+      iterator it = item->second;
+      m_mapIndex.erase(item);
+      m_map.erase(it);
+      return 1;
+    }
+
+    //---------------------------------------------------------------------------
+    iterator erase(const_iterator a_it)
+    {
+      m_mapIndex.erase(view_type(a_it->first));
+      return m_map.erase(a_it);
+    }
+
+    //---------------------------------------------------------------------------
+    iterator erase(iterator a_it)
+    {
+      return erase(const_iterator(a_it));
+    }
+
+    //---------------------------------------------------------------------------
+    iterator erase(const_iterator a_itFirst, const_iterator a_itLast)
+    {
+      while (a_itFirst != a_itLast)
+        a_itFirst = erase(a_itFirst);
+
+      return m_map.erase(a_itLast, a_itLast);
+    }
+
+    //---------------------------------------------------------------------------
+    bool operator==(const SymbolTable &a_Table) const { return m_map == a_Table.m_map; }
+    bool operator!=(const SymbolTable &a_Table) const { return m_map != a_Table.m_map; }
+  }; // class SymbolTable
+
+MUP_NAMESPACE_END
+
+#endif
@@ -34,13 +34,24 @@
 	*/
 #include "mpTest.h"
 #include "mpValue.h"
-
+#include "mpSimdMath.h"
+#include "mpCompiledExpression.h"
+#include "mpNativeCache.h"
+#include "mpOprtFused.h"
+#include "mpRPNArchive.h"
+#include "mpFormulaGraph.h"
+#include "mpPreparedExpression.h"
+
+#include <clocale>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cstdint>
 #include <cmath>
 #include <iostream>
 #include <complex>
 #include <limits>
+#include <thread>
 
 #define MUP_CONST_PI  3.141592653589793238462643
 #define MUP_CONST_E   2.718281828459045235360287
@@ -49,6 +60,8 @@ using namespace std;
 
 MUP_NAMESPACE_START
 
+static bool IsIdentical(const IValue &v1, const IValue &v2);
+
 //-----------------------------------------------------------------------------------------------
 //
 // class OprtStrAdd
@@ -86,6 +99,89 @@ public:
 };
 
 
+class DbgOprtScale : public IOprtBin
+{
+public:
+
+	DbgOprtScale(const char_type *a_szIdent, float_type a_fScale)
+		:IOprtBin(a_szIdent, (int)prADD_SUB, oaLEFT)
+		,m_fScale(a_fScale)
+	{}
+
+
+	void Eval(ptr_val_type& ret, const ptr_val_type *arg, int argc)
+	{
+		MUP_VERIFY(argc == 2);
+		*ret = arg[0]->GetFloat() + m_fScale * arg[1]->GetFloat();
+	}
+
+
+	const char_type* GetDesc() const
+	{
+		return _T("internally used operator adding its scaled right operand for unit testing");
+	}
+
+
+	IToken* Clone() const
+	{
+		return new DbgOprtScale(*this);
+	}
+
+private:
+
+	float_type m_fScale;
+};
+
+
+class DbgValReader : public IValueReader
+{
+public:
+
+	DbgValReader(char_type a_cTag, float_type a_fVal, const char_type *a_szStart)
+		:IValueReader()
+		,m_cTag(a_cTag)
+		,m_fVal(a_fVal)
+		,m_szStart(a_szStart)
+	{}
+
+
+	virtual bool IsValue(string_view_type a_sExpr, int &a_iPos, Value &a_Val) override
+	{
+		++s_nCalls;
+		if (a_sExpr.substr(a_iPos, 2) != string_type({ _T('@'), m_cTag }))
+			return false;
+
+		a_Val = m_fVal;
+		a_iPos += 2;
+		return true;
+	}
+
+
+	virtual IValueReader* Clone(TokenReader *pTokenReader) const override
+	{
+		IValueReader *pReader = new DbgValReader(*this);
+		pReader->SetParent(pTokenReader);
+		return pReader;
+	}
+
+
+	virtual const char_type* GetStartChars() const override
+	{
+		return m_szStart;
+	}
+
+	static int s_nCalls;
+
+private:
+
+	char_type m_cTag;
+	float_type m_fVal;
+	const char_type *m_szStart;
+};
+
+int DbgValReader::s_nCalls = 0;
+
+
 class FunTest0 : public ICallback
 {
 public:
@@ -133,6 +229,38 @@ public:
 
 
 
+/** \brief Returns its argument and counts its calls. */
+class FunCount : public ICallback
+{
+public:
+	FunCount(const char_type *szIdent, bool bVolatile) : ICallback(cmFUNC, szIdent, 1)
+	{
+		if (bVolatile)
+			AddFlags(IToken::flVOLATILE);
+	}
+
+	virtual void Eval(ptr_val_type& ret, const ptr_val_type* a_pArg, int /*a_iArgc*/)
+	{
+		++s_nCalls;
+		*ret = *a_pArg[0];
+	}
+
+	virtual const char_type* GetDesc() const
+	{
+		return _T("");
+	}
+
+	virtual IToken* Clone() const
+	{
+		return new FunCount(*this);
+	}
+
+	static int s_nCalls;
+}; // class FunCount
+
+int FunCount::s_nCalls = 0;
+
+
 int ParserTester::c_iCount = 0;
 
 
@@ -157,6 +285,26 @@ ParserTester::ParserTester()
 	AddTest(&ParserTester::TestScript);
 	AddTest(&ParserTester::TestValReader);
 	AddTest(&ParserTester::TestIssueReports);
+	AddTest(&ParserTester::TestOptimizer);
+	AddTest(&ParserTester::TestRealEngine);
+	AddTest(&ParserTester::TestEvalBatch);
+	AddTest(&ParserTester::TestSimdMath);
+	AddTest(&ParserTester::TestCompiledExpr);
+	AddTest(&ParserTester::TestThreadedCode);
+	AddTest(&ParserTester::TestFusedTokens);
+	AddTest(&ParserTester::TestRPNCache);
+	AddTest(&ParserTester::TestRPNArchive);
+	AddTest(&ParserTester::TestFormulaGraph);
+	AddTest(&ParserTester::TestMemoization);
+	AddTest(&ParserTester::TestPreparedExpression);
+	AddTest(&ParserTester::TestLongExpression);
+	AddTest(&ParserTester::TestNumberParsing);
+	AddTest(&ParserTester::TestOprtLookup);
+	AddTest(&ParserTester::TestSymbolTable);
+	AddTest(&ParserTester::TestValReaderDispatch);
+	AddTest(&ParserTester::TestJit);
+	AddTest(&ParserTester::TestTieredJit);
+	AddTest(&ParserTester::TestNativeCache);
 
 	ParserTester::c_iCount = 0;
 }
@@ -1454,164 +1602,2462 @@ int ParserTester::TestValReader()
 }
 
 //---------------------------------------------------------------------------
-void ParserTester::AddTest(testfun_type a_pFun)
+int ParserTester::TestOptimizer()
 {
-	m_vTestFun.push_back(a_pFun);
+	int  iNumErr = 0;
+	*m_stream << _T("testing optimizer...");
+
+	// Constant subexpressions must collapse into a single value token
+	iNumErr += RpnSizeTest(_T("1+2-3*4/5^6*(2*(1-5+(3*7^9)*(4+6*7-3)))+12"), 1);
+	iNumErr += RpnSizeTest(_T("a+b-e*pi/5^6"), 5);
+	iNumErr += RpnSizeTest(_T("(1+b)*(-3)"), 5);
+	iNumErr += RpnSizeTest(_T("(cos(2.41)/b)"), 3);
+	iNumErr += RpnSizeTest(_T("sin(pi/2)+strlen(\"hello\")"), 1);
+	iNumErr += RpnSizeTest(_T("{1,2,3}*2"), 1);
+	iNumErr += RpnSizeTest(_T("a<b ? 1+2 : 3*4"), 8);
+
+	// Folding must not change the type of the result
+	iNumErr += RpnSizeTest(_T("1/0"), 3);
+	iNumErr += EqnTest(_T("1/0"), std::numeric_limits<float_type>::infinity(), true);
+	iNumErr += EqnTest(_T("-1/0"), -std::numeric_limits<float_type>::infinity(), true);
+
+	// Variables and assignments can't be folded
+	iNumErr += RpnSizeTest(_T("a*b"), 3);
+	iNumErr += RpnSizeTest(_T("a=1+2"), 3);
+
+	// Repeated subexpressions are computed once
+	iNumErr += RpnSizeTest(_T("sin(a+b)*sin(a+b)"), 7);
+	iNumErr += RpnSizeTest(_T("(a+b)*(a+b)*(a+b)"), 8);
+	iNumErr += RpnSizeTest(_T("(a+b)*(a<b ? a+b : 0)"), 13);
+	iNumErr += RpnSizeTest(_T("a<b ? a+b : a+b"), 12);     // first occurrence is conditional
+	iNumErr += RpnSizeTest(_T("(a+b)*(a=3)*(a+b)"), 11);   // assignment invalidates a+b
+	iNumErr += EqnTest(_T("sin(a+b)*sin(a+b)"), std::sin(3.0)*std::sin(3.0), true);
+	iNumErr += EqnTest(_T("(b+1)*(b+1)+(b+1)"), 12.0, true);
+	iNumErr += EqnTest(_T("(a+b)*(a<b ? a+b : 0)"), 9.0, true);
+	iNumErr += EqnTest(_T("(a+b)*(a>b ? a+b : 0)"), 0.0, true);
+	iNumErr += EqnTest(_T("a<b && (a+b)==3 ? (a+b)*2 : 0"), 6.0, true);
+	iNumErr += EqnTest(_T("(va*2)[0]+(va*2)[1]"), 6.0, true);
+
+	// Operators with constant operands are replaced by cheaper forms. The power
+	// operator of the complex package is not replaced since it uses std::pow.
+	iNumErr += RpnSizeTest(_T("a^2+b^2"), 7);
+	iNumErr += RpnSizeTest(_T("(a+b)^0.5"), 5);
+	iNumErr += RpnSizeTest(_T("a/4-b/3"), 5);
+	iNumErr += RpnSizeTest(_T("1*(a+b)*1"), 5);
+	iNumErr += RpnSizeTest(_T("-(-a)"), 2);
+	iNumErr += RpnSizeTest(_T("a^6"), 3);
+	iNumErr += RpnSizeTest(_T("a^b"), 3);
+	iNumErr += RpnSizeTest(_T("a^2*a^2"), 6);
+	iNumErr += OptimizerTest(_T("a^2"));
+	iNumErr += OptimizerTest(_T("a^3"));
+	iNumErr += OptimizerTest(_T("a^5"));
+	iNumErr += OptimizerTest(_T("a^0.5"));
+	iNumErr += OptimizerTest(_T("a/4"));
+	iNumErr += OptimizerTest(_T("a/3"));
+	iNumErr += OptimizerTest(_T("a/0.1"));
+	iNumErr += OptimizerTest(_T("a*1"));
+	iNumErr += OptimizerTest(_T("1*a"));
+	iNumErr += OptimizerTest(_T("a+0"));
+	iNumErr += OptimizerTest(_T("0+a"));
+	iNumErr += OptimizerTest(_T("a-0"));
+	iNumErr += OptimizerTest(_T("-(-a)"));
+	iNumErr += OptimizerTest(_T("-(-(a*0))"));
+	iNumErr += OptimizerTest(_T("(a*2)^2+(a*2)^2"));
+
+	Assessment(iNumErr);
+	return iNumErr;
 }
 
 //---------------------------------------------------------------------------
-void ParserTester::Run()
+int ParserTester::TestRealEngine()
 {
-	int iStat = 0;
-	try
-	{
-		for (int i = 0; i < (int)m_vTestFun.size(); ++i)
-			iStat += (this->*m_vTestFun[i])();
-	}
-	catch (ParserError &e)
-	{
-		*m_stream << e.GetMsg() << endl;
-		*m_stream << e.GetToken() << endl;
-		Abort();
-	}
-	catch (std::exception &e)
-	{
-		*m_stream << e.what() << endl;
-		Abort();
-	}
-	catch (...)
-	{
-		*m_stream << _T("Internal error");
-		Abort();
-	}
+	int  iNumErr = 0;
+	*m_stream << _T("testing real engine...");
+
+	// Arithmetic operators
+	iNumErr += RealEngineTest(_T("a*2+1"), true);
+	iNumErr += RealEngineTest(_T("(a+1)*(a-1)/3"), true);
+	iNumErr += RealEngineTest(_T("a*(-3)"), true);
+	iNumErr += RealEngineTest(_T("-a"), true);
+	iNumErr += RealEngineTest(_T("-(-a)"), true);
+	iNumErr += RealEngineTest(_T("a*1-0"), true);
+	iNumErr += RealEngineTest(_T("a/0"), true);
+	iNumErr += RealEngineTest(_T("a*a*1e300"), true);
+	iNumErr += RealEngineTest(_T("a^2"), true);
+	iNumErr += RealEngineTest(_T("a^6"), true);
+	iNumErr += RealEngineTest(_T("a^0.5"), true);
+	iNumErr += RealEngineTest(_T("a^-1"), true);
+	iNumErr += RealEngineTest(_T("a^3.5"), true);
+	iNumErr += RealEngineTest(_T("a/4+a/3"), true);
+	iNumErr += RealEngineTest(_T("a+0"), true);
+	iNumErr += RealEngineTest(_T("(a*2)^2+(a*2)^2"), true);
 
-	if (iStat == 0)
-	{
-		*m_stream << _T("Test passed (") << ParserTester::c_iCount << _T(" expressions)") << endl;
-	}
-	else
-	{
-		*m_stream << _T("Test failed with ") << iStat
-			<< _T(" errors (") << ParserTester::c_iCount
-			<< _T(" expressions)") << endl;
-	}
-	ParserTester::c_iCount = 0;
+	// Functions
+	iNumErr += RealEngineTest(_T("sin(a)+cos(a)*tan(a)"), true);
+	iNumErr += RealEngineTest(_T("sqrt(a)"), true);
+	iNumErr += RealEngineTest(_T("sqrt(a)*2"), true);
+	iNumErr += RealEngineTest(_T("exp(a)-ln(a)"), true);
+	iNumErr += RealEngineTest(_T("log(a)+log10(a)+log2(a)"), true);
+	iNumErr += RealEngineTest(_T("sinh(a)+cosh(a)+tanh(a)"), true);
+	iNumErr += RealEngineTest(_T("abs(a)"), true);
+	iNumErr += RealEngineTest(_T("pow(a,0.5)"), true);
+	iNumErr += RealEngineTest(_T("pow(a,2)"), true);
+
+	// Comparisons and conditionals
+	iNumErr += RealEngineTest(_T("a<1"), true);
+	iNumErr += RealEngineTest(_T("a==0 || a>=2"), true);
+	iNumErr += RealEngineTest(_T("a!=0 && a<=2"), true);
+	iNumErr += RealEngineTest(_T("a<1 ? a*2 : a/2"), true);
+	iNumErr += RealEngineTest(_T("a<1 ? 1 : 2"), true);
+	iNumErr += RealEngineTest(_T("a>0 ? (a>1 ? a*3 : a*4) : -a"), true);
+
+	// Results of other types or with the type of a variable
+	iNumErr += RealEngineTest(_T("a"), false);
+	iNumErr += RealEngineTest(_T("a<1 ? a : 2"), false);
+	iNumErr += RealEngineTest(_T("a<1 ? a*2 : a<2"), false);
+	iNumErr += RealEngineTest(_T("a<1 ? \"x\" : \"y\""), false);
+	iNumErr += RealEngineTest(_T("{1,2}*a"), false);
+	iNumErr += RealEngineTest(_T("a=1"), false);
+	iNumErr += RealEngineTest(_T("a*2, a*3"), false);
 
-#ifdef MUP_LEAKAGE_REPORT
-	// All tokens must have been destroyed by now, verify this
-	IToken::LeakageReport();
-#endif
+	Assessment(iNumErr);
+	return iNumErr;
 }
 
 //---------------------------------------------------------------------------
-int ParserTester::ThrowTest(const string_type &a_sExpr, int a_nErrc, int a_nPos, string_type a_sIdent)
+int ParserTester::TestEvalBatch()
 {
-	ParserTester::c_iCount++;
-
-	try
+	int  iNumErr = 0;
+	*m_stream << _T("testing batch evaluation...");
+
+	// Evaluated block wise
+	iNumErr += EvalBatchTest(_T("a*b+1"));
+	iNumErr += EvalBatchTest(_T("sin(a)+cos(b)"));
+	iNumErr += EvalBatchTest(_T("a^b-a^2"));
+	iNumErr += EvalBatchTest(_T("(a*2)^2+(a*2)^2"));
+	iNumErr += EvalBatchTest(_T("sqrt(a)*b"));
+	iNumErr += EvalBatchTest(_T("a*a*1e300"));
+	iNumErr += EvalBatchTest(_T("a<b"));
+
+	// Conditionals are evaluated row by row
+	iNumErr += EvalBatchTest(_T("a<1 ? a*b : a/b"));
+	iNumErr += EvalBatchTest(_T("a==0 || a>=2"));
+
+	// Evaluated by the generic engine
+	iNumErr += EvalBatchTest(_T("a"));
+	iNumErr += EvalBatchTest(_T("a<1 ? a : 2"));
+	iNumErr += EvalBatchTest(_T("a=a*b"));
+
+	// Evaluated by several threads
+	iNumErr += ParallelBatchTest(_T("sin(a)*b+a^2"));
+	iNumErr += ParallelBatchTest(_T("sqrt(a)*b"));
+	iNumErr += ParallelBatchTest(_T("a<1 ? a*b : a/b"));
+	iNumErr += ParallelBatchTest(_T("a<1 ? a : 2"));
+	iNumErr += ParallelBatchTest(_T("a=a*b"));
+	iNumErr += ParallelBatchTest(_T("a>199.999 ? {a,b} : a"));  // fails in several chunks
+
+	// Errors
 	{
-		ParserX p;
+		ParserTester::c_iCount++;
 
-		// Add variables
-		Value vVarVal[] = { 1., 2., 3., -2. };
-		p.DefineVar(_T("a"), Variable(&vVarVal[0]));
-		p.DefineVar(_T("b"), Variable(&vVarVal[1]));
-		p.DefineVar(_T("c"), Variable(&vVarVal[2]));
-		p.DefineVar(_T("d"), Variable(&vVarVal[3]));
+		Value a(_T("hello")), b((float_type)1.5);
+		ParserX p;
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
 
-		// Add functions
-		p.DefineFun(new FunReturnFalse);
+		const float_type col[] = { 0, 1, 2 };
+		float_type res[3];
+		column_maptype cols;
+		cols[_T("a")] = col;
 
-		// array variables
-		Value aVal1(3, 0);
-		aVal1.At(0) = (float_type)1.0;
-		aVal1.At(1) = (float_type)2.0;
-		aVal1.At(2) = (float_type)3.0;
+		const struct
+		{
+			const char_type* szExpr;
+			const char_type* szCol;
+			EErrorCodes eErrc;
+		}
+		errors[] =
+		{
+			{ _T("a<1 ? \"x\" : \"y\""), _T("a"), ecTYPE_CONFLICT },
+			{ _T("{1,2}*a"),               _T("a"), ecTYPE_CONFLICT },
+			{ _T("a*b"),                   _T("c"), ecUNASSIGNABLE_TOKEN },
+		};
 
-		Value aVal2(3, 0);
-		aVal2.At(0) = (float_type)4.0;
-		aVal2.At(1) = (float_type)3.0;
-		aVal2.At(2) = (float_type)2.0;
+		for (const auto& err : errors)
+		{
+			column_maptype errCols;
+			errCols[err.szCol] = col;
 
-		Value aVal3(4, 0);
-		aVal3.At(0) = (float_type)4.0;
-		aVal3.At(1) = (float_type)3.0;
-		aVal3.At(2) = (float_type)2.0;
-		aVal3.At(3) = (float_type)5.0;
+			EErrorCodes eErrc = ecUNDEFINED;
+			try
+			{
+				p.SetExpr(err.szExpr);
+				p.EvalBatch(errCols, res, 3);
+			}
+			catch (ParserError &e)
+			{
+				eErrc = e.GetCode();
+			}
 
-		Value aVal4(4, 0);
-		aVal4.At(0) = (float_type)4.0;
-		aVal4.At(1) = false;
-		aVal4.At(2) = _T("hallo");
+			if (eErrc != err.eErrc || a.GetType() != 's')
+			{
+				*m_stream << _T("\n  ") << err.szExpr << _T(" : batch evaluation did not fail as expected");
+				iNumErr++;
+			}
+		}
+	}
 
-		// Matrix variables
-		Value m1(3, 3, 0);
-		m1.At(0, 0) = 1.;
-		m1.At(1, 1) = 1.;
-		m1.At(2, 2) = 1.;
+	Assessment(iNumErr);
+	return iNumErr;
+}
 
-		Value m2(3, 3, 0);
-		m2.At(0, 0) = 1.;  m2.At(0, 1) = 2.;  m2.At(0, 2) = 3.;
-		m2.At(1, 0) = 4.;  m2.At(1, 1) = 5.;  m2.At(1, 2) = 6.;
-		m2.At(2, 0) = 7.;  m2.At(2, 1) = 8.;  m2.At(2, 2) = 9.;
+//---------------------------------------------------------------------------
+int ParserTester::TestCompiledExpr()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing compiled expressions...");
+
+	// Bytecode engine
+	iNumErr += CompiledExprTest(_T("a*b+1"));
+	iNumErr += CompiledExprTest(_T("sin(a)+cos(b)*a^2"));
+	iNumErr += CompiledExprTest(_T("(a*2)^2+(a*2)^2"));
+	iNumErr += CompiledExprTest(_T("a<1 ? a*b : a/b"));
+
+	// Generic engine
+	iNumErr += CompiledExprTest(_T("a"));
+	iNumErr += CompiledExprTest(_T("sqrt(a)*b"));
+	iNumErr += CompiledExprTest(_T("a^2-a/4"));
+	iNumErr += CompiledExprTest(_T("{1,2}*a"));
+	iNumErr += CompiledExprTest(_T("strlen(s)+a"));
+	iNumErr += CompiledExprTest(_T("a<1 ? s : \"x\""));
+	iNumErr += CompiledExprTest(_T("sum(a,b,3)"));
+	iNumErr += CompiledExprTest(_T("c=a*b"));
+
+	// Errors are reported with the expression of the compiled expression
+	{
+		ParserTester::c_iCount++;
 
-		p.DefineVar(_T("m1"), Variable(&m1));
-		p.DefineVar(_T("m2"), Variable(&m2));
-		p.DefineVar(_T("va"), Variable(&aVal1));
-		p.DefineVar(_T("vb"), Variable(&aVal2));
-		p.DefineVar(_T("vc"), Variable(&aVal3));
-		p.DefineVar(_T("vd"), Variable(&aVal4));
+		Value a(_T("hello"));
+		ParserX p;
+		p.DefineVar(_T("a"), Variable(&a));
+		p.SetExpr(_T("a*2"));
+		CompiledExpression expr(p);
+		p.SetExpr(_T("1"));
+
+		EvalContext ctx;
+		string_type sExpr;
+		try
+		{
+			expr.Eval(ctx);
+		}
+		catch (ParserError &e)
+		{
+			sExpr = e.GetExpr();
+		}
 
-		p.SetExpr(a_sExpr);
-		Value fRes = p.Eval();
+		if (sExpr != _T("a*2"))
+		{
+			*m_stream << _T("\n  a*2 : compiled expression did not report the error");
+			iNumErr++;
+		}
 	}
-	catch (ParserError &e)
+
+	// Threads sharing compiled expressions, each with its own context and variables
 	{
-		// output the formula in case of an failed test
-		if (a_nErrc != e.GetCode())
+		ParserTester::c_iCount++;
+
+		Value a((float_type)0), b((float_type)0.5);
+		ParserX p;
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.EnableOptimizer(true);
+
+		const char_type* szExpr[] = { _T("sin(a)*b+a^2-(a+b)/3"), _T("sqrt(a)*b+a^2+(a+b)^2") };
+		std::vector<CompiledExpression> vExpr;
+		for (const char_type* sz : szExpr)
 		{
-			*m_stream << _T("\n  ")
-				<< _T("Expression: \"") << a_sExpr
-				<< _T("\"  Code:") << e.GetCode()
-				<< _T("  Expected:") << a_nErrc;
+			p.SetExpr(sz);
+			vExpr.push_back(CompiledExpression(p));
 		}
 
-		// Check whether the error is reported at the correct expression position
-		if (a_nPos != -1 && a_nPos != e.GetPos())
+		const int nThreads = 4, nRows = 2000;
+		auto RowValue = [](int nThread, int nRow) { return (float_type)nRow * 0.01 - 10 + nThread; };
+
+		std::vector<cmplx_type> vRes(nThreads * nRows * vExpr.size());
+		std::vector<std::thread> vThread;
+		for (int t = 0; t < nThreads; ++t)
 		{
-			*m_stream << _T("\n  ")
-				<< _T("Invalid error position: \"") << a_sExpr
-				<< _T("\"  Pos:") << e.GetPos()
-				<< _T("  Expected:") << a_nPos;
+			vThread.push_back(std::thread([&, t]()
+			{
+				Value aLocal((float_type)0);
+				EvalContext ctx;
+				ctx.DefineVar(_T("a"), Variable(&aLocal));
+				for (int i = 0; i < nRows; ++i)
+				{
+					aLocal = RowValue(t, i);
+					for (std::size_t j = 0; j < vExpr.size(); ++j)
+						vRes[(t * nRows + i) * vExpr.size() + j] = vExpr[j].Eval(ctx).GetComplex();
+				}
+			}));
 		}
 
-		if (a_sIdent.length() && a_sIdent != e.GetContext().Ident)
+		for (std::thread& thread : vThread)
+			thread.join();
+
+		int nFailed = 0;
+		for (std::size_t j = 0; j < vExpr.size(); ++j)
 		{
-			*m_stream << _T("\n  ")
-				<< _T("Invalid identifier: \"") << a_sExpr
-				<< _T("\"  Ident:") << e.GetContext().Ident
-				<< _T("  Expected:") << a_sIdent;
+			p.SetExpr(szExpr[j]);
+			for (int t = 0; t < nThreads; ++t)
+			{
+				for (int i = 0; i < nRows; ++i)
+				{
+					a = RowValue(t, i);
+					if (p.Eval().GetComplex() != vRes[(t * nRows + i) * vExpr.size() + j])
+						nFailed++;
+				}
+			}
+
+			if (nFailed != 0)
+			{
+				*m_stream << _T("\n  ") << szExpr[j] << _T(" : ") << nFailed << _T(" different results evaluated by several threads");
+				iNumErr++;
+			}
 		}
 
-		return (a_nErrc == e.GetCode() && (a_nPos == -1 || a_nPos == e.GetPos())) ? 0 : 1;
+		if (a.GetFloat() != RowValue(nThreads - 1, nRows - 1) || b.GetFloat() != 0.5)
+		{
+			*m_stream << _T("\n  evaluation by several threads changed the variables of the parser");
+			iNumErr++;
+		}
 	}
 
-	*m_stream << _T("\n  ")
-		<< _T("Expression failed: \"")
-		<< a_sExpr
-		<< _T("\"  (no exception raised).");
-
-	return 1;
+	Assessment(iNumErr);
+	return iNumErr;
 }
 
 //---------------------------------------------------------------------------
-int ParserTester::EqnTest(const string_type &a_str, Value a_val, bool a_fPass, int nExprVar, bool evaluateOnce)
+int ParserTester::TestThreadedCode()
 {
-	ParserTester::c_iCount++;
-	int iRet(1);
-	Value fVal[5];
+	int  iNumErr = 0;
+	*m_stream << _T("testing threaded code...");
+
+	// Built in operators with real numbers and other types
+	iNumErr += ThreadedCodeTest(_T("a+b*c"));
+	iNumErr += ThreadedCodeTest(_T("a-b/c"));
+	iNumErr += ThreadedCodeTest(_T("(a+1)*(b-2)/(c+3)"));
+	iNumErr += ThreadedCodeTest(_T("a<b || a>c || a<=b && b>=c"));
+	iNumErr += ThreadedCodeTest(_T("a==b || a!=c"));
+	iNumErr += ThreadedCodeTest(_T("(a<b)==(b<a)"));
+	iNumErr += ThreadedCodeTest(_T("a+1i*b"));
+	iNumErr += ThreadedCodeTest(_T("{1,2}+{a,b}"));
+	iNumErr += ThreadedCodeTest(_T("{a,b}*c"));
+	iNumErr += ThreadedCodeTest(_T("s==\"hello\""));
+
+	// Functions, index operator, conditionals and assignments
+	iNumErr += ThreadedCodeTest(_T("sin(a)+sum(a,b,c)"));
+	iNumErr += ThreadedCodeTest(_T("{a,b,c}[a>0 ? 1 : 0]"));
+	iNumErr += ThreadedCodeTest(_T("a>0 ? (b>1 ? a*3 : a*4) : -a"));
+	iNumErr += ThreadedCodeTest(_T("a>0 && b>0 ? s : \"x\""));
+	iNumErr += ThreadedCodeTest(_T("c=a*b"));
+	iNumErr += ThreadedCodeTest(_T("c+=a*b"));
+	iNumErr += ThreadedCodeTest(_T("(a*2)^2+(a*2)^2"));
+	iNumErr += ThreadedCodeTest(_T("a"));
+	iNumErr += ThreadedCodeTest(_T("s"));
+	iNumErr += ThreadedCodeTest(_T("a>0 || b"));
+	iNumErr += ThreadedCodeTest(_T("a>0 ? b : 3"));
+	iNumErr += ThreadedCodeTest(_T("sum(a, b*2, 3) + a*(b-1)"));
+	iNumErr += ThreadedCodeTest(_T("c=a, c+b"));
+	iNumErr += ThreadedCodeTest(_T("{a,b}[1]+{a,b}[0]*2"));
+
+	// Errors
+	iNumErr += ThreadedCodeTest(_T("a+s"));
+	iNumErr += ThreadedCodeTest(_T("a<s"));
+	iNumErr += ThreadedCodeTest(_T("{1,2}+{a,b,c}"));
+	iNumErr += ThreadedCodeTest(_T("sum(a>0?1,0,0:3)"));
 
-	try
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestFusedTokens()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing superinstructions...");
+
+	// Short token sequences are replaced by a single token
+	iNumErr += RpnSizeTest(_T("a+b*a"), 5, 1);
+	iNumErr += RpnSizeTest(_T("a*b+a"), 5, 1);
+	iNumErr += RpnSizeTest(_T("a*2"), 3, 1);
+	iNumErr += RpnSizeTest(_T("a<b"), 3, 1);
+	iNumErr += RpnSizeTest(_T("sin(a)"), 2, 1);
+	iNumErr += RpnSizeTest(_T("-a"), 2, 1);
+	iNumErr += RpnSizeTest(_T("sin(a)+a*b"), 6, 3);
+	iNumErr += RpnSizeTest(_T("a*b-a/b"), 7, 3);
+	iNumErr += RpnSizeTest(_T("sum(a,b)"), 3, 3);
+
+	// Fused tokens must not change results or errors
+	iNumErr += OptimizerTest(_T("a*a+a"));
+	iNumErr += OptimizerTest(_T("a+a*2"));
+	iNumErr += OptimizerTest(_T("a*1i+a"));
+	iNumErr += OptimizerTest(_T("sin(a)+a*a"));
+	iNumErr += OptimizerTest(_T("-a+a/3"));
+	iNumErr += OptimizerTest(_T("a<1 || a>=2"));
+	iNumErr += OptimizerTest(_T("a+\"x\""));
+	iNumErr += OptimizerTest(_T("a*{1,2}+a"));
+	iNumErr += RealEngineTest(_T("a*a+a"), true);
+	iNumErr += RealEngineTest(_T("a+a*2+a*a*3"), true);
+	iNumErr += RealEngineTest(_T("sin(a)-a/2"), true);
+	iNumErr += ThreadedCodeTest(_T("a*b+c"));
+	iNumErr += ThreadedCodeTest(_T("c+a*b"));
+	iNumErr += ThreadedCodeTest(_T("-a+sin(b)"));
+	iNumErr += ThreadedCodeTest(_T("a*s+b"));
+	iNumErr += ThreadedCodeTest(_T("(a<b)+a*1i"));
+
+	// Fused tokens evaluated as callbacks give the same results as the parser
+	{
+		Value a(cmplx_type(1, 2)), b((float_type)3);
+		ParserX p;
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.EnableOptimizer(true);
+		p.SetExpr(_T("a*2i+b"));
+		p.Eval();
+
+		const token_vec_type &vRPN = p.GetRPN().GetData();
+		OprtFused *pFused = (vRPN.size() == 1 && vRPN[0]->GetCode() == cmFUSED) ? static_cast<OprtFused*>(vRPN[0].Get()) : nullptr;
+		for (int i = 0; i < 2 && pFused != nullptr; ++i)
+		{
+			ParserTester::c_iCount++;
+			a = cmplx_type(1 + i, 2);
+
+			val_vec_type vArg;
+			for (const ptr_tok_type &tok : pFused->GetTokens())
+			{
+				if (tok->GetCode() == cmVAL)
+					vArg.push_back(ptr_val_type(tok->AsIValue()));
+			}
+
+			ptr_val_type ret(new Value);
+			pFused->Eval(ret, vArg.data(), (int)vArg.size());
+			if (!IsIdentical(*ret, p.Eval()))
+			{
+				*m_stream << _T("\n  a*2i+b : fused token evaluated as callback differs from the parser (")
+					<< *ret << _T(" / ") << p.Eval() << _T(")");
+				iNumErr++;
+			}
+		}
+
+		if (pFused == nullptr)
+		{
+			*m_stream << _T("\n  a*2i+b : expression was not fused");
+			iNumErr++;
+		}
+	}
+
+	// With fused multiply add the product is not rounded. 0.1*10 is
+	// exactly one after rounding, but not before.
+	const float_type fExpected = std::fma((float_type)0.1, (float_type)10, (float_type)-1);
+	const EPackages packages[] = { pckALL_COMPLEX, pckALL_NON_COMPLEX };
+	const char_type* szExpr[] = { _T("a*b+c"), _T("c+a*b") };
+	for (const EPackages package : packages)
+	{
+		for (const char_type* sExpr : szExpr)
+		{
+			for (int nMode = 0; nMode < 4; ++nMode)
+			{
+				ParserTester::c_iCount++;
+
+				Value a((float_type)0.1), b((float_type)10), c((float_type)-1);
+				ParserX p(package);
+				p.DefineVar(_T("a"), Variable(&a));
+				p.DefineVar(_T("b"), Variable(&b));
+				p.DefineVar(_T("c"), Variable(&c));
+				p.EnableOptimizer(true);
+				p.EnableFusedMultiplyAdd(true);
+				p.EnableRealEngine(nMode == 1);
+				p.EnableThreadedCode(nMode == 2);
+				p.EnableRegisterCode(nMode == 3);
+				p.SetExpr(sExpr);
+
+				Value res[2];
+				res[0] = p.Eval();
+				p.EnableOptimizer(false);
+				p.SetExpr(sExpr);
+				res[1] = p.Eval();
+				if (res[0].GetType() != 'f' || res[0].GetFloat() != fExpected || res[1].GetFloat() != 0)
+				{
+					*m_stream << _T("\n  ") << sExpr << _T(" : unexpected result of the fused multiply add (")
+						<< res[0] << _T(" / ") << res[1] << _T(")");
+					iNumErr++;
+				}
+			}
+		}
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestRPNCache()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing the RPN cache...");
+
+	Value a((float_type)1.5), b((float_type)2), s(_T("hello"));
+	ParserX p, p2;
+	for (ParserX* pParser : { &p, &p2 })
+	{
+		pParser->DefineVar(_T("a"), Variable(&a));
+		pParser->DefineVar(_T("b"), Variable(&b));
+		pParser->DefineVar(_T("s"), Variable(&s));
+		pParser->EnableOptimizer(true);
+	}
+	p.SetRPNCacheSize(4);
+
+	// Results and errors of cached expressions must be identical to the ones of
+	// a parser without cache
+	const char_type* szExpr[] = { _T("a+b"), _T("a<b ? s : \"x\""), _T("{a,b}[1]*2"), _T("a*s"), _T("c=a*b, c+1"), _T("a+b") };
+	for (int nPass = 0; nPass < 2; ++nPass)
+	{
+		for (const char_type* sExpr : szExpr)
+		{
+			ParserTester::c_iCount++;
+
+			Value vRes[2];
+			string_type sErr[2];
+			std::size_t nVar[2] = { 0, 0 };
+			ParserX* pParser[2] = { &p, &p2 };
+			for (int i = 0; i < 2; ++i)
+			{
+				try
+				{
+					pParser[i]->SetExpr(sExpr);
+					nVar[i] = pParser[i]->GetExprVar().size();
+					vRes[i] = pParser[i]->Eval();
+				}
+				catch (ParserError &e)
+				{
+					sErr[i] = e.GetMsg();
+				}
+			}
+
+			if (sErr[0] != sErr[1] || nVar[0] != nVar[1] || (sErr[0].empty() && !IsIdentical(vRes[0], vRes[1])))
+			{
+				*m_stream << _T("\n  ") << sExpr << _T(" : cached RPN changed the result");
+				iNumErr++;
+			}
+		}
+	}
+
+	// Both GetExprVar and Eval look up the expression. Only expressions without
+	// syntax errors are stored, the last one is found in the first pass.
+	const RPNCache& cache = p.GetRPNCache();
+	ParserTester::c_iCount++;
+	if (cache.GetSize() != 4 || cache.GetHits() != 12 || cache.GetMisses() != 10)
+	{
+		*m_stream << _T("\n  unexpected RPN cache statistics (hits=") << cache.GetHits() 
+			<< _T("; misses=") << cache.GetMisses() << _T(")");
+		iNumErr++;
+	}
+
+	// The least recently used entries are dropped, changed definitions 
+	// invalidate the entries
+	ParserTester::c_iCount++;
+	p.SetRPNCacheSize(2);
+	p.RemoveVar(_T("b"));
+	p.DefineConst(_T("b"), Value((float_type)10));
+	p.SetExpr(_T("a+b"));
+	if (cache.GetSize() != 2 || p.Eval().GetFloat() != 11.5 || cache.GetHits() != 12)
+	{
+		*m_stream << _T("\n  a+b : RPN cache used an outdated entry");
+		iNumErr++;
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestRPNArchive()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing RPN archives...");
+
+	const char_type* szExpr[] = { 
+		_T("a*b+1"), _T("a+b*a"), _T("sin(a)+cos(b)*a^2"), _T("(a*2)^2+(a*2)^2"), _T("a<1 ? a*b : a/b"), 
+		_T("a>0 && b>0 || a<-5"), _T("{1,2,3}*a"), _T("{a,b}[1]"), _T("strlen(s)+a"), _T("s==\"hello\""),
+		_T("sum(a,b,3)"), _T("-(-a)+a/4+a*1+a^0.5"), _T("3+4i*a"), _T("1e300*a+0"), _T("a*2\nb+1"), 
+		_T("a*s"), _T("{1,{2,3}}[0]") };
+
+	// Expressions loaded from the archive must compute the same results as the
+	// expressions compiled by the parser. The second parser binds the 
+	// variables to other values.
+	for (int nOptimizer = 0; nOptimizer < 3; ++nOptimizer)
+	{
+		Value a((float_type)1.5), b((float_type)-2), s(_T("hello"));
+		Value a2((float_type)0.5), b2((float_type)3), s2(_T("world"));
+		ParserX p, p2;
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.DefineVar(_T("s"), Variable(&s));
+		p.EnableOptimizer(nOptimizer > 0);
+		p.EnableFusedMultiplyAdd(nOptimizer == 2);
+		p2.DefineVar(_T("a"), Variable(&a2));
+		p2.DefineVar(_T("b"), Variable(&b2));
+		p2.DefineVar(_T("s"), Variable(&s2));
+
+		RPNArchiveWriter writer;
+		std::vector<CompiledExpression> vExpr;
+		for (const char_type* sExpr : szExpr)
+		{
+			p.SetExpr(sExpr);
+			vExpr.push_back(CompiledExpression(p));
+			writer.Add(vExpr.back());
+		}
+
+		const std::vector<char> vData = writer.GetData();
+		RPNArchive archive(vData.data(), vData.size());
+		for (std::size_t i = 0; i < vExpr.size(); ++i)
+		{
+			ParserTester::c_iCount++;
+
+			CompiledExpression expr[2] = { vExpr[i], archive.Load(i, p) };
+			CompiledExpression expr2 = archive.Load(i, p2);
+			p2.SetExpr(szExpr[i]);
+			p2.EnableOptimizer(nOptimizer > 0);
+			p2.EnableFusedMultiplyAdd(nOptimizer == 2);
+			CompiledExpression expr2Parsed(p2);
+
+			Value vRes[4];
+			string_type sErr[4];
+			const CompiledExpression* pExpr[4] = { &expr[0], &expr[1], &expr2Parsed, &expr2 };
+			for (int k = 0; k < 4; ++k)
+			{
+				try
+				{
+					EvalContext ctx;
+					vRes[k] = pExpr[k]->Eval(ctx);
+				}
+				catch (ParserError &e)
+				{
+					sErr[k] = e.GetMsg();
+				}
+			}
+
+			bool bOk = archive.GetExpr(i) == szExpr[i] && expr[0].IsRealEngineUsed() == expr[1].IsRealEngineUsed();
+			for (int k = 0; k < 4; k += 2)
+			{
+				bOk = bOk && sErr[k] == sErr[k + 1] && (!sErr[k].empty() || IsIdentical(vRes[k], vRes[k + 1]));
+			}
+
+			if (!bOk)
+			{
+				*m_stream << _T("\n  ") << szExpr[i] << _T(" : archived expression changed the result (")
+					<< vRes[0] << _T(" / ") << vRes[1] << sErr[0] << _T(" / ") << sErr[1] << _T(")");
+				iNumErr++;
+			}
+		}
+	}
+
+	// Names must be defined by the parser loading the expression
+	{
+		ParserTester::c_iCount++;
+
+		Value a((float_type)1);
+		ParserX p, p2;
+		p.DefineVar(_T("a"), Variable(&a));
+		p.SetExpr(_T("a+1"));
+
+		RPNArchiveWriter writer;
+		writer.Add(CompiledExpression(p));
+		std::vector<char> vData = writer.GetData();
+
+		EErrorCodes eErr = ecUNDEFINED;
+		try
+		{
+			RPNArchive(vData.data(), vData.size()).Load(0, p2);
+		}
+		catch (ParserError &e)
+		{
+			eErr = e.GetCode();
+		}
+
+		if (eErr != ecUNASSIGNABLE_TOKEN)
+		{
+			*m_stream << _T("\n  a+1 : undefined variable was not reported");
+			iNumErr++;
+		}
+
+		// Damaged or truncated archives
+		ParserTester::c_iCount++;
+		int nRejected = 0;
+		std::vector<char> vDamaged(vData);
+		vDamaged[0] = 'X';
+		for (int i = 0; i < 2; ++i)
+		{
+			try
+			{
+				if (i == 0)
+					RPNArchive(vData.data(), vData.size() - 8);
+				else
+					RPNArchive(vDamaged.data(), vDamaged.size());
+			}
+			catch (ParserError &e)
+			{
+				nRejected += e.GetCode() == ecINVALID_ARCHIVE;
+			}
+		}
+
+		if (nRejected != 2)
+		{
+			*m_stream << _T("\n  invalid archive was not rejected");
+			iNumErr++;
+		}
+	}
+
+	// Damaged jump offsets and stack sizes must be rejected when the expression is loaded
+	{
+		ParserTester::c_iCount++;
+
+		Value a((float_type)1), b((float_type)2);
+		ParserX p;
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.SetExpr(_T("a<1 ? a*b : a/b"));
+
+		RPNArchiveWriter writer;
+		writer.Add(CompiledExpression(p));
+		const std::vector<char> vData = writer.GetData();
+
+		// Locate the record of the expression and its if token; the file header
+		// stores the offset of the directory at byte 32, the expression header 
+		// takes 40 bytes and the token records 32 bytes each.
+		std::uint64_t nDir = 0, nRec = 0;
+		std::memcpy(&nDir, &vData[32], sizeof(nDir));
+		std::memcpy(&nRec, &vData[(std::size_t)nDir], sizeof(nRec));
+		std::size_t nIf = 0;
+		for (std::size_t nTok = nRec + 40; nTok + 32 <= vData.size() && nIf == 0; nTok += 32)
+		{
+			std::int32_t nCode = 0;
+			std::memcpy(&nCode, &vData[nTok + 4], sizeof(nCode));
+			if (nCode == cmIF)
+				nIf = nTok;
+		}
+
+		const std::int32_t nVal[3] = { 100000, -3, 1 };
+		const std::size_t nPos[3] = { nIf + 16, nIf + 16, (std::size_t)nRec + 20 };
+		int nRejected = 0;
+		for (int i = 0; i < 3 && nIf != 0; ++i)
+		{
+			std::vector<char> vDamaged(vData);
+			std::memcpy(&vDamaged[nPos[i]], &nVal[i], sizeof(nVal[i]));
+			try
+			{
+				RPNArchive(vDamaged.data(), vDamaged.size()).Load(0, p);
+			}
+			catch (ParserError &e)
+			{
+				nRejected += e.GetCode() == ecINVALID_ARCHIVE;
+			}
+		}
+
+		if (nRejected != 3)
+		{
+			*m_stream << _T("\n  a<1 ? a*b : a/b : damaged offset or stack size was not rejected");
+			iNumErr++;
+		}
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestFormulaGraph()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing formula graphs...");
+
+	for (int nOptimizer = 0; nOptimizer < 2; ++nOptimizer)
+	{
+		Value x((float_type)1), y((float_type)2), a, b, c, d, r;
+		ParserX p;
+		p.DefineVar(_T("x"), Variable(&x));
+		p.DefineVar(_T("y"), Variable(&y));
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.DefineVar(_T("c"), Variable(&c));
+		p.DefineVar(_T("d"), Variable(&d));
+		p.DefineVar(_T("r"), Variable(&r));
+		p.EnableOptimizer(nOptimizer != 0);
+
+		// Formulas are sorted by their levels, the result of the last one is 
+		// assigned by the graph
+		FormulaGraph graph;
+		const char_type* szExpr[] = { _T("d = c>5 ? c*2 : -1"), _T("a = x+1"), _T("b = a*y"), _T("c = a+b"), _T("x*10") };
+		for (const char_type* sExpr : szExpr)
+		{
+			p.SetExpr(sExpr);
+			graph.AddFormula(p, (sExpr == szExpr[4]) ? _T("r") : _T(""));
+		}
+
+		ParserTester::c_iCount++;
+		const std::vector<std::size_t>& vOrder = graph.GetOrder();
+		std::size_t nEval = graph.Recompute();
+		if (vOrder != std::vector<std::size_t>{ 1, 4, 2, 3, 0 } || nEval != 5 || 
+			d.GetFloat() != 12 || r.GetFloat() != 10 || graph.GetResult(2).GetFloat() != 4)
+		{
+			*m_stream << _T("\n  unexpected order or results of the formulas");
+			iNumErr++;
+		}
+
+		// Only the formulas depending on changed variables are evaluated. The
+		// left operand of "=" is not read.
+		ParserTester::c_iCount++;
+		y = (float_type)3;
+		graph.SetDirty(_T("y"));
+		graph.SetDirty(_T("r"));
+		nEval = graph.Recompute();
+		graph.SetDirty(_T("a"));
+		if (nEval != 3 || b.GetFloat() != 6 || d.GetFloat() != 16 || graph.GetNumDirty() != 2)
+		{
+			*m_stream << _T("\n  unexpected formulas recomputed after changing y");
+			iNumErr++;
+		}
+
+		ParserTester::c_iCount++;
+		x = (float_type)2;
+		graph.SetDirty(_T("x"));
+		nEval = graph.Recompute();
+		if (nEval != 5 || c.GetFloat() != 12 || d.GetFloat() != 24 || r.GetFloat() != 20 || graph.GetNumDirty() != 0)
+		{
+			*m_stream << _T("\n  unexpected formulas recomputed after changing x");
+			iNumErr++;
+		}
+
+		// Cyclic dependencies are reported
+		ParserTester::c_iCount++;
+		graph.Clear();
+		p.SetExpr(_T("a = b"));
+		graph.AddFormula(p);
+		p.SetExpr(_T("b = a+1"));
+		graph.AddFormula(p);
+		EErrorCodes eErr = ecUNDEFINED;
+		try
+		{
+			graph.Recompute();
+		}
+		catch (ParserError &exc)
+		{
+			eErr = exc.GetCode();
+		}
+
+		if (eErr != ecCYCLIC_DEPENDENCY)
+		{
+			*m_stream << _T("\n  cyclic dependency was not detected");
+			iNumErr++;
+		}
+	}
+
+	// Independent formulas evaluated by several threads give the same results
+	// as the ones evaluated by the calling thread
+	{
+		const int nFormulas = 64;
+		Value x((float_type)1.5), y((float_type)2);
+		std::vector<Value> vRes(nFormulas);
+		auto Name = [](const char_type *szPrefix, int i)
+		{
+			stringstream_type ss;
+			ss << szPrefix << i;
+			return ss.str();
+		};
+
+		ParserX p;
+		p.DefineVar(_T("x"), Variable(&x));
+		p.DefineVar(_T("y"), Variable(&y));
+		for (int i = 0; i < nFormulas; ++i)
+			p.DefineVar(Name(_T("r"), i), Variable(&vRes[i]));
+
+		FormulaGraph graph[2];
+		graph[1].SetThreads(4);
+		for (FormulaGraph &g : graph)
+		{
+			for (int i = 0; i < nFormulas; ++i)
+			{
+				string_type sVar = Name(_T("r"), i);
+				p.SetExpr((i < nFormulas / 2) ? Name(_T("x*"), i) : sVar + Name(_T(" = y + r"), i - nFormulas / 2));
+				g.AddFormula(p, (i < nFormulas / 2) ? sVar : string_type());
+			}
+		}
+
+		for (int nPass = 0; nPass < 2; ++nPass)
+		{
+			ParserTester::c_iCount++;
+			std::size_t nEval[2];
+			std::vector<float_type> vSum[2];
+			for (int i = 0; i < 2; ++i)
+			{
+				nEval[i] = graph[i].Recompute();
+				for (const Value &val : vRes)
+					vSum[i].push_back(val.GetFloat());
+			}
+
+			if (nEval[0] != nEval[1] || vSum[0] != vSum[1] || vSum[1].back() != y.GetFloat() + 31 * x.GetFloat())
+			{
+				*m_stream << _T("\n  concurrent recomputation changed the results");
+				iNumErr++;
+			}
+
+			x = (float_type)2.5;
+			graph[0].SetDirty(_T("x"));
+			graph[1].SetDirty(_T("x"));
+		}
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestMemoization()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing the memoization of results...");
+
+	Value a((float_type)1), b((float_type)2), v(3, 0.0);
+	ParserX p;
+	p.DefineVar(_T("a"), Variable(&a));
+	p.DefineVar(_T("b"), Variable(&b));
+	p.DefineVar(_T("v"), Variable(&v));
+	p.DefineFun(ptr_cal_type(new FunCount(_T("count"), false)));
+	p.DefineFun(ptr_cal_type(new FunCount(_T("vcount"), true)));
+	p.EnableMemoization(true);
+
+	// The result is reused until a variable is modified
+	ParserTester::c_iCount++;
+	FunCount::s_nCalls = 0;
+	p.SetExpr(_T("count(a)*b"));
+	p.Eval();
+	float_type fRes[3];
+	fRes[0] = p.Eval().GetFloat();
+	a = (float_type)2;
+	fRes[1] = p.Eval().GetFloat();
+	b += Value((float_type)1);
+	fRes[2] = p.Eval().GetFloat();
+	p.Eval();
+	if (fRes[0] != 2 || fRes[1] != 4 || fRes[2] != 6 || FunCount::s_nCalls != 3)
+	{
+		*m_stream << _T("\n  count(a)*b : unexpected memoized results");
+		iNumErr++;
+	}
+
+	// Volatile functions and assignments disable the memoization
+	ParserTester::c_iCount++;
+	FunCount::s_nCalls = 0;
+	for (const char_type* sExpr : { _T("vcount(a)"), _T("b = count(a)") })
+	{
+		p.SetExpr(sExpr);
+		p.Eval();
+		p.Eval();
+	}
+
+	if (FunCount::s_nCalls != 4)
+	{
+		*m_stream << _T("\n  volatile expressions were not reevaluated");
+		iNumErr++;
+	}
+
+	// Modifying matrix elements through At changes the version of the matrix
+	ParserTester::c_iCount++;
+	FunCount::s_nCalls = 0;
+	p.SetExpr(_T("count(v[1])"));
+	p.Eval();
+	p.Eval();
+	v.At(1) = (float_type)5;
+	if (p.Eval().GetFloat() != 5 || FunCount::s_nCalls != 2)
+	{
+		*m_stream << _T("\n  count(v[1]) : modified matrix element was not detected");
+		iNumErr++;
+	}
+
+	ParserTester::c_iCount++;
+	FunCount::s_nCalls = 0;
+	p.EnableMemoization(false);
+	p.Eval();
+	p.Eval();
+	if (FunCount::s_nCalls != 2)
+	{
+		*m_stream << _T("\n  count(v[1]) : result reused with memoization disabled");
+		iNumErr++;
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestPreparedExpression()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing prepared expressions...");
+
+	Value x((float_type)2), y((float_type)3);
+	ParserX p;
+	p.DefineVar(_T("x"), Variable(&x));
+	p.DefineVar(_T("y"), Variable(&y));
+
+	// Literals become parameters of the shape
+	ParserTester::c_iCount++;
+	PreparedExpression prep(p, _T("x*0.37 + y*1.2"));
+	const std::vector<float_type> &vLit = prep.GetLiterals();
+	if (prep.GetNumParams() != 2 || vLit.size() != 2 || vLit[0] != 0.37 || vLit[1] != 1.2)
+	{
+		*m_stream << _T("\n  x*0.37 + y*1.2 : unexpected parameters");
+		iNumErr++;
+	}
+
+	ParserTester::c_iCount++;
+	EvalContext ctx;
+	const float_type fParam[] = { 0.41, 0.9 };
+	p.SetExpr(_T("x*0.41 + y*0.9"));
+	if (prep.Eval(ctx, fParam).GetFloat() != p.Eval().GetFloat())
+	{
+		*m_stream << _T("\n  x*0.37 + y*1.2 : wrong result for new parameters");
+		iNumErr++;
+	}
+
+	// Expressions differing only in their literals share a shape; constants, 
+	// postfix operators and integer literals are handled
+	ParserTester::c_iCount++;
+	PreparedExpressionCache cache(p);
+	const char_type *sExpr[] = { _T("x*0.37 + y*1.2"), _T("x*5 + y*0x10"), _T("sin(x)*3m"), 
+		                         _T("sin(x)*4m"), _T("pi*2 + x"), _T("pi*7 + x"), _T("x*0.37 + y*x") };
+	const std::size_t nShape[] = { 1, 1, 2, 2, 3, 3, 4 };
+	std::vector<float_type> vParam;
+	for (std::size_t i = 0; i < sizeof(nShape) / sizeof(nShape[0]); ++i)
+	{
+		std::shared_ptr<const PreparedExpression> pPrep = cache.Prepare(sExpr[i], vParam);
+		p.SetExpr(sExpr[i]);
+		if (cache.GetSize() != nShape[i] || vParam.size() != pPrep->GetNumParams() ||
+			std::fabs(pPrep->Eval(ctx, vParam.data()).GetFloat() - p.Eval().GetFloat()) > 1e-12)
+		{
+			*m_stream << _T("\n  ") << sExpr[i] << _T(" : shape was not reused or wrong result");
+			iNumErr++;
+		}
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestLongExpression()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing long expressions...");
+
+	Value a((float_type)0.5);
+	ParserX p;
+	p.DefineVar(_T("a"), Variable(&a));
+
+	// Generated expression of about 90 KB; every value reader is used and 
+	// the last token ends the expression
+	ParserTester::c_iCount++;
+	const int nTerms = 2000;
+	stringstream_type ss;
+	for (int i = 0; i < nTerms; ++i)
+		ss << _T("0x1f+0b101+2.5e0*a+(true?1:0)+strlen(\"ab\")+");
+	ss << _T("0x10");
+
+	p.SetExpr(ss.str());
+	if (p.Eval().GetFloat() != nTerms * (31 + 5 + 1.25 + 1 + 2) + 16)
+	{
+		*m_stream << _T("\n  long expression : wrong result");
+		iNumErr++;
+	}
+
+	// Values at the end of the expression
+	ParserTester::c_iCount++;
+	const char_type *sExpr[] = { _T("0b11"), _T("0xff"), _T("1.5i"), _T("false"), _T("\"a\\\"\"") };
+	const Value vRes[] = { Value((float_type)3), Value((float_type)255), Value(cmplx_type(0, 1.5)), Value(false), Value(string_type(_T("a\""))) };
+	for (std::size_t i = 0; i < sizeof(sExpr) / sizeof(sExpr[0]); ++i)
+	{
+		p.SetExpr(sExpr[i]);
+		if (!(p.Eval() == vRes[i]))
+		{
+			*m_stream << _T("\n  ") << sExpr[i] << _T(" : value was not read");
+			iNumErr++;
+		}
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestNumberParsing()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing number parsing...");
+
+	ParserX p;
+
+	// Results must be correctly rounded
+	struct SNum
+	{
+		const char_type *sExpr;
+		float_type fVal;
+	} vNum[] = {
+		{ _T("0.1"), 0.1 },
+		{ _T("3.14159265358979323846264338327950"), 3.141592653589793 },
+		{ _T("123456789012345678901234567890"), 1.2345678901234568e29 },
+		{ _T("9007199254740993"), 9007199254740992.0 },
+		{ _T("2.2250738585072014e-308"), 2.2250738585072014e-308 },
+		{ _T("4.9e-324"), 4.9e-324 },
+		{ _T("1e-400"), 0 },
+		{ _T("0.000000000000000000000000000001e30"), 1 },
+		{ _T("1.7976931348623157e308"), 1.7976931348623157e308 },
+		{ _T("0x7fffffff"), 2147483647 },
+		{ _T("0b1010"), 10 },
+
+		// Hexadecimal floating point numbers as read by strtod. Numbers starting 
+		// with "0x" and a hex digit are integers read by the hex value reader.
+		{ _T("0X1.8P1"), 3 },
+		{ _T("0x.8p1"), 1 },
+		{ _T("0X1A"), 26 },
+		{ _T("-0X1P-2"), -0.25 },
+		{ _T("0X1.FFFFFFFFFFFFFP1023"), 1.7976931348623157e308 },
+		{ _T("0X1P1024"), std::numeric_limits<float_type>::infinity() },
+		{ _T("0X1P-1074"), 4.9e-324 },
+		{ _T("0X1.8P-1074"), 9.9e-324 },
+		{ _T("0X1P-1075"), 0 },
+		{ _T("0X1.0000000001P-1075"), 4.9e-324 },
+		{ _T("0X1.00000000000008P0"), 1 },
+		{ _T("0X1.00000000000018P0"), 1.0000000000000004 },
+		{ _T("0X1.000000000000080000000001P0"), 1.0000000000000002 },
+		{ _T("0X100000000000000000000P-80"), 1 }
+	};
+
+	for (const SNum &num : vNum)
+	{
+		ParserTester::c_iCount++;
+		p.SetExpr(num.sExpr);
+		if (p.Eval().GetFloat() != num.fVal)
+		{
+			*m_stream << _T("\n  ") << num.sExpr << _T(" : wrong value");
+			iNumErr++;
+		}
+	}
+
+	// The decimal point does not depend on the locale
+	ParserTester::c_iCount++;
+	const std::string sLocale = std::setlocale(LC_NUMERIC, nullptr);
+	if (std::setlocale(LC_NUMERIC, "de_DE.UTF-8") != nullptr || std::setlocale(LC_NUMERIC, "de_DE") != nullptr)
+	{
+		p.SetExpr(_T("1.5+2.25"));
+		if (p.Eval().GetFloat() != 3.75)
+		{
+			*m_stream << _T("\n  1.5+2.25 : wrong value in the de_DE locale");
+			iNumErr++;
+		}
+
+		std::setlocale(LC_NUMERIC, sLocale.c_str());
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestOprtLookup()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing the operator lookup...");
+
+	ParserX p;
+	p.DefineOprt(new DbgSillyAdd);
+	p.DefineOprt(new DbgOprtScale(_T("<+>"), 10));
+	p.DefineOprt(new DbgOprtScale(_T("<+>>"), 100));
+
+	// The longest operator is found
+	struct SOprt
+	{
+		const char_type *sExpr;
+		float_type fVal;
+	} vOprt[] = {
+		{ _T("1++2"), 3 },
+		{ _T("1+2"), 3 },
+		{ _T("1<+>2"), 21 },
+		{ _T("1<+>>2"), 201 },
+		{ _T("1<+>-2"), -19 },
+		{ _T("1<2"), 1 }
+	};
+
+	for (const SOprt &oprt : vOprt)
+	{
+		ParserTester::c_iCount++;
+		p.SetExpr(oprt.sExpr);
+		if (p.Eval().GetFloat() != oprt.fVal)
+		{
+			*m_stream << _T("\n  ") << oprt.sExpr << _T(" : wrong operator");
+			iNumErr++;
+		}
+	}
+
+	// Removing and redefining operators rebuilds the lookup
+	ParserTester::c_iCount++;
+	p.RemoveOprt(_T("<+>>"));
+	p.SetExpr(_T("1<+>2"));
+	float_type fRes = p.Eval().GetFloat();
+	p.DefineOprt(new DbgOprtScale(_T("<+>>"), 1000));
+	p.SetExpr(_T("1<+>>2"));
+	if (fRes != 21 || p.Eval().GetFloat() != 2001)
+	{
+		*m_stream << _T("\n  1<+>>2 : operator lookup was not rebuilt");
+		iNumErr++;
+	}
+
+	// Copies of the parser look up their own operators
+	ParserTester::c_iCount++;
+	ParserX p2(p);
+	p.RemoveOprt(_T("<+>>"));
+	p2.SetExpr(_T("1<+>>2"));
+	if (p2.Eval().GetFloat() != 2001)
+	{
+		*m_stream << _T("\n  1<+>>2 : copied parser lost its operator");
+		iNumErr++;
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestSymbolTable()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing the symbol table...");
+
+	auto Name = [](const char_type *szPrefix, int i)
+	{
+		stringstream_type ss;
+		ss << szPrefix << i;
+		return ss.str();
+	};
+
+	// Many variables, each one is found by the token reader
+	ParserTester::c_iCount++;
+	const int nVar = 50000;
+	std::vector<Value> vVal(nVar);
+	ParserX p;
+	for (int i = 0; i < nVar; ++i)
+	{
+		vVal[i] = (float_type)i;
+		p.DefineVar(Name(_T("x"), i), Variable(&vVal[i]));
+	}
+
+	p.SetExpr(_T("x0 + x12345 + x49999"));
+	if (p.GetVar().size() != nVar || p.Eval().GetFloat() != 12345 + 49999)
+	{
+		*m_stream << _T("\n  x0 + x12345 + x49999 : variable lookup failed");
+		iNumErr++;
+	}
+
+	// Copies of the parser index their own entries
+	ParserTester::c_iCount++;
+	ParserX p2(p);
+	p.RemoveVar(_T("x12345"));
+	p.ClearVar();
+	p2.SetExpr(_T("x12345*2"));
+	if (p2.Eval().GetFloat() != 24690 || p.IsVarDefined(_T("x12345")) || !p2.IsVarDefined(_T("x12345")))
+	{
+		*m_stream << _T("\n  x12345*2 : copied symbol table lost a variable");
+		iNumErr++;
+	}
+
+	// Removed names can be defined again
+	ParserTester::c_iCount++;
+	Value a((float_type)1), b((float_type)2);
+	ParserX p3;
+	p3.DefineVar(_T("c"), Variable(&b));
+	p3.DefineVar(_T("b"), Variable(&b));
+	p3.DefineVar(_T("a"), Variable(&a));
+	p3.RemoveVar(_T("b"));
+	p3.DefineVar(_T("b"), Variable(&a));
+	p3.SetExpr(_T("a+b"));
+	const var_maptype &vars = p3.GetVar();
+	if (p3.Eval().GetFloat() != 2 || vars.size() != 3 || vars.count(_T("b")) != 1)
+	{
+		*m_stream << _T("\n  a+b : redefined variable not found");
+		iNumErr++;
+	}
+
+	// Iteration follows the alphabetical order like std::map
+	ParserTester::c_iCount++;
+	string_type sNames;
+	for (const auto &item : vars)
+		sNames += item.first;
+
+	if (sNames != _T("abc") || vars.lower_bound(_T("bb"))->first != _T("c") || vars.rbegin()->first != _T("c"))
+	{
+		*m_stream << _T("\n  symbols are not sorted (") << sNames << _T(")");
+		iNumErr++;
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestValReaderDispatch()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing the value reader dispatch...");
+
+	ParserX p;
+	p.AddValueReader(new DbgValReader(_T('a'), 10, nullptr));
+	p.AddValueReader(new DbgValReader(_T('b'), 20, _T("@")));
+
+	// Readers with and without start characters read their values
+	ParserTester::c_iCount++;
+	p.SetExpr(_T("@a+@b*2"));
+	if (p.Eval().GetFloat() != 50)
+	{
+		*m_stream << _T("\n  @a+@b*2 : custom value reader failed");
+		iNumErr++;
+	}
+
+	// Only the reader without start characters is tried for other tokens
+	ParserTester::c_iCount++;
+	Value x((float_type)1);
+	p.DefineVar(_T("x"), Variable(&x));
+	DbgValReader::s_nCalls = 0;
+	p.SetExpr(_T("x+1"));
+	p.Eval();
+	int nCalls = DbgValReader::s_nCalls;
+
+	ParserX p2(p);
+	DbgValReader::s_nCalls = 0;
+	p2.SetExpr(_T("@b"));
+	if (nCalls != 1 || p2.Eval().GetFloat() != 20 || DbgValReader::s_nCalls != 2)
+	{
+		*m_stream << _T("\n  unexpected value reader calls");
+		iNumErr++;
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestJit()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing machine code...");
+
+	const bool bSupported = JitEngine::IsSupported();
+	Value a((float_type)1.5), s(_T("hello"));
+	ParserX p;
+	p.DefineVar(_T("a"), Variable(&a));
+	p.DefineVar(_T("s"), Variable(&s));
+
+	// Expressions the bytecode engine can't evaluate are interpreted
+	ParserTester::c_iCount++;
+	p.SetExpr(_T("strlen(s)+a"));
+	if (p.Compile(jitNATIVE) || p.Eval().GetFloat() != 6.5)
+	{
+		*m_stream << _T("\n  strlen(s)+a : expression was compiled to machine code");
+		iNumErr++;
+	}
+
+	// The mode is kept for new expressions
+	ParserTester::c_iCount++;
+	p.SetExpr(_T("a*a+1"));
+	if (p.Eval().GetFloat() != 3.25 || p.GetJitEngine().IsValid() != bSupported)
+	{
+		*m_stream << _T("\n  a*a+1 : machine code mode was not kept for a new expression");
+		iNumErr++;
+	}
+
+	// Variables changing their type fall back to the generic engine
+	ParserTester::c_iCount++;
+	a = cmplx_type(1, 1);
+	if (p.Eval().GetComplex() != cmplx_type(1, 2))
+	{
+		*m_stream << _T("\n  a*a+1 : machine code did not fall back to the generic engine");
+		iNumErr++;
+	}
+
+	ParserTester::c_iCount++;
+	a = (float_type)2;
+	if (p.Compile(jitNONE) || p.GetJitEngine().IsValid() || p.Eval().GetFloat() != 5)
+	{
+		*m_stream << _T("\n  a*a+1 : machine code was not disabled");
+		iNumErr++;
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestTieredJit()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing tiered compilation...");
+
+	const bool bSupported = JitEngine::IsSupported();
+	Value a((float_type)1.5), s(_T("hello"));
+	ParserX p;
+	p.DefineVar(_T("a"), Variable(&a));
+	p.DefineVar(_T("s"), Variable(&s));
+	p.SetTierUpThreshold(3);
+	p.SetExpr(_T("a*a+1"));
+
+	// Expressions start with the generic engine
+	ParserTester::c_iCount++;
+	if (p.Compile(jitTIERED) || p.Eval().GetFloat() != 3.25 || p.Eval().GetFloat() != 3.25 || p.GetRealEngine().IsValid())
+	{
+		*m_stream << _T("\n  a*a+1 : expression was compiled before reaching the threshold");
+		iNumErr++;
+	}
+
+	// and are compiled in the background once they are evaluated often
+	ParserTester::c_iCount++;
+	int nEvals = 0;
+	for (; nEvals < 100000 && !p.GetRealEngine().IsValid(); ++nEvals)
+	{
+		if (p.Eval().GetFloat() != 3.25)
+			break;
+
+		std::this_thread::yield();
+	}
+
+	if (!p.GetRealEngine().IsValid() || p.GetJitEngine().IsValid() != bSupported || p.Eval().GetFloat() != 3.25)
+	{
+		*m_stream << _T("\n  a*a+1 : expression was not compiled after ") << nEvals << _T(" evaluations");
+		iNumErr++;
+	}
+
+	// New expressions start over
+	ParserTester::c_iCount++;
+	p.SetExpr(_T("a*2"));
+	if (p.Eval().GetFloat() != 3 || p.GetRealEngine().IsValid())
+	{
+		*m_stream << _T("\n  a*2 : expression was compiled before reaching the threshold");
+		iNumErr++;
+	}
+
+	// Expressions the bytecode engine can't evaluate stay with the generic engine
+	ParserTester::c_iCount++;
+	p.SetExpr(_T("strlen(s)+a"));
+	for (nEvals = 0; nEvals < 100; ++nEvals)
+	{
+		if (p.Eval().GetFloat() != 6.5 || p.GetRealEngine().IsValid())
+		{
+			*m_stream << _T("\n  strlen(s)+a : wrong result in tiered mode");
+			iNumErr++;
+			break;
+		}
+	}
+
+	// EvalBatch compiles the expression right away
+	ParserTester::c_iCount++;
+	p.SetExpr(_T("a*3"));
+	const float_type vCol[] = { 1, 2, 3 };
+	float_type vRes[3] = { 0 };
+	column_maptype columns;
+	columns[_T("a")] = vCol;
+	p.EvalBatch(columns, vRes, 3);
+	if (vRes[0] != 3 || vRes[1] != 6 || vRes[2] != 9 || !p.GetRealEngine().IsValid())
+	{
+		*m_stream << _T("\n  a*3 : EvalBatch did not compile the expression");
+		iNumErr++;
+	}
+
+	ParserTester::c_iCount++;
+	try
+	{
+		p.SetTierUpThreshold(0);
+		*m_stream << _T("\n  SetTierUpThreshold(0) : invalid threshold was accepted");
+		iNumErr++;
+	}
+	catch (const ParserError&)
+	{}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns true if two values have the same type and the same bits. */
+static bool IsIdentical(const IValue &v1, const IValue &v2)
+{
+	if (v1.GetType() != v2.GetType())
+		return false;
+
+	switch (v1.GetType())
+	{
+	case 'i':
+	case 'f':
+	case 'c':
+	{
+		const cmplx_type &c1 = v1.GetComplex(), &c2 = v2.GetComplex();
+		return (c1 == c2 || (c1 != c1 && c2 != c2)) &&
+			std::signbit(c1.real()) == std::signbit(c2.real()) &&
+			std::signbit(c1.imag()) == std::signbit(c2.imag());
+	}
+
+	case 'm':
+		if (v1.GetRows() != v2.GetRows() || v1.GetCols() != v2.GetCols())
+			return false;
+
+		for (int i = 0; i < v1.GetRows(); ++i)
+		{
+			for (int j = 0; j < v1.GetCols(); ++j)
+			{
+				if (!IsIdentical(v1.GetArray().At(i, j), v2.GetArray().At(i, j)))
+					return false;
+			}
+		}
+		return true;
+
+	default:
+		return v1 == v2;
+	}
+}
+
+//---------------------------------------------------------------------------
+/** \brief Check expressions compiled to shared libraries by a NativeCache.
+
+	The native code must give the same results as the interpreter. The 
+	libraries are built only if a compiler is installed.
+*/
+int ParserTester::TestNativeCache()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing native code cache...");
+
+	const char* szTmp = std::getenv("TMPDIR");
+	const std::string sDir = std::string((szTmp != nullptr) ? szTmp : "/tmp") + "/muparserx_test_cache";
+	const bool bNative = NativeCache::IsSupported() && std::system("c++ --version > /dev/null 2>&1") == 0;
+
+	const string_type sExpr[] = {
+		_T("a<b ? sin(a)*b^2 : sqrt(b)-a/3"),
+		_T("(a>0 && b<3) || a==b ? -a*2 : ln(b)+a^0.5"),
+		_T("cos(a)+a^3/b+abs(-a)")
+	};
+
+	const EPackages packages[] = { pckALL_COMPLEX, pckALL_NON_COMPLEX };
+	const float_type vals[] = { -1.5, 0.5, 3, 0 };
+
+	NativeCache cache(sDir);
+	for (const EPackages package : packages)
+	{
+		Value a((float_type)0), b((float_type)2);
+		ParserX p(package);
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+
+		for (const string_type &str : sExpr)
+		{
+			ParserTester::c_iCount++;
+			p.SetExpr(str);
+			CompiledExpression expr(p);
+			CompiledExpression native = cache.Load(expr);
+			if (native.IsNativeCodeUsed() != bNative)
+			{
+				*m_stream << _T("\n  ") << str << _T(" : expression was not compiled to native code");
+				iNumErr++;
+				continue;
+			}
+
+			EvalContext ctx;
+			for (const float_type va : vals)
+			{
+				for (const float_type vb : vals)
+				{
+					a = va;
+					b = vb;
+					Value v1 = p.Eval();
+					Value v2 = native.Eval(ctx);
+					if (!IsIdentical(v1, v2))
+					{
+						*m_stream << _T("\n  ") << str << _T(" : native code and interpreter differ (a=") << va << _T(", b=") << vb << _T(")");
+						iNumErr++;
+					}
+				}
+			}
+		}
+	}
+
+	// Equivalent bytecode shares a library
+	ParserTester::c_iCount++;
+	std::size_t nSize = cache.GetSize();
+	{
+		Value a((float_type)1), b((float_type)2);
+		ParserX p(pckALL_NON_COMPLEX);
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.SetExpr(_T("cos( a ) + a^3 / b + abs(-a)"));
+		if (cache.Load(CompiledExpression(p)).IsNativeCodeUsed() != bNative || cache.GetSize() != nSize)
+		{
+			*m_stream << _T("\n  cached library was not reused");
+			iNumErr++;
+		}
+	}
+
+	// A new cache loads the libraries from the directory
+	ParserTester::c_iCount++;
+	{
+		NativeCache cache2(sDir);
+		Value a((float_type)1), b((float_type)2);
+		ParserX p(pckALL_NON_COMPLEX);
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.SetExpr(sExpr[2]);
+		if (cache2.Load(CompiledExpression(p)).IsNativeCodeUsed() != bNative || cache2.GetNumBuilds() != 0)
+		{
+			*m_stream << _T("\n  library was not loaded from the cache directory");
+			iNumErr++;
+		}
+	}
+
+	// Threads loading the same expression share a library
+	ParserTester::c_iCount++;
+	{
+		NativeCache cache3(sDir);
+		Value a((float_type)1), b((float_type)2);
+		ParserX p(pckALL_NON_COMPLEX);
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.SetExpr(sExpr[0]);
+		CompiledExpression expr(p);
+
+		bool bUsed[4];
+		std::vector<std::thread> vThreads;
+		for (int i = 0; i < 4; ++i)
+			vThreads.emplace_back([&, i]() { bUsed[i] = cache3.Load(expr).IsNativeCodeUsed(); });
+
+		for (std::thread &t : vThreads)
+			t.join();
+
+		bool bStat = cache3.GetSize() == (bNative ? 1u : 0u);
+		for (bool bUse : bUsed)
+			bStat &= bUse == bNative;
+
+		if (!bStat)
+		{
+			*m_stream << _T("\n  concurrent loads did not share a library");
+			iNumErr++;
+		}
+	}
+
+	if (bNative)
+	{
+		Value a((float_type)1), b((float_type)2);
+		ParserX p(pckALL_NON_COMPLEX);
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.SetExpr(sExpr[2]);
+
+		// Libraries are not loaded from directories others can write to
+		ParserTester::c_iCount++;
+		const std::string sShared = sDir + "_shared";
+		std::system(("mkdir -p '" + sShared + "' && chmod 777 '" + sShared + "'").c_str());
+		NativeCache cache4(sShared);
+		if (cache4.Load(CompiledExpression(p)).IsNativeCodeUsed() || cache4.GetNumBuilds() != 0)
+		{
+			*m_stream << _T("\n  library was loaded from a directory writable by others");
+			iNumErr++;
+		}
+
+		// The compiler is not started by a shell
+		ParserTester::c_iCount++;
+		NativeCache cache5(sDir + "/\"$(exit 1)`exit 1`");
+		if (!cache5.Load(CompiledExpression(p)).IsNativeCodeUsed())
+		{
+			*m_stream << _T("\n  library was not built in a directory with special characters");
+			iNumErr++;
+		}
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Check that the optimizer does not change the result of an expression.
+
+	The expression is evaluated with and without the optimizer using the complex
+	and the non complex package. The variable a is set to values of different
+	types, including -0. Results must be identical, errors must have the same
+	message.
+*/
+int ParserTester::OptimizerTest(const string_type &a_str)
+{
+	ParserTester::c_iCount++;
+
+	Value vec(3, 0);
+	vec.At(0) = (float_type)1.0;
+	vec.At(1) = (float_type)-0.0;
+	vec.At(2) = (float_type)-2.5;
+
+	// 1.0274^3 computed by std::pow differs from 1.0274*1.0274*1.0274 in the last bit
+	const Value vals[] = { Value((float_type)-0.0), Value((float_type)0.0), Value((float_type)2.0),
+		Value((float_type)-3.5), Value((float_type)1.0274), Value((float_type)1e300), Value(cmplx_type(1, -2)), vec,
+		Value(true), Value(_T("hello")) };
+
+	const EPackages packages[] = { pckALL_COMPLEX, pckALL_NON_COMPLEX };
+
+	for (const EPackages package : packages)
+	{
+		for (const Value& val : vals)
+		{
+			string_type sRes[2];
+			Value res[2];
+			for (int i = 0; i < 2; ++i)
+			{
+				Value a(val);
+				ParserX p(package);
+				p.DefineVar(_T("a"), Variable(&a));
+				p.EnableOptimizer(i == 1);
+				p.SetExpr(a_str);
+
+				try
+				{
+					res[i] = p.Eval();
+				}
+				catch (ParserError &e)
+				{
+					sRes[i] = e.GetMsg();
+				}
+			}
+
+			if (sRes[0] != sRes[1] || (sRes[0].empty() && !IsIdentical(res[0], res[1])))
+			{
+				*m_stream << _T("\n  ") << a_str << _T(" : optimizer changed the result for a=") << val
+					<< _T(" (") << res[0] << _T(" / ") << res[1] << sRes[0] << _T(" / ") << sRes[1] << _T(")");
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Check that the real engine computes the same result as the generic engine.
+	\param a_str The expression.
+	\param a_bCompiled True if the expression must be compiled for the real engine.
+
+	Like OptimizerTest but comparing the generic engine with the real engine. 
+	Each evaluation is repeated with and without the optimizer. Values of
+	the variable a that are not real numbers must be passed to the generic
+	engine.
+*/
+int ParserTester::RealEngineTest(const string_type &a_str, bool a_bCompiled)
+{
+	ParserTester::c_iCount++;
+
+	Value vec(3, 0);
+	vec.At(0) = (float_type)1.0;
+	vec.At(1) = (float_type)-0.0;
+	vec.At(2) = (float_type)-2.5;
+
+	const Value vals[] = { Value((float_type)-0.0), Value((float_type)0.0), Value((float_type)2.0),
+		Value((float_type)-3.5), Value((float_type)0.25), Value((float_type)1e300), 
+		Value(std::numeric_limits<float_type>::infinity()), Value(std::numeric_limits<float_type>::quiet_NaN()),
+		Value(cmplx_type(1, -2)), vec, Value(true), Value(_T("hello")) };
+
+	const EPackages packages[] = { pckALL_COMPLEX, pckALL_NON_COMPLEX };
+
+	for (const EPackages package : packages)
+	{
+		for (int nOptimizer = 0; nOptimizer < 2; ++nOptimizer)
+		{
+			for (const Value& val : vals)
+			{
+				// Generic engine, bytecode engine and machine code
+				string_type sRes[3];
+				Value res[3];
+				for (int i = 0; i < 3; ++i)
+				{
+					Value a(val);
+					ParserX p(package);
+					p.DefineVar(_T("a"), Variable(&a));
+					p.EnableOptimizer(nOptimizer == 1);
+					p.EnableRealEngine(i >= 1);
+					p.SetExpr(a_str);
+
+					try
+					{
+						if (i == 2)
+							p.Compile(jitNATIVE);
+
+						res[i] = p.Eval();
+
+						// Evaluate twice since the first evaluation creates the bytecode
+						res[i] = p.Eval();
+					}
+					catch (ParserError &e)
+					{
+						sRes[i] = e.GetMsg();
+					}
+
+					if (i == 1 && p.GetRealEngine().IsValid() != a_bCompiled)
+					{
+						*m_stream << _T("\n  ") << a_str << _T(" : expression was ") << (a_bCompiled ? _T("not ") : _T(""))
+							<< _T("compiled for the real engine");
+						return 1;
+					}
+
+					if (i == 2 && p.GetJitEngine().IsValid() != (a_bCompiled && JitEngine::IsSupported()))
+					{
+						*m_stream << _T("\n  ") << a_str << _T(" : expression was ") << (a_bCompiled ? _T("not ") : _T(""))
+							<< _T("compiled to machine code");
+						return 1;
+					}
+				}
+
+				for (int i = 1; i < 3; ++i)
+				{
+					if (sRes[0] != sRes[i] || (sRes[0].empty() && !IsIdentical(res[0], res[i])))
+					{
+						*m_stream << _T("\n  ") << a_str << _T(" : ") << ((i == 1) ? _T("real engine") : _T("machine code")) 
+							<< _T(" changed the result for a=") << val
+							<< _T(" (") << res[0] << _T(" / ") << res[i] << sRes[0] << _T(" / ") << sRes[i] << _T(")");
+						return 1;
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of floating point numbers between two values. */
+static std::int64_t UlpDistance(float_type v1, float_type v2)
+{
+	std::int64_t i1, i2;
+	std::memcpy(&i1, &v1, sizeof(i1));
+	std::memcpy(&i2, &v2, sizeof(i2));
+
+	// Map negative numbers to an ascending order
+	if (i1 < 0)
+		i1 = std::numeric_limits<std::int64_t>::min() - i1;
+
+	if (i2 < 0)
+		i2 = std::numeric_limits<std::int64_t>::min() - i2;
+
+	return (i1 > i2) ? i1 - i2 : i2 - i1;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::TestSimdMath()
+{
+	int  iNumErr = 0;
+	*m_stream << _T("testing simd math functions...");
+
+	// Maximum difference to the standard library
+	const struct
+	{
+		const char_type* szName;
+		SimdMath::fun_type pFun;
+		float_type(*pScalar)(float_type);
+		float_type fMin;
+		float_type fMax;
+		int nMaxUlp;
+	}
+	funs[] =
+	{
+		{ _T("sin"),   SimdMath::Sin,   [](float_type v) { return std::sin(v); },   -1e5, 1e5, 1 },
+		{ _T("cos"),   SimdMath::Cos,   [](float_type v) { return std::cos(v); },   -1e5, 1e5, 1 },
+		{ _T("exp"),   SimdMath::Exp,   [](float_type v) { return std::exp(v); },   -750, 750, 1 },
+		{ _T("log"),   SimdMath::Log,   [](float_type v) { return std::log(v); },   -1,   1e6, 1 },
+		{ _T("log2"),  SimdMath::Log2,  [](float_type v) { return std::log2(v); },  -1,   1e6, 2 },
+		{ _T("log10"), SimdMath::Log10, [](float_type v) { return std::log10(v); }, -1,   1e6, 2 },
+		{ _T("sqrt"),  SimdMath::Sqrt,  [](float_type v) { return std::sqrt(v); },  -1,   1e6, 0 },
+		{ _T("abs"),   SimdMath::Abs,   [](float_type v) { return std::fabs(v); },  -1e6, 1e6, 0 }
+	};
+
+	// Infinite, NaN and zero results must be the same as in the standard library
+	const float_type fInf = std::numeric_limits<float_type>::infinity();
+	const float_type special[] = { 0.0, -0.0, fInf, -fInf, std::numeric_limits<float_type>::quiet_NaN(),
+		std::numeric_limits<float_type>::denorm_min(), -std::numeric_limits<float_type>::denorm_min(),
+		std::numeric_limits<float_type>::min(), std::numeric_limits<float_type>::max(), 1e-300, 1e-13, 
+		1, -1, 2, 0.5, 3.141592653589793, 1.5707963267948966, 355, 1e6, -1e300, 708, 709.7, -745.2, -746 };
+	const int nSpecial = (int)(sizeof(special) / sizeof(special[0]));
+	const int nCount = nSpecial + 1001;
+
+	const ESimdLevel eCpuLevel = SimdMath::GetCpuLevel();
+	for (int nLevel = simdNONE; nLevel <= eCpuLevel; ++nLevel)
+	{
+		SimdMath::SetLevel((ESimdLevel)nLevel);
+		for (const auto& fun : funs)
+		{
+			ParserTester::c_iCount++;
+
+			std::vector<float_type> arg(nCount);
+			for (int i = 0; i < nCount; ++i)
+				arg[i] = (i < nSpecial) ? special[i] : fun.fMin + (fun.fMax - fun.fMin) * (i - nSpecial) / 1000;
+
+			// Odd sizes test the remaining values after the last full vector
+			std::vector<float_type> res(arg);
+			fun.pFun(res.data(), nCount);
+
+			for (int i = 0; i < nCount; ++i)
+			{
+				float_type fExpected = fun.pScalar(arg[i]);
+				bool bOk = (std::isnan(fExpected) && std::isnan(res[i])) ||
+					(fExpected == res[i] && std::signbit(fExpected) == std::signbit(res[i])) ||
+					(std::isfinite(fExpected) && fExpected != 0 && UlpDistance(fExpected, res[i]) <= fun.nMaxUlp);
+				if (!bOk)
+				{
+					*m_stream << _T("\n  ") << fun.szName << _T("(") << arg[i] << _T(") = ") << res[i]
+						<< _T(" differs from ") << fExpected << _T(" (level ") << nLevel << _T(")");
+					iNumErr++;
+					break;
+				}
+			}
+		}
+	}
+
+	SimdMath::SetLevel(eCpuLevel);
+
+	// Batch evaluation with vectorized functions
+	{
+		ParserTester::c_iCount++;
+
+		Value a;
+		ParserX p(pckALL_NON_COMPLEX);
+		p.DefineVar(_T("a"), Variable(&a));
+		p.SetExpr(_T("sin(a)*exp(-a/4)+sqrt(abs(a))+log(abs(a)+1)-cos(a)"));
+
+		const std::size_t nRows = 1000;
+		std::vector<float_type> col(nRows), res(nRows);
+		for (std::size_t i = 0; i < nRows; ++i)
+			col[i] = (float_type)i * 0.1 - 50;
+
+		column_maptype cols;
+		cols[_T("a")] = col.data();
+		p.EnableSimdMath(true);
+		p.EvalBatch(cols, res.data(), nRows);
+
+		for (std::size_t i = 0; i < nRows; ++i)
+		{
+			a = col[i];
+			float_type fRes = p.Eval().GetFloat();
+			if (std::fabs(fRes - res[i]) > 1e-12 * std::fabs(fRes))
+			{
+				*m_stream << _T("\n  batch evaluation with simd math differs for a=") << col[i]
+					<< _T(" (") << fRes << _T(" / ") << res[i] << _T(")");
+				iNumErr++;
+				break;
+			}
+		}
+	}
+
+	Assessment(iNumErr);
+	return iNumErr;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Compare the results of EvalBatch with the results of Eval for each row.
+
+	"a" is bound to a column, "b" keeps its value for all rows.
+*/
+int ParserTester::EvalBatchTest(const string_type &a_str)
+{
+	ParserTester::c_iCount++;
+
+	const float_type vals[] = { -0.0, 0, 2, -3.5, 0.25, 1e300, -1, 7,
+		std::numeric_limits<float_type>::infinity(), std::numeric_limits<float_type>::quiet_NaN() };
+	const std::size_t nVals = sizeof(vals) / sizeof(vals[0]);
+
+	// More than two blocks of the bytecode engine
+	const std::size_t nRows = 2 * RealEngine::c_nBlockSize + 45;
+	std::vector<float_type> col(nRows);
+	for (std::size_t i = 0; i < nRows; ++i)
+		col[i] = (i % 2) ? (float_type)i * 0.37 - 50 : vals[(i / 2) % nVals];
+
+	const EPackages packages[] = { pckALL_COMPLEX, pckALL_NON_COMPLEX };
+
+	for (const EPackages package : packages)
+	{
+		for (int nOptimizer = 0; nOptimizer < 2; ++nOptimizer)
+		{
+			Value a(_T("hello")), b((float_type)1.5);
+			ParserX p(package);
+			p.DefineVar(_T("a"), Variable(&a));
+			p.DefineVar(_T("b"), Variable(&b));
+			p.EnableOptimizer(nOptimizer == 1);
+			p.SetExpr(a_str);
+
+			column_maptype cols;
+			cols[_T("a")] = col.data();
+
+			std::vector<float_type> res(nRows);
+			try
+			{
+				p.EvalBatch(cols, res.data(), nRows);
+			}
+			catch (ParserError &e)
+			{
+				*m_stream << _T("\n  ") << a_str << _T(" : unexpected exception in batch evaluation (") << e.GetMsg() << _T(")");
+				return 1;
+			}
+
+			if (a.GetType() != 's')
+			{
+				*m_stream << _T("\n  ") << a_str << _T(" : batch evaluation did not restore the variable");
+				return 1;
+			}
+
+			for (std::size_t i = 0; i < nRows; ++i)
+			{
+				a = col[i];
+				float_type fRes = p.Eval().GetFloat();
+				bool bSame = (std::isnan(fRes) && std::isnan(res[i])) ||
+					(fRes == res[i] && std::signbit(fRes) == std::signbit(res[i]));
+				if (!bSame)
+				{
+					*m_stream << _T("\n  ") << a_str << _T(" : batch evaluation changed the result for a=") << col[i]
+						<< _T(" (") << fRes << _T(" / ") << res[i] << _T(")");
+					return 1;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Check that batch evaluation by several threads gives the same results 
+		   and errors as the serial evaluation. */
+int ParserTester::ParallelBatchTest(const string_type &a_str)
+{
+	ParserTester::c_iCount++;
+
+	// Many chunks of the thread pool
+	const std::size_t nRows = 100000;
+	std::vector<float_type> col(nRows);
+	for (std::size_t i = 0; i < nRows; ++i)
+		col[i] = std::sin((float_type)i) * ((i % 7) ? 10 : 200);
+
+	column_maptype cols;
+	cols[_T("a")] = col.data();
+
+	const EPackages packages[] = { pckALL_COMPLEX, pckALL_NON_COMPLEX };
+	for (const EPackages package : packages)
+	{
+		Value a((float_type)0), b((float_type)1.5);
+		ParserX p(package);
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.SetExpr(a_str);
+
+		std::vector<float_type> res(nRows), resSerial(nRows);
+		string_type sErr, sErrSerial;
+		const int threads[] = { 1, 2, 3, 8 };
+		for (int nThreads : threads)
+		{
+			p.SetBatchThreads(nThreads);
+			std::vector<float_type>& vRes = (nThreads == 1) ? resSerial : res;
+			string_type& sMsg = (nThreads == 1) ? sErrSerial : sErr;
+			sMsg.clear();
+
+			try
+			{
+				p.EvalBatch(cols, vRes.data(), nRows);
+			}
+			catch (ParserError &e)
+			{
+				sMsg = e.GetMsg();
+			}
+
+			if (nThreads == 1)
+				continue;
+
+			if (sErr != sErrSerial)
+			{
+				*m_stream << _T("\n  ") << a_str << _T(" : ") << nThreads << _T(" threads reported a different error (") << sErr << _T(")");
+				return 1;
+			}
+
+			if (sErr.empty() && std::memcmp(res.data(), resSerial.data(), nRows * sizeof(float_type)) != 0)
+			{
+				*m_stream << _T("\n  ") << a_str << _T(" : ") << nThreads << _T(" threads changed the results");
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Check that a compiled expression gives the same results as the parser it was 
+		   compiled by. 
+		   
+	The expression is evaluated with the complex and the non complex package, with
+	and without the optimizer, before and after the parser changes its expression and
+	with variables bound by the evaluation context.
+*/
+int ParserTester::CompiledExprTest(const string_type &a_str)
+{
+	ParserTester::c_iCount++;
+
+	const float_type vals[] = { -1.5, 0.5, 3, 0 };
+	const EPackages packages[] = { pckALL_COMPLEX, pckALL_NON_COMPLEX };
+
+	for (const EPackages package : packages)
+	{
+		for (int nOptimizer = 0; nOptimizer < 2; ++nOptimizer)
+		{
+			Value a((float_type)0), b((float_type)2), c((float_type)0), s(_T("hello"));
+			ParserX p(package);
+			p.DefineVar(_T("a"), Variable(&a));
+			p.DefineVar(_T("b"), Variable(&b));
+			p.DefineVar(_T("c"), Variable(&c));
+			p.DefineVar(_T("s"), Variable(&s));
+			p.EnableOptimizer(nOptimizer == 1);
+
+			try
+			{
+				p.SetExpr(a_str);
+				CompiledExpression expr(p);
+				EvalContext ctx;
+
+				std::vector<Value> vExpected;
+				for (float_type fVal : vals)
+				{
+					a = fVal;
+					vExpected.push_back(p.Eval());
+					if (!IsIdentical(vExpected.back(), expr.Eval(ctx)))
+					{
+						*m_stream << _T("\n  ") << a_str << _T(" : compiled expression changed the result for a=") << fVal;
+						return 1;
+					}
+				}
+
+				// The compiled expression does not depend on the parser
+				p.SetExpr(_T("a+1"));
+				p.Eval();
+				for (std::size_t i = 0; i < vExpected.size(); ++i)
+				{
+					a = vals[i];
+					if (!IsIdentical(vExpected[i], expr.Eval(ctx)))
+					{
+						*m_stream << _T("\n  ") << a_str << _T(" : compiled expression depends on the parser");
+						return 1;
+					}
+				}
+
+				// Variables bound by the context
+				Value aLocal((float_type)0);
+				ctx.DefineVar(_T("a"), Variable(&aLocal));
+				a = (float_type)100;
+				for (std::size_t i = 0; i < vExpected.size(); ++i)
+				{
+					aLocal = vals[i];
+					if (!IsIdentical(vExpected[i], expr.Eval(ctx)) || a.GetFloat() != 100)
+					{
+						*m_stream << _T("\n  ") << a_str << _T(" : variable bound by the evaluation context was ignored");
+						return 1;
+					}
+				}
+			}
+			catch (ParserError &e)
+			{
+				*m_stream << _T("\n  ") << a_str << _T(" : unexpected exception (") << e.GetMsg() << _T(")");
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Compare the results and errors of the generic engine with and 
+		   without threaded code.
+*/
+int ParserTester::ThreadedCodeTest(const string_type &a_str)
+{
+	ParserTester::c_iCount++;
+
+	const float_type vals[] = { -1.5, 0.5, 3, 0 };
+	const EPackages packages[] = { pckALL_COMPLEX, pckALL_NON_COMPLEX };
+
+	for (const EPackages package : packages)
+	{
+		for (int nOptimizer = 0; nOptimizer < 2; ++nOptimizer)
+		{
+			Value a((float_type)0), b((float_type)2), c((float_type)0), s(_T("hello"));
+			ParserX p(package);
+			p.DefineVar(_T("a"), Variable(&a));
+			p.DefineVar(_T("b"), Variable(&b));
+			p.DefineVar(_T("c"), Variable(&c));
+			p.DefineVar(_T("s"), Variable(&s));
+			p.EnableOptimizer(nOptimizer == 1);
+			p.EnableRealEngine(false);
+			p.SetExpr(a_str);
+
+			for (float_type fVal : vals)
+			{
+				// RPN interpreter, threaded code and register code
+				Value vRes[3];
+				string_type sErr[3];
+				for (int nMode = 0; nMode < 3; ++nMode)
+				{
+					a = fVal;
+					c = (float_type)0;
+					p.EnableThreadedCode(nMode == 1);
+					p.EnableRegisterCode(nMode == 2);
+					try
+					{
+						// Evaluate twice since the stack may hold values of 
+						// the previous evaluation
+						p.Eval();
+						vRes[nMode] = p.Eval();
+					}
+					catch (ParserError &e)
+					{
+						sErr[nMode] = e.GetMsg();
+					}
+				}
+
+				for (int nMode = 1; nMode < 3; ++nMode)
+				{
+					if (sErr[0] != sErr[nMode] || (sErr[0].empty() && !IsIdentical(vRes[0], vRes[nMode])))
+					{
+						*m_stream << _T("\n  ") << a_str << _T(" : ") << ((nMode == 1) ? _T("threaded") : _T("register")) 
+						          << _T(" code changed the result for a=") << fVal;
+						return 1;
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Check the number of RPN tokens created for an expression by the optimizer.
+	\param a_str The expression
+	\param a_nSize The number of tokens with fused tokens counted as the tokens they replace
+	\param a_nFusedSize The number of tokens including fused tokens or -1
+*/
+int ParserTester::RpnSizeTest(const string_type &a_str, int a_nSize, int a_nFusedSize)
+{
+	ParserTester::c_iCount++;
+
+	try
+	{
+		Value a((float_type)1.0), b((float_type)2.0);
+
+		ParserX p;
+		p.DefineVar(_T("a"), Variable(&a));
+		p.DefineVar(_T("b"), Variable(&b));
+		p.EnableOptimizer(true);
+		p.SetExpr(a_str);
+		p.Eval();
+
+		int nSize = 0;
+		for (const ptr_tok_type &tok : p.GetRPN().GetData())
+			nSize += (tok->GetCode() == cmFUSED) ? (int)static_cast<OprtFused*>(tok.Get())->GetTokens().size() : 1;
+
+		if (nSize != a_nSize)
+		{
+			*m_stream << _T("\n  ") << a_str << _T(" : unexpected number of RPN tokens (")
+				<< nSize << _T("; expected=") << a_nSize << _T(")");
+			return 1;
+		}
+
+		if (a_nFusedSize >= 0 && (int)p.GetRPN().GetSize() != a_nFusedSize)
+		{
+			*m_stream << _T("\n  ") << a_str << _T(" : unexpected number of fused RPN tokens (")
+				<< p.GetRPN().GetSize() << _T("; expected=") << a_nFusedSize << _T(")");
+			return 1;
+		}
+	}
+	catch (ParserError &e)
+	{
+		*m_stream << _T("\n  ") << a_str << _T(" : ") << e.GetMsg();
+		return 1;
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+void ParserTester::AddTest(testfun_type a_pFun)
+{
+	m_vTestFun.push_back(a_pFun);
+}
+
+//---------------------------------------------------------------------------
+void ParserTester::Run()
+{
+	int iStat = 0;
+	try
+	{
+		for (int i = 0; i < (int)m_vTestFun.size(); ++i)
+			iStat += (this->*m_vTestFun[i])();
+	}
+	catch (ParserError &e)
+	{
+		*m_stream << e.GetMsg() << endl;
+		*m_stream << e.GetToken() << endl;
+		Abort();
+	}
+	catch (std::exception &e)
+	{
+		*m_stream << e.what() << endl;
+		Abort();
+	}
+	catch (...)
+	{
+		*m_stream << _T("Internal error");
+		Abort();
+	}
+
+	if (iStat == 0)
+	{
+		*m_stream << _T("Test passed (") << ParserTester::c_iCount << _T(" expressions)") << endl;
+	}
+	else
+	{
+		*m_stream << _T("Test failed with ") << iStat
+			<< _T(" errors (") << ParserTester::c_iCount
+			<< _T(" expressions)") << endl;
+	}
+	ParserTester::c_iCount = 0;
+
+#ifdef MUP_LEAKAGE_REPORT
+	// All tokens must have been destroyed by now, verify this
+	IToken::LeakageReport();
+#endif
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::ThrowTest(const string_type &a_sExpr, int a_nErrc, int a_nPos, string_type a_sIdent)
+{
+	ParserTester::c_iCount++;
+
+	try
+	{
+		ParserX p;
+
+		// Add variables
+		Value vVarVal[] = { 1., 2., 3., -2. };
+		p.DefineVar(_T("a"), Variable(&vVarVal[0]));
+		p.DefineVar(_T("b"), Variable(&vVarVal[1]));
+		p.DefineVar(_T("c"), Variable(&vVarVal[2]));
+		p.DefineVar(_T("d"), Variable(&vVarVal[3]));
+
+		// Add functions
+		p.DefineFun(new FunReturnFalse);
+
+		// array variables
+		Value aVal1(3, 0);
+		aVal1.At(0) = (float_type)1.0;
+		aVal1.At(1) = (float_type)2.0;
+		aVal1.At(2) = (float_type)3.0;
+
+		Value aVal2(3, 0);
+		aVal2.At(0) = (float_type)4.0;
+		aVal2.At(1) = (float_type)3.0;
+		aVal2.At(2) = (float_type)2.0;
+
+		Value aVal3(4, 0);
+		aVal3.At(0) = (float_type)4.0;
+		aVal3.At(1) = (float_type)3.0;
+		aVal3.At(2) = (float_type)2.0;
+		aVal3.At(3) = (float_type)5.0;
+
+		Value aVal4(4, 0);
+		aVal4.At(0) = (float_type)4.0;
+		aVal4.At(1) = false;
+		aVal4.At(2) = _T("hallo");
+
+		// Matrix variables
+		Value m1(3, 3, 0);
+		m1.At(0, 0) = 1.;
+		m1.At(1, 1) = 1.;
+		m1.At(2, 2) = 1.;
+
+		Value m2(3, 3, 0);
+		m2.At(0, 0) = 1.;  m2.At(0, 1) = 2.;  m2.At(0, 2) = 3.;
+		m2.At(1, 0) = 4.;  m2.At(1, 1) = 5.;  m2.At(1, 2) = 6.;
+		m2.At(2, 0) = 7.;  m2.At(2, 1) = 8.;  m2.At(2, 2) = 9.;
+
+		p.DefineVar(_T("m1"), Variable(&m1));
+		p.DefineVar(_T("m2"), Variable(&m2));
+		p.DefineVar(_T("va"), Variable(&aVal1));
+		p.DefineVar(_T("vb"), Variable(&aVal2));
+		p.DefineVar(_T("vc"), Variable(&aVal3));
+		p.DefineVar(_T("vd"), Variable(&aVal4));
+
+		p.SetExpr(a_sExpr);
+		Value fRes = p.Eval();
+	}
+	catch (ParserError &e)
+	{
+		// output the formula in case of an failed test
+		if (a_nErrc != e.GetCode())
+		{
+			*m_stream << _T("\n  ")
+				<< _T("Expression: \"") << a_sExpr
+				<< _T("\"  Code:") << e.GetCode()
+				<< _T("  Expected:") << a_nErrc;
+		}
+
+		// Check whether the error is reported at the correct expression position
+		if (a_nPos != -1 && a_nPos != e.GetPos())
+		{
+			*m_stream << _T("\n  ")
+				<< _T("Invalid error position: \"") << a_sExpr
+				<< _T("\"  Pos:") << e.GetPos()
+				<< _T("  Expected:") << a_nPos;
+		}
+
+		if (a_sIdent.length() && a_sIdent != e.GetContext().Ident)
+		{
+			*m_stream << _T("\n  ")
+				<< _T("Invalid identifier: \"") << a_sExpr
+				<< _T("\"  Ident:") << e.GetContext().Ident
+				<< _T("  Expected:") << a_sIdent;
+		}
+
+		return (a_nErrc == e.GetCode() && (a_nPos == -1 || a_nPos == e.GetPos())) ? 0 : 1;
+	}
+
+	*m_stream << _T("\n  ")
+		<< _T("Expression failed: \"")
+		<< a_sExpr
+		<< _T("\"  (no exception raised).");
+
+	return 1;
+}
+
+//---------------------------------------------------------------------------
+int ParserTester::EqnTest(const string_type &a_str, Value a_val, bool a_fPass, int nExprVar, bool evaluateOnce)
+{
+	ParserTester::c_iCount++;
+	int iRet(1);
+	Value fVal[5];
+	char_type cRes[5];  // Types of the results, assigning them to fVal may change the type
+
+	try
 	{
 		// p1 is a pointer since I'm going to delete it in order to test if
 		// parsers after copy construction still refer to members of the deleted object.
@@ -1675,7 +4121,9 @@ int ParserTester::EqnTest(const string_type &a_str, Value a_val, bool a_fPass, i
 
 		p1->SetExpr(a_str);
 
-		fVal[0] = p1->Eval();
+		const IValue *pRes = &p1->Eval();
+		cRes[0] = pRes->GetType();
+		fVal[0] = *pRes;
 
 		if (evaluateOnce)
 		{
@@ -1684,6 +4132,8 @@ int ParserTester::EqnTest(const string_type &a_str, Value a_val, bool a_fPass, i
 			fVal[2] = fVal[0];
 			fVal[3] = fVal[0];
 			fVal[4] = fVal[0];
+			for (int i = 1; i < 5; ++i)
+				cRes[i] = cRes[0];
 		}
 		else
 		{
@@ -1696,24 +4146,57 @@ int ParserTester::EqnTest(const string_type &a_str, Value a_val, bool a_fPass, i
 			vParser.clear();              // delete the vector
 			p1.reset(0);                  // delete the original
 
-			fVal[1] = p2.Eval();          // If copy constructions does not work
+			pRes = &p2.Eval();            // If copy constructions does not work
+			cRes[1] = pRes->GetType();
+			fVal[1] = *pRes;
 			// we may see a crash here
 
 			// Test assignement operator
-			// additionally  disable Optimizer this time
+			// additionally enable the optimizer this time
 			ParserX p3;
 			p3 = p2;
-			fVal[2] = p3.Eval();          // If assignment does not work
+			p3.EnableOptimizer(true);
+			pRes = &p3.Eval();            // If assignment does not work
+			cRes[2] = pRes->GetType();
+			fVal[2] = *pRes;
 			// we may see a crash here
 
 			// Calculating a second time will parse from rpn rather than from
 			// string. The result must be the same...
-			fVal[3] = p3.Eval();
+			pRes = &p3.Eval();
+			cRes[3] = pRes->GetType();
+			fVal[3] = *pRes;
 
 			// Calculate yet another time. There is the possibility of
 			// changing variables as a side effect of expression
 			// evaluation. So there are really bugs that could make this fail...
-			fVal[4] = p3.Eval();
+			pRes = &p3.Eval();
+			cRes[4] = pRes->GetType();
+			fVal[4] = *pRes;
+
+			// Machine code must compute the same results as the interpreters
+			const ParserX* pInterpreted[] = { &p2, &p3 };
+			const Value* pResult[] = { &fVal[1], &fVal[4] };
+			for (int i = 0; i < 2; ++i)
+			{
+				ParserX p4(*pInterpreted[i]);
+				p4.Compile(jitNATIVE);
+				if (!IsIdentical(p4.Eval(), *pResult[i]))
+				{
+					*m_stream << _T("\n  ") << a_str << _T(" : machine code changed the result");
+					return 1;
+				}
+
+				// and so must the register code of the generic engine
+				ParserX p5(*pInterpreted[i]);
+				p5.EnableRealEngine(false);
+				p5.EnableRegisterCode(true);
+				if (!IsIdentical(p5.Eval(), *pResult[i]) || !IsIdentical(p5.Eval(), *pResult[i]))
+				{
+					*m_stream << _T("\n  ") << a_str << _T(" : register code changed the result");
+					return 1;
+				}
+			}
 
 			// Check i number of used variables is correct
 			if (nExprVar != -1)
@@ -1747,6 +4230,18 @@ int ParserTester::EqnTest(const string_type &a_str, Value a_val, bool a_fPass, i
 			return 1;
 		}
 
+		// 2.) the optimizer must not change the type of the result
+		if (cRes[1] != cRes[0] || cRes[2] != cRes[0] || cRes[3] != cRes[0] || cRes[4] != cRes[0])
+		{
+			*m_stream << _T("\n  ") << a_str << _T(" :  result type changed by copying or optimizing (")
+				<< cRes[0] << _T(", ")
+				<< cRes[1] << _T(", ")
+				<< cRes[2] << _T(", ")
+				<< cRes[3] << _T(", ")
+				<< cRes[4] << _T(")");
+			return 1;
+		}
+
 		if ((cType == 'c' || a_val.GetType() == 'c') && cType != a_val.GetType())
 		{
 			*m_stream << _T("\n  ") << a_str << _T(" :  Complex value sliced!");
@@ -1772,7 +4267,7 @@ int ParserTester::EqnTest(const string_type &a_str, Value a_val, bool a_fPass, i
 			bStat = true;
 			int num = sizeof(fVal) / sizeof(Value);
 			for (int i = 0; i < num; ++i)
-				bStat &= (fabs(a_val.GetFloat() - fVal[i].GetFloat()) <= fabs(fVal[i].GetFloat()*0.0001));
+				bStat &= (a_val.GetFloat() == fVal[i].GetFloat() || fabs(a_val.GetFloat() - fVal[i].GetFloat()) <= fabs(fVal[i].GetFloat()*0.0001));
 		}
 		break;
 
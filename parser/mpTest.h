@@ -62,6 +62,26 @@ MUP_NAMESPACE_START
         int TestScript();
 		int TestValReader();
         int TestIssueReports();
+        int TestOptimizer();
+        int TestRealEngine();
+        int TestEvalBatch();
+        int TestSimdMath();
+        int TestCompiledExpr();
+        int TestThreadedCode();
+        int TestFusedTokens();
+        int TestRPNCache();
+        int TestRPNArchive();
+        int TestFormulaGraph();
+        int TestMemoization();
+        int TestPreparedExpression();
+        int TestLongExpression();
+        int TestNumberParsing();
+        int TestOprtLookup();
+        int TestSymbolTable();
+        int TestValReaderDispatch();
+        int TestJit();
+        int TestTieredJit();
+        int TestNativeCache();
 
         void Assessment(int a_iNumErr) const;
         void Abort() const;
@@ -96,6 +116,13 @@ MUP_NAMESPACE_START
         // Test Double Parser
         int EqnTest(const string_type &a_str, Value a_val, bool a_fPass, int nExprVar = -1, bool evaluateOnce = false);
         int ThrowTest(const string_type &a_str, int a_nErrc, int a_nPos = -1, string_type a_sIdent = string_type());
+        int RpnSizeTest(const string_type &a_str, int a_nSize, int a_nFusedSize = -1);
+        int OptimizerTest(const string_type &a_str);
+        int RealEngineTest(const string_type &a_str, bool a_bCompiled);
+        int EvalBatchTest(const string_type &a_str);
+        int ParallelBatchTest(const string_type &a_str);
+        int CompiledExprTest(const string_type &a_str);
+        int ThreadedCodeTest(const string_type &a_str);
     }; // ParserTester
 }  // namespace mu
 
@@ -0,0 +1,220 @@
+/** \file
+    \brief Implementation of a work stealing thread pool used for batch evaluation.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+#include "mpThreadPool.h"
+
+#include <algorithm>
+#include <limits>
+
+
+MUP_NAMESPACE_START
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of hardware threads or 1 if it is unknown. */
+int ThreadPool::GetHardwareThreads()
+{
+	return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+//---------------------------------------------------------------------------
+/** \brief Create a thread pool.
+	\param nThreads The number of threads including the calling thread.
+	                Values smaller than 1 select the number of hardware threads.
+*/
+ThreadPool::ThreadPool(int nThreads)
+	:m_vThread()
+	, m_vQueue()
+	, m_pTask(nullptr)
+	, m_nGeneration(0)
+	, m_nBusy(0)
+	, m_bStop(false)
+	, m_pError()
+	, m_nErrorTask(std::numeric_limits<std::size_t>::max())
+{
+	if (nThreads < 1)
+		nThreads = GetHardwareThreads();
+
+	for (int i = 0; i < nThreads; ++i)
+		m_vQueue.push_back(std::unique_ptr<SQueue>(new SQueue));
+
+	for (int i = 1; i < nThreads; ++i)
+		m_vThread.push_back(std::thread(&ThreadPool::WorkerMain, this, i));
+}
+
+//---------------------------------------------------------------------------
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_bStop = true;
+	}
+
+	m_cvStart.notify_all();
+	for (std::thread& thread : m_vThread)
+		thread.join();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Returns the number of threads including the calling thread. */
+int ThreadPool::GetNumThreads() const
+{
+	return (int)m_vQueue.size();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Execute the tasks with indices 0 to nTasks-1 and wait for them.
+	\param nTasks The number of tasks
+	\param task The function executing a task
+	\throw Any exception thrown by a task
+*/
+void ThreadPool::Run(std::size_t nTasks, const task_type& task)
+{
+	std::lock_guard<std::mutex> lockRun(m_mtxRun);
+
+	// Contiguous ranges of tasks for each worker
+	const std::size_t nWorkers = m_vQueue.size();
+	for (std::size_t i = 0; i < nWorkers; ++i)
+	{
+		std::size_t nFirst = nTasks * i / nWorkers, 
+					nLast = nTasks * (i + 1) / nWorkers;
+
+		std::lock_guard<std::mutex> lock(m_vQueue[i]->m_mtx);
+		for (std::size_t t = nFirst; t < nLast; ++t)
+			m_vQueue[i]->m_vTask.push_back(t);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_pTask = &task;
+		m_pError = nullptr;
+		m_nErrorTask = std::numeric_limits<std::size_t>::max();
+		m_nBusy = (int)m_vThread.size();
+		++m_nGeneration;
+	}
+
+	m_cvStart.notify_all();
+	Work(0);
+
+	std::unique_lock<std::mutex> lock(m_mtx);
+	m_cvDone.wait(lock, [this]() { return m_nBusy == 0; });
+	m_pTask = nullptr;
+
+	if (m_pError)
+		std::rethrow_exception(m_pError);
+}
+
+//---------------------------------------------------------------------------
+/** \brief The main function of the threads of the pool. */
+void ThreadPool::WorkerMain(int nWorker)
+{
+	unsigned nGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mtx);
+			m_cvStart.wait(lock, [&]() { return m_bStop || m_nGeneration != nGeneration; });
+			if (m_bStop)
+				return;
+
+			nGeneration = m_nGeneration;
+		}
+
+		Work(nWorker);
+
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (--m_nBusy == 0)
+			m_cvDone.notify_one();
+	}
+}
+
+//---------------------------------------------------------------------------
+/** \brief Execute tasks until all queues are empty. */
+void ThreadPool::Work(int nWorker)
+{
+	std::size_t nTask;
+	while (PopTask(nWorker, nTask))
+	{
+		if (nTask > m_nErrorTask)
+			continue;
+
+		try
+		{
+			(*m_pTask)(nWorker, nTask);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			if (nTask < m_nErrorTask)
+			{
+				m_pError = std::current_exception();
+				m_nErrorTask = nTask;
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+/** \brief Take a task from the own queue or steal one from another worker.
+	\return false if there are no tasks left.
+*/
+bool ThreadPool::PopTask(int nWorker, std::size_t& nTask)
+{
+	{
+		SQueue& queue = *m_vQueue[nWorker];
+		std::lock_guard<std::mutex> lock(queue.m_mtx);
+		if (!queue.m_vTask.empty())
+		{
+			nTask = queue.m_vTask.front();
+			queue.m_vTask.pop_front();
+			return true;
+		}
+	}
+
+	const std::size_t nWorkers = m_vQueue.size();
+	for (std::size_t i = 1; i < nWorkers; ++i)
+	{
+		SQueue& queue = *m_vQueue[(nWorker + i) % nWorkers];
+		std::lock_guard<std::mutex> lock(queue.m_mtx);
+		if (!queue.m_vTask.empty())
+		{
+			nTask = queue.m_vTask.back();
+			queue.m_vTask.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+MUP_NAMESPACE_END
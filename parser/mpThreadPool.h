@@ -0,0 +1,116 @@
+#ifndef MUP_THREAD_POOL_H
+#define MUP_THREAD_POOL_H
+
+/** \file
+    \brief Definition of a work stealing thread pool used for batch evaluation.
+
+<pre>
+               __________                                 ____  ___
+    _____  __ _\______   \_____ _______  ______ __________\   \/  /
+   /     \|  |  \     ___/\__  \\_  __ \/  ___// __ \_  __ \     /
+  |  Y Y  \  |  /    |     / __ \|  | \/\___ \\  ___/|  | \/     \
+  |__|_|  /____/|____|    (____  /__|  /____  >\___  >__| /___/\  \
+        \/                     \/           \/     \/           \_/
+                                       Copyright (C) 2023, Ingo Berg
+                                       All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+   * Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   * Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+</pre>
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mpTypes.h"
+
+
+MUP_NAMESPACE_START
+
+  //---------------------------------------------------------------------------
+  /** \brief A pool of threads executing a fixed number of tasks.
+
+    Run distributes the task indices in contiguous ranges to the queues of
+    the workers. Each worker takes the tasks of its own queue from the front.
+    A worker whose queue is empty steals tasks from the back of the other 
+    queues. The calling thread takes part in the work as worker 0, so a 
+    pool with one thread does not create any threads.
+
+    If tasks throw, Run rethrows the exception of the task with the lowest
+    index. Tasks with a higher index than a failed task are skipped. Which 
+    exception is reported does not depend on the order in which the tasks 
+    are executed.
+  */
+  class ThreadPool
+  {
+  public:
+
+    /** \brief The task function: Arguments are the worker index and the task index. */
+    typedef std::function<void(int, std::size_t)> task_type;
+
+    static int GetHardwareThreads();
+
+    explicit ThreadPool(int nThreads);
+   ~ThreadPool();
+
+    ThreadPool(const ThreadPool &ref) = delete;
+    ThreadPool& operator=(const ThreadPool &ref) = delete;
+
+    int GetNumThreads() const;
+    void Run(std::size_t nTasks, const task_type &task);
+
+  private:
+
+    /** \brief The tasks assigned to a worker. */
+    struct SQueue
+    {
+      std::mutex m_mtx;
+      std::deque<std::size_t> m_vTask;
+    };
+
+    void WorkerMain(int nWorker);
+    void Work(int nWorker);
+    bool PopTask(int nWorker, std::size_t &nTask);
+
+    std::vector<std::thread> m_vThread;
+    std::vector<std::unique_ptr<SQueue>> m_vQueue;
+
+    std::mutex m_mtxRun;            ///< Serializes calls of Run
+    std::mutex m_mtx;               ///< Protects the members below
+    std::condition_variable m_cvStart;
+    std::condition_variable m_cvDone;
+    const task_type *m_pTask;
+    unsigned m_nGeneration;         ///< Incremented by each call of Run
+    int m_nBusy;                    ///< Number of threads working on the current call of Run
+    bool m_bStop;
+    std::exception_ptr m_pError;    ///< Exception of the task with the lowest index
+    std::atomic<std::size_t> m_nErrorTask;  ///< Index of the task that threw m_pError
+  };
+
+MUP_NAMESPACE_END
+
+#endif
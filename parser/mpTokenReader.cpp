@@ -38,6 +38,7 @@
 
 #include <cassert>
 #include <cctype>
+#include <type_traits>
 
 #include "mpParserBase.h"
 #include "mpIValReader.h"
@@ -98,6 +99,7 @@ void TokenReader::Assign(const TokenReader &obj)
 	m_pConstDef = obj.m_pConstDef;
 	m_pDynVarShadowValues = obj.m_pDynVarShadowValues;
 	m_vTokens = obj.m_vTokens;
+	m_bOprtTrieValid = false;   // The tries refer to the operator maps of obj
 
 	// Reader klassen klonen
 	DeleteValReader();
@@ -106,6 +108,8 @@ void TokenReader::Assign(const TokenReader &obj)
 	{
 		m_vValueReader.push_back(obj.m_vValueReader[i]->Clone(this));
 	}
+
+	BuildValReaderDispatch();
 }
 
 //---------------------------------------------------------------------------
@@ -139,6 +143,11 @@ TokenReader::TokenReader(ParserXBase *a_pParent)
 	, m_vValueReader()
 	, m_UsedVar()
 	, m_fZero(0)
+	, m_OprtTrie()
+	, m_OprtShortcutTrie()
+	, m_InfixOprtTrie()
+	, m_PostOprtTrie()
+	, m_bOprtTrieValid(false)
 {
 	assert(m_pParser);
 	SetParent(m_pParser);
@@ -185,6 +194,44 @@ void TokenReader::AddValueReader(IValueReader *a_pReader)
 {
 	a_pReader->SetParent(this);
 	m_vValueReader.push_back(a_pReader);
+	BuildValReaderDispatch();
+}
+
+//---------------------------------------------------------------------------
+/** \brief Assign the value readers to the characters their values can start with.
+
+	Each entry lists the readers in the order they were added. Readers 
+	not declaring start characters are listed in every entry.
+*/
+void TokenReader::BuildValReaderDispatch()
+{
+	typedef std::make_unsigned<char_type>::type uchar_type;
+
+	for (readervec_type &vReader : m_vValReaderDispatch)
+		vReader.clear();
+
+	m_vValReaderOther.clear();
+
+	for (IValueReader *pReader : m_vValueReader)
+	{
+		const char_type *szStart = pReader->GetStartChars();
+		if (szStart == nullptr)
+		{
+			for (readervec_type &vReader : m_vValReaderDispatch)
+				vReader.push_back(pReader);
+
+			m_vValReaderOther.push_back(pReader);
+			continue;
+		}
+
+		for (; *szStart != 0; ++szStart)
+		{
+			std::size_t c = static_cast<uchar_type>(*szStart);
+			readervec_type &vReader = (c < 256) ? m_vValReaderDispatch[c] : m_vValReaderOther;
+			if (vReader.empty() || vReader.back() != pReader)
+				vReader.push_back(pReader);
+		}
+	}
 }
 
 //---------------------------------------------------------------------------
@@ -245,14 +292,29 @@ void TokenReader::SetExpr(const string_type &a_sExpr)
 	if (std::all_of(a_sExpr.begin(), a_sExpr.end(), [](char_type c) { return !std::isgraph(c); }))
 		throw ParserError(_T("Non printable characters in expression found!"));
 
-	// Check maximum allowed expression length. An arbitrary value small enough so i can debug expressions sent to me
-	if (a_sExpr.length() >= 10000)
-		throw ParserError(_T("Expression longer than 10000 characters!"));
+	// Check maximum allowed expression length. Tokenizing takes linear time so 
+	// long generated expressions are accepted. The limit bounds the time spent 
+	// on deeply nested expressions, parsing them is not linear.
+	if (a_sExpr.length() >= 1000000)
+		throw ParserError(_T("Expression longer than 1000000 characters!"));
 
 	m_sExpr = a_sExpr; 
 	ReInit();
 }
 
+//---------------------------------------------------------------------------
+/** \brief Restore the state after the expression was read.
+	\param a_nPos The final reading position.
+	\param a_UsedVar The variables used by the expression.
+
+	Used by the parser if the RPN of the expression was taken from its cache.
+*/
+void TokenReader::Restore(int a_nPos, const var_maptype &a_UsedVar)
+{
+	m_nPos = a_nPos;
+	m_UsedVar = a_UsedVar;
+}
+
 //---------------------------------------------------------------------------
 /** \brief Reset the token reader to the start of the formula.
 	\post #m_nPos==0, #m_nSynFlags = noOPT | noBC | noPOSTOP | noSTR
@@ -319,6 +381,9 @@ ptr_tok_type TokenReader::ReadNextToken()
 
 	SkipCommentsAndWhitespaces();
 
+	if (!m_bOprtTrieValid)
+		BuildOprtTrie();
+
 	int token_pos = m_nPos;
 	ptr_tok_type pTok;
 
@@ -381,7 +446,7 @@ ptr_tok_type TokenReader::ReadNextToken()
 	//
 	// !!! From this point on there is no exit without an exception possible...
 	//
-	string_type sTok;
+	string_view_type sTok;
 	int iEnd = ExtractToken(m_pParser->ValidNameChars(), sTok, m_nPos);
 
 	ErrorContext err;
@@ -390,7 +455,7 @@ ptr_tok_type TokenReader::ReadNextToken()
 	err.Pos = m_nPos;
 
 	if (iEnd != m_nPos)
-		err.Ident = sTok;
+		err.Ident = string_type(sTok);
 	else
 		err.Ident = m_sExpr.substr(m_nPos);
 
@@ -409,18 +474,39 @@ void TokenReader::SetParent(ParserXBase *a_pParent)
 	m_pVarDef = &a_pParent->m_varDef;
 	m_pConstDef = &a_pParent->m_valDef;
 	m_pDynVarShadowValues = &a_pParent->m_valDynVarShadow;
+	m_bOprtTrieValid = false;
+}
+
+//---------------------------------------------------------------------------
+/** \brief Rebuild the operator tries before the next token is read.
+
+	Called by the parser whenever an operator is defined or removed.
+*/
+void TokenReader::InvalidateOprtTrie()
+{
+	m_bOprtTrieValid = false;
+}
+
+//---------------------------------------------------------------------------
+void TokenReader::BuildOprtTrie()
+{
+	m_OprtTrie.Build(*m_pOprtDef);
+	m_OprtShortcutTrie.Build(*m_pOprtShortcutDef);
+	m_InfixOprtTrie.Build(*m_pInfixOprtDef);
+	m_PostOprtTrie.Build(*m_pPostOprtDef);
+	m_bOprtTrieValid = true;
 }
 
 //---------------------------------------------------------------------------
 /** \brief Extract all characters that belong to a certain charset.
 	\param a_szCharSet [in] Const char array of the characters allowed in the token.
-	\param a_strTok [out]  The string that consists entirely of characters listed in a_szCharSet.
+	\param a_strTok [out]  View of the characters listed in a_szCharSet, it is valid until the expression changes.
 	\param a_iPos [in] Position in the string from where to start reading.
 	\return The Position of the first character not listed in a_szCharSet.
 	\throw nothrow
 	*/
 int TokenReader::ExtractToken(const char_type *a_szCharSet,
-	string_type &a_sTok,
+	string_view_type &a_sTok,
 	int a_iPos) const
 {
 	int iEnd = (int)m_sExpr.find_first_not_of(a_szCharSet, a_iPos);
@@ -429,7 +515,7 @@ int TokenReader::ExtractToken(const char_type *a_szCharSet,
 		iEnd = (int)m_sExpr.length();
 
 	if (iEnd != a_iPos)
-		a_sTok.assign(m_sExpr.begin() + a_iPos, m_sExpr.begin() + iEnd);
+		a_sTok = string_view_type(m_sExpr).substr(a_iPos, iEnd - a_iPos);
 
 	return iEnd;
 }
@@ -439,8 +525,8 @@ int TokenReader::ExtractToken(const char_type *a_szCharSet,
 */
 bool TokenReader::IsBuiltIn(ptr_tok_type &a_Tok)
 {
-	const char_type **pOprtDef = m_pParser->GetOprtDef(),
-		*szFormula = m_sExpr.c_str();
+	const char_type **pOprtDef = m_pParser->GetOprtDef();
+	string_view_type sExpr(m_sExpr);
 	int i;
 
 	try
@@ -450,7 +536,7 @@ bool TokenReader::IsBuiltIn(ptr_tok_type &a_Tok)
 		for (i = 0; pOprtDef[i]; i++)
 		{
 			std::size_t len(std::char_traits<char_type>::length(pOprtDef[i]));
-			if (string_type(pOprtDef[i]) == string_type(szFormula + m_nPos, szFormula + m_nPos + len))
+			if (sExpr.compare(m_nPos, len, pOprtDef[i]) == 0)
 			{
 				switch (i)
 				{
@@ -675,7 +761,7 @@ bool TokenReader::IsEOF(ptr_tok_type &a_Tok)
 	*/
 bool TokenReader::IsInfixOpTok(ptr_tok_type &a_Tok)
 {
-	string_type sTok;
+	string_view_type sTok;
 	int iEnd = ExtractToken(m_pParser->ValidInfixOprtChars(), sTok, m_nPos);
 
 	if (iEnd == m_nPos)
@@ -683,24 +769,20 @@ bool TokenReader::IsInfixOpTok(ptr_tok_type &a_Tok)
 
 	try
 	{
-		// iteraterate over all infix operator strings
-		oprt_ifx_maptype::const_iterator item = m_pInfixOprtDef->begin();
-		for (item = m_pInfixOprtDef->begin(); item != m_pInfixOprtDef->end(); ++item)
-		{
-			if (sTok.find(item->first) != 0)
-				continue;
+		// find the longest infix operator the token starts with
+		std::size_t nLen = 0;
+		const ptr_tok_type *pOprt = m_InfixOprtTrie.Find(sTok, nLen);
+		if (pOprt == nullptr)
+			return false;
 
-			a_Tok = ptr_tok_type(item->second->Clone());
-			m_nPos += (int)item->first.length();
+		a_Tok = ptr_tok_type((*pOprt)->Clone());
+		m_nPos += (int)nLen;
 
-			if (m_nSynFlags & noIFX)
-				throw ecUNEXPECTED_OPERATOR;
+		if (m_nSynFlags & noIFX)
+			throw ecUNEXPECTED_OPERATOR;
 
-			m_nSynFlags = noPFX | noIFX | noOPT | noBC | noIC | noIO | noEND | noCOMMA | noNEWLINE | noIF | noELSE;
-			return true;
-		}
-
-		return false;
+		m_nSynFlags = noPFX | noIFX | noOPT | noBC | noIC | noIO | noEND | noCOMMA | noNEWLINE | noIF | noELSE;
+		return true;
 	}
 	catch (EErrorCodes e)
 	{
@@ -720,7 +802,7 @@ bool TokenReader::IsFunTok(ptr_tok_type &a_Tok)
 	if (m_pFunDef->size() == 0)
 		return false;
 
-	string_type sTok;
+	string_view_type sTok;
 	int iEnd = ExtractToken(m_pParser->ValidNameChars(), sTok, m_nPos);
 	if (iEnd == m_nPos)
 		return false;
@@ -774,31 +856,27 @@ bool TokenReader::IsPostOpTok(ptr_tok_type &a_Tok)
 	// token readers.
 
 	// Test if there could be a postfix operator
-	string_type sTok;
+	string_view_type sTok;
 	int iEnd = ExtractToken(m_pParser->ValidOprtChars(), sTok, m_nPos);
 	if (iEnd == m_nPos)
 		return false;
 
 	try
 	{
-		// iteraterate over all postfix operator strings
-		oprt_pfx_maptype::const_iterator item;
-		for (item = m_pPostOprtDef->begin(); item != m_pPostOprtDef->end(); ++item)
-		{
-			if (sTok.find(item->first) != 0)
-				continue;
-
-			a_Tok = ptr_tok_type(item->second->Clone());
-			m_nPos += (int)item->first.length();
+		// find the longest postfix operator the token starts with
+		std::size_t nLen = 0;
+		const ptr_tok_type *pOprt = m_PostOprtTrie.Find(sTok, nLen);
+		if (pOprt == nullptr)
+			return false;
 
-			if (m_nSynFlags & noPFX)
-				throw ecUNEXPECTED_OPERATOR;
+		a_Tok = ptr_tok_type((*pOprt)->Clone());
+		m_nPos += (int)nLen;
 
-			m_nSynFlags = noVAL | noVAR | noFUN | noBO | noPFX /*| noIO*/ | noIF;
-			return true;
-		}
+		if (m_nSynFlags & noPFX)
+			throw ecUNEXPECTED_OPERATOR;
 
-		return false;
+		m_nSynFlags = noVAL | noVAR | noFUN | noBO | noPFX /*| noIO*/ | noIF;
+		return true;
 	}
 	catch (EErrorCodes e)
 	{
@@ -815,57 +893,49 @@ bool TokenReader::IsPostOpTok(ptr_tok_type &a_Tok)
 /** \brief Check if a string position contains a binary operator. */
 bool TokenReader::IsOprt(ptr_tok_type &a_Tok)
 {
-	string_type sTok;
+	string_view_type sTok;
 	int iEnd = ExtractToken(m_pParser->ValidOprtChars(), sTok, m_nPos);
 	if (iEnd == m_nPos)
 		return false;
 
-	oprt_bin_maptype::reverse_iterator item;
+	std::size_t nLen = 0;
 	try
 	{
 		// Note:
-		// All tokens in oprt_bin_maptype are have been sorted by their length
 		// Long operators must come first! Otherwise short names (like: "add") that
 		// are part of long token names (like: "add123") will be found instead
-		// of the long ones.
-		// Length sorting is done with ascending length so we use a reverse iterator here.
-		for (item = m_pOprtDef->rbegin(); item != m_pOprtDef->rend(); ++item)
-		{
-			if (sTok.find(item->first) != 0)
-				continue;
-
-			// operator found, check if we expect one...
-			if (m_nSynFlags & noOPT)
-			{
-				// An operator was found but is not expected to occur at
-				// this position of the formula, maybe it is an infix
-				// operator, not a binary operator. Both operator types
-				// can use the same characters in their identifiers.
-				if (IsInfixOpTok(a_Tok))
-					return true;
-
-				// nope, it's no infix operator and we dont expect
-				// an operator
-				throw ecUNEXPECTED_OPERATOR;
-			}
-			else
-			{
-				a_Tok = ptr_tok_type(item->second->Clone());
+		// of the long ones. The trie returns the longest match.
+		const ptr_tok_type *pOprt = m_OprtTrie.Find(sTok, nLen);
+		if (pOprt == nullptr)
+			return false;
 
-				m_nPos += (int)a_Tok->GetIdent().length();
-				m_nSynFlags = noBC | noIO | noIC | noOPT | noCOMMA | noEND | noNEWLINE | noPFX | noIF | noELSE;
+		// operator found, check if we expect one...
+		if (m_nSynFlags & noOPT)
+		{
+			// An operator was found but is not expected to occur at
+			// this position of the formula, maybe it is an infix
+			// operator, not a binary operator. Both operator types
+			// can use the same characters in their identifiers.
+			if (IsInfixOpTok(a_Tok))
 				return true;
-			}
+
+			// nope, it's no infix operator and we dont expect
+			// an operator
+			throw ecUNEXPECTED_OPERATOR;
 		}
 
-		return false;
+		a_Tok = ptr_tok_type((*pOprt)->Clone());
+
+		m_nPos += (int)nLen;
+		m_nSynFlags = noBC | noIO | noIC | noOPT | noCOMMA | noEND | noNEWLINE | noPFX | noIF | noELSE;
+		return true;
 	}
 	catch (EErrorCodes e)
 	{
 		ErrorContext err;
 		err.Errc = e;
-		err.Pos = m_nPos; // - (int)item->first.length();
-		err.Ident = item->first;
+		err.Pos = m_nPos;
+		err.Ident = string_type(sTok.substr(0, nLen));
 		err.Expr = m_sExpr;
 		throw ParserError(err);
 	}
@@ -876,41 +946,31 @@ bool TokenReader::IsOprt(ptr_tok_type &a_Tok)
 /** \brief Check if a string position contains a binary operator with short cut evaluation. */
 bool TokenReader::IsShortCutOprt(ptr_tok_type &a_Tok)
 {
-	string_type sTok;
+	string_view_type sTok;
 	int iEnd = ExtractToken(m_pParser->ValidOprtChars(), sTok, m_nPos);
 	if (iEnd == m_nPos)
 		return false;
 
-	oprt_bin_shortcut_maptype::reverse_iterator item;
+	std::size_t nLen = 0;
 	try
 	{
-		// Note:
-		// All tokens in oprt_bin_maptype are have been sorted by their length
-		// Long operators must come first! Otherwise short names (like: "add") that
-		// are part of long token names (like: "add123") will be found instead
-		// of the long ones.
-		// Length sorting is done with ascending length so we use a reverse iterator here.
-		for (item = m_pOprtShortcutDef->rbegin(); item != m_pOprtShortcutDef->rend(); ++item)
-		{
-			if (sTok.find(item->first) != 0)
-				continue;
-
-			// operator found, check if we expect one...
-			a_Tok = ptr_tok_type(item->second->Clone());
+		// The trie returns the longest operator the token starts with
+		const ptr_tok_type *pOprt = m_OprtShortcutTrie.Find(sTok, nLen);
+		if (pOprt == nullptr)
+			return false;
 
-			m_nPos += (int)a_Tok->GetIdent().length();
-			m_nSynFlags = noBC | noIO | noIC | noOPT | noCOMMA | noEND | noNEWLINE | noPFX | noIF | noELSE;
-			return true;
-		}
+		a_Tok = ptr_tok_type((*pOprt)->Clone());
 
-		return false;
+		m_nPos += (int)nLen;
+		m_nSynFlags = noBC | noIO | noIC | noOPT | noCOMMA | noEND | noNEWLINE | noPFX | noIF | noELSE;
+		return true;
 	}
 	catch (EErrorCodes e)
 	{
 		ErrorContext err;
 		err.Errc = e;
-		err.Pos = m_nPos; // - (int)item->first.length();
-		err.Ident = item->first;
+		err.Pos = m_nPos;
+		err.Ident = string_type(sTok.substr(0, nLen));
 		err.Expr = m_sExpr;
 		throw ParserError(err);
 	}
@@ -929,27 +989,28 @@ bool TokenReader::IsValTok(ptr_tok_type &a_Tok)
 	if (m_vValueReader.size() == 0)
 		return false;
 
-	stringstream_type stream(m_sExpr.c_str() + m_nPos);
-	string_type sTok;
+	string_view_type sExpr(m_sExpr), sTok;
 
 	try
 	{
-		// call the value recognition functions provided by the user
-		// Call user defined value recognition functions
-		int iSize = (int)m_vValueReader.size();
+		// Call the value readers whose values can start with the current character
+		typedef std::make_unsigned<char_type>::type uchar_type;
+		std::size_t c = static_cast<uchar_type>(sExpr[m_nPos]);
+		const readervec_type &vReader = (c < 256) ? m_vValReaderDispatch[c] : m_vValReaderOther;
+
 		Value val;
-		for (int i = 0; i < iSize; ++i)
+		for (IValueReader *pReader : vReader)
 		{
 			int iStart = m_nPos;
-			if (m_vValueReader[i]->IsValue(m_sExpr.c_str(), m_nPos, val))
+			if (pReader->IsValue(sExpr, m_nPos, val))
 			{
-				sTok.assign(m_sExpr.c_str(), iStart, m_nPos);
+				sTok = sExpr.substr(iStart, m_nPos - iStart);
 				if (m_nSynFlags & noVAL)
 					throw ecUNEXPECTED_VAL;
 
 				m_nSynFlags = noVAL | noVAR | noFUN | noBO | noIFX | noIO;
 				a_Tok = ptr_tok_type(val.Clone());
-				a_Tok->SetIdent(string_type(sTok.begin(), sTok.begin() + (m_nPos - iStart)));
+				a_Tok->SetIdent(string_type(sTok));
 				return true;
 			}
 		}
@@ -959,7 +1020,7 @@ bool TokenReader::IsValTok(ptr_tok_type &a_Tok)
 		ErrorContext err;
 		err.Errc = e;
 		err.Pos = m_nPos;
-		err.Ident = sTok;
+		err.Ident = string_type(sTok);
 		err.Expr = m_sExpr;
 		err.Pos = m_nPos - (int)sTok.length();
 		throw ParserError(err);
@@ -978,7 +1039,7 @@ bool TokenReader::IsVarOrConstTok(ptr_tok_type &a_Tok)
 	if (!m_pVarDef->size() && !m_pConstDef->size() && !m_pFunDef->size())
 		return false;
 
-	string_type sTok;
+	string_view_type sTok;
 	int iEnd;
 	try
 	{
@@ -996,7 +1057,7 @@ bool TokenReader::IsVarOrConstTok(ptr_tok_type &a_Tok)
 			m_nPos = iEnd;
 			m_nSynFlags = noVAL | noVAR | noFUN | noBO | noIFX;
 			a_Tok = ptr_tok_type(item->second->Clone());
-			a_Tok->SetIdent(sTok);
+			a_Tok->SetIdent(item->first);
 			m_UsedVar[item->first] = item->second;  // Add variable to used-var-list
 			return true;
 		}
@@ -1011,7 +1072,7 @@ bool TokenReader::IsVarOrConstTok(ptr_tok_type &a_Tok)
 			m_nPos = iEnd;
 			m_nSynFlags = noVAL | noVAR | noFUN | noBO | noIFX | noIO;
 			a_Tok = ptr_tok_type(item->second->Clone());
-			a_Tok->SetIdent(sTok);
+			a_Tok->SetIdent(item->first);
 			return true;
 		}
 	}
@@ -1020,7 +1081,7 @@ bool TokenReader::IsVarOrConstTok(ptr_tok_type &a_Tok)
 		ErrorContext err;
 		err.Errc = e;
 		err.Pos = m_nPos;
-		err.Ident = sTok;
+		err.Ident = string_type(sTok);
 		err.Expr = m_sExpr;
 		throw ParserError(err);
 	}
@@ -1042,7 +1103,7 @@ bool TokenReader::IsComment()
 	*/
 bool TokenReader::IsUndefVarTok(ptr_tok_type &a_Tok)
 {
-	string_type sTok;
+	string_view_type sTok;
 	int iEnd = ExtractToken(m_pParser->ValidNameChars(), sTok, m_nPos);
 	if (iEnd == m_nPos || (sTok.size() > 0 && sTok[0] >= _T('0') && sTok[0] <= _T('9')))
 		return false;
@@ -1051,25 +1112,26 @@ bool TokenReader::IsUndefVarTok(ptr_tok_type &a_Tok)
 	{
 		ErrorContext err;
 		err.Errc = ecUNEXPECTED_VAR;
-		err.Ident = sTok;
+		err.Ident = string_type(sTok);
 		err.Expr = m_sExpr;
 		err.Pos = m_nPos;
 		throw ParserError(err);
 	}
 
 	// Create a variable token
+	const string_type sName(sTok);
 	if (m_pParser->m_bAutoCreateVar)
 	{
 		ptr_val_type val(new Value);                   // Create new value token
 		m_pDynVarShadowValues->push_back(val);         // push to the vector of shadow values
 		a_Tok = ptr_tok_type(new Variable(val.Get())); // bind variable to the new value item
-		(*m_pVarDef)[sTok] = a_Tok;                    // add new variable to the variable list
+		(*m_pVarDef)[sName] = a_Tok;                   // add new variable to the variable list
 	}
 	else
 		a_Tok = ptr_tok_type(new Variable(nullptr));      // bind variable to empty variable
 
-	a_Tok->SetIdent(sTok);
-	m_UsedVar[sTok] = a_Tok;     // add new variable to used-var-list
+	a_Tok->SetIdent(sName);
+	m_UsedVar[sName] = a_Tok;    // add new variable to used-var-list
 
 	m_nPos = iEnd;
 	m_nSynFlags = noVAL | noVAR | noFUN | noBO | noIFX;
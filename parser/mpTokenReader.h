@@ -50,6 +50,7 @@
 #include "mpError.h"
 #include "mpStack.h"
 #include "mpFwdDecl.h"
+#include "mpOprtTrie.h"
 
 MUP_NAMESPACE_START
 
@@ -69,8 +70,11 @@ MUP_NAMESPACE_START
     void Assign(const TokenReader &a_Reader);
     void DeleteValReader();
     void SetParent(ParserXBase *a_pParent);
+    void InvalidateOprtTrie();
+    void BuildOprtTrie();
+    void BuildValReaderDispatch();
 
-    int ExtractToken(const char_type *a_szCharSet, string_type &a_sTok, int a_iPos) const;
+    int ExtractToken(const char_type *a_szCharSet, string_view_type &a_sTok, int a_iPos) const;
 
     void SkipCommentsAndWhitespaces();
     bool IsBuiltIn(ptr_tok_type &t);
@@ -110,9 +114,17 @@ MUP_NAMESPACE_START
     var_maptype  *m_pVarDef;             ///< The only non const pointer to parser internals
 
     readervec_type m_vValueReader;  ///< Value token identification function
+    readervec_type m_vValReaderDispatch[256];  ///< Value readers tried at a position starting with a given character
+    readervec_type m_vValReaderOther;          ///< Value readers tried at characters beyond the dispatch table
     var_maptype m_UsedVar;
     float_type m_fZero;             ///< Dummy value of zero, referenced by undefined variables
 
+    OprtTrie m_OprtTrie;            ///< Longest match of binary operators
+    OprtTrie m_OprtShortcutTrie;    ///< Longest match of short circuit operators
+    OprtTrie m_InfixOprtTrie;       ///< Longest match of infix operators
+    OprtTrie m_PostOprtTrie;        ///< Longest match of postfix operators
+    bool m_bOprtTrieValid;          ///< False if the operators changed since the tries were built
+
   public:
 
     TokenReader(ParserXBase *a_pParent);
@@ -126,6 +138,7 @@ MUP_NAMESPACE_START
     const var_maptype& GetUsedVar() const;
     const token_buf_type& GetTokens() const;
     void SetExpr(const string_type &a_sExpr);
+    void Restore(int a_nPos, const var_maptype &a_UsedVar);
 
     void ReInit();
     ptr_tok_type ReadNextToken();
@@ -37,6 +37,7 @@
 
 //--- Standard include ------------------------------------------------------
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <sstream>
 #include <vector>
@@ -47,6 +48,7 @@
 #include "suSortPred.h"  // We need the string utils sorting predicates
 #include "mpDefines.h"
 #include "mpMatrix.h"
+#include "mpSymbolTable.h"
 
 
 MUP_NAMESPACE_START
@@ -115,34 +117,41 @@ typedef MUP_STRING_TYPE string_type;
 /** \brief Character type of the parser. */
 typedef string_type::value_type char_type;
 
+/** \brief Non owning view of a string used by the tokenizer. */
+typedef std::basic_string_view<char_type> string_view_type;
+
 typedef std::basic_stringstream<char_type, std::char_traits<char_type>, std::allocator<char_type> > stringstream_type;
 
 /** \brief Type of a vector holding pointers to value reader objects. */
 typedef std::vector<IValueReader*> readervec_type;
 
 /** \brief type for the parser variable storage. */
-typedef std::map<string_type, ptr_tok_type> var_maptype;
+typedef SymbolTable<char_type, ptr_tok_type> var_maptype;
 
 /** \brief type of a container used to store parser values.  */
-typedef std::map<string_type, ptr_tok_type> val_maptype;
+typedef SymbolTable<char_type, ptr_tok_type> val_maptype;
+
+/** \brief Type of a container that binds variable names to arrays of values (see ParserXBase::EvalBatch). */
+typedef SymbolTable<char_type, const float_type*> column_maptype;
 
 /** \brief Type of a container that binds Callback object pointer
 	     to operator identifiers. */
-typedef std::map<string_type, ptr_tok_type> fun_maptype;
+typedef SymbolTable<char_type, ptr_tok_type> fun_maptype;
 
 /** \brief Type of a container that short circuit operator object pointer*/
-typedef std::map<string_type, ptr_tok_type> oprt_bin_shortcut_maptype;
+typedef SymbolTable<char_type, ptr_tok_type> oprt_bin_shortcut_maptype;
 
 /** \brief Type of a container that binds Callback object pointer
-	     to operator identifiers. 
+	     to operator identifiers. The longest match is found by the 
+	     operator tries of the token reader.
 */
-typedef std::map<string_type, ptr_tok_type, su::pred::SortByLength<string_type> > oprt_bin_maptype;
+typedef SymbolTable<char_type, ptr_tok_type> oprt_bin_maptype;
 
 /** \brief Type of a map for storing postfix operators by their name. */
-typedef std::map<string_type, ptr_tok_type> oprt_pfx_maptype;
+typedef SymbolTable<char_type, ptr_tok_type> oprt_pfx_maptype;
 
 /** \brief Type of a map for storing infix operators by their name. */
-typedef std::map<string_type, ptr_tok_type> oprt_ifx_maptype;
+typedef SymbolTable<char_type, ptr_tok_type> oprt_ifx_maptype;
 
 //------------------------------------------------------------------------------
 /** \brief Bytecode values.
@@ -188,8 +197,13 @@ enum ECmdCode
     cmSCRIPT_ENDIF      = 28,  ///< Reserved for future use
     cmSCRIPT_FUNCTION   = 29,  ///< Reserved for future use
 
+    // The following codes are created by the optimizer
+    cmSTORE             = 30,  ///< Copy the top of the stack into a temporary slot
+    cmLOAD              = 31,  ///< Push the content of a temporary slot on the stack
+    cmFUSED             = 32,  ///< Superinstruction replacing a short token sequence (see OprtFused)
+
     // misc codes
-    cmUNKNOWN           = 30,  ///< uninitialized item
+    cmUNKNOWN           = 33,  ///< uninitialized item
     cmCOUNT                    ///< Dummy entry for counting the enum values
 }; // ECmdCode
 
@@ -214,6 +228,15 @@ enum EPackages
     pckALL_NON_COMPLEX = pckCOMMON | pckNON_COMPLEX | pckSTRING | pckUNIT | pckMATRIX
 };
 
+//------------------------------------------------------------------------------
+/** \brief Code generation modes of ParserXBase::Compile. */
+enum EJitMode
+{
+    jitNONE   = 0,  ///< Evaluate with the interpreters
+    jitNATIVE = 1,  ///< Translate real valued expressions into machine code if possible
+    jitTIERED = 2   ///< Interpret first, compile expressions evaluated often in the background
+};
+
 //------------------------------------------------------------------------------
 /** \brief Syntax codes.
 
@@ -363,6 +386,12 @@ enum EErrorCodes
     // internal errors
     ecINTERNAL_ERROR            = 51, ///< Internal error of any kind.
 
+    // binary archives
+    ecINVALID_ARCHIVE           = 52, ///< Invalid or incompatible archive of compiled expressions (see RPNArchive)
+
+    // formula graphs
+    ecCYCLIC_DEPENDENCY         = 53, ///< Formulas depend on each other cyclically (see FormulaGraph)
+
     // The last two are special entries
     ecCOUNT,                          ///< This is no error code, It just stores just the total number of error codes
     ecUNDEFINED                 = -1  ///< Undefined message, placeholder to detect unassigned error messages
@@ -36,6 +36,8 @@
 #include "mpError.h"
 #include "mpStringConversionHelper.h"
 
+#include <limits>
+
 MUP_NAMESPACE_START
 
 //------------------------------------------------------------------------------
@@ -53,11 +55,11 @@ DblValReader::~DblValReader()
 {}
 
 
-bool DblValReader::IsValue(const char_type* a_szExpr, int& a_iPos, Value& a_Val)
+bool DblValReader::IsValue(string_view_type a_sExpr, int& a_iPos, Value& a_Val)
 {
 	bool stat;
 	int parsedLen;
-	double val = StringConversionHelper<char_type>::ParseDouble(a_szExpr + a_iPos, parsedLen, stat);
+	double val = StringConversionHelper<char_type>::ParseDouble(a_sExpr.data() + a_iPos, parsedLen, stat);
 	float_type fVal = val;
 
 	if (!stat)
@@ -67,7 +69,7 @@ bool DblValReader::IsValue(const char_type* a_szExpr, int& a_iPos, Value& a_Val)
 
 	// Finally i have to check if the next sign is the "i" for a imaginary unit
 	// if so this is an imaginary value
-	if (a_szExpr[a_iPos] == 'i')
+	if (a_iPos < (int)a_sExpr.length() && a_sExpr[a_iPos] == 'i')
 	{
 		a_Val = cmplx_type(0.0, fVal);
 		a_iPos++;
@@ -81,6 +83,13 @@ bool DblValReader::IsValue(const char_type* a_szExpr, int& a_iPos, Value& a_Val)
 }
 
 
+const char_type* DblValReader::GetStartChars() const
+{
+	// Leading white space, signs, "inf" and "nan" are read as well
+	return _T("0123456789.+-iInN \t\n\v\f\r");
+}
+
+
 IValueReader* DblValReader::Clone(TokenReader* pTokenReader) const
 {
 	IValueReader* pReader = new DblValReader(*this);
@@ -104,17 +113,17 @@ BoolValReader::~BoolValReader()
 {}
 
 
-bool BoolValReader::IsValue(const char_type* a_szExpr, int& a_iPos, Value& a_Val)
+bool BoolValReader::IsValue(string_view_type a_sExpr, int& a_iPos, Value& a_Val)
 {
-	string_type sExpr(a_szExpr + a_iPos);
+	string_view_type sExpr = a_sExpr.substr(a_iPos);
 
-	if (sExpr.find(_T("true")) == 0)
+	if (sExpr.compare(0, 4, _T("true")) == 0)
 	{
 		a_Val = true;
 		a_iPos += 4;
 		return true;
 	}
-	else if (sExpr.find(_T("false")) == 0)
+	else if (sExpr.compare(0, 5, _T("false")) == 0)
 	{
 		a_Val = false;
 		a_iPos += 5;
@@ -125,6 +134,12 @@ bool BoolValReader::IsValue(const char_type* a_szExpr, int& a_iPos, Value& a_Val
 }
 
 
+const char_type* BoolValReader::GetStartChars() const
+{
+	return _T("tf");
+}
+
+
 IValueReader* BoolValReader::Clone(TokenReader* pTokenReader) const
 {
 	IValueReader* pReader = new BoolValReader(*this);
@@ -152,39 +167,49 @@ HexValReader::HexValReader()
 	Hex values must start with a "0x" characters. The position a_iPos is advanded in case
 	a hex value was found.
 	*/
-bool HexValReader::IsValue(const char_type* a_szExpr, int& a_iPos, Value& a_val)
+bool HexValReader::IsValue(string_view_type a_sExpr, int& a_iPos, Value& a_val)
 {
-	std::size_t len = std::char_traits<char_type>::length(a_szExpr);
-	if (a_iPos >= (int)len || a_szExpr[a_iPos + 1] != 'x' || a_szExpr[a_iPos + 1] == 0 || a_szExpr[a_iPos] != '0')
-		return 0;
-
-	unsigned iVal(0);
-
-	stringstream_type::pos_type nPos(0);
-	stringstream_type ss(a_szExpr + a_iPos + 2);
-	ss >> std::hex >> iVal;
-
-	if (ss.fail())
+	std::size_t len = a_sExpr.length();
+	if (a_iPos + 1 >= (int)len || a_sExpr[a_iPos] != '0' || a_sExpr[a_iPos + 1] != 'x')
 		return false;
 
-	if (ss.eof())
-	{
-		// This part sucks but tellg will return -1 if eof is set,
-		// so i need a special treatment for those cases.
-		for (; a_szExpr[a_iPos] != 0; ++a_iPos);
-	}
-	else
+	unsigned iVal(0);
+	std::size_t i = a_iPos + 2;
+	for (; i < len; ++i)
 	{
-		nPos = ss.tellg();
-		assert(nPos > 0);
-		a_iPos += (int)(2 + nPos);
+		char_type c = a_sExpr[i];
+		unsigned iDigit;
+		if (c >= '0' && c <= '9')
+			iDigit = (unsigned)(c - '0');
+		else if (c >= 'a' && c <= 'f')
+			iDigit = (unsigned)(c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F')
+			iDigit = (unsigned)(c - 'A' + 10);
+		else
+			break;
+
+		// Values not fitting into an unsigned integer are not accepted
+		if (iVal > (std::numeric_limits<unsigned>::max() >> 4))
+			return false;
+
+		iVal = (iVal << 4) | iDigit;
 	}
 
+	if (i == (std::size_t)a_iPos + 2)
+		return false;
+
+	a_iPos = (int)i;
 	a_val = (float_type)iVal;
 	return true;
 }
 
 
+const char_type* HexValReader::GetStartChars() const
+{
+	return _T("0");
+}
+
+
 IValueReader* HexValReader::Clone(TokenReader* pTokenReader) const
 {
 	IValueReader* pReader = new HexValReader(*this);
@@ -207,20 +232,20 @@ BinValReader::~BinValReader()
 {}
 
 
-bool BinValReader::IsValue(const char_type* a_szExpr, int& a_iPos, Value& a_Val)
+bool BinValReader::IsValue(string_view_type a_sExpr, int& a_iPos, Value& a_Val)
 {
-	const char_type* szExpr = a_szExpr + a_iPos;
+	string_view_type sExpr = a_sExpr.substr(a_iPos);
 
-	if (szExpr[0] != '0' || (szExpr[1] != 'b' && szExpr[1] != 'B'))
+	if (sExpr.length() < 2 || sExpr[0] != '0' || (sExpr[1] != 'b' && sExpr[1] != 'B'))
 		return false;
 
 	// <ibg 2014-05-26/> Number of bits hardcoded to 32, i can't 
 	//                   store 64 bit integers in double values without 
 	//                   loss. There is no point in accepting them.
 	unsigned iVal = 0, iBits = 32 /*sizeof(iVal)*8*/, i;
-	for (i = 0; (szExpr[i + 2] == '0' || szExpr[i + 2] == '1') && i <= iBits; ++i)
+	for (i = 0; i + 2 < sExpr.length() && (sExpr[i + 2] == '0' || sExpr[i + 2] == '1') && i <= iBits; ++i)
 	{
-		iVal |= (unsigned)(szExpr[i + 2] == '1') << ((iBits - 1) - i);
+		iVal |= (unsigned)(sExpr[i + 2] == '1') << ((iBits - 1) - i);
 	}
 
 	if (i == 0)
@@ -238,6 +263,12 @@ bool BinValReader::IsValue(const char_type* a_szExpr, int& a_iPos, Value& a_Val)
 }
 
 
+const char_type* BinValReader::GetStartChars() const
+{
+	return _T("0");
+}
+
+
 IValueReader* BinValReader::Clone(TokenReader* pTokenReader) const
 {
 	IValueReader* pReader = new BinValReader(*this);
@@ -261,13 +292,14 @@ StrValReader::~StrValReader()
 {}
 
 
-string_type StrValReader::Unescape(const char_type* szExpr, int& nPos)
+string_type StrValReader::Unescape(string_view_type a_sExpr, int& nPos)
 {
 	string_type out;
 	bool bEscape = false;
 
-	for (char_type c = szExpr[nPos]; c != 0; c = szExpr[++nPos])
+	for (; nPos < (int)a_sExpr.length(); ++nPos)
 	{
+		char_type c = a_sExpr[nPos];
 		switch (c)
 		{
 		case '\\':
@@ -313,17 +345,22 @@ string_type StrValReader::Unescape(const char_type* szExpr, int& nPos)
 }
 
 
-bool StrValReader::IsValue(const char_type* a_pszExpr, int& a_iPos, Value& a_Val)
+bool StrValReader::IsValue(string_view_type a_sExpr, int& a_iPos, Value& a_Val)
 {
-	const char_type* szExpr = a_pszExpr + a_iPos;
-	if (szExpr[0] != '"')
+	if (a_iPos >= (int)a_sExpr.length() || a_sExpr[a_iPos] != '"')
 		return false;
 
-	a_Val = Unescape(a_pszExpr, ++a_iPos);
+	a_Val = Unescape(a_sExpr, ++a_iPos);
 	return true;
 }
 
 
+const char_type* StrValReader::GetStartChars() const
+{
+	return _T("\"");
+}
+
+
 IValueReader* StrValReader::Clone(TokenReader* pTokenReader) const
 {
 	IValueReader* pReader = new StrValReader(*this);
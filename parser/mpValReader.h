@@ -55,8 +55,9 @@ MUP_NAMESPACE_START
   public:    
       DblValReader();
       virtual ~DblValReader();
-      virtual bool IsValue(const char_type *a_szExpr, int &a_iPos, Value &a_fVal) override;
+      virtual bool IsValue(string_view_type a_sExpr, int &a_iPos, Value &a_fVal) override;
       virtual IValueReader* Clone(TokenReader *pTokenReader) const override;
+      virtual const char_type* GetStartChars() const override;
   };
 
   //------------------------------------------------------------------------------
@@ -73,8 +74,9 @@ MUP_NAMESPACE_START
   public:    
       BoolValReader();
       virtual ~BoolValReader();
-      virtual bool IsValue(const char_type *a_szExpr, int &a_iPos, Value &a_fVal) override;
+      virtual bool IsValue(string_view_type a_sExpr, int &a_iPos, Value &a_fVal) override;
       virtual IValueReader* Clone(TokenReader *pTokenReader) const override;
+      virtual const char_type* GetStartChars() const override;
   };
 
   //------------------------------------------------------------------------------
@@ -90,8 +92,9 @@ MUP_NAMESPACE_START
   {
   public:    
       HexValReader();
-      virtual bool IsValue(const char_type *a_szExpr, int &a_iPos, Value &a_fVal) override;
+      virtual bool IsValue(string_view_type a_sExpr, int &a_iPos, Value &a_fVal) override;
       virtual IValueReader* Clone(TokenReader *pTokenReader) const override;
+      virtual const char_type* GetStartChars() const override;
   };
 
   //------------------------------------------------------------------------------
@@ -108,8 +111,9 @@ MUP_NAMESPACE_START
   public:    
       BinValReader();
       virtual ~BinValReader();
-      virtual bool IsValue(const char_type *a_szExpr, int &a_iPos, Value &a_fVal) override;
+      virtual bool IsValue(string_view_type a_sExpr, int &a_iPos, Value &a_fVal) override;
       virtual IValueReader* Clone(TokenReader *pTokenReader) const override;
+      virtual const char_type* GetStartChars() const override;
   };
 
   //------------------------------------------------------------------------------
@@ -126,11 +130,12 @@ MUP_NAMESPACE_START
   public:    
       StrValReader();
       virtual ~StrValReader();
-      virtual bool IsValue(const char_type *a_szExpr, int &a_iPos, Value &a_fVal) override;
+      virtual bool IsValue(string_view_type a_sExpr, int &a_iPos, Value &a_fVal) override;
       virtual IValueReader* Clone(TokenReader *pTokenReader) const override;
+      virtual const char_type* GetStartChars() const override;
 
   private:
-      string_type Unescape(const char_type *szExpr, int &len);
+      string_type Unescape(string_view_type a_sExpr, int &a_iPos);
   };
 
 MUP_NAMESPACE_END
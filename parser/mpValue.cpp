@@ -49,6 +49,7 @@ MUP_NAMESPACE_START
 	, m_cType(cType)
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {
 	// strings and arrays must allocate their memory
 	switch (cType)
@@ -67,6 +68,7 @@ Value::Value(int_type a_iVal)
 	, m_cType('i')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {}
 
 //---------------------------------------------------------------------------
@@ -78,6 +80,7 @@ Value::Value(bool_type a_bVal)
 	, m_cType('b')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {}
 
 //---------------------------------------------------------------------------
@@ -89,6 +92,7 @@ Value::Value(string_type a_sVal)
 	, m_cType('s')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {}
 
 //---------------------------------------------------------------------------
@@ -100,6 +104,7 @@ Value::Value(int_type array_size, float_type v)
 	, m_cType('m')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {}
 
 //---------------------------------------------------------------------------
@@ -113,6 +118,7 @@ Value::Value(int_type m, int_type n, float_type v)
 	, m_cType('m')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {}
 
 //---------------------------------------------------------------------------
@@ -124,6 +130,7 @@ Value::Value(const char_type* a_szVal)
 	, m_cType('s')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {}
 
 //---------------------------------------------------------------------------
@@ -135,6 +142,7 @@ Value::Value(const cmplx_type& v)
 	, m_cType('c')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {
 	// modified as suggested here: https://github.com/beltoforion/muparserx/issues/98
 	m_cType = (m_val.imag() == 0) ? ((std::floor(m_val.real()) == m_val.real()) ? 'i' : 'f') : 'c';
@@ -149,6 +157,7 @@ Value::Value(float_type val)
 	, m_cType((val == (int_type)val) ? 'i' : 'f')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {}
 
 //---------------------------------------------------------------------------
@@ -160,6 +169,7 @@ Value::Value(const matrix_type& val)
 	, m_cType('m')
 	, m_iFlags(flNONE)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {}
 
 //---------------------------------------------------------------------------
@@ -168,6 +178,7 @@ Value::Value(const Value& a_Val)
 	, m_psVal(nullptr)
 	, m_pvVal(nullptr)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {
 	Assign(a_Val);
 }
@@ -178,6 +189,7 @@ Value::Value(const IValue& a_Val)
 	, m_psVal(nullptr)
 	, m_pvVal(nullptr)
 	, m_pCache(nullptr)
+	, m_nVersion(0)
 {
 	Reset();
 
@@ -214,6 +226,7 @@ Value::Value(const IValue& a_Val)
 //---------------------------------------------------------------------------
 Value& Value::operator=(const Value& a_Val)
 {
+	++m_nVersion;
 	Assign(a_Val);
 	return *this;
 }
@@ -243,6 +256,9 @@ IValue& Value::At(const IValue& row, const IValue& col)
 //---------------------------------------------------------------------------
 IValue& Value::At(int nRow, int nCol)
 {
+	// Elements may be modified through the returned reference
+	++m_nVersion;
+
 	if (IsMatrix())
 	{
 		if (nRow >= m_pvVal->GetRows() || nCol >= m_pvVal->GetCols() || nRow < 0 || nCol < 0)
@@ -343,6 +359,7 @@ void Value::Reset()
 //---------------------------------------------------------------------------
 IValue& Value::operator=(bool val)
 {
+	++m_nVersion;
 	m_val = cmplx_type((float_type)val, 0);
 
 	delete m_psVal;
@@ -359,6 +376,7 @@ IValue& Value::operator=(bool val)
 //---------------------------------------------------------------------------
 IValue& Value::operator=(int_type a_iVal)
 {
+	++m_nVersion;
 	m_val = cmplx_type((float_type)a_iVal, (float_type)0.0);
 
 	delete m_psVal;
@@ -375,6 +393,7 @@ IValue& Value::operator=(int_type a_iVal)
 //---------------------------------------------------------------------------
 IValue& Value::operator=(float_type val)
 {
+	++m_nVersion;
 	m_val = cmplx_type(val, 0);
 
 	delete m_psVal;
@@ -391,6 +410,7 @@ IValue& Value::operator=(float_type val)
 //---------------------------------------------------------------------------
 IValue& Value::operator=(string_type a_sVal)
 {
+	++m_nVersion;
 	m_val = cmplx_type();
 
 	if (!m_psVal)
@@ -409,6 +429,7 @@ IValue& Value::operator=(string_type a_sVal)
 //---------------------------------------------------------------------------
 IValue& Value::operator=(const char_type* a_szVal)
 {
+	++m_nVersion;
 	m_val = cmplx_type();
 
 	if (!m_psVal)
@@ -427,6 +448,7 @@ IValue& Value::operator=(const char_type* a_szVal)
 //---------------------------------------------------------------------------
 IValue& Value::operator=(const matrix_type& a_vVal)
 {
+	++m_nVersion;
 	m_val = cmplx_type(0, 0);
 
 	delete m_psVal;
@@ -446,6 +468,7 @@ IValue& Value::operator=(const matrix_type& a_vVal)
 //---------------------------------------------------------------------------
 IValue& Value::operator=(const cmplx_type& val)
 {
+	++m_nVersion;
 	m_val = val;
 
 	delete m_psVal;
@@ -465,6 +488,7 @@ IValue& Value::operator=(const cmplx_type& val)
 //---------------------------------------------------------------------------
 IValue& Value::operator+=(const IValue& val)
 {
+	++m_nVersion;
 	if (IsScalar() && val.IsScalar())
 	{
 		// Scalar/Scalar addition
@@ -497,6 +521,7 @@ IValue& Value::operator+=(const IValue& val)
 //---------------------------------------------------------------------------
 IValue& Value::operator-=(const IValue& val)
 {
+	++m_nVersion;
 	if (IsScalar() && val.IsScalar())
 	{
 		// Scalar/Scalar addition
@@ -531,6 +556,7 @@ IValue& Value::operator-=(const IValue& val)
 	*/
 IValue& Value::operator*=(const IValue& val)
 {
+	++m_nVersion;
 	if (IsScalar() && val.IsScalar())
 	{
 		// Scalar/Scalar multiplication
@@ -575,6 +601,18 @@ IValue& Value::operator*=(const IValue& val)
 	return *this;
 }
 
+//---------------------------------------------------------------------------
+/** \brief Returns a counter incremented by each modification of the value.
+
+	Used by ParserXBase to detect whether the variables of an expression 
+	changed since its last evaluation. Only the assignment operators and 
+	non const access to matrix elements count as modification.
+*/
+std::size_t Value::GetVersion() const
+{
+	return m_nVersion;
+}
+
 //---------------------------------------------------------------------------
 /** \brief Returns a character representing the type of this value instance.
 	\return m_cType Either one of 'c' for comlex, 'i' for integer,
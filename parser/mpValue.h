@@ -100,6 +100,7 @@ MUP_NAMESPACE_START
     virtual const matrix_type& GetArray() const override;
     virtual int GetRows() const override;
     virtual int GetCols() const override;
+    virtual std::size_t GetVersion() const override;
 
     virtual bool IsVariable() const override;
 
@@ -124,6 +125,7 @@ MUP_NAMESPACE_START
     char_type    m_cType;  ///< A byte indicating the type os the represented value
     EFlags       m_iFlags; ///< Additional flags
     ValueCache  *m_pCache; ///< Pointer to the Value Cache
+    std::size_t  m_nVersion; ///< Incremented by each modification
 
     void CheckType(char_type a_cType) const;
     void Assign(const Value &a_Val);
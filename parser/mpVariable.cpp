@@ -322,6 +322,14 @@ MUP_NAMESPACE_START
         }
     }
 
+  //-----------------------------------------------------------------------------------------------
+  /** \brief Returns the modification counter of the bound value. */
+  std::size_t Variable::GetVersion() const
+  {
+    assert(m_pVal);
+    return m_pVal->GetVersion();
+  }
+
   //-----------------------------------------------------------------------------------------------
   void Variable::SetFloat(float_type a_fVal)
   {
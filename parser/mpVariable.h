@@ -84,6 +84,7 @@ MUP_NAMESPACE_START
     virtual const matrix_type& GetArray() const;
     virtual int GetRows() const;
     virtual int GetCols() const;
+    virtual std::size_t GetVersion() const;
 
     virtual bool IsVariable() const;
     virtual IToken* Clone() const;
@@ -78,7 +78,9 @@ class FunPrint : public ICallback
 {
 public:
 	FunPrint() : ICallback(cmFUNC, _T("print"), 1)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* a_pArg, int /*a_iArgc*/)
 	{
@@ -126,7 +128,9 @@ class FunListVar : public ICallback
 public:
 
 	FunListVar() : ICallback(cmFUNC, _T("list_var"), 0)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* /*a_pArg*/, int /*a_iArgc*/)
 	{
@@ -176,7 +180,9 @@ class FunListConst : public ICallback
 public:
 
 	FunListConst() : ICallback(cmFUNC, _T("list_const"), 0)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* /*a_pArg*/, int /*a_iArgc*/)
 	{
@@ -212,12 +218,57 @@ public:
 }; // class FunListConst
 
 
+//-------------------------------------------------------------------------------------------------
+/** \brief Expressions used by the benchmark functions. */
+static const char_type* g_sBenchExpr[] = {
+	_T("sin(a)"),
+	_T("cos(a)"),
+	_T("tan(a)"),
+	_T("sqrt(a)"),
+	_T("(a+b)*3"),
+	_T("a^2+b^2"),
+	_T("a^3+b^3"),
+	_T("a^4+b^4"),
+	_T("a^5+b^5"),
+	_T("a*2+b*2"),
+	_T("-(b^1.1)"),
+	_T("a + b * c"),
+	_T("a * b + c"),
+	_T("a+b*(a+b)"),
+	_T("(1+b)*(-3)"),
+	_T("e^log(7*a)"),
+	_T("10^log(3+b)"),
+	_T("a+b-e*pi/5^6"),
+	_T("a^b/e*pi-5+6"),
+	_T("sin(a)+sin(b)"),
+	_T("(cos(2.41)/b)"),
+	_T("-(sin(pi+a)+1)"),
+	_T("a-(e^(log(7+b)))"),
+	_T("sin(((a-a)+b)+a)"),
+	_T("((0.09/a)+2.58)-1.67"),
+	_T("abs(sin(sqrt(a^2+b^2))*255)"),
+	_T("abs(sin(sqrt(a*a+b*b))*255)"),
+	_T("cos(0.90-((cos(b)/2.89)/e)/a)"),
+	_T("(1*(2*(3*(4*(5*(6*(a+b)))))))"),
+	_T("abs(sin(sqrt(a^2.1+b^2.1))*255)"),
+	_T("(1*(2*(3*(4*(5*(6*(7*(a+b))))))))"),
+	_T("1/(a*sqrt(2*pi))*e^(-0.5*((b-a)/a)^2)"),
+	_T("1+2-3*4/5^6*(2*(1-5+(3*7^9)*(4+6*7-3)))+12"),
+	_T("1+b-3*4/5^6*(2*(1-5+(3*7^9)*(4+6*7-3)))+12*a"),
+	_T("(b+1)*(b+2)*(b+3)*(b+4)*(b+5)*(b+6)*(b+7)*(b+8)*(b+9)*(b+10)*(b+11)*(b+12)"),
+	_T("(a/((((b+(((e*(((((pi*((((3.45*((pi+a)+pi))+b)+b)*a))+0.68)+e)+a)/a))+a)+b))+b)*a)-pi))"),
+	_T("(((-9))-e/(((((((pi-(((-7)+(-3)/4/e))))/(((-5))-2)-((pi+(-0))*(sqrt((e+e))*(-8))*(((-pi)+(-pi)-(-9)*(6*5))/(-e)-e))/2)/((((sqrt(2/(-e)+6)-(4-2))+((5/(-2))/(1*(-pi)+3))/8)*pi*((pi/((-2)/(-6)*1*(-1))*(-6)+(-e)))))/((e+(-2)+(-e)*((((-3)*9+(-e)))+(-9)))))))-((((e-7+(((5/pi-(3/1+pi)))))/e)/(-5))/(sqrt((((((1+(-7))))+((((-e)*(-e)))-8))*(-5)/((-e)))*(-6)-((((((-2)-(-9)-(-e)-1)/3))))/(sqrt((8+(e-((-6))+(9*(-9))))*(((3+2-8))*(7+6+(-5))+((0/(-e)*(-pi))+7)))+(((((-e)/e/e)+((-6)*5)*e+(3+(-5)/pi))))+pi))/sqrt((((9))+((((pi))-8+2))+pi))/e*4)*((-5)/(((-pi))*(sqrt(e)))))-(((((((-e)*(e)-pi))/4+(pi)*(-9)))))))+(-pi)"),
+	0 };
+
+
 //-------------------------------------------------------------------------------------------------
 class FunBenchmark : public ICallback
 {
 public:
 	FunBenchmark() : ICallback(cmFUNC, _T("bench"), 0)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* /*a_pArg*/, int /*a_iArgc*/)
 	{
@@ -241,45 +292,7 @@ public:
 		strftime(outstr, sizeof(outstr), "Result_%Y%m%d_%H%M%S_release.txt", &newtime);
 #endif
 
-		const char_type* sExpr[] = {
-									 _T("sin(a)"),
-									 _T("cos(a)"),
-									 _T("tan(a)"),
-									 _T("sqrt(a)"),
-									 _T("(a+b)*3"),
-									 _T("a^2+b^2"),
-									 _T("a^3+b^3"),
-									 _T("a^4+b^4"),
-									 _T("a^5+b^5"),
-									 _T("a*2+b*2"),
-									 _T("-(b^1.1)"),
-									 _T("a + b * c"),
-									 _T("a * b + c"),
-									 _T("a+b*(a+b)"),
-									 _T("(1+b)*(-3)"),
-									 _T("e^log(7*a)"),
-									 _T("10^log(3+b)"),
-									 _T("a+b-e*pi/5^6"),
-									 _T("a^b/e*pi-5+6"),
-									 _T("sin(a)+sin(b)"),
-									 _T("(cos(2.41)/b)"),
-									 _T("-(sin(pi+a)+1)"),
-									 _T("a-(e^(log(7+b)))"),
-									 _T("sin(((a-a)+b)+a)"),
-									 _T("((0.09/a)+2.58)-1.67"),
-									 _T("abs(sin(sqrt(a^2+b^2))*255)"),
-									 _T("abs(sin(sqrt(a*a+b*b))*255)"),
-									 _T("cos(0.90-((cos(b)/2.89)/e)/a)"),
-									 _T("(1*(2*(3*(4*(5*(6*(a+b)))))))"),
-									 _T("abs(sin(sqrt(a^2.1+b^2.1))*255)"),
-									 _T("(1*(2*(3*(4*(5*(6*(7*(a+b))))))))"),
-									 _T("1/(a*sqrt(2*pi))*e^(-0.5*((b-a)/a)^2)"),
-									 _T("1+2-3*4/5^6*(2*(1-5+(3*7^9)*(4+6*7-3)))+12"),
-									 _T("1+b-3*4/5^6*(2*(1-5+(3*7^9)*(4+6*7-3)))+12*a"),
-									 _T("(b+1)*(b+2)*(b+3)*(b+4)*(b+5)*(b+6)*(b+7)*(b+8)*(b+9)*(b+10)*(b+11)*(b+12)"),
-									 _T("(a/((((b+(((e*(((((pi*((((3.45*((pi+a)+pi))+b)+b)*a))+0.68)+e)+a)/a))+a)+b))+b)*a)-pi))"),
-									 _T("(((-9))-e/(((((((pi-(((-7)+(-3)/4/e))))/(((-5))-2)-((pi+(-0))*(sqrt((e+e))*(-8))*(((-pi)+(-pi)-(-9)*(6*5))/(-e)-e))/2)/((((sqrt(2/(-e)+6)-(4-2))+((5/(-2))/(1*(-pi)+3))/8)*pi*((pi/((-2)/(-6)*1*(-1))*(-6)+(-e)))))/((e+(-2)+(-e)*((((-3)*9+(-e)))+(-9)))))))-((((e-7+(((5/pi-(3/1+pi)))))/e)/(-5))/(sqrt((((((1+(-7))))+((((-e)*(-e)))-8))*(-5)/((-e)))*(-6)-((((((-2)-(-9)-(-e)-1)/3))))/(sqrt((8+(e-((-6))+(9*(-9))))*(((3+2-8))*(7+6+(-5))+((0/(-e)*(-pi))+7)))+(((((-e)/e/e)+((-6)*5)*e+(3+(-5)/pi))))+pi))/sqrt((((9))+((((pi))-8+2))+pi))/e*4)*((-5)/(((-pi))*(sqrt(e)))))-(((((((-e)*(e)-pi))/4+(pi)*(-9)))))))+(-pi)"),
-									 0 };
+		const char_type** sExpr = g_sBenchExpr;
 
 
 
@@ -378,12 +391,160 @@ public:
 }; // class FunBenchmark
 
 
+//-------------------------------------------------------------------------------------------------
+class FunBenchmarkVM : public ICallback
+{
+public:
+	FunBenchmarkVM() : ICallback(cmFUNC, _T("bench_vm"), 0)
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
+
+	virtual void Eval(ptr_val_type& ret, const ptr_val_type* /*a_pArg*/, int /*a_iArgc*/)
+	{
+		Value a((float_type)1.0);
+		Value b((float_type)2.0);
+		Value c((float_type)3.0);
+
+		// Both parsers use the generic engine, one with the value stack and one with register code
+		ParserX parser[2];
+		for (int k = 0; k < 2; ++k)
+		{
+			parser[k].EnableRealEngine(false);
+			parser[k].EnableRegisterCode(k == 1);
+			parser[k].DefineVar(_T("a"), Variable(&a));
+			parser[k].DefineVar(_T("b"), Variable(&b));
+			parser[k].DefineVar(_T("c"), Variable(&c));
+		}
+
+		int iCount = 400000;
+		double avg_speedup = 0;
+		int ct = 0;
+
+		console() << _T("\"Eqn no.\", \"stack eval per second\", \"register eval per second\", \"speedup\", \"expr\"\n");
+		for (int i = 0; g_sBenchExpr[i]; ++i)
+		{
+			double eval_per_sec[2];
+			for (int k = 0; k < 2; ++k)
+			{
+				parser[k].SetExpr(g_sBenchExpr[i]);
+
+				// implicitely create reverse polish notation
+				parser[k].Eval();
+
+				StartTimer();
+				for (int n = 0; n < iCount; ++n)
+					parser[k].Eval();
+
+				eval_per_sec[k] = (double)iCount * 1000.0 / StopTimer();
+			}
+
+			double speedup = eval_per_sec[1] / eval_per_sec[0];
+			avg_speedup += speedup;
+			ct++;
+
+			console() << _T("Eqn_") << i << _T(", ")
+				      << (long)eval_per_sec[0] << _T(", ")
+				      << (long)eval_per_sec[1] << _T(", ")
+				      << speedup << _T(", ")
+				      << g_sBenchExpr[i] << _T("\n");
+		}
+
+		avg_speedup /= (double)ct;
+		console() << _T("# Average speedup: ") << avg_speedup << _T("\n");
+
+		*ret = (float_type)avg_speedup;
+	}
+
+	virtual const char_type* GetDesc() const
+	{
+		return _T("bench_vm() - Compare the stack based engine with register code on the benchmark expressions and return the average speedup.");
+	}
+
+	virtual IToken* Clone() const
+	{
+		return new FunBenchmarkVM(*this);
+	}
+}; // class FunBenchmarkVM
+
+
+//-------------------------------------------------------------------------------------------------
+class FunBenchmarkParse : public ICallback
+{
+public:
+	FunBenchmarkParse() : ICallback(cmFUNC, _T("bench_parse"), 0)
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
+
+	virtual void Eval(ptr_val_type& ret, const ptr_val_type* /*a_pArg*/, int /*a_iArgc*/)
+	{
+		Value a((float_type)1.0);
+		Value b((float_type)2.0);
+
+		ParserX parser;
+		parser.DefineVar(_T("a"), Variable(&a));
+		parser.DefineVar(_T("b"), Variable(&b));
+
+		// Generated expressions from 2 KB to 512 KB; each size parses about 
+		// the same number of characters
+		const string_type sTerm = _T("sin(a)*0.5+b^2-0x1f/(a+1.5e0)+");
+		const std::size_t nChars = 2 * 1024 * 1024;
+		double time_per_char[2] = { 0, 0 };
+
+		console() << _T("\"Length\", \"parse time [us]\", \"parse time per KB [us]\"\n");
+		for (std::size_t nLen = 2048; nLen <= 512 * 1024; nLen *= 2)
+		{
+			string_type sExpr;
+			while (sExpr.length() + sTerm.length() < nLen)
+				sExpr += sTerm;
+			sExpr += _T("a");
+
+			std::size_t iCount = nChars / sExpr.length();
+
+			// SetExpr tokenizes the expression when it is evaluated for the first time
+			StartTimer();
+			for (std::size_t n = 0; n < iCount; ++n)
+			{
+				parser.SetExpr(sExpr);
+				parser.Eval();
+			}
+
+			double us = StopTimer() * 1000.0 / (double)iCount;
+			time_per_char[nLen == 2048 ? 0 : 1] = us / (double)sExpr.length();
+
+			console() << sExpr.length() << _T(", ")
+				      << us << _T(", ")
+				      << us * 1024.0 / (double)sExpr.length() << _T("\n");
+		}
+
+		// 1 if the parse time grows linearly with the length
+		double ratio = time_per_char[1] / time_per_char[0];
+		console() << _T("# Time per character of the longest over the shortest expression: ") << ratio << _T("\n");
+
+		*ret = (float_type)ratio;
+	}
+
+	virtual const char_type* GetDesc() const
+	{
+		return _T("bench_parse() - Parse generated expressions from 2 KB to 512 KB and return the ratio of the time per character of the longest and the shortest one.");
+	}
+
+	virtual IToken* Clone() const
+	{
+		return new FunBenchmarkParse(*this);
+	}
+}; // class FunBenchmarkParse
+
+
 //-------------------------------------------------------------------------------------------------
 class FunListFunctions : public ICallback
 {
 public:
 	FunListFunctions() : ICallback(cmFUNC, _T("list_fun"), 0)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* /*a_pArg*/, int /*a_iArgc*/)
 	{
@@ -427,7 +588,9 @@ class FunEnableOptimizer : public ICallback
 {
 public:
 	FunEnableOptimizer() : ICallback(cmFUNC, _T("enable_optimizer"), 1)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* a_pArg, int /*a_iArgc*/)
 	{
@@ -452,7 +615,9 @@ class FunSelfTest : public ICallback
 {
 public:
 	FunSelfTest() : ICallback(cmFUNC, _T("test"), 0)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* /*a_pArg*/, int /*a_iArgc*/)
 	{
@@ -478,7 +643,9 @@ class FunEnableDebugDump : public ICallback
 {
 public:
 	FunEnableDebugDump() : ICallback(cmFUNC, _T("debug"), 2)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* a_pArg, int /*a_iArgc*/)
 	{
@@ -521,7 +688,9 @@ class FunLang : public ICallback
 {
 public:
 	FunLang() : ICallback(cmFUNC, _T("lang"), 1)
-	{}
+	{
+		AddFlags(IToken::flVOLATILE);
+	}
 
 	virtual void Eval(ptr_val_type& ret, const ptr_val_type* a_pArg, int /*a_iArgc*/)
 	{
@@ -764,6 +933,8 @@ void Calc()
 	parser.DefineFun(new FunListFunctions);
 	parser.DefineFun(new FunListConst);
 	parser.DefineFun(new FunBenchmark);
+	parser.DefineFun(new FunBenchmarkVM);
+	parser.DefineFun(new FunBenchmarkParse);
 	parser.DefineFun(new FunEnableOptimizer);
 	parser.DefineFun(new FunSelfTest);
 	parser.DefineFun(new FunEnableDebugDump);